@@ -362,7 +362,12 @@
  * configCHECK_FOR_STACK_OVERFLOW is set to 1. See
  * https://www.freertos.org/Stacks-and-stack-overflow-checking.html  Defaults to
  * 0 if left undefined. */
+/* Checked in debug builds; vApplicationStackOverflowHook() is in main.c. */
+#ifndef NDEBUG
+#define configCHECK_FOR_STACK_OVERFLOW        2
+#else
 #define configCHECK_FOR_STACK_OVERFLOW        0
+#endif
 
 /******************************************************************************/
 /* Run time and task stats gathering related definitions. *********************/
@@ -379,7 +384,7 @@
  * are used by trace and visualisation functions and tools.  Set to 0 to exclude
  * the additional information from the structures. Defaults to 0 if left
  * undefined. */
-#define configUSE_TRACE_FACILITY                0
+#define configUSE_TRACE_FACILITY                1
 
 /* Set to 1 to include the vTaskList() and vTaskGetRunTimeStats() functions in
  * the build.  Set to 0 to exclude these functions from the build.  These two
@@ -437,6 +442,13 @@
 #define configSMP_SPINLOCK_0    PICO_SPINLOCK_ID_OS1
 #define configSMP_SPINLOCK_1    PICO_SPINLOCK_ID_OS2
 
+/******************************************************************************/
+/* Trace hook definitions. ****************************************************/
+/******************************************************************************/
+
+/* Application trace recorder hooks (traceTASK_SWITCHED_IN etc.). */
+#include "trace_hooks.h"
+
 /******************************************************************************/
 /* FreeRTOS MPU specific definitions. *****************************************/
 /******************************************************************************/
@@ -535,8 +547,10 @@
  * affinity feature is enabled, the vTaskCoreAffinitySet and
  * vTaskCoreAffinityGet APIs can be used to set and retrieve which cores a task
  * can run on. If configUSE_CORE_AFFINITY is set to 0 then the FreeRTOS
- * scheduler is free to run any task on any available core. */
-#define configUSE_CORE_AFFINITY                   0
+ * scheduler is free to run any task on any available core.  Enabled for the
+ * pico-sdk flash_safe_execute() helper, which pins a task to the other core to
+ * park it while flash is written; no task of this firmware sets an affinity. */
+#define configUSE_CORE_AFFINITY                   1
 
 /* When using SMP with core affinity feature enabled, set
  * configTASK_DEFAULT_CORE_AFFINITY to change the default core affinity mask for
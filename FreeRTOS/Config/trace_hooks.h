@@ -0,0 +1,82 @@
+#ifndef TRACE_HOOKS_H
+#define TRACE_HOOKS_H
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Set to 0 to compile every trace hook out. */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED (1)
+#endif
+
+/* Kernel events. */
+#define TRACE_EV_TASK_CREATE (0x01U)   /* arg: TCB number, data: first 4 name chars. */
+#define TRACE_EV_TASK_IN (0x02U)       /* arg: TCB number.                           */
+#define TRACE_EV_TASK_OUT (0x03U)      /* arg: TCB number.                           */
+#define TRACE_EV_QUEUE_SEND (0x04U)    /* data: queue address.                       */
+#define TRACE_EV_QUEUE_RECEIVE (0x05U) /* data: queue address.                       */
+#define TRACE_EV_QUEUE_FULL (0x06U)    /* data: queue address.                       */
+#define TRACE_EV_NOTIFY (0x07U)        /* arg: notification index.                   */
+#define TRACE_EV_NOTIFY_TAKE (0x08U)   /* arg: notification index.                   */
+
+/* Application events. */
+#define TRACE_EV_ISR_ENTER (0x20U)  /* arg: IRQ number.                 */
+#define TRACE_EV_ISR_EXIT (0x21U)   /* arg: IRQ number.                 */
+#define TRACE_EV_FRAME_RX (0x22U)   /* arg: channel, data: identifier.  */
+#define TRACE_EV_FILTER (0x23U)     /* arg: 1 if forwarded, data: id.   */
+#define TRACE_EV_ENQUEUE (0x24U)    /* arg: record type, data: size.    */
+#define TRACE_EV_USB_FLUSH (0x25U)  /* data: bytes written.             */
+
+#if TRACE_ENABLED && !defined(__ASSEMBLER__)
+
+#include <stdint.h>
+
+void traceRecord(uint32_t event, uint32_t arg, uint32_t data);
+
+/* -------------------------------------------------------------------------- */
+/* FreeRTOS trace macros                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* These expand inside tasks.c and queue.c, where the TCB and queue */
+/* structures are visible. uxTCBNumber needs configUSE_TRACE_FACILITY. */
+#define traceTASK_CREATE(pxNewTCB)                                         \
+    traceRecord(TRACE_EV_TASK_CREATE, (pxNewTCB)->uxTCBNumber,             \
+                ((uint32_t)(uint8_t)(pxNewTCB)->pcTaskName[0]) |           \
+                    ((uint32_t)(uint8_t)(pxNewTCB)->pcTaskName[1] << 8) |  \
+                    ((uint32_t)(uint8_t)(pxNewTCB)->pcTaskName[2] << 16) | \
+                    ((uint32_t)(uint8_t)(pxNewTCB)->pcTaskName[3] << 24))
+
+#define traceTASK_SWITCHED_IN() \
+    traceRecord(TRACE_EV_TASK_IN, pxCurrentTCBs[portGET_CORE_ID()]->uxTCBNumber, 0)
+
+#define traceTASK_SWITCHED_OUT() \
+    traceRecord(TRACE_EV_TASK_OUT, pxCurrentTCBs[portGET_CORE_ID()]->uxTCBNumber, 0)
+
+#define traceQUEUE_SEND(pxQueue) \
+    traceRecord(TRACE_EV_QUEUE_SEND, 0, (uint32_t)(pxQueue))
+
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) \
+    traceRecord(TRACE_EV_QUEUE_SEND, 1, (uint32_t)(pxQueue))
+
+#define traceQUEUE_SEND_FAILED(pxQueue) \
+    traceRecord(TRACE_EV_QUEUE_FULL, 0, (uint32_t)(pxQueue))
+
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue) \
+    traceRecord(TRACE_EV_QUEUE_FULL, 1, (uint32_t)(pxQueue))
+
+#define traceQUEUE_RECEIVE(pxQueue) \
+    traceRecord(TRACE_EV_QUEUE_RECEIVE, 0, (uint32_t)(pxQueue))
+
+#define traceTASK_NOTIFY(uxIndexToNotify) \
+    traceRecord(TRACE_EV_NOTIFY, (uxIndexToNotify), 0)
+
+#define traceTASK_NOTIFY_GIVE_FROM_ISR(uxIndexToNotify) \
+    traceRecord(TRACE_EV_NOTIFY, (uxIndexToNotify), 1)
+
+#define traceTASK_NOTIFY_TAKE(uxIndexToWaitOn) \
+    traceRecord(TRACE_EV_NOTIFY_TAKE, (uxIndexToWaitOn), 0)
+
+#endif /* TRACE_ENABLED && !defined(__ASSEMBLER__) */
+
+#endif /* TRACE_HOOKS_H */
@@ -0,0 +1,966 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <hardware/structs/systick.h>
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include "bridge.h"
+#include "protocol.h"
+#include "channel.h"
+#include "can_signal.h"
+#include "dedup.h"
+#include "nv_config.h"
+#include "gateway.h"
+#include "pipeline.h"
+#include "mem_profile.h"
+#include "clock_sync.h"
+#include "pack.h"
+#include "self_test.h"
+#include "stats.h"
+#include "trace.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Encoded records waiting to be handed to the transport. Large enough for */
+/* the signal records produced by a single frame.                          */
+#define OUT_BUFF_SIZE (PROTO_MAX_RECORD * 4U)
+
+/* Encoded command responses. */
+#define RESP_BUFF_SIZE (PROTO_MAX_RECORD)
+
+/* Signal updates per PROTO_REC_SIGNAL record. */
+#define SIGNALS_PER_RECORD ((PROTO_MAX_PAYLOAD - 4U) / SIGNAL_UPDATE_WIRE_SIZE)
+
+/* PROTO_REC_STATS pages: the global counters, then one per channel. */
+#define STATS_PAGE_GLOBAL (0U)
+#define STATS_PAGE_NUM (1U + CAN_CHANNEL_NUM)
+#define STATS_PAGE_MAX (((uint32_t)STAT_GLOBAL_NUM > (uint32_t)STAT_CH_NUM) ? STAT_GLOBAL_NUM : STAT_CH_NUM)
+
+_Static_assert(1U + STAT_GLOBAL_NUM * 8U <= PROTO_MAX_PAYLOAD, "global statistics do not fit a record");
+_Static_assert(1U + STAT_CH_NUM * 8U <= PROTO_MAX_PAYLOAD, "channel statistics do not fit a record");
+
+/* Page ch + 1 reads STAT_CH_NUM counters from STAT_CH(ch, 0): each one */
+/* that exists must carry the rate limit counters, within STAT_NUM.     */
+#define STATS_PAGE_HAS(ch, id) \
+    (((ch) >= CAN_CHANNEL_NUM) || (((id) < STAT_CH_NUM) && ((uint32_t)STAT_CH(ch, id) < STAT_NUM)))
+
+_Static_assert(STATS_PAGE_HAS(0U, STAT_CH_TX_SHAPED) && STATS_PAGE_HAS(0U, STAT_CH_TX_LIMITED),
+               "channel 0 page misses the rate limit counters");
+_Static_assert(STATS_PAGE_HAS(1U, STAT_CH_TX_SHAPED) && STATS_PAGE_HAS(1U, STAT_CH_TX_LIMITED),
+               "channel 1 page misses the rate limit counters");
+_Static_assert(STATS_PAGE_HAS(2U, STAT_CH_TX_SHAPED) && STATS_PAGE_HAS(2U, STAT_CH_TX_LIMITED),
+               "channel 2 page misses the rate limit counters");
+_Static_assert(STATS_PAGE_HAS(3U, STAT_CH_TX_SHAPED) && STATS_PAGE_HAS(3U, STAT_CH_TX_LIMITED),
+               "channel 3 page misses the rate limit counters");
+
+/* Fixed part of a PROTO_CMD_TX_FRAME payload. */
+#define TX_FRAME_HEADER_SIZE (7U)
+
+/* Longest measurement kept: SysTick wraps once a tick. */
+#define CYCLES_MAX_US (1000000U / configTICK_RATE_HZ)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Start of a cycle count. */
+typedef struct
+{
+    uint32_t start; /* SysTick value. */
+    uint32_t startUs;
+    uint32_t core;
+    bool isValid;
+} Cycles_t;
+
+/* Output state of one host link. */
+typedef struct
+{
+    uint8_t out[OUT_BUFF_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint8_t resp[RESP_BUFF_SIZE];
+    uint32_t respLen;
+    uint8_t nextChannel; /* Round robin position over the channels. */
+    PackEncoder_t pack;  /* Stream state in BRIDGE_MODE_PACKED.       */
+} BridgeLink_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static void onCommand(uint8_t type, const uint8_t *payload, uint8_t len, void *ctx);
+static void applyConfig(void);
+static uint8_t transmit(const uint8_t *payload, uint8_t len);
+static void respond(uint8_t type, const uint8_t *payload, uint8_t len);
+static void acknowledge(uint8_t cmd, uint8_t result);
+static uint8_t channelLink(uint8_t ch);
+static bool produce(uint8_t link);
+static void encodeSignals(const CanFrame_t *frame);
+static void encodeRaw(const CanFrame_t *frame);
+static void encodePacked(const CanFrame_t *frame);
+static void emitPacked(void);
+static void cyclesBegin(Cycles_t *mark);
+static void cyclesEnd(const Cycles_t *mark, StatId_t cycles, StatId_t timed);
+static bool cyclesRead(uint32_t *value, uint32_t *core);
+static void encodeSummary(const DedupSummary_t *summary);
+static void emit(uint8_t type, const uint8_t *payload, uint8_t len);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static SemaphoreHandle_t gLock = NULL;
+static StaticSemaphore_t gLockDef;
+
+static ProtoParser_t gParsers[BRIDGE_LINK_NUM];
+static BridgeLink_t gLinks[BRIDGE_LINK_NUM];
+
+/* Link that sent the last valid command. */
+static uint8_t gControlLink = BRIDGE_LINK_CDC(0);
+
+/* Link being filled by produce() and emit(). */
+static BridgeLink_t *gCur = NULL;
+
+static uint8_t gMode = BRIDGE_MODE_RAW;
+
+/* Settings as last applied, kept in step with the commands so that */
+/* PROTO_CMD_CONFIG_SAVE can store them as they are.                */
+static NvConfig_t gConfig;
+static uint16_t gSignalStaged = 0; /* Definitions since the last clear. */
+static bool gIsSignalDirty = false;
+static uint8_t gRouteStaged = 0; /* Routes since the last clear. */
+static bool gIsRouteDirty = false;
+static uint8_t gRateStaged = 0; /* Rate limits since the last clear. */
+static bool gIsRateDirty = false;
+
+/* Set once the first frame has been forwarded. */
+static bool gIsForwarding = false;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void bridgeInit(void)
+{
+    gLock = xSemaphoreCreateMutexStatic(&gLockDef);
+
+    for (uint8_t link = 0; link < BRIDGE_LINK_NUM; link++)
+    {
+        protoParserInit(&gParsers[link]);
+        gLinks[link].head = 0;
+        gLinks[link].tail = 0;
+        gLinks[link].respLen = 0;
+        gLinks[link].nextChannel = 0;
+        packInit(&gLinks[link].pack);
+    }
+    channelInit();
+    signalInit();
+    dedupInit();
+    gatewayInit();
+    nvConfigDefaults(&gConfig);
+}
+
+bool bridgeLoadConfig(void)
+{
+    uint32_t start = time_us_32();
+
+    if (!nvConfigLoad(&gConfig))
+    {
+        return false;
+    }
+
+    applyConfig();
+    statsAdd(STAT_CONFIG_APPLY_US, time_us_32() - start);
+
+    return true;
+}
+
+void bridgeHostInput(uint8_t link, const uint8_t *data, uint32_t size)
+{
+    xSemaphoreTake(gLock, portMAX_DELAY);
+    protoParserFeed(&gParsers[link], data, size, onCommand, &gParsers[link]);
+    xSemaphoreGive(gLock);
+}
+
+uint32_t bridgeHostOutput(uint8_t link, uint8_t *buff, uint32_t size)
+{
+    BridgeLink_t *out = &gLinks[link];
+    uint32_t count = 0;
+
+    xSemaphoreTake(gLock, portMAX_DELAY);
+
+    while (count < size)
+    {
+        /* Refill from the next response or frame. */
+        if ((out->head == out->tail) && !produce(link))
+        {
+            break;
+        }
+
+        uint32_t chunk = out->tail - out->head;
+        if (chunk > size - count)
+        {
+            chunk = size - count;
+        }
+
+        memcpy(&buff[count], &out->out[out->head], chunk);
+        out->head += chunk;
+        count += chunk;
+    }
+
+    statsAdd(STAT_BYTES_OUT, count);
+
+    xSemaphoreGive(gLock);
+
+    return count;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static void onCommand(uint8_t type, const uint8_t *payload, uint8_t len, void *ctx)
+{
+    /* Follow the host to the link it talks on. */
+    gControlLink = (uint8_t)((ProtoParser_t *)ctx - gParsers);
+
+    switch (type)
+    {
+    case PROTO_CMD_SET_MODE:
+        if ((len != 1) || (payload[0] > BRIDGE_MODE_PACKED))
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+
+        /* A new stream starts with a reset its decoder can join at. */
+        if ((payload[0] == BRIDGE_MODE_PACKED) && (gMode != BRIDGE_MODE_PACKED))
+        {
+            for (uint8_t link = 0; link < BRIDGE_LINK_NUM; link++)
+            {
+                packInit(&gLinks[link].pack);
+            }
+        }
+        gMode = payload[0];
+        gConfig.mode = gMode;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_GET_STATS:
+    {
+        static uint8_t resp[1U + STATS_PAGE_MAX * 8U];
+        static StatsSnapshot_t snapshot;
+        uint8_t page = (len > 0) ? payload[0] : STATS_PAGE_GLOBAL;
+        uint32_t first;
+        uint32_t count;
+
+        /* One page per record, so any channel count fits: the global */
+        /* counters, or those of channel (page - 1).                  */
+        if ((len > 1) || (page >= STATS_PAGE_NUM))
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        first = (page == STATS_PAGE_GLOBAL) ? 0U : (uint32_t)STAT_CH(page - 1U, 0);
+        count = (page == STATS_PAGE_GLOBAL) ? STAT_GLOBAL_NUM : STAT_CH_NUM;
+
+        statsSnapshot(&snapshot);
+        resp[0] = page;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            protoPutU64(&resp[1U + i * 8U], snapshot.counter[first + i]);
+        }
+        respond(PROTO_REC_STATS, resp, (uint8_t)(1U + count * 8U));
+        break;
+    }
+
+    case PROTO_CMD_SET_DEDUP:
+        if (len != 3)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        dedupConfigure(payload[0] != 0, protoGetU16(&payload[1]));
+        gConfig.dedupEnabled = (payload[0] != 0);
+        gConfig.dedupKeepaliveMs = protoGetU16(&payload[1]);
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_GET_MEMORY:
+    {
+        static uint8_t resp[PROTO_MAX_PAYLOAD];
+
+        respond(PROTO_REC_MEMORY, resp, memProfileReport(resp, sizeof(resp)));
+        break;
+    }
+
+    case PROTO_CMD_PACK_RESYNC:
+        /* The decoder on this link missed a record: reset its stream. */
+        if (len != 0)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        packResync(&gLinks[gControlLink].pack);
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_CLOCK_PING:
+    {
+        static uint8_t resp[CLOCK_SYNC_PONG_SIZE];
+        uint32_t rxTime = time_us_32();
+
+        if (len != CLOCK_SYNC_PING_SIZE)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        respond(PROTO_REC_CLOCK, resp, clockSyncPong(payload, rxTime, resp));
+        break;
+    }
+
+    case PROTO_CMD_TRACE_START:
+        traceStart();
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_TRACE_STOP:
+        traceStop();
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_TRACE_DUMP:
+        acknowledge(type, traceDumpBegin() ? PROTO_ACK_OK : PROTO_ACK_INVALID);
+        break;
+
+    case PROTO_CMD_CONFIG_SAVE:
+        /* A half-built table would be stored without its tail. */
+        if (gIsSignalDirty || gIsRouteDirty || gIsRateDirty)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        gConfig.link = gControlLink;
+        acknowledge(type, nvConfigSave(&gConfig) ? PROTO_ACK_OK : PROTO_ACK_NO_SPACE);
+        break;
+
+    case PROTO_CMD_CONFIG_ERASE:
+        acknowledge(type, nvConfigErase() ? PROTO_ACK_OK : PROTO_ACK_NO_SPACE);
+        break;
+
+    case PROTO_CMD_SIGNAL_CLEAR:
+        signalTableClear();
+        gSignalStaged = 0;
+        gIsSignalDirty = true;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_SIGNAL_ADD:
+    {
+        uint8_t result = PROTO_ACK_OK;
+
+        if ((len % SIGNAL_DEF_WIRE_SIZE) != 0)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+
+        for (uint8_t pos = 0; pos < len; pos += SIGNAL_DEF_WIRE_SIZE)
+        {
+            SignalDef_t def;
+
+            if (!signalDecodeDef(&payload[pos], &def))
+            {
+                result = PROTO_ACK_INVALID;
+                break;
+            }
+            if (!signalTableAdd(&def))
+            {
+                result = PROTO_ACK_NO_SPACE;
+                break;
+            }
+            memcpy(gConfig.signals[gSignalStaged++], &payload[pos], SIGNAL_DEF_WIRE_SIZE);
+        }
+        gIsSignalDirty = true;
+        acknowledge(type, result);
+        break;
+    }
+
+    case PROTO_CMD_SIGNAL_COMMIT:
+        if (!signalTableCommit())
+        {
+            acknowledge(type, PROTO_ACK_NO_SPACE);
+            break;
+        }
+        gConfig.signalCount = gSignalStaged;
+        gIsSignalDirty = false;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_TX_FRAME:
+    {
+        /* Frames are not acknowledged on success to keep the link free. */
+        uint8_t result = transmit(payload, len);
+
+        if (result != PROTO_ACK_OK)
+        {
+            acknowledge(type, result);
+        }
+        break;
+    }
+
+    case PROTO_CMD_SET_FILTER:
+        if ((len != 11) ||
+            !channelSetFilter(payload[0], payload[1], protoGetU32(&payload[2]),
+                              protoGetU32(&payload[6]), payload[10]))
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        gConfig.filters[payload[0]][payload[1]].id = protoGetU32(&payload[2]);
+        gConfig.filters[payload[0]][payload[1]].mask = protoGetU32(&payload[6]);
+        gConfig.filters[payload[0]][payload[1]].flags = payload[10];
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_ROUTE_CLEAR:
+        gatewayTableClear();
+        gRouteStaged = 0;
+        gIsRouteDirty = true;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_ROUTE_ADD:
+    {
+        uint8_t result = PROTO_ACK_OK;
+
+        if ((len % GATEWAY_ROUTE_WIRE_SIZE) != 0)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+
+        for (uint8_t pos = 0; pos < len; pos += GATEWAY_ROUTE_WIRE_SIZE)
+        {
+            GatewayRoute_t route;
+
+            if (!gatewayDecodeRoute(&payload[pos], &route))
+            {
+                result = PROTO_ACK_INVALID;
+                break;
+            }
+            if (!gatewayTableAdd(&route))
+            {
+                result = PROTO_ACK_NO_SPACE;
+                break;
+            }
+            memcpy(gConfig.routes[gRouteStaged++], &payload[pos], GATEWAY_ROUTE_WIRE_SIZE);
+        }
+        gIsRouteDirty = true;
+        acknowledge(type, result);
+        break;
+    }
+
+    case PROTO_CMD_ROUTE_COMMIT:
+        /* The new table replaces the old one between two frames. */
+        if (!gatewayTableCommit())
+        {
+            acknowledge(type, PROTO_ACK_NO_SPACE);
+            break;
+        }
+        gConfig.routeCount = gRouteStaged;
+        gIsRouteDirty = false;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_RATE_CLEAR:
+        channelRateClear();
+        gRateStaged = 0;
+        memset(gConfig.busloads, 0, sizeof(gConfig.busloads));
+        gIsRateDirty = true;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_RATE_ADD:
+    {
+        uint8_t result = PROTO_ACK_OK;
+
+        if ((len % RATE_RULE_WIRE_SIZE) != 0)
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+
+        for (uint8_t pos = 0; pos < len; pos += RATE_RULE_WIRE_SIZE)
+        {
+            RateRule_t rule;
+
+            if (!rateDecodeRule(&payload[pos], &rule))
+            {
+                result = PROTO_ACK_INVALID;
+                break;
+            }
+            if (!channelRateAdd(&rule))
+            {
+                result = PROTO_ACK_NO_SPACE;
+                break;
+            }
+            memcpy(gConfig.rates[gRateStaged++], &payload[pos], RATE_RULE_WIRE_SIZE);
+        }
+        gIsRateDirty = true;
+        acknowledge(type, result);
+        break;
+    }
+
+    case PROTO_CMD_RATE_BUSLOAD:
+    {
+        RateBusload_t busload;
+
+        if ((len != RATE_BUSLOAD_WIRE_SIZE) || !rateDecodeBusload(payload, &busload))
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        channelRateBusload(&busload);
+        memcpy(gConfig.busloads[busload.channel], payload, RATE_BUSLOAD_WIRE_SIZE);
+        gIsRateDirty = true;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+    }
+
+    case PROTO_CMD_RATE_COMMIT:
+        /* Buckets start full under the new limits. */
+        channelRateCommit();
+        gConfig.rateCount = gRateStaged;
+        gIsRateDirty = false;
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_SELFTEST_START:
+    {
+        TrafficConfig_t config;
+
+        if ((len != TRAFFIC_CONFIG_WIRE_SIZE) || !trafficDecodeConfig(payload, &config) ||
+            !selfTestStart(&config))
+        {
+            acknowledge(type, PROTO_ACK_INVALID);
+            break;
+        }
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+    }
+
+    case PROTO_CMD_SELFTEST_STOP:
+        /* The result comes as PROTO_REC_SELFTEST when the run is done. */
+        selfTestStop();
+        acknowledge(type, PROTO_ACK_OK);
+        break;
+
+    case PROTO_CMD_SELFTEST_REPORT:
+    {
+        static uint8_t resp[TRAFFIC_REPORT_SIZE];
+
+        selfTestReport(resp);
+        respond(PROTO_REC_SELFTEST, resp, sizeof(resp));
+        break;
+    }
+
+    default:
+        acknowledge(type, PROTO_ACK_UNKNOWN);
+        break;
+    }
+}
+
+static void applyConfig(void)
+{
+    /* Runs before the scheduler starts. Anything that does not fit this */
+    /* firmware is skipped rather than failing the whole configuration.  */
+    if (gConfig.mode <= BRIDGE_MODE_PACKED)
+    {
+        gMode = gConfig.mode;
+    }
+    if (gConfig.link < BRIDGE_LINK_NUM)
+    {
+        gControlLink = gConfig.link;
+    }
+    dedupConfigure(gConfig.dedupEnabled != 0, gConfig.dedupKeepaliveMs);
+
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        for (uint8_t index = 0; index < CHANNEL_FILTER_NUM; index++)
+        {
+            const NvConfigFilter_t *filter = &gConfig.filters[ch][index];
+
+            (void)channelSetFilter(ch, index, filter->id, filter->mask, filter->flags);
+        }
+    }
+
+    if (gConfig.signalCount > SIGNAL_MAX_SIGNALS)
+    {
+        gConfig.signalCount = 0;
+    }
+
+    signalTableClear();
+    for (uint16_t i = 0; i < gConfig.signalCount; i++)
+    {
+        SignalDef_t def;
+
+        if (signalDecodeDef(gConfig.signals[i], &def))
+        {
+            (void)signalTableAdd(&def);
+        }
+    }
+    (void)signalTableCommit();
+    gSignalStaged = gConfig.signalCount;
+
+    if (gConfig.routeCount > GATEWAY_MAX_ROUTES)
+    {
+        gConfig.routeCount = 0;
+    }
+
+    gatewayTableClear();
+    for (uint8_t i = 0; i < gConfig.routeCount; i++)
+    {
+        GatewayRoute_t route;
+
+        if (gatewayDecodeRoute(gConfig.routes[i], &route))
+        {
+            (void)gatewayTableAdd(&route);
+        }
+    }
+    (void)gatewayTableCommit();
+    gRouteStaged = gConfig.routeCount;
+
+    if (gConfig.rateCount > RATE_MAX_RULES)
+    {
+        gConfig.rateCount = 0;
+    }
+
+    channelRateClear();
+    for (uint8_t i = 0; i < gConfig.rateCount; i++)
+    {
+        RateRule_t rule;
+
+        if (rateDecodeRule(gConfig.rates[i], &rule))
+        {
+            (void)channelRateAdd(&rule);
+        }
+    }
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        RateBusload_t busload;
+
+        if (rateDecodeBusload(gConfig.busloads[ch], &busload) && (busload.channel == ch))
+        {
+            channelRateBusload(&busload);
+        }
+    }
+    channelRateCommit();
+    gRateStaged = gConfig.rateCount;
+}
+
+static uint8_t transmit(const uint8_t *payload, uint8_t len)
+{
+    CanFrame_t frame;
+
+    /* Payload: channel, id, flags, length, data. */
+    if ((len < TX_FRAME_HEADER_SIZE) ||
+        (payload[6] > CAN_FRAME_MAX_LEN) ||
+        (len != TX_FRAME_HEADER_SIZE + payload[6]) ||
+        (payload[0] >= CAN_CHANNEL_NUM))
+    {
+        return PROTO_ACK_INVALID;
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.channel = payload[0];
+    frame.id = protoGetU32(&payload[1]);
+    frame.flags = payload[5];
+    frame.len = payload[6];
+    frame.timestamp = time_us_32();
+    memcpy(frame.data, &payload[TX_FRAME_HEADER_SIZE], frame.len);
+
+    /* The controller would send whatever the bits say, so a frame it */
+    /* cannot code as given is refused here.                          */
+    if (!canFrameIsValid(&frame) || (!CAN_FD_ENABLED && (frame.flags & CAN_FLAG_FD)))
+    {
+        return PROTO_ACK_INVALID;
+    }
+
+    return channelTransmit(&frame) ? PROTO_ACK_OK : PROTO_ACK_NO_SPACE;
+}
+
+static void respond(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    BridgeLink_t *out = &gLinks[gControlLink];
+
+    /* Only the latest response is kept if the host does not read. */
+    out->respLen = protoEncode(type, payload, len, out->resp, sizeof(out->resp));
+}
+
+static void acknowledge(uint8_t cmd, uint8_t result)
+{
+    uint8_t resp[2] = {cmd, result};
+
+    respond(PROTO_REC_ACK, resp, sizeof(resp));
+}
+
+static uint8_t channelLink(uint8_t ch)
+{
+    /* With an interface per channel, CDC hosts read each channel on its */
+    /* own interface. A host on the UART gets every channel multiplexed. */
+    if (CAN_CDC_PER_CHANNEL && (gControlLink != BRIDGE_LINK_UART))
+    {
+        return BRIDGE_LINK_CDC(ch);
+    }
+
+    return gControlLink;
+}
+
+static bool produce(uint8_t link)
+{
+    BridgeLink_t *out = &gLinks[link];
+    uint32_t channelMask = 0;
+    CanFrame_t frame;
+
+    gCur = out;
+    out->head = 0;
+    out->tail = 0;
+
+    /* Responses take priority over frames. */
+    if (out->respLen > 0)
+    {
+        memcpy(out->out, out->resp, out->respLen);
+        out->tail = out->respLen;
+        out->respLen = 0;
+        statsInc(STAT_RECORDS_OUT);
+        return true;
+    }
+
+    /* A trace dump holds back frames until it is complete. */
+    if (link == gControlLink)
+    {
+        static uint8_t payload[2U + TRACE_EVENTS_PER_RECORD * TRACE_EVENT_WIRE_SIZE];
+        uint8_t len = traceDumpNext(payload, sizeof(payload));
+
+        if (len > 0)
+        {
+            emit(PROTO_REC_TRACE, payload, len);
+            return true;
+        }
+    }
+
+    /* The result of a self test run, once, as it ends. */
+    if (link == gControlLink)
+    {
+        static uint8_t payload[TRAFFIC_REPORT_SIZE];
+
+        if (selfTestTakeResult(payload))
+        {
+            emit(PROTO_REC_SELFTEST, payload, sizeof(payload));
+            return true;
+        }
+    }
+
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        if (channelLink(ch) == link)
+        {
+            channelMask |= 1UL << ch;
+        }
+    }
+
+    /* Visit the channels of this link in turn, one frame at a time, */
+    /* so a busy channel can not starve the others. Frames that do    */
+    /* not produce a record are consumed silently.                    */
+    for (uint8_t idle = 0; idle < CAN_CHANNEL_NUM;)
+    {
+        uint8_t ch = out->nextChannel;
+
+        out->nextChannel = (uint8_t)((ch + 1U) % CAN_CHANNEL_NUM);
+
+        if (!(channelMask & (1UL << ch)) || !channelReceive(ch, &frame))
+        {
+            idle++;
+            continue;
+        }
+        idle = 0;
+
+        Cycles_t mark;
+
+        cyclesBegin(&mark);
+        statsInc(STAT_FRAMES_IN);
+
+        if (gMode == BRIDGE_MODE_SIGNAL)
+        {
+            encodeSignals(&frame);
+        }
+        else if (gMode == BRIDGE_MODE_PACKED)
+        {
+            encodePacked(&frame);
+        }
+        else
+        {
+            encodeRaw(&frame);
+        }
+
+        cyclesEnd(&mark, STAT_PROCESS_CYCLES, STAT_PROCESS_TIMED);
+
+        if (out->tail > 0)
+        {
+            if (!gIsForwarding)
+            {
+                /* The hardware timer starts at reset. */
+                statsAdd(STAT_FIRST_RECORD_US, time_us_32());
+                gIsForwarding = true;
+            }
+            return true;
+        }
+    }
+
+    /* Idle: send the frames packed so far. */
+    if (packIsOpen(&out->pack))
+    {
+        emitPacked();
+        return true;
+    }
+
+    /* Idle: report repeats of IDs that stopped being sent. */
+    if ((gMode == BRIDGE_MODE_RAW) && (channelMask != 0))
+    {
+        DedupSummary_t summary;
+
+        if (dedupPollIdle(time_us_32(), channelMask, &summary))
+        {
+            encodeSummary(&summary);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void encodeRaw(const CanFrame_t *frame)
+{
+    /* Dedup and encoding are specialised for the build in pipeline.cpp. */
+    gCur->tail += pipelineRaw(frame, &gCur->out[gCur->tail], sizeof(gCur->out) - gCur->tail);
+}
+
+/* Frames are packed into the link's open record, which goes out when */
+/* it is full or when the channels run out of frames. Only            */
+/* packFrame() is timed: emitting a full record is not packing.       */
+static void encodePacked(const CanFrame_t *frame)
+{
+    Cycles_t mark;
+    bool isPacked;
+
+    cyclesBegin(&mark);
+    isPacked = packFrame(&gCur->pack, frame);
+    cyclesEnd(&mark, STAT_PACK_CYCLES, STAT_PACK_TIMED);
+
+    if (!isPacked)
+    {
+        emitPacked();
+
+        cyclesBegin(&mark);
+        (void)packFrame(&gCur->pack, frame);
+        cyclesEnd(&mark, STAT_PACK_CYCLES, STAT_PACK_TIMED);
+    }
+}
+
+static void emitPacked(void)
+{
+    uint8_t len = packClose(&gCur->pack);
+
+    if (len > 0)
+    {
+        emit(PROTO_REC_PACKED, gCur->pack.payload, len);
+    }
+}
+
+/* SysTick counts core cycles down from its reload value, once a tick,  */
+/* and belongs to the core it is read on. Interrupts stay enabled: a    */
+/* measurement that moved to the other core or saw the counter reload   */
+/* is dropped, and the timed count says how many were kept. Interrupts  */
+/* taken meanwhile are in the cycles.                                   */
+static void cyclesBegin(Cycles_t *mark)
+{
+    mark->startUs = time_us_32();
+    mark->isValid = cyclesRead(&mark->start, &mark->core);
+}
+
+static void cyclesEnd(const Cycles_t *mark, StatId_t cycles, StatId_t timed)
+{
+    uint32_t now;
+    uint32_t core;
+
+    if (cyclesRead(&now, &core) && mark->isValid && (core == mark->core) && (now <= mark->start) &&
+        (time_us_32() - mark->startUs < CYCLES_MAX_US))
+    {
+        statsAdd(cycles, mark->start - now);
+        statsInc(timed);
+    }
+}
+
+/* Whether the task stayed on one core for the read. */
+static bool cyclesRead(uint32_t *value, uint32_t *core)
+{
+    *core = get_core_num();
+    *value = systick_hw->cvr;
+
+    return get_core_num() == *core;
+}
+
+static void encodeSummary(const DedupSummary_t *summary)
+{
+    uint8_t payload[14];
+
+    protoPutU32(&payload[0], summary->id);
+    payload[4] = summary->channel;
+    payload[5] = summary->flags;
+    protoPutU32(&payload[6], summary->count);
+    protoPutU32(&payload[10], summary->lastTimestamp);
+
+    emit(PROTO_REC_SUPPRESSED, payload, sizeof(payload));
+}
+
+static void encodeSignals(const CanFrame_t *frame)
+{
+    static SignalUpdate_t updates[SIGNAL_MAX_SIGNALS];
+    static uint8_t payload[PROTO_MAX_PAYLOAD];
+    uint32_t count = signalProcess(frame, updates, SIGNAL_MAX_SIGNALS);
+
+    for (uint32_t i = 0; i < count; i += SIGNALS_PER_RECORD)
+    {
+        uint32_t n = count - i;
+        uint32_t pos = 4;
+
+        if (n > SIGNALS_PER_RECORD)
+        {
+            n = SIGNALS_PER_RECORD;
+        }
+
+        protoPutU32(&payload[0], frame->timestamp);
+        for (uint32_t j = 0; j < n; j++)
+        {
+            protoPutU16(&payload[pos], updates[i + j].index);
+            protoPutU32(&payload[pos + 2], updates[i + j].value);
+            pos += SIGNAL_UPDATE_WIRE_SIZE;
+        }
+
+        emit(PROTO_REC_SIGNAL, payload, (uint8_t)pos);
+    }
+}
+
+static void emit(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    uint32_t size = protoEncode(type, payload, len, &gCur->out[gCur->tail], sizeof(gCur->out) - gCur->tail);
+
+    if (size > 0)
+    {
+        gCur->tail += size;
+        statsInc(STAT_RECORDS_OUT);
+        traceRecord(TRACE_EV_ENQUEUE, type, size);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_config.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Output modes of the CAN to host direction. */
+#define BRIDGE_MODE_RAW (0U)    /* Forward every frame.                */
+#define BRIDGE_MODE_SIGNAL (1U) /* Forward changed signal values only. */
+#define BRIDGE_MODE_PACKED (2U) /* Forward every frame, compressed.    */
+
+/* Number of CDC interfaces. (matches CFG_TUD_CDC) */
+#define BRIDGE_CDC_NUM (CAN_CDC_PER_CHANNEL ? CAN_CHANNEL_NUM : 1U)
+
+/* Host links. Frames go to the link that sent the last valid command, */
+/* or to the CDC interface of their channel if each channel has one.   */
+#define BRIDGE_LINK_CDC(n) ((uint8_t)(n))
+#define BRIDGE_LINK_UART (BRIDGE_CDC_NUM)
+#define BRIDGE_LINK_NUM (BRIDGE_CDC_NUM + 1U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void bridgeInit(void);
+bool bridgeLoadConfig(void);
+void bridgeHostInput(uint8_t link, const uint8_t *data, uint32_t size);
+uint32_t bridgeHostOutput(uint8_t link, uint8_t *buff, uint32_t size);
+
+#endif /* BRIDGE_H */
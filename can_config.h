@@ -0,0 +1,28 @@
+#ifndef CAN_CONFIG_H
+#define CAN_CONFIG_H
+
+/* -------------------------------------------------------------------------- */
+/* Channel configuration                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Number of CAN channels bridged by this build. (1..4) */
+#ifndef CAN_CHANNEL_NUM
+#define CAN_CHANNEL_NUM (2U)
+#endif
+
+/* Set to 1 to give every channel its own CDC interface. (up to 3 channels) */
+/* Otherwise all channels share one interface, told apart by channel tag.   */
+#define CAN_CDC_PER_CHANNEL (0)
+
+/* Set to 0 for classic CAN 2.0 only. Payloads are then at most 8 bytes. */
+#define CAN_FD_ENABLED (1)
+
+#if (CAN_CHANNEL_NUM < 1) || (CAN_CHANNEL_NUM > 4)
+#error "CAN_CHANNEL_NUM must be 1 to 4: lookup keys carry the channel in 2 bits."
+#endif
+
+#if CAN_CDC_PER_CHANNEL && (CAN_CHANNEL_NUM > 3)
+#error "At most 3 CDC interfaces are described in usb_descriptors.c."
+#endif
+
+#endif /* CAN_CONFIG_H */
@@ -0,0 +1,77 @@
+#ifndef CAN_FRAME_H
+#define CAN_FRAME_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Maximum payload length of a frame. (CAN FD) */
+#define CAN_FRAME_MAX_LEN (64U)
+
+/* Maximum payload length of a classic frame. */
+#define CAN_CLASSIC_MAX_LEN (8U)
+
+/* Frame flags. */
+#define CAN_FLAG_EXT (0x01U) /* 29-bit identifier.   */
+#define CAN_FLAG_RTR (0x02U) /* Remote request.      */
+#define CAN_FLAG_FD (0x04U)  /* CAN FD format.       */
+#define CAN_FLAG_BRS (0x08U) /* CAN FD bit rate switch. */
+
+/* Identifier masks. */
+#define CAN_STD_ID_MASK (0x000007FFUL)
+#define CAN_EXT_ID_MASK (0x1FFFFFFFUL)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* A received or to be transmitted CAN frame. */
+typedef struct
+{
+    uint32_t id;        /* Identifier. (11 or 29 bits)              */
+    uint32_t timestamp; /* Hardware timer timestamp in microseconds. */
+    uint8_t flags;      /* CAN_FLAG_*                               */
+    uint8_t len;        /* Payload length in bytes.                 */
+    uint8_t channel;    /* Source or destination channel.           */
+    uint8_t reserved;
+    uint8_t data[CAN_FRAME_MAX_LEN];
+} CanFrame_t;
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Whether a DLC codes the length: 0 to 8, 12, 16, 20, 24, 32, 48, 64. */
+static inline bool canLenIsDlc(uint8_t len)
+{
+    return (len <= CAN_CLASSIC_MAX_LEN) || ((len <= 24U) && ((len % 4U) == 0U)) || (len == 32U) || (len == 48U) ||
+           (len == 64U);
+}
+
+/* Whether a frame can go on a bus as it is: the identifier fits 11 or */
+/* 29 bits, a classic frame carries up to 8 bytes and no BRS, and an   */
+/* FD frame a length a DLC codes and no remote request.                */
+static inline bool canFrameIsValid(const CanFrame_t *frame)
+{
+    uint32_t idMask = (frame->flags & CAN_FLAG_EXT) ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+
+    if ((frame->id & ~idMask) != 0)
+    {
+        return false;
+    }
+
+    if (frame->flags & CAN_FLAG_FD)
+    {
+        return canLenIsDlc(frame->len) && !(frame->flags & CAN_FLAG_RTR);
+    }
+
+    return (frame->len <= CAN_CLASSIC_MAX_LEN) && !(frame->flags & CAN_FLAG_BRS);
+}
+
+#endif /* CAN_FRAME_H */
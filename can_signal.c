@@ -0,0 +1,355 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include "can_signal.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Message key: identifier, channel in bits 29-30 and the extended flag in bit 31. */
+#define MESSAGE_KEY(id, isExt, ch) ((id) | ((uint32_t)(ch) << 29) | ((isExt) ? 0x80000000UL : 0UL))
+#define DEF_KEY(def) MESSAGE_KEY((def)->id, (def)->flags & SIGNAL_FLAG_EXT, \
+                                 ((def)->flags & SIGNAL_FLAG_CHANNEL_MASK) >> SIGNAL_FLAG_CHANNEL_SHIFT)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Precomputed extraction plan of one signal. */
+typedef struct
+{
+    uint32_t mask;     /* Value mask after shifting.           */
+    uint32_t deadband; /* Report threshold in raw units.       */
+    uint32_t last;     /* Last reported value.                 */
+    uint16_t index;    /* Host side signal index.              */
+    uint8_t firstByte; /* First payload byte to load.          */
+    uint8_t byteCount; /* Number of payload bytes to load.     */
+    uint8_t shift;     /* Right shift after loading.           */
+    uint8_t length;    /* Length in bits.                      */
+    uint8_t flags;     /* SIGNAL_FLAG_*                        */
+    bool isValid;      /* Set once the first value was reported. */
+} SignalPlan_t;
+
+/* Signals belonging to one message. */
+typedef struct
+{
+    uint32_t key;
+    uint16_t first;
+    uint16_t count;
+} SignalMessage_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static bool buildPlan(const SignalDef_t *def, uint16_t index, SignalPlan_t *plan);
+static const SignalMessage_t *findMessage(uint32_t key);
+static uint32_t extract(const SignalPlan_t *plan, const uint8_t *data);
+static bool isReportable(const SignalPlan_t *plan, uint32_t value);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Staging table filled by signalTableAdd(). */
+static SignalDef_t gStageDefs[SIGNAL_MAX_SIGNALS];
+static uint16_t gStageCount = 0;
+
+/* Active table, grouped by message and sorted by key. */
+static SignalPlan_t gPlans[SIGNAL_MAX_SIGNALS];
+static SignalMessage_t gMessages[SIGNAL_MAX_MESSAGES];
+static uint16_t gMessageCount = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void signalInit(void)
+{
+    gStageCount = 0;
+    gMessageCount = 0;
+}
+
+void signalTableClear(void)
+{
+    gStageCount = 0;
+}
+
+/* Definitions come checked by signalDecodeDef(). */
+bool signalTableAdd(const SignalDef_t *def)
+{
+    if (gStageCount >= SIGNAL_MAX_SIGNALS)
+    {
+        return false;
+    }
+
+    gStageDefs[gStageCount++] = *def;
+
+    return true;
+}
+
+bool signalTableCommit(void)
+{
+    static uint16_t order[SIGNAL_MAX_SIGNALS];
+    uint16_t messageCount = 0;
+
+    /* Sort the staged signals by message key. (stable insertion sort) */
+    for (uint16_t i = 0; i < gStageCount; i++)
+    {
+        uint32_t key = DEF_KEY(&gStageDefs[i]);
+        uint16_t j = i;
+
+        while ((j > 0) && (DEF_KEY(&gStageDefs[order[j - 1]]) > key))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    /* Count messages before touching the active table. */
+    for (uint16_t i = 0; i < gStageCount; i++)
+    {
+        const SignalDef_t *def = &gStageDefs[order[i]];
+        const SignalDef_t *prev = (i > 0) ? &gStageDefs[order[i - 1]] : NULL;
+
+        if ((prev == NULL) || (DEF_KEY(prev) != DEF_KEY(def)))
+        {
+            messageCount++;
+        }
+    }
+
+    if (messageCount > SIGNAL_MAX_MESSAGES)
+    {
+        return false;
+    }
+
+    /* Compile the plans. */
+    gMessageCount = 0;
+    for (uint16_t i = 0; i < gStageCount; i++)
+    {
+        const SignalDef_t *def = &gStageDefs[order[i]];
+        uint32_t key = DEF_KEY(def);
+
+        (void)buildPlan(def, order[i], &gPlans[i]);
+
+        if ((gMessageCount == 0) || (gMessages[gMessageCount - 1].key != key))
+        {
+            gMessages[gMessageCount].key = key;
+            gMessages[gMessageCount].first = i;
+            gMessages[gMessageCount].count = 0;
+            gMessageCount++;
+        }
+        gMessages[gMessageCount - 1].count++;
+    }
+
+    return true;
+}
+
+bool signalDecodeDef(const uint8_t *wire, SignalDef_t *def)
+{
+    SignalPlan_t plan;
+
+    def->id = protoGetU32(&wire[0]);
+    def->startBit = protoGetU16(&wire[4]);
+    def->length = wire[6];
+    def->flags = wire[7];
+    def->deadband = protoGetU32(&wire[8]);
+
+    /* Reject definitions that can not be extracted. */
+    return buildPlan(def, 0, &plan);
+}
+
+uint32_t signalProcess(const CanFrame_t *frame, SignalUpdate_t *updates, uint32_t maxUpdates)
+{
+    const SignalMessage_t *msg = findMessage(MESSAGE_KEY(frame->id, frame->flags & CAN_FLAG_EXT, frame->channel));
+    uint32_t count = 0;
+
+    if (msg == NULL)
+    {
+        return 0;
+    }
+
+    for (uint16_t i = 0; (i < msg->count) && (count < maxUpdates); i++)
+    {
+        SignalPlan_t *plan = &gPlans[msg->first + i];
+        uint32_t value;
+
+        /* The signal is not contained in a short frame. */
+        if ((uint32_t)plan->firstByte + plan->byteCount > frame->len)
+        {
+            continue;
+        }
+
+        value = extract(plan, frame->data);
+
+        if (isReportable(plan, value))
+        {
+            plan->last = value;
+            plan->isValid = true;
+
+            updates[count].index = plan->index;
+            updates[count].value = value;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static bool buildPlan(const SignalDef_t *def, uint16_t index, SignalPlan_t *plan)
+{
+    uint32_t firstByte;
+    uint32_t lastByte;
+    uint32_t shift;
+
+    if ((def->length == 0) || (def->length > SIGNAL_MAX_LENGTH))
+    {
+        return false;
+    }
+
+    if (def->flags & SIGNAL_FLAG_MOTOROLA)
+    {
+        /* DBC start bit is the MSB in sawtooth numbering. Convert to */
+        /* a linear big-endian bit position to find the LSB.          */
+        uint32_t msb = (def->startBit / 8U) * 8U + (7U - def->startBit % 8U);
+        uint32_t lsb = msb + def->length - 1U;
+
+        firstByte = msb / 8U;
+        lastByte = lsb / 8U;
+        shift = 7U - lsb % 8U;
+    }
+    else
+    {
+        firstByte = def->startBit / 8U;
+        lastByte = (def->startBit + def->length - 1U) / 8U;
+        shift = def->startBit % 8U;
+    }
+
+    if (lastByte >= CAN_FRAME_MAX_LEN)
+    {
+        return false;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    plan->mask = (def->length == 32U) ? 0xFFFFFFFFUL : ((1UL << def->length) - 1UL);
+    plan->deadband = def->deadband;
+    plan->index = index;
+    plan->firstByte = (uint8_t)firstByte;
+    plan->byteCount = (uint8_t)(lastByte - firstByte + 1U);
+    plan->shift = (uint8_t)shift;
+    plan->length = def->length;
+    plan->flags = def->flags;
+
+    return true;
+}
+
+static const SignalMessage_t *findMessage(uint32_t key)
+{
+    uint32_t lo = 0;
+    uint32_t hi = gMessageCount;
+
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2U;
+
+        if (gMessages[mid].key < key)
+        {
+            lo = mid + 1U;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return ((lo < gMessageCount) && (gMessages[lo].key == key)) ? &gMessages[lo] : NULL;
+}
+
+static uint32_t extract(const SignalPlan_t *plan, const uint8_t *data)
+{
+    const uint8_t *p = &data[plan->firstByte];
+    uint32_t value;
+
+    /* Up to four bytes fit in a 32-bit accumulator, which avoids */
+    /* 64-bit shifts on Cortex-M0+.                               */
+    if (plan->byteCount <= 4U)
+    {
+        uint32_t acc = 0;
+
+        if (plan->flags & SIGNAL_FLAG_MOTOROLA)
+        {
+            for (uint8_t i = 0; i < plan->byteCount; i++)
+            {
+                acc = (acc << 8) | p[i];
+            }
+        }
+        else
+        {
+            for (uint8_t i = plan->byteCount; i > 0; i--)
+            {
+                acc = (acc << 8) | p[i - 1];
+            }
+        }
+        value = (acc >> plan->shift) & plan->mask;
+    }
+    else
+    {
+        uint64_t acc = 0;
+
+        if (plan->flags & SIGNAL_FLAG_MOTOROLA)
+        {
+            for (uint8_t i = 0; i < plan->byteCount; i++)
+            {
+                acc = (acc << 8) | p[i];
+            }
+        }
+        else
+        {
+            for (uint8_t i = plan->byteCount; i > 0; i--)
+            {
+                acc = (acc << 8) | p[i - 1];
+            }
+        }
+        value = (uint32_t)(acc >> plan->shift) & plan->mask;
+    }
+
+    /* Sign extension. */
+    if ((plan->flags & SIGNAL_FLAG_SIGNED) && (value & (1UL << (plan->length - 1U))))
+    {
+        value |= ~plan->mask;
+    }
+
+    return value;
+}
+
+static bool isReportable(const SignalPlan_t *plan, uint32_t value)
+{
+    uint32_t delta;
+
+    if (!plan->isValid)
+    {
+        return true;
+    }
+
+    if (plan->deadband == 0)
+    {
+        return value != plan->last;
+    }
+
+    if (plan->flags & SIGNAL_FLAG_SIGNED)
+    {
+        int64_t diff = (int64_t)(int32_t)value - (int64_t)(int32_t)plan->last;
+        delta = (uint32_t)((diff < 0) ? -diff : diff);
+    }
+    else
+    {
+        delta = (value > plan->last) ? (value - plan->last) : (plan->last - value);
+    }
+
+    return delta > plan->deadband;
+}
@@ -0,0 +1,68 @@
+#ifndef CAN_SIGNAL_H
+#define CAN_SIGNAL_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_frame.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Capacity of the signal table. */
+#define SIGNAL_MAX_SIGNALS (128U)
+#define SIGNAL_MAX_MESSAGES (64U)
+
+/* Longest signal that can be extracted. */
+#define SIGNAL_MAX_LENGTH (32U)
+
+/* Signal definition flags. */
+#define SIGNAL_FLAG_MOTOROLA (0x01U)      /* Big-endian (DBC byte order 0). */
+#define SIGNAL_FLAG_SIGNED (0x02U)        /* Two's complement value.       */
+#define SIGNAL_FLAG_EXT (0x04U)           /* Message uses a 29-bit ID.     */
+#define SIGNAL_FLAG_CHANNEL_MASK (0x30U)  /* Channel of the message.       */
+#define SIGNAL_FLAG_CHANNEL_SHIFT (4U)
+
+/* Size of a signal definition in a PROTO_CMD_SIGNAL_ADD payload. */
+#define SIGNAL_DEF_WIRE_SIZE (12U)
+
+/* Size of a signal update in a PROTO_REC_SIGNAL payload. */
+#define SIGNAL_UPDATE_WIRE_SIZE (6U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Signal definition as generated from a DBC by the host.          */
+/* Scale and offset stay on the host: the device reports raw       */
+/* values and the deadband is given in raw units (deadband/scale). */
+typedef struct
+{
+    uint32_t id;       /* Message identifier.                    */
+    uint16_t startBit; /* DBC start bit.                         */
+    uint8_t length;    /* Length in bits. (1..SIGNAL_MAX_LENGTH) */
+    uint8_t flags;     /* SIGNAL_FLAG_*                          */
+    uint32_t deadband; /* Report threshold in raw units.         */
+} SignalDef_t;
+
+/* A signal whose value changed. */
+typedef struct
+{
+    uint16_t index; /* Order in which the host added the signal. */
+    uint32_t value; /* Raw value. (sign-extended if signed)      */
+} SignalUpdate_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void signalInit(void);
+void signalTableClear(void);
+bool signalTableAdd(const SignalDef_t *def);
+bool signalTableCommit(void);
+bool signalDecodeDef(const uint8_t *wire, SignalDef_t *def);
+uint32_t signalProcess(const CanFrame_t *frame, SignalUpdate_t *updates, uint32_t maxUpdates);
+
+#endif /* CAN_SIGNAL_H */
@@ -0,0 +1,482 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <timers.h>
+#include "channel.h"
+#include "stats.h"
+#include "trace.h"
+#include "gateway.h"
+#include "self_test.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define RATE_TABLE_NUM (2U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef struct
+{
+    uint32_t id;
+    uint32_t mask;
+    uint8_t flags;
+} ChannelFilter_t;
+
+typedef struct
+{
+    QueueHandle_t rxQueue;
+    StaticQueue_t rxQueueDef;
+    uint8_t rxQueueBuff[CHANNEL_RX_QUEUE_LEN * sizeof(CanFrame_t)];
+
+    QueueHandle_t txQueue;
+    StaticQueue_t txQueueDef;
+    uint8_t txQueueBuff[CHANNEL_TX_QUEUE_LEN * sizeof(CanFrame_t)];
+
+    ChannelFilter_t filters[CHANNEL_FILTER_NUM];
+    uint8_t filterCount; /* Enabled filters. */
+
+    ChannelTxKick_t kick;
+    void *kickCtx;
+
+    /* The head of the transmit queue waits for a rate limit. Frames keep */
+    /* their order, so the ones behind it wait as well.                   */
+    TimerHandle_t releaseTimer;
+    StaticTimer_t releaseTimerDef;
+    volatile bool isHeld;
+    bool isHeadShaped; /* Counted in STAT_CH_TX_SHAPED. */
+} Channel_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static bool isAccepted(const Channel_t *chan, const CanFrame_t *frame);
+static bool txPop(uint8_t ch, CanFrame_t *frame, BaseType_t *isWoken);
+static void hold(uint8_t ch, uint64_t waitNs, BaseType_t *isWoken);
+static void onRelease(TimerHandle_t timer);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static Channel_t gChannels[CAN_CHANNEL_NUM];
+
+/* Rate limits staged by channelRateAdd() and channelRateBusload(). */
+static RateRule_t gStageRules[RATE_MAX_RULES];
+static uint8_t gStageCount = 0;
+static RateBusload_t gStageBusloads[CAN_CHANNEL_NUM];
+
+/* The transmit path admits frames against gRateActive under gRateLock, */
+/* so a commit can fill the other table and swap them between frames.  */
+static RateTable_t gRateTables[RATE_TABLE_NUM];
+static RateTable_t *gRateActive = &gRateTables[0];
+static spin_lock_t *gRateLock = NULL;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void channelInit(void)
+{
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        Channel_t *chan = &gChannels[ch];
+
+        chan->rxQueue = xQueueCreateStatic(CHANNEL_RX_QUEUE_LEN, sizeof(CanFrame_t),
+                                           chan->rxQueueBuff, &chan->rxQueueDef);
+        chan->txQueue = xQueueCreateStatic(CHANNEL_TX_QUEUE_LEN, sizeof(CanFrame_t),
+                                           chan->txQueueBuff, &chan->txQueueDef);
+        memset(chan->filters, 0, sizeof(chan->filters));
+        chan->filterCount = 0;
+        chan->kick = NULL;
+        chan->kickCtx = NULL;
+        chan->releaseTimer = xTimerCreateStatic("release", 1, pdFALSE, (void *)(uintptr_t)ch,
+                                                onRelease, &chan->releaseTimerDef);
+        chan->isHeld = false;
+        chan->isHeadShaped = false;
+    }
+
+    /* No limits until a commit. */
+    memset(gStageBusloads, 0, sizeof(gStageBusloads));
+    gStageCount = 0;
+    rateTableBuild(&gRateTables[0], gStageRules, 0, gStageBusloads);
+    gRateActive = &gRateTables[0];
+    gRateLock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+}
+
+void channelRegisterDriver(uint8_t ch, ChannelTxKick_t kick, void *ctx)
+{
+    gChannels[ch].kickCtx = ctx;
+    gChannels[ch].kick = kick;
+}
+
+bool channelSetFilter(uint8_t ch, uint8_t index, uint32_t id, uint32_t mask, uint8_t flags)
+{
+    Channel_t *chan;
+    uint8_t count = 0;
+
+    if ((ch >= CAN_CHANNEL_NUM) || (index >= CHANNEL_FILTER_NUM))
+    {
+        return false;
+    }
+
+    chan = &gChannels[ch];
+
+    /* Disable while rewriting so a receiving ISR never sees half a filter. */
+    chan->filters[index].flags = 0;
+    chan->filters[index].id = id & mask;
+    chan->filters[index].mask = mask;
+    chan->filters[index].flags = flags;
+
+    /* Keep enabled filters packed at the front for the receive path. */
+    for (uint8_t i = 0; i < CHANNEL_FILTER_NUM; i++)
+    {
+        if (chan->filters[i].flags & CHANNEL_FILTER_ENABLED)
+        {
+            count = i + 1U;
+        }
+    }
+    chan->filterCount = count;
+
+    return true;
+}
+
+void channelRateClear(void)
+{
+    gStageCount = 0;
+    memset(gStageBusloads, 0, sizeof(gStageBusloads));
+}
+
+bool channelRateAdd(const RateRule_t *rule)
+{
+    if (gStageCount >= RATE_MAX_RULES)
+    {
+        return false;
+    }
+
+    gStageRules[gStageCount++] = *rule;
+
+    return true;
+}
+
+void channelRateBusload(const RateBusload_t *busload)
+{
+    gStageBusloads[busload->channel] = *busload;
+}
+
+void channelRateCommit(void)
+{
+    RateTable_t *next = (gRateActive == &gRateTables[0]) ? &gRateTables[1] : &gRateTables[0];
+    uint32_t save;
+
+    rateTableBuild(next, gStageRules, gStageCount, gStageBusloads);
+
+    save = spin_lock_blocking(gRateLock);
+    gRateActive = next;
+    spin_unlock(gRateLock, save);
+
+    /* Frames held by the old limits are tried against the new ones. */
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        if (gChannels[ch].isHeld)
+        {
+            onRelease(gChannels[ch].releaseTimer);
+        }
+    }
+}
+
+bool channelRx(uint8_t ch, CanFrame_t *frame)
+{
+    Channel_t *chan = &gChannels[ch];
+
+    frame->channel = ch;
+    traceRecord(TRACE_EV_FRAME_RX, ch, frame->id);
+
+    /* Frames of a self test run are checked and go no further. */
+    if (selfTestRx(frame))
+    {
+        return false;
+    }
+
+    /* Bus to bus routes go first and do not depend on the host filters. */
+    if (gatewayRoute(frame, NULL))
+    {
+        return false;
+    }
+
+    if (!isAccepted(chan, frame))
+    {
+        statsInc(STAT_CH(ch, STAT_CH_RX_FILTERED));
+        return false;
+    }
+
+    if (xQueueSend(chan->rxQueue, frame, 0) != pdPASS)
+    {
+        statsInc(STAT_CH(ch, STAT_CH_RX_DROPPED));
+        return false;
+    }
+
+    statsInc(STAT_CH(ch, STAT_CH_RX_FRAMES));
+
+    return true;
+}
+
+bool channelRxFromISR(uint8_t ch, CanFrame_t *frame, BaseType_t *isWoken)
+{
+    Channel_t *chan = &gChannels[ch];
+
+    frame->channel = ch;
+    traceRecord(TRACE_EV_FRAME_RX, ch, frame->id);
+
+    if (selfTestRx(frame))
+    {
+        return false;
+    }
+
+    if (gatewayRoute(frame, isWoken))
+    {
+        return false;
+    }
+
+    if (!isAccepted(chan, frame))
+    {
+        statsInc(STAT_CH(ch, STAT_CH_RX_FILTERED));
+        return false;
+    }
+
+    if (xQueueSendFromISR(chan->rxQueue, frame, isWoken) != pdPASS)
+    {
+        statsInc(STAT_CH(ch, STAT_CH_RX_DROPPED));
+        return false;
+    }
+
+    statsInc(STAT_CH(ch, STAT_CH_RX_FRAMES));
+
+    return true;
+}
+
+bool channelReceive(uint8_t ch, CanFrame_t *frame)
+{
+    return xQueueReceive(gChannels[ch].rxQueue, frame, 0) == pdPASS;
+}
+
+bool channelTransmit(const CanFrame_t *frame)
+{
+    Channel_t *chan;
+
+    if (frame->channel >= CAN_CHANNEL_NUM)
+    {
+        return false;
+    }
+
+    chan = &gChannels[frame->channel];
+
+    if (xQueueSend(chan->txQueue, frame, 0) != pdPASS)
+    {
+        statsInc(STAT_CH(frame->channel, STAT_CH_TX_DROPPED));
+        return false;
+    }
+
+    statsInc(STAT_CH(frame->channel, STAT_CH_TX_FRAMES));
+
+    if (chan->kick != NULL)
+    {
+        chan->kick(chan->kickCtx, NULL);
+    }
+
+    return true;
+}
+
+bool channelForward(uint8_t ch, const CanFrame_t *frame, BaseType_t *isWoken)
+{
+    Channel_t *chan = &gChannels[ch];
+    BaseType_t result;
+
+    /* Queued by value, sizeof(CanFrame_t) bytes, as channelTransmit() */
+    /* does. The copy keeps the source channel in frame->channel.      */
+    if (isWoken != NULL)
+    {
+        result = xQueueSendFromISR(chan->txQueue, frame, isWoken);
+    }
+    else
+    {
+        result = xQueueSend(chan->txQueue, frame, 0);
+    }
+
+    if (result != pdPASS)
+    {
+        statsInc(STAT_CH(ch, STAT_CH_TX_DROPPED));
+        return false;
+    }
+
+    statsInc(STAT_CH(ch, STAT_CH_TX_FRAMES));
+
+    if (chan->kick != NULL)
+    {
+        chan->kick(chan->kickCtx, isWoken);
+    }
+
+    return true;
+}
+
+bool channelTxPending(uint8_t ch)
+{
+    /* A held frame is not pending: the release kicks the driver again. */
+    return !gChannels[ch].isHeld && (uxQueueMessagesWaiting(gChannels[ch].txQueue) > 0);
+}
+
+/* Room left in the transmit queue, for a sender that would rather wait */
+/* than have frames dropped.                                            */
+uint32_t channelTxFree(uint8_t ch)
+{
+    return uxQueueSpacesAvailable(gChannels[ch].txQueue);
+}
+
+bool channelTxPop(uint8_t ch, CanFrame_t *frame)
+{
+    return txPop(ch, frame, NULL);
+}
+
+bool channelTxPopFromISR(uint8_t ch, CanFrame_t *frame, BaseType_t *isWoken)
+{
+    return txPop(ch, frame, isWoken);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+/* Takes the head of the transmit queue if the rate limits let it go. */
+/* Costs one table lookup and two buckets per frame.                  */
+static bool txPop(uint8_t ch, CanFrame_t *frame, BaseType_t *isWoken)
+{
+    Channel_t *chan = &gChannels[ch];
+
+    while (true)
+    {
+        BaseType_t result;
+        RateVerdict_t verdict;
+        uint64_t now;
+        uint64_t release;
+        uint32_t save;
+
+        if (isWoken != NULL)
+        {
+            result = xQueuePeekFromISR(chan->txQueue, frame);
+        }
+        else
+        {
+            result = xQueuePeek(chan->txQueue, frame, 0);
+        }
+
+        if (result != pdPASS)
+        {
+            return false;
+        }
+
+        now = time_us_64() * 1000U;
+        save = spin_lock_blocking(gRateLock);
+        verdict = rateTableAdmit(gRateActive, ch, frame, now, &release);
+        spin_unlock(gRateLock, save);
+
+        if (verdict == RATE_SHAPE)
+        {
+            hold(ch, release - now, isWoken);
+            return false;
+        }
+
+        /* Only this driver takes from the queue: the head is still frame. */
+        if (isWoken != NULL)
+        {
+            (void)xQueueReceiveFromISR(chan->txQueue, frame, isWoken);
+        }
+        else
+        {
+            (void)xQueueReceive(chan->txQueue, frame, 0);
+        }
+        chan->isHeld = false;
+        chan->isHeadShaped = false;
+
+        if (verdict == RATE_PASS)
+        {
+            return true;
+        }
+
+        statsInc(STAT_CH(ch, STAT_CH_TX_LIMITED));
+    }
+}
+
+/* Keeps the head back until the release. The timer runs on ticks, so it */
+/* may fire up to a tick late; a burst of a tick or more absorbs that.   */
+static void hold(uint8_t ch, uint64_t waitNs, BaseType_t *isWoken)
+{
+    Channel_t *chan = &gChannels[ch];
+    TickType_t ticks = pdMS_TO_TICKS((uint32_t)((waitNs + 999999U) / 1000000U));
+    BaseType_t isStarted;
+
+    if (ticks == 0)
+    {
+        ticks = 1;
+    }
+
+    if (!chan->isHeadShaped)
+    {
+        statsInc(STAT_CH(ch, STAT_CH_TX_SHAPED));
+        chan->isHeadShaped = true;
+    }
+
+    /* Held before the timer starts, so an early release is not lost.  */
+    /* Should the timer command queue be full, the head is left unheld */
+    /* and the driver's next poll shapes it again.                     */
+    chan->isHeld = true;
+    if (isWoken != NULL)
+    {
+        isStarted = xTimerChangePeriodFromISR(chan->releaseTimer, ticks, isWoken);
+    }
+    else
+    {
+        isStarted = xTimerChangePeriod(chan->releaseTimer, ticks, 0);
+    }
+
+    if (isStarted != pdPASS)
+    {
+        chan->isHeld = false;
+    }
+}
+
+static void onRelease(TimerHandle_t timer)
+{
+    Channel_t *chan = &gChannels[(uintptr_t)pvTimerGetTimerID(timer)];
+
+    chan->isHeld = false;
+    if (chan->kick != NULL)
+    {
+        chan->kick(chan->kickCtx, NULL);
+    }
+}
+
+static bool isAccepted(const Channel_t *chan, const CanFrame_t *frame)
+{
+    bool isExt = (frame->flags & CAN_FLAG_EXT) != 0;
+
+    if (chan->filterCount == 0)
+    {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < chan->filterCount; i++)
+    {
+        const ChannelFilter_t *filter = &chan->filters[i];
+
+        if ((filter->flags & CHANNEL_FILTER_ENABLED) &&
+            (((filter->flags & CHANNEL_FILTER_EXT) != 0) == isExt) &&
+            ((frame->id & filter->mask) == filter->id))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
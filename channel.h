@@ -0,0 +1,62 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include "can_config.h"
+#include "can_frame.h"
+#include "rate_limit.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Depth of the per channel queues. */
+#define CHANNEL_RX_QUEUE_LEN (32U)
+#define CHANNEL_TX_QUEUE_LEN (16U)
+
+/* Acceptance filters per channel. No enabled filter accepts every frame. */
+#define CHANNEL_FILTER_NUM (8U)
+
+/* Acceptance filter flags. */
+#define CHANNEL_FILTER_ENABLED (0x01U)
+#define CHANNEL_FILTER_EXT (0x02U) /* Match 29-bit identifiers. */
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Called when a frame was queued for transmission on an idle controller, */
+/* or when a frame held back by a rate limit is due. The driver pulls     */
+/* frames with channelTxPop(). isWoken is NULL in task context and the    */
+/* FreeRTOS woken flag when called from an ISR.                           */
+typedef void (*ChannelTxKick_t)(void *ctx, BaseType_t *isWoken);
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void channelInit(void);
+void channelRegisterDriver(uint8_t ch, ChannelTxKick_t kick, void *ctx);
+bool channelSetFilter(uint8_t ch, uint8_t index, uint32_t id, uint32_t mask, uint8_t flags);
+
+void channelRateClear(void);
+bool channelRateAdd(const RateRule_t *rule);
+void channelRateBusload(const RateBusload_t *busload);
+void channelRateCommit(void);
+
+bool channelRx(uint8_t ch, CanFrame_t *frame);
+bool channelRxFromISR(uint8_t ch, CanFrame_t *frame, BaseType_t *isWoken);
+bool channelReceive(uint8_t ch, CanFrame_t *frame);
+
+bool channelTransmit(const CanFrame_t *frame);
+bool channelForward(uint8_t ch, const CanFrame_t *frame, BaseType_t *isWoken);
+bool channelTxPending(uint8_t ch);
+uint32_t channelTxFree(uint8_t ch);
+bool channelTxPop(uint8_t ch, CanFrame_t *frame);
+bool channelTxPopFromISR(uint8_t ch, CanFrame_t *frame, BaseType_t *isWoken);
+
+#endif /* CHANNEL_H */
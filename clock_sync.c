@@ -0,0 +1,92 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <hardware/structs/usb.h>
+#include <tusb.h>
+#include "clock_sync.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static void sofIrqHandler(void);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Latest start of frame. Written by the USB interrupt and read by tasks */
+/* on either core, so a sequence number, odd while the interrupt writes, */
+/* tells a reader to try again.                                          */
+static volatile uint32_t gSofSeq = 0;
+static volatile uint32_t gSofTime = 0;
+static volatile uint32_t gSofCount = 0;
+static volatile uint16_t gSofFrame = CLOCK_SYNC_NO_FRAME;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void clockSyncInit(void)
+{
+    /* Runs after the TinyUSB handler in the same interrupt, once it has  */
+    /* taken the status, so reading the frame number takes nothing away. */
+    irq_add_shared_handler(USBCTRL_IRQ, sofIrqHandler, PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY);
+
+    /* TinyUSB enables the start of frame interrupt only for a consumer. */
+    tud_sof_cb_enable(true);
+}
+
+uint8_t clockSyncPong(const uint8_t *ping, uint32_t rxTime, uint8_t *pong)
+{
+    uint8_t *p = &pong[CLOCK_SYNC_PING_SIZE];
+    uint32_t seq;
+    uint32_t sofTime;
+    uint32_t sofCount;
+    uint16_t sofFrame;
+
+    do
+    {
+        seq = gSofSeq;
+        __dmb();
+        sofTime = gSofTime;
+        sofCount = gSofCount;
+        sofFrame = gSofFrame;
+        __dmb();
+    } while ((seq & 1U) || (seq != gSofSeq));
+
+    /* The ping goes back as it came: the host matches exchanges by it. */
+    memcpy(pong, ping, CLOCK_SYNC_PING_SIZE);
+    protoPutU32(&p[0], rxTime);
+    protoPutU16(&p[4], sofFrame);
+    protoPutU32(&p[6], sofTime);
+    protoPutU32(&p[10], sofCount);
+
+    return CLOCK_SYNC_PONG_SIZE;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static void sofIrqHandler(void)
+{
+    uint32_t now = time_us_32();
+    uint16_t frame = (uint16_t)(usb_hw->sof_rd & USB_SOF_RD_BITS);
+
+    /* Every USB event of the frame shares this interrupt. */
+    if (frame == gSofFrame)
+    {
+        return;
+    }
+
+    gSofSeq++;
+    __dmb();
+    gSofTime = now;
+    gSofFrame = frame;
+    gSofCount++;
+    __dmb();
+    gSofSeq++;
+}
@@ -0,0 +1,45 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* PROTO_CMD_CLOCK_PING payload, host times in host microseconds:          */
+/*                                                                          */
+/*     seq u32, t1 u64, prevSeq u32, prevT4 u64, hostFrame u16,             */
+/*     hostFrameTime u64                                                    */
+/*                                                                          */
+/* t1 is the send time of this ping, prevT4 the receive time of the pong   */
+/* to ping prevSeq, so that a capture holds all four times of every        */
+/* exchange. A host that can read the USB frame number passes the time    */
+/* the frame hostFrame started, or CLOCK_SYNC_NO_FRAME.                    */
+#define CLOCK_SYNC_PING_SIZE (34U)
+
+/* PROTO_REC_CLOCK payload: the ping, then in device microseconds          */
+/*                                                                          */
+/*     t2 u32, sofFrame u16, sofTime u32, sofCount u32                      */
+/*                                                                          */
+/* t2 is when the ping was handled, sofTime when the start of frame        */
+/* sofFrame arrived and sofCount the frames seen since USB came up.        */
+#define CLOCK_SYNC_PONG_SIZE (CLOCK_SYNC_PING_SIZE + 14U)
+
+#define CLOCK_SYNC_NO_FRAME (0xFFFFU)
+
+/* USB frame numbers are 11 bits, one per millisecond at full speed. */
+#define CLOCK_SYNC_FRAME_MASK (0x07FFU)
+#define CLOCK_SYNC_FRAME_US (1000U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void clockSyncInit(void);
+uint8_t clockSyncPong(const uint8_t *ping, uint32_t rxTime, uint8_t *pong);
+
+#endif /* CLOCK_SYNC_H */
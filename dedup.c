@@ -0,0 +1,189 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include "dedup.h"
+#include "stats.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Slot key: identifier, channel in bits 29-30 and the extended flag in bit 31. */
+#define SLOT_KEY(frame) ((frame)->id | ((uint32_t)(frame)->channel << 29) | \
+                         (((frame)->flags & CAN_FLAG_EXT) ? 0x80000000UL : 0UL))
+#define KEY_CHANNEL(key) (((key) >> 29) & 0x03U)
+
+/* Slots visited by a single dedupPollIdle() call. */
+#define SCAN_PER_POLL (8U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef struct
+{
+    uint32_t key;
+    uint32_t forwardedAt; /* Timestamp of the last forwarded frame.  */
+    uint32_t lastSeen;    /* Timestamp of the last suppressed frame. */
+    uint32_t count;       /* Suppressed frames since forwardedAt.    */
+    uint8_t flags;
+    uint8_t len;
+    bool isUsed;
+    uint8_t data[DEDUP_MAX_LEN];
+} DedupSlot_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static DedupSlot_t *lookup(uint32_t key, uint32_t now);
+static void takeSummary(DedupSlot_t *slot, DedupSummary_t *summary);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static DedupSlot_t gSlots[DEDUP_SLOTS];
+static bool gIsEnabled = false;
+static uint32_t gKeepaliveUs = DEDUP_DEFAULT_KEEPALIVE_MS * 1000U;
+static uint32_t gScanPos = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void dedupInit(void)
+{
+    memset(gSlots, 0, sizeof(gSlots));
+    gScanPos = 0;
+}
+
+void dedupConfigure(bool isEnabled, uint32_t keepaliveMs)
+{
+    /* Start from an empty cache so no stale payload is compared. */
+    dedupInit();
+
+    gIsEnabled = isEnabled;
+    gKeepaliveUs = keepaliveMs * 1000U;
+}
+
+bool dedupIsEnabled(void)
+{
+    return gIsEnabled;
+}
+
+bool dedupFilter(const CanFrame_t *frame, DedupSummary_t *summary, bool *hasSummary)
+{
+    DedupSlot_t *slot;
+
+    *hasSummary = false;
+
+    if (!gIsEnabled || (frame->len > DEDUP_MAX_LEN) || (frame->flags & CAN_FLAG_RTR))
+    {
+        return true;
+    }
+
+    slot = lookup(SLOT_KEY(frame), frame->timestamp);
+    if (slot == NULL)
+    {
+        statsInc(STAT_DEDUP_UNCACHED);
+        return true;
+    }
+
+    if (slot->isUsed &&
+        (slot->key == SLOT_KEY(frame)) &&
+        (slot->len == frame->len) &&
+        (memcmp(slot->data, frame->data, frame->len) == 0) &&
+        ((uint32_t)(frame->timestamp - slot->forwardedAt) < gKeepaliveUs))
+    {
+        /* Identical repeat inside the keepalive interval. */
+        slot->count++;
+        slot->lastSeen = frame->timestamp;
+        statsInc(STAT_DEDUP_SUPPRESSED);
+        return false;
+    }
+
+    /* Payload changed, keepalive elapsed, first sighting or a slot */
+    /* taken over from another identifier.                          */
+    if (slot->count > 0)
+    {
+        takeSummary(slot, summary);
+        *hasSummary = true;
+    }
+
+    slot->key = SLOT_KEY(frame);
+    slot->forwardedAt = frame->timestamp;
+    slot->flags = frame->flags;
+    slot->len = frame->len;
+    slot->isUsed = true;
+    memcpy(slot->data, frame->data, frame->len);
+
+    return true;
+}
+
+bool dedupPollIdle(uint32_t now, uint32_t channelMask, DedupSummary_t *summary)
+{
+    if (!gIsEnabled)
+    {
+        return false;
+    }
+
+    /* Report repeats of IDs that went silent, a few slots at a time. */
+    for (uint32_t i = 0; i < SCAN_PER_POLL; i++)
+    {
+        DedupSlot_t *slot = &gSlots[gScanPos];
+
+        gScanPos = (gScanPos + 1U) & (DEDUP_SLOTS - 1U);
+
+        if (slot->isUsed && (slot->count > 0) &&
+            (channelMask & (1UL << KEY_CHANNEL(slot->key))) &&
+            ((uint32_t)(now - slot->lastSeen) >= gKeepaliveUs))
+        {
+            takeSummary(slot, summary);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static DedupSlot_t *lookup(uint32_t key, uint32_t now)
+{
+    /* Fibonacci hashing with bounded linear probing. */
+    uint32_t pos = (uint32_t)(key * 0x9E3779B1U) >> (32U - DEDUP_SLOT_BITS);
+    DedupSlot_t *victim = NULL;
+    uint32_t victimAge = 0;
+
+    for (uint32_t i = 0; i < DEDUP_MAX_PROBE; i++)
+    {
+        DedupSlot_t *slot = &gSlots[(pos + i) & (DEDUP_SLOTS - 1U)];
+        uint32_t age;
+
+        if (!slot->isUsed || (slot->key == key))
+        {
+            return slot;
+        }
+
+        /* Time since the identifier was last seen, forwarded or not. */
+        age = now - ((slot->count > 0) ? slot->lastSeen : slot->forwardedAt);
+
+        if (((uint32_t)(now - slot->forwardedAt) >= gKeepaliveUs) && (age >= victimAge))
+        {
+            victim = slot;
+            victimAge = age;
+        }
+    }
+
+    return victim;
+}
+
+static void takeSummary(DedupSlot_t *slot, DedupSummary_t *summary)
+{
+    summary->id = slot->key & CAN_EXT_ID_MASK;
+    summary->channel = (uint8_t)KEY_CHANNEL(slot->key);
+    summary->count = slot->count;
+    summary->lastTimestamp = slot->lastSeen;
+    summary->flags = slot->flags;
+
+    slot->count = 0;
+}
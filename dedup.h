@@ -0,0 +1,55 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_frame.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Number of cache slots. (power of two) */
+#define DEDUP_SLOT_BITS (7U)
+#define DEDUP_SLOTS (1U << DEDUP_SLOT_BITS)
+
+/* Slots probed for an identifier. When they are all taken, the one that */
+/* went longest without a frame is given up, provided its keepalive has   */
+/* elapsed so it could not suppress anything any more; its repeats are   */
+/* reported first. Otherwise the frame is forwarded uncached and counted  */
+/* in STAT_DEDUP_UNCACHED.                                                */
+#define DEDUP_MAX_PROBE (8U)
+
+/* Longest payload held in the cache. Longer frames are always forwarded. */
+#define DEDUP_MAX_LEN (8U)
+
+/* Default keepalive interval. */
+#define DEDUP_DEFAULT_KEEPALIVE_MS (1000U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Repeats suppressed since the last forwarded frame of an ID. */
+typedef struct
+{
+    uint32_t id;
+    uint32_t count;         /* Number of identical frames dropped. */
+    uint32_t lastTimestamp; /* Timestamp of the last dropped one.  */
+    uint8_t flags;
+    uint8_t channel;
+} DedupSummary_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void dedupInit(void);
+void dedupConfigure(bool isEnabled, uint32_t keepaliveMs);
+bool dedupIsEnabled(void);
+bool dedupFilter(const CanFrame_t *frame, DedupSummary_t *summary, bool *hasSummary);
+bool dedupPollIdle(uint32_t now, uint32_t channelMask, DedupSummary_t *summary);
+
+#endif /* DEDUP_H */
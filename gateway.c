@@ -0,0 +1,308 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stddef.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "gateway.h"
+#include "channel.h"
+#include "protocol.h"
+#include "stats.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Standard identifiers indexed directly. */
+#define STD_ID_NUM (CAN_STD_ID_MASK + 1U)
+
+#define TABLE_NUM (2U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Compiled routing table. A standard identifier selects a route set, a   */
+/* bit mask of the routes it matches, so the lookup costs two loads.     */
+/* Extended identifiers are matched against the channel's extended routes. */
+typedef struct
+{
+    GatewayRoute_t routes[GATEWAY_MAX_ROUTES];
+    uint8_t stdSet[CAN_CHANNEL_NUM][STD_ID_NUM];
+    uint32_t sets[GATEWAY_MAX_SETS];
+    uint32_t extRoutes[CAN_CHANNEL_NUM];
+} GatewayTable_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static bool build(GatewayTable_t *table);
+static void forward(const GatewayRoute_t *route, const CanFrame_t *frame, BaseType_t *isWoken);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Staging table filled by gatewayTableAdd(). */
+static GatewayRoute_t gStageRoutes[GATEWAY_MAX_ROUTES];
+static uint8_t gStageCount = 0;
+
+/* The receive path reads gActive while a commit fills the other table. */
+static GatewayTable_t gTables[TABLE_NUM];
+static GatewayTable_t *volatile gActive = &gTables[0];
+
+/* Lookups in progress. A task may move to the other core mid-lookup, */
+/* so a single count is kept under a hardware spin lock.              */
+static spin_lock_t *gReaderLock = NULL;
+static volatile uint32_t gReaders = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void gatewayInit(void)
+{
+    /* Both tables start empty: every identifier maps to the empty set 0. */
+    memset(gTables, 0, sizeof(gTables));
+    gActive = &gTables[0];
+    gStageCount = 0;
+    gReaderLock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+}
+
+void gatewayTableClear(void)
+{
+    gStageCount = 0;
+}
+
+bool gatewayTableAdd(const GatewayRoute_t *route)
+{
+    if (gStageCount >= GATEWAY_MAX_ROUTES)
+    {
+        return false;
+    }
+
+    gStageRoutes[gStageCount++] = *route;
+
+    return true;
+}
+
+bool gatewayTableCommit(void)
+{
+    GatewayTable_t *next = (gActive == &gTables[0]) ? &gTables[1] : &gTables[0];
+
+    if (!build(next))
+    {
+        return false;
+    }
+
+    /* Publish, then wait until no lookup can still hold the old table. */
+    /* Sleep rather than spin: the lookup may belong to a task that     */
+    /* this one preempted. Before the scheduler runs there is none.     */
+    __dmb();
+    gActive = next;
+    __dmb();
+
+    while (gReaders != 0)
+    {
+        vTaskDelay(1);
+    }
+
+    return true;
+}
+
+bool gatewayDecodeRoute(const uint8_t *wire, GatewayRoute_t *route)
+{
+    route->srcChannel = wire[0];
+    route->dstMask = wire[1];
+    route->flags = wire[2];
+    route->id = protoGetU32(&wire[3]);
+    route->mask = protoGetU32(&wire[7]);
+    route->newId = protoGetU32(&wire[11]);
+    route->rewriteMask = protoGetU32(&wire[15]);
+    memcpy(route->dataAnd, &wire[19], GATEWAY_MASK_LEN);
+    memcpy(route->dataOr, &wire[27], GATEWAY_MASK_LEN);
+
+    return (route->srcChannel < CAN_CHANNEL_NUM) &&
+           (route->dstMask != 0) &&
+           (route->dstMask < (1U << CAN_CHANNEL_NUM)) &&
+           ((route->flags & ~GATEWAY_FLAG_ALL) == 0);
+}
+
+bool gatewayRoute(const CanFrame_t *frame, BaseType_t *isWoken)
+{
+    const GatewayTable_t *table;
+    uint32_t hits = 0;
+    bool isExclusive = false;
+    uint32_t save;
+
+    save = spin_lock_blocking(gReaderLock);
+    gReaders++;
+    table = gActive;
+    spin_unlock(gReaderLock, save);
+
+    if (frame->flags & CAN_FLAG_EXT)
+    {
+        uint32_t ext = table->extRoutes[frame->channel];
+
+        while (ext != 0)
+        {
+            uint32_t index = (uint32_t)__builtin_ctz(ext);
+            const GatewayRoute_t *route = &table->routes[index];
+
+            ext &= ext - 1U;
+            if ((frame->id & route->mask) == route->id)
+            {
+                hits |= 1UL << index;
+            }
+        }
+    }
+    else
+    {
+        hits = table->sets[table->stdSet[frame->channel][frame->id & CAN_STD_ID_MASK]];
+    }
+
+    while (hits != 0)
+    {
+        const GatewayRoute_t *route = &table->routes[__builtin_ctz(hits)];
+
+        hits &= hits - 1U;
+        forward(route, frame, isWoken);
+        isExclusive |= (route->flags & GATEWAY_FLAG_EXCLUSIVE) != 0;
+    }
+
+    save = spin_lock_blocking(gReaderLock);
+    gReaders--;
+    spin_unlock(gReaderLock, save);
+
+    return isExclusive;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static bool build(GatewayTable_t *table)
+{
+    uint32_t setCount = 1;
+
+    memset(table, 0, sizeof(*table));
+
+    for (uint8_t i = 0; i < gStageCount; i++)
+    {
+        GatewayRoute_t *route = &table->routes[i];
+        uint32_t idMask;
+
+        *route = gStageRoutes[i];
+        idMask = (route->flags & GATEWAY_FLAG_EXT) ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+        route->mask &= idMask;
+        route->id &= route->mask;
+
+        /* A rewrite cannot set bits the identifier does not have. */
+        route->newId &= idMask;
+        route->rewriteMask &= idMask;
+
+        if (route->flags & GATEWAY_FLAG_EXT)
+        {
+            table->extRoutes[route->srcChannel] |= 1UL << i;
+        }
+    }
+
+    /* Expand the standard routes over the identifier space. Neighbouring */
+    /* identifiers mostly share a set, so the last one is tried first.    */
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        uint32_t lastSet = 0;
+
+        for (uint32_t id = 0; id < STD_ID_NUM; id++)
+        {
+            uint32_t bits = 0;
+            uint32_t set;
+
+            for (uint8_t i = 0; i < gStageCount; i++)
+            {
+                const GatewayRoute_t *route = &table->routes[i];
+
+                if ((route->srcChannel == ch) &&
+                    !(route->flags & GATEWAY_FLAG_EXT) &&
+                    ((id & route->mask) == route->id))
+                {
+                    bits |= 1UL << i;
+                }
+            }
+
+            if (table->sets[lastSet] == bits)
+            {
+                set = lastSet;
+            }
+            else
+            {
+                for (set = 0; (set < setCount) && (table->sets[set] != bits); set++)
+                {
+                }
+
+                if (set == setCount)
+                {
+                    if (setCount >= GATEWAY_MAX_SETS)
+                    {
+                        return false;
+                    }
+                    table->sets[setCount++] = bits;
+                }
+            }
+
+            table->stdSet[ch][id] = (uint8_t)set;
+            lastSet = set;
+        }
+    }
+
+    return true;
+}
+
+static void forward(const GatewayRoute_t *route, const CanFrame_t *frame, BaseType_t *isWoken)
+{
+    const CanFrame_t *out = frame;
+    CanFrame_t copy;
+
+    /* Frames go out as received unless the route changes them, which  */
+    /* costs a local copy. Either way channelForward() then copies all */
+    /* sizeof(CanFrame_t) bytes into each destination's TX queue.      */
+    /* gateway_sim times these copies against the whole path.          */
+    if (route->flags & (GATEWAY_FLAG_REWRITE | GATEWAY_FLAG_MASK_DATA))
+    {
+        memcpy(&copy, frame, offsetof(CanFrame_t, data) + frame->len);
+
+        if (route->flags & GATEWAY_FLAG_REWRITE)
+        {
+            copy.id = (frame->id & ~route->rewriteMask) | (route->newId & route->rewriteMask);
+        }
+
+        if (route->flags & GATEWAY_FLAG_MASK_DATA)
+        {
+            for (uint8_t i = 0; (i < GATEWAY_MASK_LEN) && (i < copy.len); i++)
+            {
+                copy.data[i] = (uint8_t)((copy.data[i] & route->dataAnd[i]) | route->dataOr[i]);
+            }
+        }
+
+        out = &copy;
+    }
+
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        if (!(route->dstMask & (1U << ch)))
+        {
+            continue;
+        }
+
+        if (channelForward(ch, out, isWoken))
+        {
+            statsInc(STAT_GATEWAY_FORWARDED);
+            statsAdd(STAT_GATEWAY_US, time_us_32() - frame->timestamp);
+        }
+        else
+        {
+            statsInc(STAT_GATEWAY_DROPPED);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include "can_config.h"
+#include "can_frame.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Capacity of the routing table. (one bit per route in a route set) */
+#define GATEWAY_MAX_ROUTES (32U)
+
+/* Distinct sets of routes matched by standard identifiers, per table. */
+#define GATEWAY_MAX_SETS (256U)
+
+/* Payload bytes covered by the data mask. */
+#define GATEWAY_MASK_LEN (8U)
+
+/* Route flags. */
+#define GATEWAY_FLAG_EXT (0x01U)       /* Match 29-bit identifiers.             */
+#define GATEWAY_FLAG_REWRITE (0x02U)   /* Replace identifier bits.              */
+#define GATEWAY_FLAG_MASK_DATA (0x04U) /* Apply dataAnd/dataOr to the payload.  */
+#define GATEWAY_FLAG_EXCLUSIVE (0x08U) /* Do not forward the frame to the host. */
+#define GATEWAY_FLAG_ALL (0x0FU)
+
+/* Size of a route in a PROTO_CMD_ROUTE_ADD payload. */
+#define GATEWAY_ROUTE_WIRE_SIZE (35U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Forward frames of srcChannel matching id/mask to every channel in dstMask. */
+/* A rewrite replaces the identifier bits set in rewriteMask with newId.     */
+typedef struct
+{
+    uint32_t id;
+    uint32_t mask;
+    uint32_t newId;
+    uint32_t rewriteMask;
+    uint8_t srcChannel;
+    uint8_t dstMask;
+    uint8_t flags; /* GATEWAY_FLAG_* */
+    uint8_t dataAnd[GATEWAY_MASK_LEN];
+    uint8_t dataOr[GATEWAY_MASK_LEN];
+} GatewayRoute_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void gatewayInit(void);
+void gatewayTableClear(void);
+
+/* Stages a route; false when the table is full. */
+bool gatewayTableAdd(const GatewayRoute_t *route);
+bool gatewayTableCommit(void);
+
+/* Decodes a route from its wire form; false when it names a channel */
+/* that does not exist, no destination, or an unknown flag.          */
+bool gatewayDecodeRoute(const uint8_t *wire, GatewayRoute_t *route);
+bool gatewayRoute(const CanFrame_t *frame, BaseType_t *isWoken);
+
+#endif /* GATEWAY_H */
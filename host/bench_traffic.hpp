@@ -0,0 +1,155 @@
+#ifndef BENCH_TRAFFIC_HPP
+#define BENCH_TRAFFIC_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "capture.hpp"
+
+/* Frames the benches run on: those of a capture, or synthetic vehicle */
+/* traffic that is the same on every run.                              */
+
+namespace canaan
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* A periodic message of the synthetic traffic. */
+struct SyntheticMessage
+{
+    uint32_t id;
+    uint8_t channel;
+    uint8_t flags;
+    uint8_t len;
+    uint32_t periodUs;
+    uint64_t due;
+    uint8_t counter;
+    std::vector<uint8_t> data;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Function                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* Body and powertrain style traffic on channel 0 at 500 kbit/s, and FD */
+/* frames of a camera or radar link on channel 1. Each message has a     */
+/* rolling counter and a checksum, a few slowly changing signals and     */
+/* bytes that hardly ever change, and is sent with some jitter.          */
+inline std::vector<CanFrame_t> makeTraffic(unsigned seconds)
+{
+    static const uint32_t kPeriods[] = {10000U, 20000U, 20000U, 50000U, 100000U, 100000U, 200000U, 1000000U};
+    std::mt19937 rng(1);
+    std::vector<SyntheticMessage> messages;
+    std::vector<CanFrame_t> frames;
+
+    for (unsigned i = 0; i < 48U; i++)
+    {
+        const bool isExt = (i % 6U) == 5U;
+        const uint32_t id = isExt ? (0x18FE0000U | (i << 8) | 0x00F1U) : (0x100U + i * 0x13U);
+
+        messages.push_back(SyntheticMessage{id, 0, static_cast<uint8_t>(isExt ? CAN_FLAG_EXT : 0U), 8U,
+                                            kPeriods[rng() % 8U], rng() % 10000U, 0, std::vector<uint8_t>(8)});
+    }
+    for (unsigned i = 0; i < 8U; i++)
+    {
+        messages.push_back(SyntheticMessage{0x300U + i, 1, CAN_FLAG_FD | CAN_FLAG_BRS,
+                                            static_cast<uint8_t>((i < 4U) ? 64U : 32U), (i < 4U) ? 20000U : 50000U,
+                                            rng() % 10000U, 0, std::vector<uint8_t>((i < 4U) ? 64U : 32U)});
+    }
+    for (SyntheticMessage &message : messages)
+    {
+        for (uint8_t &byte : message.data)
+        {
+            byte = static_cast<uint8_t>((rng() % 4U == 0) ? rng() : 0U);
+        }
+    }
+
+    const uint64_t end = static_cast<uint64_t>(seconds) * 1000000U;
+
+    while (true)
+    {
+        SyntheticMessage &message =
+            *std::min_element(messages.begin(), messages.end(),
+                              [](const SyntheticMessage &a, const SyntheticMessage &b) { return a.due < b.due; });
+        CanFrame_t frame{};
+
+        if (message.due >= end)
+        {
+            break;
+        }
+
+        /* Signals: a slow 16-bit value, a status bit now and then, and */
+        /* for FD frames a few object bytes moving every frame.         */
+        const uint16_t value = static_cast<uint16_t>(message.data[0] | (message.data[1] << 8));
+        const uint16_t next = static_cast<uint16_t>(value + (rng() % 5U) - 2U);
+
+        message.data[0] = static_cast<uint8_t>(next);
+        message.data[1] = static_cast<uint8_t>(next >> 8);
+        if (rng() % 50U == 0)
+        {
+            message.data[3] ^= static_cast<uint8_t>(1U << (rng() % 8U));
+        }
+        for (size_t i = 8; i < message.len; i += 8)
+        {
+            message.data[i] = static_cast<uint8_t>(message.data[i] + (rng() % 3U));
+        }
+        message.counter = static_cast<uint8_t>((message.counter + 1U) & 0x0FU);
+        message.data[6] = static_cast<uint8_t>((message.data[6] & 0xF0U) | message.counter);
+        message.data[7] = 0;
+        for (size_t i = 0; i < message.len; i++)
+        {
+            message.data[7] = static_cast<uint8_t>(message.data[7] + ((i != 7U) ? message.data[i] : 0U));
+        }
+
+        frame.id = message.id;
+        frame.channel = message.channel;
+        frame.flags = message.flags;
+        frame.len = message.len;
+        frame.timestamp = static_cast<uint32_t>(message.due + 0xFFF00000U); /* Wraps early. */
+        std::memcpy(frame.data, message.data.data(), message.len);
+        frames.push_back(frame);
+
+        message.due += message.periodUs - 200U + rng() % 400U;
+    }
+
+    return frames;
+}
+
+inline bool readCapture(const char *path, std::vector<CanFrame_t> &frames)
+{
+    MappedFile capture;
+
+    if (!capture.open(path))
+    {
+        return false;
+    }
+
+    forEachRecord(capture.data(), capture.size(), [&](const Record &rec) {
+        Frame frame;
+        CanFrame_t out{};
+
+        if (decodeFrame(rec, frame))
+        {
+            out.id = frame.id;
+            out.timestamp = static_cast<uint32_t>(frame.timestamp);
+            out.channel = frame.channel;
+            out.flags = frame.flags;
+            out.len = frame.len;
+            std::memcpy(out.data, frame.data, frame.len);
+            frames.push_back(out);
+        }
+    });
+
+    return true;
+}
+
+} /* namespace canaan */
+
+#endif /* BENCH_TRAFFIC_HPP */
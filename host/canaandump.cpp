@@ -0,0 +1,456 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "capture.hpp"
+#include "clock_sync.hpp"
+
+/* Decodes the frames of a captured record stream, in parallel over      */
+/* chunks of the memory-mapped file, as a candump log, CSV or one raw     */
+/* little-endian file per column (prefix.timestamp.u64, prefix.id.u32,    */
+/* prefix.channel.u8, prefix.flags.u8, prefix.len.u8, prefix.data.bin     */
+/* holding len bytes per frame back to back).                             */
+/*                                                                        */
+/*     canaandump [-f candump|csv|columns] [-o output] [-j threads] [-t]  */
+/*                [-i id[:mask]]... [-e id[:mask]]... <capture.bin>       */
+/*                                                                        */
+/* -i and -e add standard and extended identifier filters, in hex.       */
+/* -t converts timestamps to host time with the clock exchanges the host */
+/* made during the capture. (see clock_sync.h)                           */
+/* Without -o, text goes to stdout; columns need -o.                      */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+constexpr size_t kChunkBytes = 4U << 20;
+
+/* Chunks formatted ahead of the writer, per thread. */
+constexpr size_t kChunksInFlight = 2U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+enum class Format
+{
+    Candump,
+    Csv,
+    Columns,
+};
+
+struct Columns
+{
+    std::vector<uint64_t> timestamp;
+    std::vector<uint32_t> id;
+    std::vector<uint8_t> channel;
+    std::vector<uint8_t> flags;
+    std::vector<uint8_t> len;
+    std::vector<uint8_t> data;
+};
+
+/* One chunk's output, in the selected format. */
+struct Output
+{
+    std::string text;
+    Columns columns;
+    uint64_t frames;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+void appendHex(std::string &out, uint32_t value, int digits)
+{
+    static const char kDigits[] = "0123456789ABCDEF";
+
+    for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+    {
+        out.push_back(kDigits[(value >> shift) & 0xFU]);
+    }
+}
+
+void appendDec(std::string &out, uint64_t value, int width = 0)
+{
+    char buf[24];
+    const std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), value);
+    const int len = static_cast<int>(res.ptr - buf);
+
+    out.append(static_cast<size_t>(std::max(0, width - len)), '0');
+    out.append(buf, res.ptr);
+}
+
+void appendData(std::string &out, const canaan::Frame &frame)
+{
+    for (uint8_t i = 0; i < frame.len; i++)
+    {
+        appendHex(out, frame.data[i], 2);
+    }
+}
+
+/* "(seconds.micros) canN ID#DATA", as written by candump -l. */
+void appendCandump(std::string &out, const canaan::Frame &frame)
+{
+    out.push_back('(');
+    appendDec(out, frame.timestamp / 1000000U);
+    out.push_back('.');
+    appendDec(out, frame.timestamp % 1000000U, 6);
+    out.append(") can");
+    appendDec(out, frame.channel);
+    out.push_back(' ');
+    appendHex(out, frame.id, (frame.flags & CAN_FLAG_EXT) ? 8 : 3);
+    out.push_back('#');
+
+    if (frame.flags & CAN_FLAG_FD)
+    {
+        out.push_back('#');
+        appendHex(out, (frame.flags & CAN_FLAG_BRS) ? 1U : 0U, 1);
+        appendData(out, frame);
+    }
+    else if (frame.flags & CAN_FLAG_RTR)
+    {
+        out.push_back('R');
+    }
+    else
+    {
+        appendData(out, frame);
+    }
+    out.push_back('\n');
+}
+
+void appendCsv(std::string &out, const canaan::Frame &frame)
+{
+    appendDec(out, frame.timestamp);
+    out.push_back(',');
+    appendDec(out, frame.channel);
+    out.push_back(',');
+    appendHex(out, frame.id, (frame.flags & CAN_FLAG_EXT) ? 8 : 3);
+    out.push_back(',');
+    appendDec(out, frame.flags);
+    out.push_back(',');
+    appendDec(out, frame.len);
+    out.push_back(',');
+    appendData(out, frame);
+    out.push_back('\n');
+}
+
+void appendColumns(Columns &out, const canaan::Frame &frame)
+{
+    out.timestamp.push_back(frame.timestamp);
+    out.id.push_back(frame.id);
+    out.channel.push_back(frame.channel);
+    out.flags.push_back(frame.flags);
+    out.len.push_back(frame.len);
+    out.data.insert(out.data.end(), frame.data, frame.data + frame.len);
+}
+
+template <typename T>
+bool writeColumn(std::FILE *file, const std::vector<T> &column)
+{
+    return column.empty() || (std::fwrite(column.data(), sizeof(T), column.size(), file) == column.size());
+}
+
+/* Replays the clock exchanges of the capture in order. An exchange is */
+/* complete once the next ping brings the receive time of its pong.    */
+canaan::ClockTimeline buildTimeline(const uint8_t *data, const canaan::CaptureIndex &index, canaan::ClockSync &sync,
+                                    uint64_t &exchanges)
+{
+    canaan::ClockTimeline timeline;
+    std::unordered_map<uint32_t, std::pair<uint64_t, int64_t>> pending; /* seq: t1, device t2. */
+
+    for (const canaan::Chunk &chunk : index.chunks)
+    {
+        canaan::DeviceClock clock{chunk.base, chunk.firstTimestamp};
+
+        canaan::forEachIndexedRecord(data, chunk, [&](const canaan::Record &rec) {
+            canaan::Frame frame;
+            canaan::ClockPong pong;
+
+            if (canaan::decodeFrame(rec, frame))
+            {
+                clock.unwrap(static_cast<uint32_t>(frame.timestamp));
+                return;
+            }
+
+            if (!canaan::decodePong(rec, pong))
+            {
+                return;
+            }
+
+            const int64_t device = clock.at(pong.t2);
+            auto prev = pending.find(pong.prevSeq);
+
+            if ((pong.prevT4 != 0) && (prev != pending.end()))
+            {
+                sync.addExchange(static_cast<int64_t>(prev->second.first), prev->second.second,
+                                 static_cast<int64_t>(pong.prevT4));
+                pending.erase(prev);
+                exchanges++;
+            }
+            sync.addSof(clock.at(pong.sofTime), pong.sofFrame, pong.sofCount);
+            sync.addHostFrame(static_cast<int64_t>(pong.hostFrameTime), pong.hostFrame);
+            pending[pong.seq] = {pong.t1, device};
+
+            timeline.add(device, sync.model());
+        });
+    }
+
+    return timeline;
+}
+
+/* "7DF" or "7E0:7F0". */
+bool parseFilter(const char *arg, canaan::IdFilter &filter, bool isExt)
+{
+    char *end;
+    const uint32_t id = static_cast<uint32_t>(std::strtoul(arg, &end, 16));
+    uint32_t mask = isExt ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+
+    if (end == arg)
+    {
+        return false;
+    }
+
+    if (*end == ':')
+    {
+        const char *maskArg = end + 1;
+        mask = static_cast<uint32_t>(std::strtoul(maskArg, &end, 16));
+        if (end == maskArg)
+        {
+            return false;
+        }
+    }
+
+    filter.add(id, mask, isExt);
+
+    return *end == '\0';
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    Format format = Format::Candump;
+    const char *outPath = nullptr;
+    const char *inPath = nullptr;
+    unsigned threads = std::max(1U, std::thread::hardware_concurrency());
+    bool isHostTime = false;
+    canaan::IdFilter filter;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+
+        if ((arg == "-f") && hasValue)
+        {
+            const std::string name = argv[++i];
+            if (name == "candump")
+            {
+                format = Format::Candump;
+            }
+            else if (name == "csv")
+            {
+                format = Format::Csv;
+            }
+            else if (name == "columns")
+            {
+                format = Format::Columns;
+            }
+            else
+            {
+                inPath = nullptr;
+                break;
+            }
+        }
+        else if ((arg == "-o") && hasValue)
+        {
+            outPath = argv[++i];
+        }
+        else if ((arg == "-j") && hasValue)
+        {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (arg == "-t")
+        {
+            isHostTime = true;
+        }
+        else if (((arg == "-i") || (arg == "-e")) && hasValue)
+        {
+            if (!parseFilter(argv[++i], filter, arg == "-e"))
+            {
+                std::cerr << "bad filter " << argv[i] << "\n";
+                return 2;
+            }
+        }
+        else if ((arg[0] != '-') && (inPath == nullptr))
+        {
+            inPath = argv[i];
+        }
+        else
+        {
+            inPath = nullptr;
+            break;
+        }
+    }
+
+    if ((inPath == nullptr) || ((format == Format::Columns) && (outPath == nullptr)))
+    {
+        std::cerr << "usage: canaandump [-f candump|csv|columns] [-o output] [-j threads] [-t]\n"
+                     "                  [-i id[:mask]]... [-e id[:mask]]... <capture.bin>\n";
+        return 2;
+    }
+
+    canaan::MappedFile capture;
+    if (!capture.open(inPath))
+    {
+        std::cerr << "cannot open " << inPath << "\n";
+        return 1;
+    }
+
+    const canaan::CaptureIndex index = canaan::indexCapture(capture.data(), capture.size(), threads, kChunkBytes);
+
+    /* Map device to host time, if asked and the capture allows. */
+    canaan::ClockSync sync;
+    canaan::ClockTimeline timeline;
+    uint64_t exchanges = 0;
+
+    if (isHostTime)
+    {
+        timeline = buildTimeline(capture.data(), index, sync, exchanges);
+        if (timeline.empty())
+        {
+            std::cerr << "no clock exchanges in " << inPath << "\n";
+            return 1;
+        }
+    }
+
+    /* Open the outputs. */
+    static const char *const kColumnNames[] = {"timestamp.u64", "id.u32", "channel.u8", "flags.u8", "len.u8", "data.bin"};
+    std::vector<std::FILE *> files;
+
+    if (format == Format::Columns)
+    {
+        for (const char *name : kColumnNames)
+        {
+            const std::string path = std::string(outPath) + "." + name;
+            files.push_back(std::fopen(path.c_str(), "wb"));
+            if (files.back() == nullptr)
+            {
+                std::cerr << "cannot open " << path << "\n";
+                return 1;
+            }
+        }
+    }
+    else
+    {
+        files.push_back((outPath != nullptr) ? std::fopen(outPath, "w") : stdout);
+        if (files.back() == nullptr)
+        {
+            std::cerr << "cannot open " << outPath << "\n";
+            return 1;
+        }
+        if (format == Format::Csv)
+        {
+            std::fputs("timestamp_us,channel,id,flags,len,data\n", files[0]);
+        }
+    }
+
+    /* Format a window of chunks in parallel, then write it in order. */
+    const std::vector<canaan::Chunk> &chunks = index.chunks;
+    const size_t window = threads * kChunksInFlight;
+    std::vector<Output> outputs(window);
+    uint64_t written = 0;
+    bool isOk = true;
+
+    for (size_t first = 0; isOk && (first < chunks.size()); first += window)
+    {
+        const size_t count = std::min(window, chunks.size() - first);
+
+        canaan::parallelFor(count, threads, [&](size_t i) {
+            Output &out = outputs[i];
+
+            out.text.clear();
+            out.columns = Columns{};
+            out.frames = 0;
+            canaan::forEachFrame(capture.data(), chunks[first + i], [&](canaan::Frame frame) {
+                if (!filter.accepts(frame.id, frame.flags))
+                {
+                    return;
+                }
+
+                if (isHostTime)
+                {
+                    frame.timestamp = static_cast<uint64_t>(timeline.toHost(static_cast<int64_t>(frame.timestamp)));
+                }
+
+                out.frames++;
+                switch (format)
+                {
+                case Format::Candump:
+                    appendCandump(out.text, frame);
+                    break;
+                case Format::Csv:
+                    appendCsv(out.text, frame);
+                    break;
+                case Format::Columns:
+                    appendColumns(out.columns, frame);
+                    break;
+                }
+            });
+        });
+
+        for (size_t i = 0; isOk && (i < count); i++)
+        {
+            const Output &out = outputs[i];
+
+            written += out.frames;
+            if (format == Format::Columns)
+            {
+                isOk = writeColumn(files[0], out.columns.timestamp) && writeColumn(files[1], out.columns.id) &&
+                       writeColumn(files[2], out.columns.channel) && writeColumn(files[3], out.columns.flags) &&
+                       writeColumn(files[4], out.columns.len) && writeColumn(files[5], out.columns.data);
+            }
+            else
+            {
+                isOk = out.text.empty() || (std::fwrite(out.text.data(), 1, out.text.size(), files[0]) == out.text.size());
+            }
+        }
+    }
+
+    for (std::FILE *file : files)
+    {
+        isOk = (std::fclose(file) == 0) && isOk;
+    }
+
+    if (!isOk)
+    {
+        std::cerr << "write failed\n";
+        return 1;
+    }
+
+    std::cerr << index.records << " records, " << index.frames << " frames, " << written << " written, "
+              << index.crcErrors << " CRC errors, " << index.tail << " trailing bytes\n";
+
+    if (isHostTime)
+    {
+        const canaan::ClockModel &model = sync.model();
+        std::cerr << exchanges << " clock exchanges, drift " << (model.rate - 1.0) * 1e6 << " ppm, last error bound "
+                  << model.error << " us\n";
+    }
+
+    return 0;
+}
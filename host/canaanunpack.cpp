@@ -0,0 +1,160 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "pack_stream.hpp"
+
+/* Expands the PROTO_REC_PACKED records of a stream captured in packed   */
+/* mode into PROTO_REC_FRAME records, passing every other record through, */
+/* so that canaandump and the other tools read it as a raw capture.       */
+/*                                                                        */
+/*     canaanunpack [input|-] [output|-]                                  */
+/*                                                                        */
+/* Reads and writes a block at a time, so it works on a pipe from the     */
+/* device as well as on a file, in constant memory. Records lost to       */
+/* corruption make the frames up to the next reset unreadable; they are   */
+/* counted on stderr.                                                     */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr size_t kBlockBytes = 1U << 20;
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+void putRecord(std::vector<uint8_t> &out, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    const size_t at = out.size();
+
+    out.push_back(PROTO_SYNC);
+    out.push_back(type);
+    out.push_back(len);
+    out.insert(out.end(), payload, payload + len);
+    out.push_back(canaan::crc8(0, &out[at + 1], 2U + len));
+}
+
+void putFrame(std::vector<uint8_t> &out, const canaan::Frame &frame)
+{
+    uint8_t payload[11U + CAN_FRAME_MAX_LEN];
+
+    protoPutU32(&payload[0], static_cast<uint32_t>(frame.timestamp));
+    protoPutU32(&payload[4], frame.id);
+    payload[8] = frame.channel;
+    payload[9] = frame.flags;
+    payload[10] = frame.len;
+    std::memcpy(&payload[11], frame.data, frame.len);
+
+    putRecord(out, PROTO_REC_FRAME, payload, static_cast<uint8_t>(11U + frame.len));
+}
+
+std::FILE *openFile(const char *path, const char *mode, std::FILE *std)
+{
+    return (std::strcmp(path, "-") == 0) ? std : std::fopen(path, mode);
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const char *inPath = (argc > 1) ? argv[1] : "-";
+    const char *outPath = (argc > 2) ? argv[2] : "-";
+
+    if ((argc > 3) || ((argc > 1) && (argv[1][0] == '-') && (argv[1][1] != '\0')))
+    {
+        std::cerr << "usage: canaanunpack [input|-] [output|-]\n";
+        return 2;
+    }
+
+    std::FILE *in = openFile(inPath, "rb", stdin);
+    if (in == nullptr)
+    {
+        std::cerr << "cannot open " << inPath << "\n";
+        return 1;
+    }
+
+    std::FILE *out = openFile(outPath, "wb", stdout);
+    if (out == nullptr)
+    {
+        std::cerr << "cannot open " << outPath << "\n";
+        return 1;
+    }
+
+    canaan::PackDecoder decoder;
+    std::vector<uint8_t> block(kBlockBytes + PROTO_MAX_RECORD);
+    std::vector<uint8_t> expanded;
+    size_t kept = 0;
+    size_t crcErrors = 0;
+    uint64_t packedIn = 0;
+    uint64_t packedBytes = 0;
+    uint64_t frames = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+
+    while (true)
+    {
+        const size_t got = std::fread(&block[kept], 1, kBlockBytes, in);
+        const size_t size = kept + got;
+
+        bytesIn += got;
+        expanded.clear();
+
+        /* At the end, whatever is left is a truncated record. */
+        const size_t used = canaan::forEachRecord(
+            block.data(), size,
+            [&](const canaan::Record &rec) {
+                if (rec.type != PROTO_REC_PACKED)
+                {
+                    putRecord(expanded, rec.type, rec.payload, rec.len);
+                    return;
+                }
+
+                packedIn++;
+                packedBytes += PROTO_HEADER_SIZE + rec.len + PROTO_TRAILER_SIZE;
+                decoder.decode(rec, [&](const canaan::Frame &frame) {
+                    putFrame(expanded, frame);
+                    frames++;
+                });
+            },
+            &crcErrors);
+
+        if (std::fwrite(expanded.data(), 1, expanded.size(), out) != expanded.size())
+        {
+            std::cerr << "cannot write " << outPath << "\n";
+            return 1;
+        }
+        bytesOut += expanded.size();
+
+        kept = size - used;
+        std::memmove(block.data(), &block[used], kept);
+
+        if (got == 0)
+        {
+            break;
+        }
+    }
+
+    std::fflush(out);
+
+    std::fprintf(stderr, "%llu packed records, %llu frames, %llu lost records, %zu CRC errors\n",
+                 static_cast<unsigned long long>(packedIn), static_cast<unsigned long long>(frames),
+                 static_cast<unsigned long long>(decoder.lost()), crcErrors);
+    if (packedBytes > 0)
+    {
+        std::fprintf(stderr, "%llu bytes in, %llu bytes out, packed records %.2f bytes per frame\n",
+                     static_cast<unsigned long long>(bytesIn), static_cast<unsigned long long>(bytesOut),
+                     (frames > 0) ? static_cast<double>(packedBytes) / frames : 0.0);
+    }
+
+    return 0;
+}
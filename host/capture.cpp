@@ -0,0 +1,223 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "capture.hpp"
+
+namespace canaan
+{
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* First record at or after pos a scan can start from: an intact record */
+/* followed by another sync byte or the end of the capture.            */
+size_t resync(const uint8_t *data, size_t size, size_t pos)
+{
+    for (pos = findSync(data, pos, size); pos + PROTO_HEADER_SIZE + PROTO_TRAILER_SIZE <= size;
+         pos = findSync(data, pos + 1U, size))
+    {
+        const size_t total = PROTO_HEADER_SIZE + data[pos + 2] + PROTO_TRAILER_SIZE;
+
+        if ((pos + total <= size) &&
+            (crc8Sliced(0, &data[pos + 1], total - 2U) == data[pos + total - 1]) &&
+            ((pos + total == size) || (data[pos + total] == PROTO_SYNC)))
+        {
+            return pos;
+        }
+    }
+
+    return size;
+}
+
+void scanChunk(const uint8_t *data, size_t size, Chunk &chunk)
+{
+    chunk.records = 0;
+    chunk.frames = 0;
+    chunk.crcErrors = 0;
+    chunk.hasFrames = false;
+    chunk.span = 0;
+
+    chunk.runs.clear();
+
+    chunk.end = scanRecords(data, size, chunk.begin, chunk.limit, [&](const Record &rec) {
+        Frame frame;
+
+        chunk.records++;
+        if (chunk.runs.empty() || (chunk.runs.back().second != rec.offset))
+        {
+            chunk.runs.emplace_back(rec.offset, rec.offset);
+        }
+        chunk.runs.back().second = rec.offset + PROTO_HEADER_SIZE + rec.len + PROTO_TRAILER_SIZE;
+
+        if (!decodeFrame(rec, frame))
+        {
+            return;
+        }
+
+        const uint32_t raw = static_cast<uint32_t>(frame.timestamp);
+
+        if (!chunk.hasFrames)
+        {
+            chunk.firstTimestamp = raw;
+            chunk.hasFrames = true;
+        }
+        else
+        {
+            chunk.span += static_cast<int32_t>(raw - chunk.lastTimestamp);
+        }
+        chunk.lastTimestamp = raw;
+        chunk.frames++;
+    }, &chunk.crcErrors);
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    struct stat st;
+    const int fd = ::open(path, O_RDONLY);
+
+    close();
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    if ((fstat(fd, &st) != 0) || (st.st_size < 0))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mSize = static_cast<size_t>(st.st_size);
+    if (mSize != 0)
+    {
+        void *map = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map == MAP_FAILED)
+        {
+            mSize = 0;
+            ::close(fd);
+            return false;
+        }
+
+        /* Read ahead aggressively: every byte is visited once, in order per thread. */
+        madvise(map, mSize, MADV_SEQUENTIAL);
+        madvise(map, mSize, MADV_WILLNEED);
+        mData = static_cast<const uint8_t *>(map);
+    }
+
+    /* The mapping stays valid without the descriptor. */
+    ::close(fd);
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(mData), mSize);
+    }
+    mData = nullptr;
+    mSize = 0;
+}
+
+void IdFilter::add(uint32_t id, uint32_t mask, bool isExt)
+{
+    mIsEmpty = false;
+
+    if (isExt)
+    {
+        mask &= CAN_EXT_ID_MASK;
+        mExt.emplace_back(id & mask, mask);
+        return;
+    }
+
+    mask &= CAN_STD_ID_MASK;
+    for (uint32_t std = 0; std <= CAN_STD_ID_MASK; std++)
+    {
+        if ((std & mask) == (id & mask))
+        {
+            mStd[std / 64U] |= 1ULL << (std % 64U);
+        }
+    }
+}
+
+CaptureIndex indexCapture(const uint8_t *data, size_t size, unsigned threads, size_t chunkBytes)
+{
+    CaptureIndex index{};
+    const size_t count = std::max<size_t>(1U, (size + chunkBytes - 1U) / std::max<size_t>(chunkBytes, 1U));
+
+    index.chunks.resize(count);
+
+    /* Scan the chunks independently, each from its first plausible record. */
+    parallelFor(count, threads, [&](size_t i) {
+        Chunk &chunk = index.chunks[i];
+
+        chunk.limit = (i + 1U == count) ? size : (i + 1U) * chunkBytes;
+        chunk.begin = (i == 0) ? 0 : resync(data, size, i * chunkBytes);
+        scanChunk(data, size, chunk);
+    });
+
+    /* Stitch: a false sync in a payload, or garbage across a boundary, */
+    /* puts a chunk's start somewhere a single pass would not have.     */
+    for (size_t i = 1; i < count; i++)
+    {
+        Chunk &chunk = index.chunks[i];
+
+        if (chunk.begin != index.chunks[i - 1U].end)
+        {
+            chunk.begin = index.chunks[i - 1U].end;
+            scanChunk(data, size, chunk);
+        }
+    }
+
+    /* Chain the timestamp bases so that every chunk unwraps the timer */
+    /* from where the previous one left it.                            */
+    bool hasLast = false;
+    uint32_t lastRaw = 0;
+    int64_t lastNow = 0;
+
+    for (Chunk &chunk : index.chunks)
+    {
+        index.records += chunk.records;
+        index.frames += chunk.frames;
+        index.crcErrors += chunk.crcErrors;
+
+        if (!chunk.hasFrames)
+        {
+            chunk.firstTimestamp = lastRaw;
+            chunk.base = lastNow;
+            continue;
+        }
+
+        chunk.base = hasLast ? lastNow + static_cast<int32_t>(chunk.firstTimestamp - lastRaw) : chunk.firstTimestamp;
+        lastNow = chunk.base + chunk.span;
+        lastRaw = chunk.lastTimestamp;
+        hasLast = true;
+    }
+
+    index.tail = size - std::min(size, index.chunks.back().end);
+
+    return index;
+}
+
+} /* namespace canaan */
@@ -0,0 +1,362 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#include "record_stream.hpp"
+#include "can_frame.h"
+
+namespace canaan
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* A PROTO_REC_FRAME record, pointing into the capture. */
+struct Frame
+{
+    uint64_t timestamp; /* Unwrapped microseconds. */
+    uint32_t id;
+    uint8_t channel;
+    uint8_t flags; /* CAN_FLAG_* */
+    uint8_t len;
+    const uint8_t *data;
+};
+
+/* A read-only mapping of a capture file. */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const char *path);
+    void close();
+
+    const uint8_t *data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    const uint8_t *mData = nullptr;
+    size_t mSize = 0;
+};
+
+/* Accepts frames whose identifier matches one of the added id/mask pairs, */
+/* or every frame if none was added.                                       */
+class IdFilter
+{
+public:
+    void add(uint32_t id, uint32_t mask, bool isExt);
+    bool empty() const { return mIsEmpty; }
+
+    bool accepts(uint32_t id, uint8_t flags) const
+    {
+        if (mIsEmpty)
+        {
+            return true;
+        }
+
+        if (!(flags & CAN_FLAG_EXT))
+        {
+            const uint32_t std = id & CAN_STD_ID_MASK;
+            return (mStd[std / 64U] >> (std % 64U)) & 1U;
+        }
+
+        for (const auto &ext : mExt)
+        {
+            if ((id & ext.second) == ext.first)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    /* Standard identifiers are expanded into a bitmap, one bit per id. */
+    std::array<uint64_t, (CAN_STD_ID_MASK + 1U) / 64U> mStd{};
+    std::vector<std::pair<uint32_t, uint32_t>> mExt;
+    bool mIsEmpty = true;
+};
+
+/* A slice of the capture decoded by one thread. Records belong to the */
+/* chunk their sync byte is in, so a record may run past limit.       */
+struct Chunk
+{
+    size_t begin;  /* First record.                                   */
+    size_t limit;  /* Records start before this offset.               */
+    size_t end;    /* Where the scan stopped: the next chunk's begin. */
+    uint64_t records;
+    uint64_t frames;
+    uint64_t crcErrors;
+    bool hasFrames;
+    uint32_t firstTimestamp; /* Raw timer value of the first frame.  */
+    uint32_t lastTimestamp;  /* Raw timer value of the last frame.   */
+    int64_t span;            /* Unwrapped last minus first.          */
+    int64_t base;            /* Unwrapped timestamp of the first frame. */
+
+    /* [begin, end) ranges of intact records back to back, so that a */
+    /* second pass can follow the lengths without checking again.    */
+    std::vector<std::pair<size_t, size_t>> runs;
+};
+
+/* Unwraps the 32-bit device timer of successive frames. Channels are */
+/* timestamped by different paths, so time may step back a little: a  */
+/* signed delta covers that and the wrap alike.                       */
+struct DeviceClock
+{
+    int64_t now;
+    uint32_t last;
+
+    int64_t unwrap(uint32_t raw)
+    {
+        now += static_cast<int32_t>(raw - last);
+        last = raw;
+        return now;
+    }
+
+    /* Unwraps a time seen between frames, leaving the clock where it is. */
+    int64_t at(uint32_t raw) const
+    {
+        return now + static_cast<int32_t>(raw - last);
+    }
+};
+
+/* Record boundaries and timestamp bases of a whole capture. */
+struct CaptureIndex
+{
+    std::vector<Chunk> chunks;
+    uint64_t records;
+    uint64_t frames;
+    uint64_t crcErrors;
+    size_t tail; /* Bytes of a truncated record at the end. */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Splits the capture into chunks of about chunkBytes and scans them on   */
+/* threads threads. The result is the same as scanning the capture in one */
+/* pass: a chunk whose start disagrees with where its predecessor stopped */
+/* is scanned again from there.                                           */
+CaptureIndex indexCapture(const uint8_t *data, size_t size, unsigned threads, size_t chunkBytes);
+
+/* -------------------------------------------------------------------------- */
+/* Function                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* crc8() eight bytes at a time: slice k holds the CRC of a byte followed */
+/* by k zero bytes, and the CRC is linear, so the eight lookups combine   */
+/* by XOR instead of chaining through one another.                        */
+constexpr std::array<std::array<uint8_t, 256>, 8> makeCrc8Slices()
+{
+    std::array<std::array<uint8_t, 256>, 8> slices{};
+
+    slices[0] = makeCrc8Table();
+    for (size_t k = 1; k < 8; k++)
+    {
+        for (size_t i = 0; i < 256; i++)
+        {
+            slices[k][i] = slices[0][slices[k - 1][i]];
+        }
+    }
+
+    return slices;
+}
+
+inline constexpr std::array<std::array<uint8_t, 256>, 8> kCrc8Slices = makeCrc8Slices();
+
+inline uint8_t crc8Sliced(uint8_t crc, const uint8_t *data, size_t size)
+{
+    for (; size >= 8U; data += 8, size -= 8U)
+    {
+        crc = kCrc8Slices[7][crc ^ data[0]] ^ kCrc8Slices[6][data[1]] ^ kCrc8Slices[5][data[2]] ^
+              kCrc8Slices[4][data[3]] ^ kCrc8Slices[3][data[4]] ^ kCrc8Slices[2][data[5]] ^
+              kCrc8Slices[1][data[6]] ^ kCrc8Slices[0][data[7]];
+    }
+
+    if (size >= 4U)
+    {
+        crc = kCrc8Slices[3][crc ^ data[0]] ^ kCrc8Slices[2][data[1]] ^ kCrc8Slices[1][data[2]] ^ kCrc8Slices[0][data[3]];
+        data += 4;
+        size -= 4U;
+    }
+
+    return crc8(crc, data, size);
+}
+
+/* Offset of the first sync byte in [pos, size), or size. */
+inline size_t findSync(const uint8_t *data, size_t pos, size_t size)
+{
+#if defined(__SSE2__)
+    const __m128i sync = _mm_set1_epi8(static_cast<char>(PROTO_SYNC));
+
+    for (; pos + 16U <= size; pos += 16U)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&data[pos]));
+        const int hits = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, sync));
+
+        if (hits != 0)
+        {
+            return pos + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(hits)));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t sync = vdupq_n_u8(PROTO_SYNC);
+
+    for (; pos + 16U <= size; pos += 16U)
+    {
+        if (vmaxvq_u8(vceqq_u8(vld1q_u8(&data[pos]), sync)) != 0)
+        {
+            break;
+        }
+    }
+#endif
+
+    while ((pos < size) && (data[pos] != PROTO_SYNC))
+    {
+        pos++;
+    }
+
+    return pos;
+}
+
+/* Calls fn(const Record &) for the intact records starting in          */
+/* [begin, limit), as forEachRecord() would, skipping garbage with      */
+/* findSync(). Returns the offset the scan stopped at.                  */
+template <typename Fn>
+size_t scanRecords(const uint8_t *data, size_t size, size_t begin, size_t limit, Fn &&fn, uint64_t *crcErrors = nullptr)
+{
+    size_t pos = begin;
+
+    while ((pos < limit) && (pos + PROTO_HEADER_SIZE + PROTO_TRAILER_SIZE <= size))
+    {
+        if (data[pos] != PROTO_SYNC)
+        {
+            pos = findSync(data, pos + 1U, size);
+            continue;
+        }
+
+        const uint8_t len = data[pos + 2];
+        const size_t total = PROTO_HEADER_SIZE + len + PROTO_TRAILER_SIZE;
+
+        if (pos + total > size)
+        {
+            break;
+        }
+
+        if (crc8Sliced(0, &data[pos + 1], 2U + len) != data[pos + total - 1])
+        {
+            if (crcErrors != nullptr)
+            {
+                (*crcErrors)++;
+            }
+            pos++;
+            continue;
+        }
+
+        fn(Record{data[pos + 1], len, &data[pos + PROTO_HEADER_SIZE], pos});
+        pos += total;
+    }
+
+    return pos;
+}
+
+/* Decodes a PROTO_REC_FRAME payload. The timestamp is left raw. */
+inline bool decodeFrame(const Record &rec, Frame &frame)
+{
+    if ((rec.type != PROTO_REC_FRAME) || (rec.len < 11U) || (rec.payload[10] > rec.len - 11U))
+    {
+        return false;
+    }
+
+    frame.timestamp = protoGetU32(&rec.payload[0]);
+    frame.id = protoGetU32(&rec.payload[4]);
+    frame.channel = rec.payload[8];
+    frame.flags = rec.payload[9];
+    frame.len = rec.payload[10];
+    frame.data = &rec.payload[11];
+
+    return true;
+}
+
+/* Calls fn(const Record &) for every record of an indexed chunk. The */
+/* index already checked them all, so this only follows the lengths.  */
+template <typename Fn>
+void forEachIndexedRecord(const uint8_t *data, const Chunk &chunk, Fn &&fn)
+{
+    for (const auto &run : chunk.runs)
+    {
+        for (size_t pos = run.first; pos < run.second; pos += PROTO_HEADER_SIZE + data[pos + 2] + PROTO_TRAILER_SIZE)
+        {
+            fn(Record{data[pos + 1], data[pos + 2], &data[pos + PROTO_HEADER_SIZE], pos});
+        }
+    }
+}
+
+/* Calls fn(const Frame &) for every frame of an indexed chunk, with the */
+/* timestamps unwrapped across the whole capture.                        */
+template <typename Fn>
+void forEachFrame(const uint8_t *data, const Chunk &chunk, Fn &&fn)
+{
+    DeviceClock clock{chunk.base, chunk.firstTimestamp};
+
+    forEachIndexedRecord(data, chunk, [&](const Record &rec) {
+        Frame frame;
+
+        if (decodeFrame(rec, frame))
+        {
+            frame.timestamp = static_cast<uint64_t>(clock.unwrap(static_cast<uint32_t>(frame.timestamp)));
+            fn(frame);
+        }
+    });
+}
+
+/* Runs work(index) for index in [0, count) on up to threads threads. */
+template <typename Work>
+void parallelFor(size_t count, unsigned threads, Work &&work)
+{
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+
+    auto run = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            work(i);
+        }
+    };
+
+    for (unsigned t = 1; (t < threads) && (t < count); t++)
+    {
+        pool.emplace_back(run);
+    }
+    run();
+
+    for (std::thread &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+} /* namespace canaan */
+
+#endif /* CAPTURE_HPP */
@@ -0,0 +1,210 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "capture.hpp"
+
+/* Writes a synthetic capture of classic and FD frames with some other   */
+/* records and a little corruption, then measures the decoder on it,     */
+/* single threaded and on every core.                                    */
+/*                                                                       */
+/*     capture_bench [megabytes] [path] [threads]                        */
+/*                                                                       */
+/* Defaults to 1024 MB in capture_bench.bin, left in place, and to one   */
+/* thread per core.                                                      */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* What a pass saw, to check every thread count sees the same. */
+struct Summary
+{
+    uint64_t frames;
+    uint64_t selected;
+    uint64_t checksum;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+void putRecord(std::vector<uint8_t> &out, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    const size_t at = out.size();
+
+    out.push_back(PROTO_SYNC);
+    out.push_back(type);
+    out.push_back(len);
+    out.insert(out.end(), payload, payload + len);
+    out.push_back(canaan::crc8(0, &out[at + 1], 2U + len));
+}
+
+bool writeCapture(const char *path, size_t bytes)
+{
+    static const uint8_t kFdLen[] = {8, 12, 16, 20, 24, 32, 48, 64};
+    std::mt19937 rng(1);
+    std::FILE *file = std::fopen(path, "wb");
+    std::vector<uint8_t> block;
+    uint32_t timestamp = 0xFFF00000U; /* Wraps early in the capture. */
+    size_t written = 0;
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    while (written < bytes)
+    {
+        block.clear();
+        while (block.size() < (1U << 20))
+        {
+            const uint32_t roll = rng();
+            uint8_t p[11U + CAN_FRAME_MAX_LEN];
+            const bool isFd = (roll & 3U) == 0;
+            const bool isExt = (roll & 0x1CU) == 0;
+            const uint8_t len = isFd ? kFdLen[(roll >> 5) & 7U] : static_cast<uint8_t>((roll >> 5) % 9U);
+
+            timestamp += 50U + ((roll >> 8) & 0xFFU);
+            protoPutU32(&p[0], timestamp);
+            protoPutU32(&p[4], isExt ? (rng() & CAN_EXT_ID_MASK) : (rng() & CAN_STD_ID_MASK));
+            p[8] = static_cast<uint8_t>((roll >> 16) & 1U);
+            p[9] = static_cast<uint8_t>((isExt ? CAN_FLAG_EXT : 0U) | (isFd ? (CAN_FLAG_FD | CAN_FLAG_BRS) : 0U));
+            p[10] = len;
+            for (uint8_t i = 0; i < len; i++)
+            {
+                p[11 + i] = static_cast<uint8_t>(rng());
+            }
+            putRecord(block, PROTO_REC_FRAME, p, static_cast<uint8_t>(11U + len));
+
+            /* Now and then a stats record, or a burst of line noise. */
+            if (((roll >> 20) & 0x3FFU) == 0)
+            {
+                putRecord(block, PROTO_REC_STATS, p, 64);
+            }
+            else if (((roll >> 20) & 0xFFFU) == 1)
+            {
+                for (int i = 0; i < 7; i++)
+                {
+                    block.push_back(static_cast<uint8_t>(rng()));
+                }
+            }
+        }
+
+        if (std::fwrite(block.data(), 1, block.size(), file) != block.size())
+        {
+            std::fclose(file);
+            return false;
+        }
+        written += block.size();
+    }
+
+    return std::fclose(file) == 0;
+}
+
+Summary decode(const canaan::MappedFile &capture, unsigned threads, double &seconds)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const canaan::CaptureIndex index = canaan::indexCapture(capture.data(), capture.size(), threads, 4U << 20);
+    std::vector<Summary> parts(index.chunks.size());
+    canaan::IdFilter filter;
+    Summary total{};
+
+    filter.add(0x100U, 0x700U, false);
+
+    canaan::parallelFor(index.chunks.size(), threads, [&](size_t i) {
+        Summary &part = parts[i];
+
+        canaan::forEachFrame(capture.data(), index.chunks[i], [&](const canaan::Frame &frame) {
+            part.frames++;
+            if (filter.accepts(frame.id, frame.flags))
+            {
+                part.selected++;
+                part.checksum += frame.timestamp ^ frame.id ^ frame.len;
+            }
+        });
+    });
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const Summary &part : parts)
+    {
+        total.frames += part.frames;
+        total.selected += part.selected;
+        total.checksum += part.checksum;
+    }
+
+    return total;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const size_t megabytes = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1024U;
+    const char *path = (argc > 2) ? argv[2] : "capture_bench.bin";
+    const unsigned cores = (argc > 3) ? static_cast<unsigned>(std::max(1, std::atoi(argv[3])))
+                                      : std::max(1U, std::thread::hardware_concurrency());
+
+    if (!writeCapture(path, megabytes << 20))
+    {
+        std::fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+
+    canaan::MappedFile capture;
+    if (!capture.open(path))
+    {
+        std::fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+
+    /* Reference: a plain single pass with forEachRecord(). */
+    Summary reference{};
+    canaan::forEachRecord(capture.data(), capture.size(), [&](const canaan::Record &rec) {
+        reference.frames += (rec.type == PROTO_REC_FRAME) ? 1U : 0U;
+    });
+
+    bool isOk = true;
+    Summary first{};
+
+    for (unsigned threads : {1U, cores})
+    {
+        double seconds = 0.0;
+        const Summary s = decode(capture, threads, seconds);
+
+        if (threads == 1U)
+        {
+            first = s;
+        }
+        isOk = isOk && (s.frames == reference.frames) && (s.selected == first.selected) && (s.checksum == first.checksum);
+
+        std::printf("%2u thread%s %8.3f s %7.2f GB/s %llu frames, %llu selected\n", threads, (threads == 1U) ? " " : "s",
+                    seconds, static_cast<double>(capture.size()) / seconds / 1e9,
+                    static_cast<unsigned long long>(s.frames), static_cast<unsigned long long>(s.selected));
+
+        if (cores == 1U)
+        {
+            break;
+        }
+    }
+
+    if (!isOk)
+    {
+        std::fprintf(stderr, "thread counts disagree\n");
+        return 1;
+    }
+
+    return 0;
+}
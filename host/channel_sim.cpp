@@ -0,0 +1,311 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+#include "channel.h"
+#include "gateway.h"
+#include "self_test.h"
+#include "protocol.h"
+#include "stats.h"
+}
+
+#include "target.hpp"
+
+/* Runs channel.c, with 4 channels, on the host target model and loads   */
+/* 1 to 4 of the buses at once, to show how the aggregate throughput to  */
+/* the host scales with the channel count and where USB saturates.       */
+/*                                                                       */
+/*     channel_sim [seconds] [data bitrate]                              */
+/*                                                                       */
+/* Every active bus delivers 64 byte CAN FD frames back to back, at      */
+/* 1 Mbit/s nominal and 5 Mbit/s data rate by default, from its receive  */
+/* interrupt through channelRxFromISR(). A host task takes them on 1 ms  */
+/* ticks, as the CDC task does, round robin over the channels as the     */
+/* bridge does, and encodes each as a PROTO_REC_FRAME into the 19 bulk   */
+/* packets of 64 bytes a full speed USB frame carries.                   */
+/*                                                                       */
+/* Exits with 1 when a load under the USB capacity loses frames, a       */
+/* saturated one does not use at least 95% of it, the channels do not    */
+/* share it within 10%, or a channel's frames arrive out of order.       */
+
+namespace
+{
+
+namespace target = canaan::target;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr uint32_t kBitrate = 1000000U;
+constexpr uint32_t kDataBitrate = 5000000U;
+
+/* Full speed bulk: 19 packets of 64 bytes in every 1 ms frame. */
+constexpr uint32_t kUsbBytesPerMs = 19U * 64U;
+
+/* PROTO_REC_FRAME payload before the data. */
+constexpr size_t kFrameHeader = 11U;
+
+/* Time to fill the queues before measuring, and to empty them after. */
+constexpr uint64_t kSettleNs = 100U * target::kNsPerMs;
+
+/* Pass criteria. */
+constexpr double kUsbShare = 0.95;
+constexpr double kFairShare = 0.90;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* A bus loaded back to back, seen from its controller's receive interrupt. */
+class Bus : public target::Device
+{
+public:
+    Bus(uint8_t ch, uint32_t dataBitrate) : mChannel(ch)
+    {
+        CanFrame_t frame = makeFrame(0);
+        uint32_t nominal;
+        uint32_t data;
+
+        rateFrameBits(&frame, &nominal, &data);
+        mFrameNs = nominal * target::kNsPerS / kBitrate + data * target::kNsPerS / dataBitrate;
+    }
+
+    uint64_t nextEvent() const override
+    {
+        return mIsActive ? mNext : target::kNever;
+    }
+
+    void advance(uint64_t now) override
+    {
+        CanFrame_t frame = makeFrame(mSeq++);
+        BaseType_t isWoken = pdFALSE;
+
+        (void)channelRxFromISR(mChannel, &frame, &isWoken);
+        mNext = now + mFrameNs;
+    }
+
+    void setActive(bool isActive)
+    {
+        mIsActive = isActive;
+        mNext = target::now();
+    }
+
+    double framesPerS() const
+    {
+        return static_cast<double>(target::kNsPerS) / mFrameNs;
+    }
+
+private:
+    CanFrame_t makeFrame(uint32_t seq) const
+    {
+        CanFrame_t frame{};
+
+        frame.id = 0x100U + mChannel;
+        frame.timestamp = time_us_32();
+        frame.flags = CAN_FLAG_FD | CAN_FLAG_BRS;
+        frame.len = CAN_FRAME_MAX_LEN;
+        protoPutU32(frame.data, seq);
+
+        return frame;
+    }
+
+    uint8_t mChannel;
+    uint64_t mFrameNs = 0;
+    uint64_t mNext = 0;
+    uint32_t mSeq = 0;
+    bool mIsActive = false;
+};
+
+/* What the host received, per channel. */
+struct Host
+{
+    uint64_t frames[CAN_CHANNEL_NUM];
+    uint64_t bytes;
+    uint32_t nextSeq[CAN_CHANNEL_NUM];
+    bool isOrdered;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+Host gHost{};
+
+StaticTask_t gUsbTaskDef;
+StackType_t gUsbStack[configMINIMAL_STACK_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* The bridge and the CDC task: whatever the USB frame has room for,  */
+/* round robin over the channels. A record cut at the end of a frame  */
+/* goes on in the next one.                                           */
+void usbTask(void *nouse)
+{
+    static uint8_t payload[PROTO_MAX_PAYLOAD];
+    static uint8_t out[PROTO_MAX_RECORD];
+    uint32_t carry = 0;
+    uint8_t next = 0;
+
+    (void)nouse;
+    while (true)
+    {
+        uint32_t budget = kUsbBytesPerMs;
+        bool isIdle = false;
+
+        vTaskDelay(1);
+
+        budget -= std::min(budget, carry);
+        carry -= std::min(carry, kUsbBytesPerMs);
+
+        while ((budget > 0) && !isIdle)
+        {
+            CanFrame_t frame;
+
+            isIdle = true;
+            for (uint8_t i = 0; i < CAN_CHANNEL_NUM; i++)
+            {
+                const uint8_t ch = (next + i) % CAN_CHANNEL_NUM;
+
+                if (channelReceive(ch, &frame))
+                {
+                    next = (ch + 1U) % CAN_CHANNEL_NUM;
+                    isIdle = false;
+                    break;
+                }
+            }
+
+            if (isIdle)
+            {
+                break;
+            }
+
+            protoPutU32(&payload[0], frame.timestamp);
+            protoPutU32(&payload[4], frame.id);
+            payload[8] = frame.channel;
+            payload[9] = frame.flags;
+            payload[10] = frame.len;
+            std::memcpy(&payload[kFrameHeader], frame.data, frame.len);
+
+            const uint32_t size =
+                protoEncode(PROTO_REC_FRAME, payload, static_cast<uint8_t>(kFrameHeader + frame.len), out, sizeof(out));
+            const uint32_t seq = protoGetU32(frame.data);
+
+            gHost.isOrdered &= seq >= gHost.nextSeq[frame.channel];
+            gHost.nextSeq[frame.channel] = seq + 1U;
+            gHost.frames[frame.channel]++;
+            gHost.bytes += size;
+
+            carry = size - std::min(budget, size);
+            budget -= std::min(budget, size);
+        }
+    }
+}
+
+/* Unused here: no self test runs. */
+extern "C" bool selfTestRx(const CanFrame_t *frame)
+{
+    (void)frame;
+    return false;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const unsigned seconds = (argc > 1) ? static_cast<unsigned>(std::max(1, std::atoi(argv[1]))) : 2U;
+    const uint32_t dataBitrate = (argc > 2) ? static_cast<uint32_t>(std::atoi(argv[2])) : kDataBitrate;
+    const uint64_t span = seconds * target::kNsPerS;
+    std::vector<Bus *> buses;
+    bool isOk = true;
+
+    statsInit();
+    gatewayInit();
+    channelInit();
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        buses.push_back(new Bus(ch, dataBitrate));
+        target::attach(buses.back());
+    }
+    (void)xTaskCreateStatic(usbTask, "usb", configMINIMAL_STACK_SIZE, NULL, 2, gUsbStack, &gUsbTaskDef);
+    gHost.isOrdered = true;
+
+    /* The record a frame makes, and how many of them USB carries. */
+    uint8_t payload[kFrameHeader + CAN_FRAME_MAX_LEN] = {};
+    uint8_t out[PROTO_MAX_RECORD];
+    const uint32_t recordSize = protoEncode(PROTO_REC_FRAME, payload, sizeof(payload), out, sizeof(out));
+    const double usbBytesPerS = kUsbBytesPerMs * 1000.0;
+    const double usbFramesPerS = usbBytesPerS / recordSize;
+
+    std::printf("64 byte FD frames at %u/%u bit/s: %.0f frames/s per bus, %u bytes per record, USB carries %.0f/s\n",
+                kBitrate, dataBitrate, buses[0]->framesPerS(), recordSize, usbFramesPerS);
+    std::printf("  %-8s %12s %12s %8s %10s %8s %8s\n", "channels", "offered/s", "delivered/s", "of USB", "dropped/s",
+                "fairness", "result");
+
+    for (uint8_t active = 1; active <= CAN_CHANNEL_NUM; active++)
+    {
+        StatsSnapshot_t before;
+        StatsSnapshot_t after;
+        Host start;
+        double offered = 0.0;
+        double delivered = 0.0;
+        double dropped = 0.0;
+        double least = 1e30;
+        double most = 0.0;
+
+        for (uint8_t ch = 0; ch < active; ch++)
+        {
+            buses[ch]->setActive(true);
+            offered += buses[ch]->framesPerS();
+        }
+
+        (void)target::run(target::now() + kSettleNs);
+        statsSnapshot(&before);
+        start = gHost;
+        (void)target::run(target::now() + span);
+        statsSnapshot(&after);
+
+        for (uint8_t ch = 0; ch < active; ch++)
+        {
+            const double frames = static_cast<double>(gHost.frames[ch] - start.frames[ch]) / seconds;
+
+            delivered += frames;
+            least = std::min(least, frames);
+            most = std::max(most, frames);
+            dropped += static_cast<double>(after.counter[STAT_CH(ch, STAT_CH_RX_DROPPED)] -
+                                           before.counter[STAT_CH(ch, STAT_CH_RX_DROPPED)]) /
+                       seconds;
+        }
+
+        /* Under the capacity nothing may be lost; at it, USB must be full */
+        /* and shared out evenly.                                          */
+        const bool isSaturated = offered > kUsbShare * usbFramesPerS;
+        const double fairness = least / std::max(most, 1.0);
+        const bool isPass = isSaturated ? ((delivered >= kUsbShare * usbFramesPerS) && (fairness >= kFairShare))
+                                        : ((dropped == 0.0) && (delivered >= 0.99 * offered));
+
+        std::printf("  %-8u %12.0f %12.0f %7.1f%% %10.0f %8.2f %8s\n", active, offered, delivered,
+                    100.0 * delivered / usbFramesPerS, dropped, fairness, isPass ? "ok" : "FAIL");
+        isOk &= isPass;
+
+        for (uint8_t ch = 0; ch < active; ch++)
+        {
+            buses[ch]->setActive(false);
+        }
+        (void)target::run(target::now() + kSettleNs);
+    }
+
+    std::printf("  order per channel: %s\n", gHost.isOrdered ? "kept" : "BROKEN");
+
+    return (isOk && gHost.isOrdered) ? 0 : 1;
+}
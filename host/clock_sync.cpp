@@ -0,0 +1,217 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include "clock_sync.hpp"
+
+namespace canaan
+{
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Standard error below which the window's own slope is trusted over  */
+/* the frame count, which assumes the bus and the host clock agree.   */
+constexpr double kMaxSlopeError = 5e-6;
+
+/* Start of frame count needed before its rate is used. */
+constexpr uint32_t kMinSofFrames = 1000U;
+
+/* Bound of a host frame timestamp: the host polls for the frame edge. */
+constexpr int64_t kHostFrameBoundUs = 20;
+
+/* How far the device rate may wander from a straight line over the   */
+/* window: a crystal's temperature drift over a minute or two.        */
+constexpr double kRateWander = 2e-6;
+
+/* How far the host controller's frame clock may be from the host     */
+/* clock, while the start of frame count sets the rate.               */
+constexpr double kBusRateError = 50e-6;
+
+/* Slope standard errors allowed for in the rate error bound. */
+constexpr double kSlopeSigmas = 3.0;
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+ClockSync::ClockSync(size_t group, size_t window)
+    : mGroup(std::max<size_t>(group, 1U)), mWindow(std::max<size_t>(window, 2U))
+{
+}
+
+void ClockSync::addExchange(int64_t t1, int64_t device, int64_t t4)
+{
+    if (t4 < t1)
+    {
+        return;
+    }
+
+    /* Rounded up, and a microsecond more for the whole microseconds. */
+    addSample(ClockSample{device, t1 + (t4 - t1) / 2, (t4 - t1 + 1) / 2 + 1});
+}
+
+void ClockSync::addSof(int64_t sofDevice, uint16_t sofFrame, uint32_t sofCount)
+{
+    if (sofFrame == CLOCK_SYNC_NO_FRAME)
+    {
+        return;
+    }
+
+    /* A reset count means USB came up again: start measuring over. */
+    if (!mHasSof || (sofCount < mFirstSofCount))
+    {
+        mFirstSofDevice = sofDevice;
+        mFirstSofCount = sofCount;
+        mHasSof = true;
+    }
+    else if (sofCount - mFirstSofCount >= kMinSofFrames)
+    {
+        mBusRate = static_cast<double>(sofDevice - mFirstSofDevice) /
+                   (static_cast<double>(sofCount - mFirstSofCount) * CLOCK_SYNC_FRAME_US);
+    }
+
+    mSofDevice = sofDevice;
+    mSofFrame = sofFrame;
+}
+
+void ClockSync::addHostFrame(int64_t hostTime, uint16_t hostFrame)
+{
+    if (!mHasSof || (hostFrame == CLOCK_SYNC_NO_FRAME))
+    {
+        return;
+    }
+
+    /* Frames between the device's last start of frame and the host's, */
+    /* either way round, within half the frame number range.            */
+    const int32_t frames = static_cast<int32_t>((hostFrame - mSofFrame + 1024U) & CLOCK_SYNC_FRAME_MASK) - 1024;
+    const int64_t device = mSofDevice + std::llround(frames * static_cast<double>(CLOCK_SYNC_FRAME_US) * mBusRate);
+
+    addSample(ClockSample{device, hostTime, kHostFrameBoundUs});
+}
+
+void ClockTimeline::add(int64_t device, const ClockModel &model)
+{
+    if (model.isValid)
+    {
+        mModels.emplace_back(device, model);
+    }
+}
+
+int64_t ClockTimeline::toHost(int64_t device) const
+{
+    auto it = std::upper_bound(mModels.begin(), mModels.end(), device,
+                               [](int64_t d, const std::pair<int64_t, ClockModel> &m) { return d < m.first; });
+
+    /* Before the first estimate, extrapolate the first one back. */
+    if (it != mModels.begin())
+    {
+        --it;
+    }
+
+    return it->second.toHost(device);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+void ClockSync::addSample(const ClockSample &sample)
+{
+    if ((mGroupCount == 0) || (sample.bound < mBest.bound))
+    {
+        mBest = sample;
+    }
+
+    /* The group's best so far joins the fit at once, so that an estimate */
+    /* exists from the first exchange; it is replaced until the group ends. */
+    if (mGroupCount > 0)
+    {
+        mSamples.pop_back();
+    }
+    mSamples.push_back(mBest);
+
+    if (++mGroupCount == mGroup)
+    {
+        mGroupCount = 0;
+        while (mSamples.size() > mWindow)
+        {
+            mSamples.pop_front();
+        }
+    }
+
+    fit();
+}
+
+void ClockSync::fit()
+{
+    /* Fit offset = host - device against x = device - device0, */
+    /* weighted by 1 / bound^2. Small numbers keep doubles exact. */
+    const ClockSample &last = mSamples.back();
+    const int64_t device0 = last.device;
+    const int64_t offset0 = last.host - last.device;
+    double sw = 0.0;
+    double sx = 0.0;
+    double sy = 0.0;
+    double sxx = 0.0;
+    double sxy = 0.0;
+
+    for (const ClockSample &s : mSamples)
+    {
+        const double w = 1.0 / (static_cast<double>(s.bound) * static_cast<double>(s.bound));
+        const double x = static_cast<double>(s.device - device0);
+        const double y = static_cast<double>((s.host - s.device) - offset0);
+
+        sw += w;
+        sx += w * x;
+        sy += w * y;
+        sxx += w * x * x;
+        sxy += w * x * y;
+    }
+
+    double slope = 1.0 / mBusRate - 1.0;
+    double rateError = kRateWander + kBusRateError;
+    const double det = sw * sxx - sx * sx;
+
+    if ((mSamples.size() >= 3U) && (det > 0.0) && (sw / det < kMaxSlopeError * kMaxSlopeError))
+    {
+        slope = (sw * sxy - sx * sy) / det;
+        rateError = kRateWander + kSlopeSigmas * std::sqrt(sw / det);
+    }
+
+    const double intercept = (sy - slope * sx) / sw;
+
+    /* Each sample puts the offset at device0 within its bound, plus the */
+    /* rate error over the distance. Those intervals must overlap.       */
+    double lo = -HUGE_VAL;
+    double hi = HUGE_VAL;
+    double nearest = HUGE_VAL;
+
+    for (const ClockSample &s : mSamples)
+    {
+        const double x = static_cast<double>(s.device - device0);
+        const double y = static_cast<double>((s.host - s.device) - offset0) - slope * x;
+        const double width = static_cast<double>(s.bound) + std::fabs(x) * rateError;
+
+        lo = std::max(lo, y - width);
+        hi = std::min(hi, y + width);
+        nearest = std::min(nearest, std::fabs(intercept - y) + width);
+    }
+
+    mModel.device0 = device0;
+    mModel.host0 = device0 + offset0 + std::llround(intercept);
+    mModel.rate = 1.0 + slope;
+    mModel.rateError = rateError;
+
+    /* Disjoint intervals break the rate error assumed; the sample that */
+    /* gives the smallest bound on its own is the best left to go by.   */
+    /* Half a microsecond more for rounding host0.                      */
+    mModel.error = ((lo <= hi) ? std::max(intercept - lo, hi - intercept) : nearest) + 0.5;
+    mModel.isValid = true;
+}
+
+} /* namespace canaan */
@@ -0,0 +1,159 @@
+#ifndef CLOCK_SYNC_HPP
+#define CLOCK_SYNC_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "record_stream.hpp"
+#include "clock_sync.h"
+
+namespace canaan
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Device time device happened at host time host, give or take bound. */
+struct ClockSample
+{
+    int64_t device;
+    int64_t host;
+    int64_t bound;
+};
+
+/* host = host0 + (device - device0) * rate, in microseconds. The error */
+/* bounds hold while the device rate stays within rateError of rate.    */
+struct ClockModel
+{
+    int64_t device0;
+    int64_t host0;
+    double rate;      /* Host microseconds per device microsecond. */
+    double error;     /* Bound on the error of host0, in microseconds. */
+    double rateError; /* Assumed bound on the error of rate. */
+    bool isValid;
+
+    int64_t toHost(int64_t device) const
+    {
+        return host0 + std::llround(static_cast<double>(device - device0) * rate);
+    }
+
+    /* Bound on the error of toHost(device). */
+    double errorAt(int64_t device) const
+    {
+        return error + std::fabs(static_cast<double>(device - device0)) * rateError;
+    }
+};
+
+/* A decoded PROTO_REC_CLOCK. (see clock_sync.h) */
+struct ClockPong
+{
+    uint32_t seq;
+    uint64_t t1;
+    uint32_t prevSeq;
+    uint64_t prevT4;
+    uint16_t hostFrame;
+    uint64_t hostFrameTime;
+    uint32_t t2;
+    uint16_t sofFrame;
+    uint32_t sofTime;
+    uint32_t sofCount;
+};
+
+/* Estimates host time from device time, continuously, out of ping round    */
+/* trips and USB start of frame timestamps.                                 */
+/*                                                                          */
+/* A round trip bounds the host time of t2 to [t1, t4]. Only the tightest   */
+/* of every group of exchanges is kept, as queueing only ever adds delay,   */
+/* and a line is fitted through the last window of them, weighted by their  */
+/* bounds. Until the window pins the drift down, the rate comes from the    */
+/* start of frame count: frames are 1 ms of the host controller's clock,    */
+/* timestamped by the device. A host that can read the frame number adds    */
+/* samples bounded by its own frame timestamps instead of USB latency.      */
+/*                                                                          */
+/* The model's error is not a statistical estimate but a bound: every       */
+/* sample's interval is carried to device0 along the fitted rate, widened   */
+/* by the rate error assumed, and the bound is the distance from host0 to   */
+/* the far end of their intersection.                                       */
+class ClockSync
+{
+public:
+    explicit ClockSync(size_t group = 8U, size_t window = 96U);
+
+    void addExchange(int64_t t1, int64_t device, int64_t t4);
+    void addSof(int64_t sofDevice, uint16_t sofFrame, uint32_t sofCount);
+    void addHostFrame(int64_t hostTime, uint16_t hostFrame);
+
+    const ClockModel &model() const { return mModel; }
+
+    /* Device microseconds per bus microsecond, 1 until measured. */
+    double busRate() const { return mBusRate; }
+
+private:
+    void addSample(const ClockSample &sample);
+    void fit();
+
+    size_t mGroup;
+    size_t mWindow;
+    std::deque<ClockSample> mSamples;
+    ClockSample mBest{};
+    size_t mGroupCount = 0;
+
+    bool mHasSof = false;
+    int64_t mSofDevice = 0;
+    uint16_t mSofFrame = 0;
+    int64_t mFirstSofDevice = 0;
+    uint32_t mFirstSofCount = 0;
+    double mBusRate = 1.0;
+
+    ClockModel mModel{};
+};
+
+/* The models a ClockSync went through, to map a whole capture. Each */
+/* device time uses the last model before it.                        */
+class ClockTimeline
+{
+public:
+    void add(int64_t device, const ClockModel &model);
+    bool empty() const { return mModels.empty(); }
+    int64_t toHost(int64_t device) const;
+
+private:
+    std::vector<std::pair<int64_t, ClockModel>> mModels;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Function                                                                   */
+/* -------------------------------------------------------------------------- */
+inline bool decodePong(const Record &rec, ClockPong &pong)
+{
+    const uint8_t *p = rec.payload;
+
+    if ((rec.type != PROTO_REC_CLOCK) || (rec.len != CLOCK_SYNC_PONG_SIZE))
+    {
+        return false;
+    }
+
+    pong.seq = protoGetU32(&p[0]);
+    pong.t1 = protoGetU64(&p[4]);
+    pong.prevSeq = protoGetU32(&p[12]);
+    pong.prevT4 = protoGetU64(&p[16]);
+    pong.hostFrame = protoGetU16(&p[24]);
+    pong.hostFrameTime = protoGetU64(&p[26]);
+    pong.t2 = protoGetU32(&p[34]);
+    pong.sofFrame = protoGetU16(&p[38]);
+    pong.sofTime = protoGetU32(&p[40]);
+    pong.sofCount = protoGetU32(&p[44]);
+
+    return true;
+}
+
+} /* namespace canaan */
+
+#endif /* CLOCK_SYNC_HPP */
@@ -0,0 +1,223 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "clock_sync.hpp"
+
+/* Runs ClockSync against a simulated device whose clock drifts, over a  */
+/* simulated full-speed USB link, and prints the true and the estimated  */
+/* error over time: once with ping round trips and start of frame counts */
+/* only, once with a host that also reads USB frame numbers.             */
+/*                                                                       */
+/*     clocksync_sim [minutes] [seed]                                    */
+/*                                                                       */
+/* The pongs go through the wire format and are matched up the way an    */
+/* offline decoder sees them, each exchange completed by the next ping.  */
+/*                                                                       */
+/* Exits with 1 when the true error ever exceeds the model's bound.      */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr double kPingIntervalUs = 100000.0;
+
+/* Host controller clock against the host clock. */
+constexpr double kBusPpm = -12.0;
+
+/* Device crystal: offset, temperature swing and random walk, in ppm. */
+constexpr double kDevicePpm = 45.0;
+constexpr double kDeviceSwingPpm = 3.0;
+constexpr double kDeviceSwingPeriodUs = 15.0 * 60e6;
+constexpr double kDeviceWalkPpm = 0.02;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* The simulated device clock, integrated at every ping. */
+struct Device
+{
+    double time; /* Unwrapped device microseconds. */
+    double ppm;
+    double walk;
+
+    uint32_t raw(double hostDelta) const
+    {
+        return static_cast<uint32_t>(static_cast<uint64_t>(time + hostDelta * (1.0 + ppm * 1e-6)));
+    }
+};
+
+struct Stats
+{
+    double sumSquares;
+    double maxAbs;
+    double maxEstimate;
+    size_t count;
+    size_t outside; /* Times the true error exceeded the bound. */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+double busTime(double host)
+{
+    return host * (1.0 + kBusPpm * 1e-6);
+}
+
+double hostTimeOfFrame(uint64_t frame)
+{
+    return static_cast<double>(frame) * CLOCK_SYNC_FRAME_US / (1.0 + kBusPpm * 1e-6);
+}
+
+/* Host time of the next start of frame after host. */
+double nextFrame(double host)
+{
+    return hostTimeOfFrame(static_cast<uint64_t>(busTime(host) / CLOCK_SYNC_FRAME_US) + 1U);
+}
+
+Stats run(bool hasHostFrame, double minutes, unsigned seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    canaan::ClockSync sync;
+    Stats stats{};
+
+    /* Starts a few seconds before the 32-bit timer wraps, 123 s into USB. */
+    Device device{4294967296.0 - 5e6, kDevicePpm, 0.0};
+    const double hostStart = 1.7e15 + 123e6;
+    const uint64_t firstFrame = static_cast<uint64_t>(busTime(hostStart) / CLOCK_SYNC_FRAME_US);
+
+    /* Host side unwrapping of t2, as a decoder does against the frames. */
+    int64_t deviceNow = static_cast<int64_t>(device.time);
+    uint32_t deviceLast = static_cast<uint32_t>(static_cast<uint64_t>(device.time));
+
+    uint32_t seq = 0;
+    uint32_t prevSeq = 0;
+    uint64_t prevT4 = 0;
+    std::vector<std::pair<uint64_t, int64_t>> sent; /* t1, device t2 by seq. */
+
+    std::printf("%s\n  min   error us     bound us   drift ppm  true ppm\n",
+                hasHostFrame ? "ping + host frame numbers" : "ping + start of frame count");
+
+    for (double elapsed = 0.0; elapsed < minutes * 60e6; elapsed += kPingIntervalUs)
+    {
+        const double host = hostStart + elapsed;
+
+        /* Ping: the host stack, then the next frame, then the device    */
+        /* task, which polls the CDC FIFO every millisecond.             */
+        const double t1 = host;
+        const double arrive = nextFrame(t1 + 20.0 + 180.0 * unit(rng)) + 1000.0 * unit(rng);
+        const uint32_t t2 = device.raw(arrive - host);
+
+        /* Latest start of frame before the ping was handled. */
+        const uint64_t frame = static_cast<uint64_t>(busTime(arrive) / CLOCK_SYNC_FRAME_US);
+        const uint32_t sofTime = device.raw(hostTimeOfFrame(frame) - host + 1.0 + 3.0 * unit(rng));
+
+        /* Pong: written at once, read at the next frame, then the host stack. */
+        const double t4 = nextFrame(arrive + 5.0 + 45.0 * unit(rng)) + 50.0 + 250.0 * unit(rng);
+
+        /* Host frame edge, polled for just before sending. */
+        const uint64_t hostFrame = static_cast<uint64_t>(busTime(t1) / CLOCK_SYNC_FRAME_US);
+        const double hostFrameTime = hostTimeOfFrame(hostFrame) + 20.0 * (unit(rng) - 0.5);
+
+        /* The pong on the wire. */
+        uint8_t payload[CLOCK_SYNC_PONG_SIZE];
+        protoPutU32(&payload[0], seq);
+        protoPutU64(&payload[4], static_cast<uint64_t>(t1));
+        protoPutU32(&payload[12], prevSeq);
+        protoPutU64(&payload[16], prevT4);
+        protoPutU16(&payload[24], hasHostFrame ? static_cast<uint16_t>(hostFrame & CLOCK_SYNC_FRAME_MASK) : CLOCK_SYNC_NO_FRAME);
+        protoPutU64(&payload[26], static_cast<uint64_t>(hostFrameTime));
+        protoPutU32(&payload[34], t2);
+        protoPutU16(&payload[38], static_cast<uint16_t>(frame & CLOCK_SYNC_FRAME_MASK));
+        protoPutU32(&payload[40], sofTime);
+        protoPutU32(&payload[44], static_cast<uint32_t>(frame - firstFrame));
+
+        canaan::ClockPong pong;
+        if (!canaan::decodePong(canaan::Record{PROTO_REC_CLOCK, CLOCK_SYNC_PONG_SIZE, payload, 0}, pong))
+        {
+            std::fprintf(stderr, "pong does not decode\n");
+            std::exit(1);
+        }
+
+        deviceNow += static_cast<int32_t>(pong.t2 - deviceLast);
+        deviceLast = pong.t2;
+
+        if ((pong.prevT4 != 0) && (pong.prevSeq < sent.size()))
+        {
+            const auto &prev = sent[pong.prevSeq];
+            sync.addExchange(static_cast<int64_t>(prev.first), prev.second, static_cast<int64_t>(pong.prevT4));
+        }
+        sync.addSof(deviceNow + static_cast<int32_t>(pong.sofTime - pong.t2), pong.sofFrame, pong.sofCount);
+        sync.addHostFrame(static_cast<int64_t>(pong.hostFrameTime), pong.hostFrame);
+        sent.emplace_back(pong.t1, deviceNow);
+
+        /* The next ping carries this pong's receive time. */
+        prevSeq = seq++;
+        prevT4 = static_cast<uint64_t>(t4);
+
+        /* Score the estimate at the device time of this instant. */
+        const canaan::ClockModel &model = sync.model();
+        if (model.isValid)
+        {
+            const double error = static_cast<double>(model.toHost(static_cast<int64_t>(device.time))) - host;
+            const double bound = model.errorAt(static_cast<int64_t>(device.time));
+
+            stats.outside += std::fabs(error) > bound;
+            if (elapsed >= 60e6)
+            {
+                stats.sumSquares += error * error;
+                stats.maxAbs = std::max(stats.maxAbs, std::fabs(error));
+                stats.maxEstimate = std::max(stats.maxEstimate, bound);
+                stats.count++;
+            }
+
+            if (std::fmod(elapsed, 60e6) < kPingIntervalUs / 2.0)
+            {
+                std::printf("  %3.0f %10.1f %12.1f %11.3f %9.3f\n", elapsed / 60e6, error, bound,
+                            (model.rate - 1.0) * 1e6, (1.0 / (1.0 + device.ppm * 1e-6) - 1.0) * 1e6);
+            }
+        }
+
+        /* Advance the device clock to the next ping. */
+        device.time += kPingIntervalUs * (1.0 + device.ppm * 1e-6);
+        device.walk += kDeviceWalkPpm * std::sqrt(kPingIntervalUs / 1e6) * normal(rng);
+        device.ppm = kDevicePpm + device.walk +
+                     kDeviceSwingPpm * std::sin(2.0 * M_PI * (elapsed + kPingIntervalUs) / kDeviceSwingPeriodUs);
+    }
+
+    return stats;
+}
+
+bool report(const Stats &stats)
+{
+    std::printf("  after the first minute: rms %.1f us, max %.1f us, max bound %.1f us\n",
+                std::sqrt(stats.sumSquares / std::max<size_t>(stats.count, 1U)), stats.maxAbs, stats.maxEstimate);
+    std::printf("  error over the bound: %zu times\n\n", stats.outside);
+
+    return stats.outside == 0U;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const double minutes = (argc > 1) ? std::atof(argv[1]) : 30.0;
+    const unsigned seed = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 1U;
+
+    const bool isSofOk = report(run(false, minutes, seed));
+    const bool isHostFrameOk = report(run(true, minutes, seed));
+
+    return (isSofOk && isHostFrameOk) ? 0 : 1;
+}
@@ -0,0 +1,531 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+extern "C"
+{
+#include "mcp251xfd.h"
+#include "channel.h"
+#include "gateway.h"
+#include "protocol.h"
+#include "self_test.h"
+#include "stats.h"
+}
+
+#include "target.hpp"
+#include "mcp_model.hpp"
+
+/* Runs gateway.c and channel.c on the host target model with two buses  */
+/* routed into each other, and measures the latency through the gateway. */
+/*                                                                       */
+/*     gateway_sim [frames] [seed]                                       */
+/*                                                                       */
+/* Channel 0 stands for a bus whose controller interrupts on every frame */
+/* received and takes frames to send straight from its TX queue. Channel */
+/* 1 is the MCP251xFD, run by mcp251xfd.c against the register model     */
+/* (see mcp_model.hpp). Both are at the MCP's 500 kbit/s and 2 Mbit/s.   */
+/*                                                                       */
+/* 0 to 1: 0x1xx frames at about 50% load, mixed with 0x3xx ones for the */
+/* host, go to channel 1 with the identifier rewritten to 0x5xx. The     */
+/* latency runs from the end of the frame on bus 0 to its start on bus   */
+/* 1, SPI and driver included.                                           */
+/*                                                                       */
+/* 1 to 0: extended 0x18FFxxxx frames back to back, mixed with others    */
+/* for the host, go to channel 0 with the first data byte masked. The    */
+/* latency runs from the end of the frame on bus 1 to its arrival in     */
+/* channel 0's TX queue, the MCP interrupt and the SPI reads included.   */
+/*                                                                       */
+/* Copy cost: frames are forwarded by value, copied by the route that    */
+/* changes them, into each TX queue and out again by the driver. The     */
+/* down route is timed on the host for 64-byte frames, whole and with    */
+/* the same copies made alone, to show what share of the path they are.  */
+/* Host figures rank; they do not predict the M0+.                       */
+/*                                                                       */
+/* Exits with 1 when a routed frame is lost, reordered, changed other    */
+/* than by its route, or reaches the host, when a frame for the host     */
+/* does not, when a latency is over its bound, or when the copies are    */
+/* over a quarter of the forwarding path.                                */
+
+namespace
+{
+
+namespace target = canaan::target;
+namespace mcp = canaan::mcp;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Task switch after an interrupt on a 125 MHz core. */
+constexpr uint64_t kWakeLatencyNs = 5U * target::kNsPerUs;
+
+/* The host empties the receive queues this often. */
+constexpr uint64_t kHostPollNs = 100U * target::kNsPerUs;
+
+/* Share of the frames that are routed; the rest go to the host. */
+constexpr double kRoutedShare = 0.7;
+
+/* Pass criteria: 99th percentile and worst case, in microseconds. */
+constexpr double kMaxP99Us = 500.0;
+constexpr double kMaxWorstUs = 1000.0;
+
+/* Forwards timed for the copy cost, and the share copies may take. */
+constexpr size_t kCopyRounds = 200000U;
+constexpr double kMaxCopyShare = 0.25;
+
+/* The payload carries a sequence number here, clear of the data mask. */
+constexpr size_t kSeqOffset = 4U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Bus 0 as its controller's receive interrupt sees it: each frame is */
+/* handed over when its last bit is in.                               */
+class Bus : public target::Device
+{
+public:
+    uint64_t nextEvent() const override
+    {
+        return (mNext < frames.size()) ? mAt : target::kNever;
+    }
+
+    void advance(uint64_t now) override
+    {
+        CanFrame_t frame = frames[mNext++];
+        BaseType_t isWoken = pdFALSE;
+
+        frame.timestamp = time_us_32();
+        endAt.push_back(now);
+        (void)channelRxFromISR(0, &frame, &isWoken);
+
+        if (mNext < frames.size())
+        {
+            mAt = now + mGaps[mNext] + frameNs(frames[mNext]);
+        }
+    }
+
+    /* Idle gaps drawn so the bus is busy about half of the time. */
+    void start(const std::vector<CanFrame_t> &toSend, std::mt19937 &rng)
+    {
+        frames = toSend;
+        mGaps.clear();
+        for (const CanFrame_t &frame : frames)
+        {
+            std::exponential_distribution<double> gap(1.0 / frameNs(frame));
+
+            mGaps.push_back(static_cast<uint64_t>(gap(rng)));
+        }
+        endAt.clear();
+        mNext = 0;
+        mAt = target::now() + frameNs(frames[0]);
+    }
+
+    static uint64_t frameNs(const CanFrame_t &frame)
+    {
+        uint32_t nominal;
+        uint32_t data;
+
+        rateFrameBits(&frame, &nominal, &data);
+
+        return nominal * target::kNsPerS / mcp::kBitrate + data * target::kNsPerS / mcp::kDataBitrate;
+    }
+
+    std::vector<CanFrame_t> frames;
+    std::vector<uint64_t> endAt;
+
+private:
+    std::vector<uint64_t> mGaps;
+    size_t mNext = 0;
+    uint64_t mAt = 0;
+};
+
+/* The host side: what reaches the receive queues. */
+class Host : public target::Device
+{
+public:
+    uint64_t nextEvent() const override
+    {
+        return mNext;
+    }
+
+    void advance(uint64_t now) override
+    {
+        CanFrame_t frame;
+
+        for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+        {
+            while (channelReceive(ch, &frame))
+            {
+                received[ch].push_back(frame);
+            }
+        }
+        mNext = now + kHostPollNs;
+    }
+
+    std::vector<CanFrame_t> received[CAN_CHANNEL_NUM];
+
+private:
+    uint64_t mNext = 0;
+};
+
+/* Frames channel 0 takes to send, and when. */
+struct Sink
+{
+    std::vector<CanFrame_t> frames;
+    std::vector<uint64_t> at;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+mcp::Model gMcp;
+Bus gBus;
+Host gHost;
+Sink gSink;
+
+StaticTask_t gMcpTaskDef;
+StackType_t gMcpStack[configMINIMAL_STACK_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* Channel 0's driver: the controller takes frames as they are queued. */
+void sinkKick(void *ctx, BaseType_t *isWoken)
+{
+    CanFrame_t frame;
+
+    (void)ctx;
+    while ((isWoken != NULL) ? channelTxPopFromISR(0, &frame, isWoken) : channelTxPop(0, &frame))
+    {
+        gSink.frames.push_back(frame);
+        gSink.at.push_back(target::now());
+    }
+}
+
+/* Channel 0's driver for the copy cost: takes each frame and drops it. */
+void dropKick(void *ctx, BaseType_t *isWoken)
+{
+    CanFrame_t frame;
+
+    (void)ctx;
+    while ((isWoken != NULL) ? channelTxPopFromISR(0, &frame, isWoken) : channelTxPop(0, &frame))
+    {
+    }
+}
+
+/* Host time per forward of frame through gatewayRoute() to channel 0, */
+/* and per round of the copies it makes: the route's own copy, into    */
+/* the TX queue and out to the driver.                                 */
+void timeCopies(const CanFrame_t &frame, double *routeNs, double *copyNs)
+{
+    using Clock = std::chrono::steady_clock;
+    CanFrame_t copy;
+    CanFrame_t slot;
+    CanFrame_t out;
+    BaseType_t isWoken = pdFALSE;
+
+    channelRegisterDriver(0, dropKick, NULL);
+
+    const auto routeStart = Clock::now();
+    for (size_t i = 0; i < kCopyRounds; i++)
+    {
+        (void)gatewayRoute(&frame, &isWoken);
+    }
+    const auto copyStart = Clock::now();
+    for (size_t i = 0; i < kCopyRounds; i++)
+    {
+        std::memcpy(&copy, &frame, offsetof(CanFrame_t, data) + frame.len);
+        std::memcpy(&slot, &copy, sizeof(slot));
+        std::memcpy(&out, &slot, sizeof(out));
+        __asm__ volatile("" : : "r"(&out) : "memory");
+    }
+    const auto copyEnd = Clock::now();
+
+    *routeNs = std::chrono::duration<double, std::nano>(copyStart - routeStart).count() / kCopyRounds;
+    *copyNs = std::chrono::duration<double, std::nano>(copyEnd - copyStart).count() / kCopyRounds;
+
+    channelRegisterDriver(0, sinkKick, NULL);
+}
+
+/* Routed and host frames, classic and FD, each with its sequence number. */
+std::vector<CanFrame_t> makeFrames(size_t count, bool isExt, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> share(0.0, 1.0);
+    std::vector<CanFrame_t> frames(count);
+    uint32_t seq = 0;
+
+    for (CanFrame_t &frame : frames)
+    {
+        const bool isRouted = share(rng) < kRoutedShare;
+
+        frame = CanFrame_t{};
+        if (isExt)
+        {
+            frame.id = (isRouted ? 0x18FF0000UL : 0x18FE0000UL) | (rng() & 0xFFFFU);
+            frame.flags = CAN_FLAG_EXT;
+        }
+        else
+        {
+            frame.id = (isRouted ? 0x100U : 0x300U) | (rng() & 0xFFU);
+        }
+        frame.flags |= (rng() & 1U) ? (CAN_FLAG_FD | CAN_FLAG_BRS) : 0U;
+        frame.len = (frame.flags & CAN_FLAG_FD) ? CAN_FRAME_MAX_LEN : 8U;
+        for (uint8_t i = 0; i < frame.len; i++)
+        {
+            frame.data[i] = static_cast<uint8_t>(rng());
+        }
+        protoPutU32(&frame.data[kSeqOffset], seq++);
+    }
+
+    return frames;
+}
+
+bool isSame(const CanFrame_t &a, const CanFrame_t &b)
+{
+    return (a.id == b.id) && (a.flags == b.flags) && (a.len == b.len) && (std::memcmp(a.data, b.data, a.len) == 0);
+}
+
+/* Checks what came out against what the route makes of what went in, */
+/* and gathers the latencies in microseconds.                         */
+bool check(const std::vector<CanFrame_t> &in, const std::vector<uint64_t> &inAt, uint32_t routed,
+           const GatewayRoute_t &route, const std::vector<CanFrame_t> &out, const std::vector<uint64_t> &outAt,
+           const std::vector<CanFrame_t> &host, std::vector<double> *latency)
+{
+    size_t next = 0;
+    size_t toHost = 0;
+    bool isOk = inAt.size() == in.size();
+
+    for (size_t i = 0; isOk && (i < in.size()); i++)
+    {
+        CanFrame_t expected = in[i];
+
+        if ((in[i].id & route.mask) != route.id)
+        {
+            isOk &= (toHost < host.size()) && isSame(host[toHost++], in[i]);
+            continue;
+        }
+
+        if (route.flags & GATEWAY_FLAG_REWRITE)
+        {
+            expected.id = (expected.id & ~route.rewriteMask) | (route.newId & route.rewriteMask);
+        }
+        if (route.flags & GATEWAY_FLAG_MASK_DATA)
+        {
+            for (uint8_t b = 0; b < GATEWAY_MASK_LEN; b++)
+            {
+                expected.data[b] = static_cast<uint8_t>((expected.data[b] & route.dataAnd[b]) | route.dataOr[b]);
+            }
+        }
+
+        isOk &= (next < out.size()) && isSame(out[next], expected);
+        if (isOk)
+        {
+            latency->push_back((outAt[next] - inAt[i]) / 1e3);
+        }
+        next++;
+    }
+
+    return isOk && (next == routed) && (next == out.size()) && (toHost == host.size());
+}
+
+double percentile(std::vector<double> values, double share)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+
+    return values[std::min(values.size() - 1U, static_cast<size_t>(share * values.size()))];
+}
+
+bool report(const char *label, const std::vector<double> &latency, bool isIntact)
+{
+    double sum = 0.0;
+
+    for (double value : latency)
+    {
+        sum += value;
+    }
+
+    const double mean = sum / std::max<size_t>(latency.size(), 1U);
+    const double p50 = percentile(latency, 0.50);
+    const double p99 = percentile(latency, 0.99);
+    const double worst = percentile(latency, 1.0);
+    const bool isPass = isIntact && !latency.empty() && (p99 <= kMaxP99Us) && (worst <= kMaxWorstUs);
+
+    std::printf("  %-24s %7zu %8.1f %8.1f %8.1f %8.1f  %s\n", label, latency.size(), mean, p50, p99, worst,
+                isPass ? "ok" : (isIntact ? "SLOW" : "WRONG"));
+
+    return isPass;
+}
+
+uint32_t countRouted(const std::vector<CanFrame_t> &frames, const GatewayRoute_t &route)
+{
+    return static_cast<uint32_t>(std::count_if(frames.begin(), frames.end(), [&route](const CanFrame_t &frame) {
+        return (frame.id & route.mask) == route.id;
+    }));
+}
+
+/* The gateway's own account: receive to TX queue, and frames lost on a */
+/* full TX queue, which fail the run.                                   */
+bool printQueueTime(const StatsSnapshot_t &before, const StatsSnapshot_t &after)
+{
+    const uint64_t forwarded = after.counter[STAT_GATEWAY_FORWARDED] - before.counter[STAT_GATEWAY_FORWARDED];
+    const uint64_t dropped = after.counter[STAT_GATEWAY_DROPPED] - before.counter[STAT_GATEWAY_DROPPED];
+    const uint64_t us = after.counter[STAT_GATEWAY_US] - before.counter[STAT_GATEWAY_US];
+
+    std::printf("    %llu forwarded, %llu dropped, %.1f us mean receive to TX queue\n",
+                static_cast<unsigned long long>(forwarded), static_cast<unsigned long long>(dropped),
+                static_cast<double>(us) / std::max<uint64_t>(forwarded, 1U));
+
+    return dropped == 0U;
+}
+
+/* Unused here: no self test runs. */
+extern "C" bool selfTestRx(const CanFrame_t *frame)
+{
+    (void)frame;
+    return false;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const size_t count = (argc > 1) ? static_cast<size_t>(std::max(1, std::atoi(argv[1]))) : 5000U;
+    const unsigned seed = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 1U;
+    const uint64_t timeout = 60U * target::kNsPerS;
+    std::mt19937 rng(seed);
+    StatsSnapshot_t before;
+    StatsSnapshot_t after;
+    bool isOk = true;
+
+    target::setWakeLatency(kWakeLatencyNs);
+    target::attachSpi(0, &gMcp, MCP_CS_PIN);
+    target::attach(&gMcp);
+    target::attach(&gBus);
+    target::attach(&gHost);
+    statsInit();
+    gatewayInit();
+    channelInit();
+    channelRegisterDriver(0, sinkKick, NULL);
+    if (!mcpInit())
+    {
+        std::printf("mcpInit failed\n");
+        return 1;
+    }
+    (void)xTaskCreateStatic(mcpTask, "mcp", configMINIMAL_STACK_SIZE, NULL, 3, gMcpStack, &gMcpTaskDef);
+
+    /* 0x1xx on bus 0 to 0x5xx on bus 1; 0x18FFxxxx on bus 1 to bus 0 */
+    /* with the top nibble of the first byte forced to 0xA.           */
+    GatewayRoute_t up{};
+    GatewayRoute_t down{};
+
+    up.id = 0x100U;
+    up.mask = 0x700U;
+    up.newId = 0x500U;
+    up.rewriteMask = 0x700U;
+    up.srcChannel = 0;
+    up.dstMask = 1U << MCP_CHANNEL;
+    up.flags = GATEWAY_FLAG_REWRITE | GATEWAY_FLAG_EXCLUSIVE;
+
+    down.id = 0x18FF0000UL;
+    down.mask = 0x1FFF0000UL;
+    down.srcChannel = MCP_CHANNEL;
+    down.dstMask = 1U << 0;
+    down.flags = GATEWAY_FLAG_EXT | GATEWAY_FLAG_MASK_DATA | GATEWAY_FLAG_EXCLUSIVE;
+    std::fill(std::begin(down.dataAnd), std::end(down.dataAnd), 0xFFU);
+    down.dataAnd[0] = 0x0FU;
+    down.dataOr[0] = 0xA0U;
+
+    gatewayTableClear();
+    isOk &= gatewayTableAdd(&up) && gatewayTableAdd(&down) && gatewayTableCommit();
+    (void)target::run(target::now() + target::kNsPerMs);
+
+    std::printf("%zu frames each way at %u/%u bit/s, %.0f%% routed, %zu bytes queued per forwarded frame\n", count,
+                mcp::kBitrate, mcp::kDataBitrate, 100.0 * kRoutedShare, sizeof(CanFrame_t));
+    std::printf("  %-24s %7s %8s %8s %8s %8s\n", "latency, us", "frames", "mean", "p50", "p99", "worst");
+
+    /* Bus 0 to the MCP251xFD, at about half load. */
+    {
+        std::vector<double> latency;
+
+        statsSnapshot(&before);
+        gBus.start(makeFrames(count, false, rng), rng);
+        const uint32_t routed = countRouted(gBus.frames, up);
+        const bool isDone = target::run(target::now() + timeout, [routed] {
+            return (gBus.endAt.size() == gBus.frames.size()) && (gMcp.sent.size() >= routed);
+        });
+
+        (void)target::run(target::now() + 2U * kHostPollNs);
+        statsSnapshot(&after);
+
+        const bool isIntact = isDone && check(gBus.frames, gBus.endAt, routed, up, gMcp.sent, gMcp.sentAt,
+                                              gHost.received[0], &latency);
+
+        isOk &= report("bus 0 to bus 1 start", latency, isIntact);
+        isOk &= printQueueTime(before, after);
+    }
+
+    /* The MCP251xFD to bus 0, back to back. */
+    {
+        std::vector<double> latency;
+        const std::vector<CanFrame_t> frames = makeFrames(count, true, rng);
+        const uint32_t routed = countRouted(frames, down);
+
+        statsSnapshot(&before);
+        gMcp.feed(frames, false);
+        const bool isDone = target::run(target::now() + timeout, [routed, &frames] {
+            return (gMcp.receivedAt.size() + gMcp.lost >= frames.size()) && (gSink.frames.size() >= routed);
+        });
+
+        (void)target::run(target::now() + 2U * kHostPollNs);
+        statsSnapshot(&after);
+
+        const bool isIntact = isDone && (gMcp.lost == 0U) && check(frames, gMcp.receivedAt, routed, down, gSink.frames,
+                                                                   gSink.at, gHost.received[MCP_CHANNEL], &latency);
+
+        isOk &= report("bus 1 to bus 0 TX queue", latency, isIntact);
+        isOk &= printQueueTime(before, after);
+    }
+
+    /* What copying by value costs a routed 64-byte frame. */
+    {
+        CanFrame_t frame{};
+        double routeNs;
+        double copyNs;
+
+        frame.id = 0x18FF0001UL;
+        frame.flags = CAN_FLAG_EXT | CAN_FLAG_FD | CAN_FLAG_BRS;
+        frame.len = CAN_FRAME_MAX_LEN;
+        frame.channel = MCP_CHANNEL;
+        statsSnapshot(&before);
+        timeCopies(frame, &routeNs, &copyNs);
+        statsSnapshot(&after);
+
+        const bool isForwarded =
+            after.counter[STAT_GATEWAY_FORWARDED] - before.counter[STAT_GATEWAY_FORWARDED] == kCopyRounds;
+        const double share = copyNs / std::max(routeNs, 1e-9);
+
+        std::printf("  copies %.1f ns of %.1f ns per routed frame on the host (%.0f%%), %.1f us on the bus  %s\n",
+                    copyNs, routeNs, 100.0 * share, Bus::frameNs(frame) / 1e3,
+                    !isForwarded ? "WRONG" : ((share <= kMaxCopyShare) ? "ok" : "SLOW"));
+        isOk &= isForwarded && (share <= kMaxCopyShare);
+    }
+
+    return isOk ? 0 : 1;
+}
@@ -0,0 +1,589 @@
+#ifndef MCP_MODEL_HPP
+#define MCP_MODEL_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+extern "C"
+{
+#include "mcp251xfd.h"
+#include "rate_limit.h"
+}
+
+#include "target.hpp"
+
+/* Register model of the MCP251xFD that mcp251xfd.c drives, for the sims */
+/* that run the driver on the host target model.                         */
+/*                                                                       */
+/* It decodes the SPI instructions into its registers and message RAM,   */
+/* keeps the FIFO indices, acts on UINC and TXREQ, sends the TX FIFO at  */
+/* the bit timing the driver set and drives the interrupt pin. Frames    */
+/* for it to receive are fed in as if from the bus.                      */
+
+namespace canaan::mcp
+{
+
+namespace target = canaan::target;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* SPI instructions. */
+inline constexpr uint8_t kCmdReset = 0x0U;
+inline constexpr uint8_t kCmdWrite = 0x2U;
+inline constexpr uint8_t kCmdRead = 0x3U;
+
+/* Registers, and where the message RAM starts and ends. */
+inline constexpr uint16_t kRegC1Con = 0x000U;
+inline constexpr uint16_t kRegC1Nbtcfg = 0x004U;
+inline constexpr uint16_t kRegC1Dbtcfg = 0x008U;
+inline constexpr uint16_t kRegC1Tdc = 0x00CU;
+inline constexpr uint16_t kRegC1Tbc = 0x010U;
+inline constexpr uint16_t kRegC1Tscon = 0x014U;
+inline constexpr uint16_t kRegC1Int = 0x01CU;
+inline constexpr uint16_t kRegFifoCon0 = 0x050U;
+inline constexpr uint16_t kRegFltCon0 = 0x1D0U;
+inline constexpr uint16_t kRegOsc = 0xE00U;
+inline constexpr uint16_t kRamBase = 0x400U;
+inline constexpr uint16_t kRamEnd = 0xC00U;
+inline constexpr size_t kSpaceSize = 0x1000U;
+
+/* C1CON after a reset: configuration mode, TX queue and TEF enabled. */
+inline constexpr uint32_t kC1ConReset = 0x04980760UL;
+inline constexpr uint8_t kModeNormalFd = 0U;
+inline constexpr uint8_t kModeIntLoopback = 2U;
+inline constexpr uint8_t kModeConfig = 4U;
+
+/* FIFO 1 transmits, FIFO 2 receives, as the driver sets them up. */
+inline constexpr unsigned kFifoNum = 3U;
+inline constexpr unsigned kTxFifo = 1U;
+inline constexpr unsigned kRxFifo = 2U;
+
+/* Bit timing from the 40 MHz oscillator and the driver's settings. */
+inline constexpr uint32_t kOscHz = 40000000U;
+inline constexpr uint32_t kBitrate = kOscHz / (MCP_NBT_BRP * (1U + MCP_NBT_TSEG1 + MCP_NBT_TSEG2));
+inline constexpr uint32_t kDataBitrate = kOscHz / (MCP_DBT_BRP * (1U + MCP_DBT_TSEG1 + MCP_DBT_TSEG2));
+
+inline constexpr uint8_t kDlcToLen[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Fifo
+{
+    uint32_t head; /* Next object the user (TX) or the bus (RX) fills. */
+    uint32_t tail; /* Next object the bus (TX) or the user (RX) takes. */
+    uint32_t count;
+    bool isRequested;
+    bool isOverflow;
+};
+
+/* Registers, message RAM and FIFOs of the controller, and the bus it */
+/* sends to and receives from. Put it on SPI with target::attachSpi()  */
+/* and on the clock with target::attach().                             */
+class Model : public target::SpiDevice, public target::Device
+{
+public:
+    Model()
+    {
+        reset();
+        target::setPin(MCP_INT_PIN, true);
+    }
+
+    /* SPI side. */
+    void select(bool isSelected) override
+    {
+        if (isSelected)
+        {
+            mPos = 0;
+            transfers++;
+        }
+        else if ((mPos >= 2U) && (mCmd == kCmdReset))
+        {
+            reset();
+        }
+        updateInt();
+    }
+
+    uint8_t exchange(uint8_t mosi) override
+    {
+        uint8_t miso = 0;
+
+        if (mPos == 0U)
+        {
+            mCmd = mosi >> 4;
+            mAddr = static_cast<uint16_t>((mosi & 0x0FU) << 8);
+        }
+        else if (mPos == 1U)
+        {
+            mAddr |= mosi;
+        }
+        else if (mCmd == kCmdRead)
+        {
+            miso = readByte(mAddr++);
+        }
+        else if (mCmd == kCmdWrite)
+        {
+            writeByte(mAddr++, mosi);
+        }
+        mPos++;
+
+        return miso;
+    }
+
+    /* Bus side. */
+    uint64_t nextEvent() const override
+    {
+        uint64_t next = target::kNever;
+
+        if (mIsSending)
+        {
+            next = mSendEnd;
+        }
+        else if (canSend())
+        {
+            next = target::now();
+        }
+
+        if (!mFeed.empty() && isRunning() && (!mIsFeedFill || (mFifo[kRxFifo].count < depth(kRxFifo))))
+        {
+            next = std::min(next, mFeedAt);
+        }
+
+        return next;
+    }
+
+    void advance(uint64_t now) override
+    {
+        if (mIsSending && (now >= mSendEnd))
+        {
+            Fifo *fifo = &mFifo[kTxFifo];
+            const CanFrame_t frame = readObject(kTxFifo, fifo->tail);
+
+            fifo->tail = (fifo->tail + 1U) % depth(kTxFifo);
+            fifo->count--;
+            fifo->isRequested &= fifo->count > 0;
+            mIsSending = false;
+            busNs += mSendEnd - mSendStart;
+            lastSent = now;
+
+            if (opMode() == kModeIntLoopback)
+            {
+                receive(frame);
+            }
+            else
+            {
+                sent.push_back(frame);
+                sentAt.push_back(mSendStart);
+            }
+        }
+
+        if (!mIsSending && canSend())
+        {
+            mIsSending = true;
+            mSendStart = now;
+            mSendEnd = now + frameNs(readObject(kTxFifo, mFifo[kTxFifo].tail));
+        }
+
+        if (!mFeed.empty() && (now >= mFeedAt) && isRunning() &&
+            (!mIsFeedFill || (mFifo[kRxFifo].count < depth(kRxFifo))))
+        {
+            const CanFrame_t frame = mFeed.front();
+
+            mFeed.pop_front();
+            receive(frame);
+            mFeedAt = now + frameNs(frame);
+        }
+
+        updateInt();
+    }
+
+    /* Frames for the bus to deliver back to back, or whenever the  */
+    /* receive FIFO has room if isFill.                             */
+    void feed(const std::vector<CanFrame_t> &frames, bool isFill)
+    {
+        mFeed.assign(frames.begin(), frames.end());
+        mFeedAt = target::now();
+        mIsFeedFill = isFill;
+    }
+
+    /* A bus that takes no time, leaving the SPI as the limit. */
+    void setInstant(bool isInstant)
+    {
+        mIsInstant = isInstant;
+    }
+
+    uint32_t reg(uint16_t addr) const
+    {
+        return mSpace[addr] | (mSpace[addr + 1U] << 8) | (mSpace[addr + 2U] << 16) |
+               (static_cast<uint32_t>(mSpace[addr + 3U]) << 24);
+    }
+
+    uint8_t opMode() const
+    {
+        return (mSpace[kRegC1Con + 2U] >> 5) & 0x07U;
+    }
+
+    uint32_t depth(unsigned m) const
+    {
+        return (mSpace[fifoCon(m) + 3U] & 0x1FU) + 1U;
+    }
+
+    uint32_t payload(unsigned m) const
+    {
+        static const uint8_t kPlSize[8] = {8, 12, 16, 20, 24, 32, 48, 64};
+
+        return kPlSize[mSpace[fifoCon(m) + 3U] >> 5];
+    }
+
+    std::vector<CanFrame_t> sent;
+    std::vector<uint64_t> sentAt;     /* Start on the bus of each sent frame. */
+    std::vector<uint64_t> receivedAt; /* End on the bus of each received one. */
+    uint64_t transfers = 0;
+    uint64_t busNs = 0;
+    uint64_t lastSent = 0;
+    uint64_t lost = 0;
+    unsigned configWrites = 0; /* Configuration written outside configuration mode. */
+
+private:
+    static uint16_t fifoCon(unsigned m)
+    {
+        return static_cast<uint16_t>(kRegFifoCon0 + 12U * m);
+    }
+
+    void reset()
+    {
+        mSpace.fill(0);
+        for (unsigned i = 0; i < 4U; i++)
+        {
+            mSpace[kRegC1Con + i] = static_cast<uint8_t>(kC1ConReset >> (8U * i));
+        }
+        resetFifos();
+        mIsSending = false;
+    }
+
+    void resetFifos()
+    {
+        for (Fifo &fifo : mFifo)
+        {
+            fifo = Fifo{};
+        }
+    }
+
+    bool isRunning() const
+    {
+        return (opMode() == kModeNormalFd) || (opMode() == kModeIntLoopback);
+    }
+
+    bool canSend() const
+    {
+        return !mIsSending && isRunning() && mFifo[kTxFifo].isRequested && (mFifo[kTxFifo].count > 0);
+    }
+
+    /* A receive FIFO with RXTSEN set keeps a time stamp after the header. */
+    uint32_t header(unsigned m) const
+    {
+        const uint8_t con = mSpace[fifoCon(m)];
+
+        return (!(con & 0x80U) && (con & 0x20U)) ? 12U : 8U;
+    }
+
+    /* FIFO 0, the TX queue, and the TEF are off; the FIFOs follow each */
+    /* other from the start of the RAM.                                 */
+    uint16_t objectAddr(unsigned m, uint32_t index) const
+    {
+        uint32_t addr = 0;
+
+        for (unsigned i = 1U; i < m; i++)
+        {
+            addr += depth(i) * (header(i) + payload(i));
+        }
+
+        return static_cast<uint16_t>(addr + index * (header(m) + payload(m)));
+    }
+
+    /* The time base counter, in SYSCLK ticks over TBCPRE + 1 since TBCEN */
+    /* was set.                                                           */
+    uint32_t tbc() const
+    {
+        const uint32_t tscon = reg(kRegC1Tscon);
+
+        if (!(tscon & (1UL << 16)))
+        {
+            return 0;
+        }
+
+        return static_cast<uint32_t>((target::now() - mTbcStart) * (kOscHz / 1000000U) /
+                                     (1000U * ((tscon & 0x3FFU) + 1U)));
+    }
+
+    uint32_t fifoSta(unsigned m) const
+    {
+        const Fifo &fifo = mFifo[m];
+        uint32_t value;
+
+        if (m == kTxFifo)
+        {
+            value = ((fifo.count < depth(m)) ? 0x01U : 0U) | ((fifo.count == 0) ? 0x04U : 0U);
+            value |= fifo.tail << 8;
+        }
+        else
+        {
+            value = ((fifo.count > 0) ? 0x01U : 0U) | ((fifo.count == depth(m)) ? 0x04U : 0U);
+            value |= (fifo.isOverflow ? 0x08U : 0U) | (fifo.head << 8);
+        }
+
+        return value;
+    }
+
+    uint8_t readByte(uint16_t addr) const
+    {
+        const uint16_t word = addr & ~3U;
+        const unsigned shift = 8U * (addr & 3U);
+
+        addr &= static_cast<uint16_t>(kSpaceSize - 1U);
+        if (word == kRegOsc)
+        {
+            return static_cast<uint8_t>((1UL << 10) >> shift);
+        }
+        if (word == kRegC1Tbc)
+        {
+            return static_cast<uint8_t>(tbc() >> shift);
+        }
+        for (unsigned m = 1U; m < kFifoNum; m++)
+        {
+            if (word == fifoCon(m) + 4U)
+            {
+                return static_cast<uint8_t>(fifoSta(m) >> shift);
+            }
+            if (word == fifoCon(m) + 8U)
+            {
+                const uint32_t index = (m == kTxFifo) ? mFifo[m].head : mFifo[m].tail;
+
+                return static_cast<uint8_t>(objectAddr(m, index) >> shift);
+            }
+        }
+
+        return mSpace[addr];
+    }
+
+    void writeByte(uint16_t addr, uint8_t value)
+    {
+        addr &= static_cast<uint16_t>(kSpaceSize - 1U);
+
+        if ((addr >= kRamBase) && (addr < kRamEnd))
+        {
+            mSpace[addr] = value;
+            return;
+        }
+
+        /* Bit timing, TDC and the FIFO layout only change in config mode. */
+        const bool isConfigOnly = ((addr >= kRegC1Nbtcfg) && (addr < kRegC1Tdc + 4U)) ||
+                                  ((addr >= kRegFifoCon0) && (addr < fifoCon(kFifoNum)) &&
+                                   ((addr - kRegFifoCon0) % 12U >= 2U) && ((addr - kRegFifoCon0) % 12U < 4U));
+
+        if (isConfigOnly && (opMode() != kModeConfig))
+        {
+            configWrites++;
+            return;
+        }
+
+        if (addr == kRegC1Con + 2U)
+        {
+            /* OPMOD is read-only. */
+            mSpace[addr] = static_cast<uint8_t>((value & 0x1FU) | (mSpace[addr] & 0xE0U));
+            return;
+        }
+
+        if (addr == kRegC1Con + 3U)
+        {
+            const uint8_t mode = value & 0x07U;
+
+            /* Configuration mode, going in or out, starts the FIFOs over. */
+            if ((mode == kModeConfig) || (opMode() == kModeConfig))
+            {
+                resetFifos();
+                mIsSending = false;
+            }
+            mSpace[addr] = value;
+            mSpace[kRegC1Con + 2U] = static_cast<uint8_t>((mSpace[kRegC1Con + 2U] & 0x1FU) | (mode << 5));
+            return;
+        }
+
+        if ((addr == kRegC1Tscon + 2U) && (value & 0x01U) && !(mSpace[addr] & 0x01U))
+        {
+            /* TBCEN starts the time base counter from 0. */
+            mTbcStart = target::now();
+        }
+
+        for (unsigned m = 1U; m < kFifoNum; m++)
+        {
+            if (addr == fifoCon(m) + 1U)
+            {
+                /* UINC and TXREQ act and read back as 0. */
+                if (value & 0x01U)
+                {
+                    increment(m);
+                }
+                if ((value & 0x02U) && (m == kTxFifo))
+                {
+                    mFifo[m].isRequested = mFifo[m].count > 0;
+                }
+                mSpace[addr] = static_cast<uint8_t>(value & ~0x03U);
+                return;
+            }
+            if (addr == fifoCon(m) + 4U)
+            {
+                /* Only RXOVIF is writable, and only to clear it. */
+                mFifo[m].isOverflow &= (value & 0x08U) != 0;
+                return;
+            }
+        }
+
+        mSpace[addr] = value;
+    }
+
+    void increment(unsigned m)
+    {
+        Fifo *fifo = &mFifo[m];
+
+        if ((m == kTxFifo) && (fifo->count < depth(m)))
+        {
+            fifo->head = (fifo->head + 1U) % depth(m);
+            fifo->count++;
+        }
+        else if ((m == kRxFifo) && (fifo->count > 0))
+        {
+            fifo->tail = (fifo->tail + 1U) % depth(m);
+            fifo->count--;
+        }
+    }
+
+    void receive(const CanFrame_t &frame)
+    {
+        Fifo *fifo = &mFifo[kRxFifo];
+
+        if (fifo->count == depth(kRxFifo))
+        {
+            fifo->isOverflow = true;
+            lost++;
+            return;
+        }
+
+        writeObject(kRxFifo, fifo->head, frame);
+        fifo->head = (fifo->head + 1U) % depth(kRxFifo);
+        fifo->count++;
+        receivedAt.push_back(target::now());
+    }
+
+    CanFrame_t readObject(unsigned m, uint32_t index) const
+    {
+        const uint8_t *obj = &mSpace[kRamBase + objectAddr(m, index)];
+        const uint32_t idWord = obj[0] | (obj[1] << 8) | (obj[2] << 16) | (static_cast<uint32_t>(obj[3]) << 24);
+        CanFrame_t frame{};
+
+        if (obj[4] & 0x10U)
+        {
+            frame.id = ((idWord & CAN_STD_ID_MASK) << 18) | ((idWord >> 11) & 0x3FFFFUL);
+            frame.flags = CAN_FLAG_EXT;
+        }
+        frame.id = (obj[4] & 0x10U) ? frame.id : (idWord & CAN_STD_ID_MASK);
+        frame.flags |= ((obj[4] & 0x20U) ? CAN_FLAG_RTR : 0U) | ((obj[4] & 0x40U) ? CAN_FLAG_BRS : 0U) |
+                       ((obj[4] & 0x80U) ? CAN_FLAG_FD : 0U);
+        frame.channel = MCP_CHANNEL;
+        frame.len = std::min<uint8_t>(kDlcToLen[obj[4] & 0x0FU], static_cast<uint8_t>(payload(m)));
+        std::memcpy(frame.data, &obj[8], frame.len);
+
+        return frame;
+    }
+
+    void writeObject(unsigned m, uint32_t index, const CanFrame_t &frame)
+    {
+        uint8_t *obj = &mSpace[kRamBase + objectAddr(m, index)];
+        const bool isExt = (frame.flags & CAN_FLAG_EXT) != 0;
+        const uint32_t idWord =
+            isExt ? (((frame.id >> 18) & CAN_STD_ID_MASK) | ((frame.id & 0x3FFFFUL) << 11)) : frame.id;
+        uint8_t dlc = 0;
+
+        while (kDlcToLen[dlc] < frame.len)
+        {
+            dlc++;
+        }
+
+        std::memset(obj, 0, header(m) + payload(m));
+        for (unsigned i = 0; i < 4U; i++)
+        {
+            obj[i] = static_cast<uint8_t>(idWord >> (8U * i));
+            if (header(m) > 8U)
+            {
+                obj[8U + i] = static_cast<uint8_t>(tbc() >> (8U * i));
+            }
+        }
+        obj[4] = static_cast<uint8_t>(dlc | (isExt ? 0x10U : 0U) | ((frame.flags & CAN_FLAG_RTR) ? 0x20U : 0U) |
+                                      ((frame.flags & CAN_FLAG_BRS) ? 0x40U : 0U) |
+                                      ((frame.flags & CAN_FLAG_FD) ? 0x80U : 0U));
+        std::memcpy(&obj[header(m)], frame.data, frame.len);
+    }
+
+    uint64_t frameNs(const CanFrame_t &frame) const
+    {
+        uint32_t nominal;
+        uint32_t data;
+
+        if (mIsInstant)
+        {
+            return 0;
+        }
+
+        rateFrameBits(&frame, &nominal, &data);
+
+        return nominal * target::kNsPerS / kBitrate + data * target::kNsPerS / kDataBitrate;
+    }
+
+    /* INT is low while an enabled FIFO condition holds. */
+    void updateInt()
+    {
+        const uint32_t enables = reg(kRegC1Int);
+        const Fifo &tx = mFifo[kTxFifo];
+        const Fifo &rx = mFifo[kRxFifo];
+        const bool isTx = (enables & (1UL << 16)) && (mSpace[fifoCon(kTxFifo)] & 0x01U) && (tx.count < depth(kTxFifo));
+        const bool isRx = (enables & (1UL << 17)) && (mSpace[fifoCon(kRxFifo)] & 0x01U) && (rx.count > 0);
+        const bool isOverflow = (enables & (1UL << 27)) && (mSpace[fifoCon(kRxFifo)] & 0x08U) && rx.isOverflow;
+        const bool level = !(isRunning() && (isTx || isRx || isOverflow));
+
+        if (level != mIntLevel)
+        {
+            mIntLevel = level;
+            target::setPin(MCP_INT_PIN, level);
+        }
+    }
+
+    std::array<uint8_t, kSpaceSize> mSpace{};
+    Fifo mFifo[kFifoNum]{};
+    uint32_t mPos = 0;
+    uint8_t mCmd = 0;
+    uint16_t mAddr = 0;
+    bool mIntLevel = true;
+
+    bool mIsInstant = false;
+    bool mIsSending = false;
+    uint64_t mSendStart = 0;
+    uint64_t mSendEnd = 0;
+    uint64_t mTbcStart = 0;
+
+    std::deque<CanFrame_t> mFeed;
+    uint64_t mFeedAt = 0;
+    bool mIsFeedFill = false;
+};
+
+} /* namespace canaan::mcp */
+
+#endif /* MCP_MODEL_HPP */
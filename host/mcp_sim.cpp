@@ -0,0 +1,388 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+extern "C"
+{
+#include "mcp251xfd.h"
+#include "channel.h"
+#include "gateway.h"
+#include "self_test.h"
+#include "stats.h"
+}
+
+#include "target.hpp"
+#include "mcp_model.hpp"
+
+/* Runs mcp251xfd.c on the host target model against the register model */
+/* of the MCP251xFD on SPI 0 (see mcp_model.hpp), and checks what        */
+/* crosses the bus both ways.                                            */
+/*                                                                       */
+/*     mcp_sim [frames] [seed]                                           */
+/*                                                                       */
+/* After mcpInit() the register contents are checked, then a mix of      */
+/* classic and FD frames goes out through channelTransmit(), comes in    */
+/* from the bus to channelReceive(), and goes round in internal          */
+/* loopback. Each direction runs at the bus rate and then against a bus  */
+/* that takes no time, which leaves the SPI and the driver as the limit. */
+/* Received frames have their time stamps checked against when the model */
+/* took them off the bus, and a classic frame over 8 bytes is sent to    */
+/* check it is refused.                                                  */
+/*                                                                       */
+/* Prints frames/s in simulated time and the SPI bytes and transfers per */
+/* frame. Exits with 1 on a register set wrong, a configuration write    */
+/* outside configuration mode, a frame lost, corrupted or reordered, a   */
+/* receive overflow at the bus rate, a bus busy under 95% of the time    */
+/* while frames were waiting to go out, a time stamp more than 5 us out  */
+/* or an oversized classic frame put on the bus.                         */
+
+namespace
+{
+
+namespace target = canaan::target;
+namespace mcp = canaan::mcp;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Task switch after an interrupt on a 125 MHz core. */
+constexpr uint64_t kWakeLatencyNs = 5U * target::kNsPerUs;
+
+/* The host side keeps the transmit queue topped up, and empties the */
+/* receive one, this often.                                           */
+constexpr uint64_t kHostPollNs = 10U * target::kNsPerUs;
+
+/* Pass criteria. */
+constexpr double kMinBusShare = 0.95;
+constexpr uint32_t kMaxStampErrUs = 5U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* The USB side: queues frames for the controller as room frees up and */
+/* takes the received ones, checking them against what it expects.     */
+class Host : public target::Device
+{
+public:
+    uint64_t nextEvent() const override
+    {
+        return ((mSent < mOut.size()) || (received < mExpected.size())) ? mNext : target::kNever;
+    }
+
+    void advance(uint64_t now) override
+    {
+        CanFrame_t frame;
+
+        while ((mSent < mOut.size()) && (channelTxFree(MCP_CHANNEL) > 0))
+        {
+            (void)channelTransmit(&mOut[mSent++]);
+        }
+
+        while (channelReceive(MCP_CHANNEL, &frame))
+        {
+            isIntact &= (received < mExpected.size()) && isSame(frame, mExpected[received]);
+            stamps.push_back(frame.timestamp);
+            received++;
+            lastReceived = now;
+        }
+
+        mNext = now + kHostPollNs;
+    }
+
+    void send(const std::vector<CanFrame_t> &frames)
+    {
+        mOut = frames;
+        mSent = 0;
+        mNext = target::now();
+    }
+
+    void expect(const std::vector<CanFrame_t> &frames)
+    {
+        mExpected = frames;
+        received = 0;
+        isIntact = true;
+        stamps.clear();
+        mNext = target::now();
+    }
+
+    static bool isSame(const CanFrame_t &a, const CanFrame_t &b)
+    {
+        return (a.id == b.id) && (a.flags == b.flags) && (a.len == b.len) && (a.channel == b.channel) &&
+               (std::memcmp(a.data, b.data, a.len) == 0);
+    }
+
+    size_t received = 0;
+    std::vector<uint32_t> stamps; /* Time stamp of each received frame. */
+    uint64_t lastReceived = 0;
+    bool isIntact = true;
+
+private:
+    std::vector<CanFrame_t> mOut;
+    size_t mSent = 0;
+    std::vector<CanFrame_t> mExpected;
+    uint64_t mNext = 0;
+};
+
+/* What a run moved and what it cost on the SPI. */
+struct Run
+{
+    uint64_t start;
+    uint64_t spiBytes;
+    uint64_t transfers;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+mcp::Model gMcp;
+Host gHost;
+
+StaticTask_t gMcpTaskDef;
+StackType_t gMcpStack[configMINIMAL_STACK_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* Classic and FD frames, standard and extended, of every valid length. */
+std::vector<CanFrame_t> makeFrames(size_t count, std::mt19937 &rng)
+{
+    std::vector<CanFrame_t> frames(count);
+
+    for (CanFrame_t &frame : frames)
+    {
+        const unsigned kind = rng() % 4U;
+
+        frame = CanFrame_t{};
+        frame.channel = MCP_CHANNEL;
+        frame.flags = (rng() & 1U) ? CAN_FLAG_EXT : 0U;
+        frame.id = (frame.flags & CAN_FLAG_EXT) ? (rng() & 0x1FFFFFFFUL) : (rng() & CAN_STD_ID_MASK);
+        if (kind == 0U)
+        {
+            frame.flags |= CAN_FLAG_RTR;
+        }
+        else if (kind == 1U)
+        {
+            frame.len = static_cast<uint8_t>(rng() % 9U);
+        }
+        else
+        {
+            frame.flags |= CAN_FLAG_FD | ((kind == 3U) ? CAN_FLAG_BRS : 0U);
+            frame.len = mcp::kDlcToLen[rng() % 16U];
+        }
+        for (uint8_t i = 0; i < frame.len; i++)
+        {
+            frame.data[i] = static_cast<uint8_t>(rng());
+        }
+    }
+
+    return frames;
+}
+
+Run begin()
+{
+    StatsSnapshot_t stats;
+
+    statsSnapshot(&stats);
+
+    return {target::now(), stats.counter[STAT_MCP_SPI_BYTES], gMcp.transfers};
+}
+
+void report(const char *label, const Run &run, uint64_t end, size_t frames, bool isIntact, const char *extra)
+{
+    StatsSnapshot_t stats;
+
+    statsSnapshot(&stats);
+
+    const double seconds = (end - run.start) / static_cast<double>(target::kNsPerS);
+    const double perFrame = static_cast<double>(stats.counter[STAT_MCP_SPI_BYTES] - run.spiBytes) / frames;
+    const double transfers = static_cast<double>(gMcp.transfers - run.transfers) / frames;
+
+    std::printf("  %-16s %10.0f %9.1f %9.2f  %-9s %s\n", label, frames / std::max(seconds, 1e-9), perFrame,
+                transfers, isIntact ? "intact" : "WRONG", extra);
+}
+
+/* Unused here: no self test runs. */
+extern "C" bool selfTestRx(const CanFrame_t *frame)
+{
+    (void)frame;
+    return false;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const size_t count = (argc > 1) ? static_cast<size_t>(std::max(1, std::atoi(argv[1]))) : 5000U;
+    const unsigned seed = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 1U;
+    const uint64_t timeout = 10U * target::kNsPerS;
+    std::mt19937 rng(seed);
+    StatsSnapshot_t stats;
+    bool isOk = true;
+
+    target::setWakeLatency(kWakeLatencyNs);
+    target::attachSpi(0, &gMcp, MCP_CS_PIN);
+    target::attach(&gMcp);
+    target::attach(&gHost);
+    statsInit();
+    gatewayInit();
+    channelInit();
+
+    /* Initialisation, checked on the registers it left. */
+    const uint64_t initStart = target::now();
+    const bool isInit = mcpInit();
+    const uint64_t initNs = target::now() - initStart;
+    const uint32_t nbtcfg = ((MCP_NBT_BRP - 1U) << 24) | ((MCP_NBT_TSEG1 - 1U) << 16) | ((MCP_NBT_TSEG2 - 1U) << 8) |
+                            (MCP_NBT_SJW - 1U);
+    const uint32_t dbtcfg = ((MCP_DBT_BRP - 1U) << 24) | ((MCP_DBT_TSEG1 - 1U) << 16) | ((MCP_DBT_TSEG2 - 1U) << 8) |
+                            (MCP_DBT_SJW - 1U);
+    const bool isConfigured =
+        isInit && (gMcp.opMode() == mcp::kModeNormalFd) && ((gMcp.reg(mcp::kRegC1Con) & (3UL << 19)) == 0) &&
+        (gMcp.reg(mcp::kRegC1Nbtcfg) == nbtcfg) && (gMcp.reg(mcp::kRegC1Dbtcfg) == dbtcfg) &&
+        (gMcp.depth(mcp::kTxFifo) == MCP_TX_FIFO_DEPTH) && (gMcp.depth(mcp::kRxFifo) == MCP_RX_FIFO_DEPTH) &&
+        (gMcp.payload(mcp::kTxFifo) == CAN_FRAME_MAX_LEN) && (gMcp.payload(mcp::kRxFifo) == CAN_FRAME_MAX_LEN) &&
+        (gMcp.reg(mcp::kRegFifoCon0 + 12U * mcp::kTxFifo) & 0x80U) && !(gMcp.reg(mcp::kRegFifoCon0 + 12U * mcp::kRxFifo) & 0x80U) &&
+        ((gMcp.reg(mcp::kRegFltCon0) & 0xFFU) == (0x80U | mcp::kRxFifo)) &&
+        ((gMcp.reg(mcp::kRegC1Tscon) & 0x303FFU) == (0x30000U | (40U - 1U))) &&
+        (gMcp.reg(mcp::kRegFifoCon0 + 12U * mcp::kRxFifo) & 0x20U) && (gMcp.configWrites == 0);
+
+    statsSnapshot(&stats);
+    std::printf("init       %s in %.2f ms, %llu SPI bytes in %llu transfers\n", isConfigured ? "ok" : "WRONG",
+                initNs / 1e6, static_cast<unsigned long long>(stats.counter[STAT_MCP_SPI_BYTES]),
+                static_cast<unsigned long long>(gMcp.transfers));
+    isOk &= isConfigured;
+    if (!isInit)
+    {
+        return 1;
+    }
+
+    (void)xTaskCreateStatic(mcpTask, "mcp", configMINIMAL_STACK_SIZE, NULL, 3, gMcpStack, &gMcpTaskDef);
+    (void)target::run(target::now() + target::kNsPerMs);
+
+    std::printf("%zu frames at %u/%u bit/s, SPI at %u Hz\n", count, mcp::kBitrate, mcp::kDataBitrate,
+                static_cast<unsigned>(MCP_SPI_BAUDRATE));
+    std::printf("  %-16s %10s %9s %9s  %-9s %s\n", "", "frames/s", "SPI B/fr", "xfers/fr", "frames", "");
+
+    /* Transmit, at the bus rate and then as fast as the SPI goes. */
+    for (const bool isInstant : {false, true})
+    {
+        const std::vector<CanFrame_t> frames = makeFrames(count, rng);
+        const uint64_t busBefore = gMcp.busNs;
+        char extra[64];
+
+        gMcp.setInstant(isInstant);
+        gMcp.sent.clear();
+        const Run run = begin();
+        gHost.send(frames);
+        const bool isDone = target::run(run.start + timeout, [&] { return gMcp.sent.size() >= frames.size(); });
+        const bool isIntact = isDone && std::equal(frames.begin(), frames.end(), gMcp.sent.begin(), Host::isSame);
+        const double busShare =
+            static_cast<double>(gMcp.busNs - busBefore) / std::max<uint64_t>(gMcp.lastSent - run.start, 1U);
+
+        std::snprintf(extra, sizeof(extra), isInstant ? "" : "bus busy %.1f%%", 100.0 * busShare);
+        report(isInstant ? "tx, SPI bound" : "tx, bus rate", run, gMcp.lastSent, frames.size(), isIntact, extra);
+        isOk &= isIntact && (isInstant || (busShare >= kMinBusShare));
+    }
+
+    /* Receive, back to back at the bus rate and then from a full FIFO. */
+    for (const bool isInstant : {false, true})
+    {
+        const std::vector<CanFrame_t> frames = makeFrames(count, rng);
+        char extra[96];
+
+        statsSnapshot(&stats);
+        const uint64_t overflows = stats.counter[STAT_MCP_RX_OVERFLOWS];
+        const uint64_t lost = gMcp.lost;
+        const size_t base = gMcp.receivedAt.size();
+        uint32_t stampErr = 0;
+
+        gMcp.setInstant(isInstant);
+        const Run run = begin();
+        gHost.expect(frames);
+        gMcp.feed(frames, isInstant);
+        const bool isDone = target::run(run.start + timeout, [&] { return gHost.received >= frames.size(); });
+
+        /* Each stamp against the microsecond the model received at. */
+        for (size_t i = 0; isDone && (i < gHost.stamps.size()); i++)
+        {
+            const uint32_t at = static_cast<uint32_t>(gMcp.receivedAt[base + i] / target::kNsPerUs);
+            const int32_t err = static_cast<int32_t>(gHost.stamps[i] - at);
+
+            stampErr = std::max<uint32_t>(stampErr, static_cast<uint32_t>(std::abs(err)));
+        }
+
+        statsSnapshot(&stats);
+        std::snprintf(extra, sizeof(extra), "%llu lost, %llu overflows counted, stamps within %u us",
+                      static_cast<unsigned long long>(gMcp.lost - lost),
+                      static_cast<unsigned long long>(stats.counter[STAT_MCP_RX_OVERFLOWS] - overflows), stampErr);
+        report(isInstant ? "rx, SPI bound" : "rx, bus rate", run, gHost.lastReceived, frames.size(),
+               isDone && gHost.isIntact, extra);
+        isOk &= isDone && gHost.isIntact && (gMcp.lost == lost) && (stampErr <= kMaxStampErrUs);
+    }
+
+    /* A classic frame over 8 bytes is refused, the next one still sent. */
+    {
+        std::vector<CanFrame_t> frames(2U);
+
+        for (CanFrame_t &frame : frames)
+        {
+            frame = CanFrame_t{};
+            frame.channel = MCP_CHANNEL;
+            frame.id = 0x123U;
+        }
+        frames[0].len = 12U;
+        frames[1].len = 8U;
+
+        statsSnapshot(&stats);
+        const uint64_t invalid = stats.counter[STAT_MCP_TX_INVALID];
+
+        gMcp.setInstant(false);
+        gMcp.sent.clear();
+        gHost.send(frames);
+        (void)target::run(target::now() + target::kNsPerMs);
+
+        statsSnapshot(&stats);
+        const bool isRefused = (gMcp.sent.size() == 1U) && Host::isSame(gMcp.sent[0], frames[1]) &&
+                               (stats.counter[STAT_MCP_TX_INVALID] == invalid + 1U);
+
+        std::printf("  %-16s %s\n", "tx, 12B classic", isRefused ? "refused" : "WRONG");
+        isOk &= isRefused;
+    }
+
+    /* Internal loopback: out through the TX FIFO, back through the RX. */
+    {
+        const std::vector<CanFrame_t> frames = makeFrames(count, rng);
+
+        gMcp.setInstant(false);
+        gMcp.sent.clear();
+        mcpSetLoopback(true);
+        (void)target::run(target::now() + target::kNsPerMs);
+
+        const Run run = begin();
+        gHost.expect(frames);
+        gHost.send(frames);
+        const bool isDone = target::run(run.start + timeout, [&] { return gHost.received >= frames.size(); });
+        const bool isIntact = isDone && gHost.isIntact && gMcp.sent.empty();
+
+        report("loopback", run, gHost.lastReceived, frames.size(), isIntact,
+               (gMcp.opMode() == mcp::kModeIntLoopback) ? "" : "not in loopback");
+        isOk &= isIntact && (gMcp.opMode() == mcp::kModeIntLoopback);
+
+        mcpSetLoopback(false);
+        (void)target::run(target::now() + target::kNsPerMs);
+        isOk &= gMcp.opMode() == mcp::kModeNormalFd;
+    }
+
+    return isOk ? 0 : 1;
+}
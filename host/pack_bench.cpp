@@ -0,0 +1,249 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "pack_stream.hpp"
+#include "bench_traffic.hpp"
+
+/* Packs the frames of a capture, or of synthetic vehicle traffic, as the */
+/* bridge does in BRIDGE_MODE_PACKED, unpacks them again and checks that  */
+/* nothing changed. Prints the stream sizes against raw mode and the host */
+/* time per frame of pack.c and of the decoder.                           */
+/*                                                                        */
+/*     pack_bench [capture.bin|-] [poll_us] [seconds]                     */
+/*                                                                        */
+/* The bridge packs the frames waiting when the host polls and closes the */
+/* record when they run out: the frames of every poll_us (default 1000,   */
+/* a full speed USB frame) go in their own records. Synthetic traffic     */
+/* (-, the default) runs for seconds, default 60. A second pass loses one */
+/* record in a thousand and checks the decoder picks up at the next reset. */
+/* A third packs again for a host that asks for a resync once it sees the */
+/* gap, which reaches the encoder two polls after the lost record.        */
+/* Exits with 1 on any difference.                                        */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Record overhead: sync, type, length and CRC. */
+constexpr size_t kRecordOverhead = PROTO_HEADER_SIZE + PROTO_TRAILER_SIZE;
+
+/* PROTO_REC_FRAME payload before the data. */
+constexpr size_t kFrameHeader = 11U;
+
+constexpr unsigned kLossEvery = 1000U;
+
+/* Polls from a lost record to its PROTO_CMD_PACK_RESYNC: the next record */
+/* shows the gap, and the command goes back in the one after.             */
+constexpr uint32_t kResyncPolls = 2U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* A packed record and the frames it holds. */
+struct Packed
+{
+    std::vector<uint8_t> payload;
+    size_t first;
+    size_t count;
+};
+
+struct Totals
+{
+    uint64_t raw;    /* Stream bytes in raw mode. */
+    uint64_t packed; /* Stream bytes in packed mode. */
+    uint64_t ops[4];
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* Packs as bridge.c does: a record is closed when it is full and when */
+/* the frames of a poll have been packed. With lossEvery, the host     */
+/* asks for a resync after each record unpack() is going to skip.      */
+std::vector<Packed> pack(const std::vector<CanFrame_t> &frames, uint32_t pollUs, unsigned lossEvery,
+                         Totals &totals)
+{
+    static PackEncoder_t enc;
+    std::vector<Packed> records;
+    size_t first = 0;
+    uint32_t pollEnd = frames.empty() ? 0U : frames[0].timestamp + pollUs;
+    uint32_t resyncPolls = 0;
+
+    auto close = [&](size_t next) {
+        const uint8_t len = packClose(&enc);
+
+        if (len > 0)
+        {
+            records.push_back(Packed{std::vector<uint8_t>(enc.payload, enc.payload + len), first, next - first});
+            totals.packed += kRecordOverhead + len;
+            if ((lossEvery != 0) && (records.size() % lossEvery == 0))
+            {
+                resyncPolls = kResyncPolls;
+            }
+        }
+        first = next;
+    };
+
+    packInit(&enc);
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const CanFrame_t &frame = frames[i];
+
+        if (static_cast<int32_t>(frame.timestamp - pollEnd) >= 0)
+        {
+            close(i);
+            pollEnd += ((frame.timestamp - pollEnd) / pollUs + 1U) * pollUs;
+            if ((resyncPolls > 0) && (--resyncPolls == 0))
+            {
+                packResync(&enc);
+            }
+        }
+
+        uint8_t at = enc.len;
+        if (!packFrame(&enc, &frame))
+        {
+            close(i);
+            at = enc.len;
+            (void)packFrame(&enc, &frame);
+        }
+
+        /* A record was opened by this frame: its header came first. */
+        at = (at == 0) ? PACK_HEADER_SIZE : at;
+        totals.ops[enc.payload[at] >> 6]++;
+        totals.raw += kRecordOverhead + kFrameHeader + frame.len;
+    }
+    close(frames.size());
+
+    return records;
+}
+
+/* Unpacks records, skipping every lossEvery-th when not 0, and compares */
+/* what comes out with the frames. Returns false on any difference.      */
+bool unpack(const std::vector<Packed> &records, const std::vector<CanFrame_t> &frames, unsigned lossEvery,
+            uint64_t &decoded, uint64_t &lost)
+{
+    canaan::PackDecoder decoder;
+    bool isSame = true;
+
+    decoded = 0;
+    for (size_t r = 0; r < records.size(); r++)
+    {
+        const Packed &packed = records[r];
+        size_t next = packed.first;
+
+        if ((lossEvery != 0) && (r % lossEvery == lossEvery - 1U))
+        {
+            continue;
+        }
+
+        decoder.decode(canaan::Record{PROTO_REC_PACKED, static_cast<uint8_t>(packed.payload.size()),
+                                      packed.payload.data(), 0},
+                       [&](const canaan::Frame &frame) {
+                           const CanFrame_t *expected = (next < packed.first + packed.count) ? &frames[next] : nullptr;
+
+                           isSame &= (expected != nullptr) &&
+                                     (static_cast<uint32_t>(frame.timestamp) == expected->timestamp) &&
+                                     (frame.id == expected->id) && (frame.channel == expected->channel) &&
+                                     (frame.flags == expected->flags) && (frame.len == expected->len) &&
+                                     (std::memcmp(frame.data, expected->data, frame.len) == 0);
+                           next++;
+                           decoded++;
+                       });
+    }
+    lost = decoder.lost();
+
+    return isSame;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const std::string source = (argc > 1) ? argv[1] : "-";
+    const uint32_t pollUs = (argc > 2) ? static_cast<uint32_t>(std::max(1, std::atoi(argv[2]))) : 1000U;
+    const unsigned seconds = (argc > 3) ? static_cast<unsigned>(std::max(1, std::atoi(argv[3]))) : 60U;
+    std::vector<CanFrame_t> frames;
+
+    if (source == "-")
+    {
+        frames = canaan::makeTraffic(seconds);
+    }
+    else if (!canaan::readCapture(source.c_str(), frames))
+    {
+        std::cerr << "cannot open " << source << "\n";
+        return 1;
+    }
+
+    if (frames.empty())
+    {
+        std::cerr << "no frames\n";
+        return 1;
+    }
+
+    Totals totals{};
+    const auto packStart = Clock::now();
+    const std::vector<Packed> records = pack(frames, pollUs, 0, totals);
+    const auto packEnd = Clock::now();
+
+    uint64_t decoded;
+    uint64_t lost;
+    const bool isSame = unpack(records, frames, 0, decoded, lost);
+    const auto unpackEnd = Clock::now();
+
+    uint64_t decodedLossy;
+    uint64_t lostLossy;
+    const bool isSameLossy = unpack(records, frames, kLossEvery, decodedLossy, lostLossy);
+
+    Totals totalsResync{};
+    uint64_t decodedResync;
+    uint64_t lostResync;
+    const std::vector<Packed> resynced = pack(frames, pollUs, kLossEvery, totalsResync);
+    const bool isSameResync = unpack(resynced, frames, kLossEvery, decodedResync, lostResync);
+
+    const double n = static_cast<double>(frames.size());
+    const double packNs = std::chrono::duration<double, std::nano>(packEnd - packStart).count() / n;
+    const double unpackNs = std::chrono::duration<double, std::nano>(unpackEnd - packEnd).count() / n;
+
+    std::printf("%zu frames, %zu records of %.1f frames, polled every %u us\n", frames.size(), records.size(),
+                n / records.size(), pollUs);
+    std::printf("  raw     %10llu bytes  %6.2f per frame\n", static_cast<unsigned long long>(totals.raw),
+                totals.raw / n);
+    std::printf("  packed  %10llu bytes  %6.2f per frame  ratio %.2f:1\n",
+                static_cast<unsigned long long>(totals.packed), totals.packed / n,
+                static_cast<double>(totals.raw) / totals.packed);
+    std::printf("  ops     xor %.1f%%  repeat %.1f%%  new %.1f%%  shape %.1f%%\n", 100.0 * totals.ops[0] / n,
+                100.0 * totals.ops[1] / n, 100.0 * totals.ops[2] / n, 100.0 * totals.ops[3] / n);
+    std::printf("  host    pack %.0f ns per frame, unpack %.0f ns per frame\n", packNs, unpackNs);
+    std::printf("  encoder %zu bytes of RAM, budget %u\n", sizeof(PackEncoder_t), PACK_RAM_BUDGET);
+    std::printf("  lossless: %s, %llu of %zu frames\n", (isSame && (decoded == frames.size())) ? "yes" : "NO",
+                static_cast<unsigned long long>(decoded), frames.size());
+    std::printf("  1 record in %u lost: %llu records skipped to the next reset, %.2f%% of the frames, %s\n",
+                kLossEvery, static_cast<unsigned long long>(lostLossy), 100.0 * (1.0 - decodedLossy / n),
+                isSameLossy ? "the rest intact" : "WRONG FRAMES");
+    std::printf("  and resync asked for: %llu records skipped, %.2f%% of the frames, ratio %.2f:1, %s\n",
+                static_cast<unsigned long long>(lostResync), 100.0 * (1.0 - decodedResync / n),
+                static_cast<double>(totalsResync.raw) / totalsResync.packed,
+                isSameResync ? "the rest intact" : "WRONG FRAMES");
+
+    return (isSame && isSameLossy && isSameResync && (decoded == frames.size()) && (lost == 0)) ? 0 : 1;
+}
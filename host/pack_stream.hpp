@@ -0,0 +1,200 @@
+#ifndef PACK_STREAM_HPP
+#define PACK_STREAM_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "capture.hpp"
+
+extern "C"
+{
+#include "pack.h"
+}
+
+namespace canaan
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Streaming decoder of PROTO_REC_PACKED records (see pack.h), fed the   */
+/* records of one link in order. It keeps only the dictionary, so any     */
+/* amount of stream goes through in constant memory.                      */
+class PackDecoder
+{
+public:
+    /* Calls fn(const Frame &) for every frame of rec, with the raw device */
+    /* timestamp as decodeFrame() leaves it. Frame data is valid during   */
+    /* the call only. Returns false for a record that could not be used:  */
+    /* not packed, malformed, or before the stream is joined at a reset.  */
+    template <typename Fn>
+    bool decode(const Record &rec, Fn &&fn)
+    {
+        const uint8_t *p = rec.payload + PACK_HEADER_SIZE;
+        const uint8_t *end = rec.payload + rec.len;
+
+        if ((rec.type != PROTO_REC_PACKED) || (rec.len < PACK_HEADER_SIZE))
+        {
+            return false;
+        }
+
+        if (rec.payload[1] & PACK_FLAG_RESET)
+        {
+            for (Slot &slot : mSlots)
+            {
+                slot.isValid = false;
+            }
+            mLast = 0;
+            mIsJoined = true;
+        }
+        else if (!mIsJoined || (rec.payload[0] != mSeq))
+        {
+            return lose();
+        }
+        mSeq = static_cast<uint8_t>(rec.payload[0] + 1U);
+
+        while (p < end)
+        {
+            const uint8_t op = *p & PACK_OP_MASK;
+            Slot &slot = mSlots[*p & PACK_SLOT_MASK];
+            uint32_t zigzag;
+
+            p++;
+            if (!getVarint(p, end, zigzag))
+            {
+                return lose();
+            }
+            mLast += (zigzag >> 1) ^ (0U - (zigzag & 1U));
+
+            if ((op != PACK_OP_NEW) && !slot.isValid)
+            {
+                return lose();
+            }
+
+            switch (op)
+            {
+            case PACK_OP_XOR:
+            {
+                const uint8_t *bitmap = p;
+
+                p += (slot.len + 7U) / 8U;
+                if (p > end)
+                {
+                    return lose();
+                }
+                for (unsigned i = 0; i < slot.len; i++)
+                {
+                    if ((bitmap[i / 8U] >> (i % 8U)) & 1U)
+                    {
+                        if (p == end)
+                        {
+                            return lose();
+                        }
+                        slot.data[i] ^= *p++;
+                    }
+                }
+                break;
+            }
+
+            case PACK_OP_REPEAT:
+                break;
+
+            case PACK_OP_NEW:
+                if (p == end)
+                {
+                    return lose();
+                }
+                slot.channel = *p >> 4;
+                slot.flags = *p++ & 0x0FU;
+                if (!getVarint(p, end, slot.id) || !getPayload(p, end, slot))
+                {
+                    return lose();
+                }
+                slot.isValid = true;
+                break;
+
+            default: /* PACK_OP_SHAPE */
+                if (p == end)
+                {
+                    return lose();
+                }
+                slot.flags = *p++;
+                if (!getPayload(p, end, slot))
+                {
+                    return lose();
+                }
+                break;
+            }
+
+            fn(Frame{mLast, slot.id, slot.channel, slot.flags, slot.len, slot.data.data()});
+        }
+
+        return true;
+    }
+
+    /* Records dropped while not joined to the stream. */
+    uint64_t lost() const { return mLost; }
+
+private:
+    struct Slot
+    {
+        uint32_t id;
+        uint8_t channel;
+        uint8_t flags;
+        uint8_t len;
+        bool isValid;
+        std::array<uint8_t, CAN_FRAME_MAX_LEN> data;
+    };
+
+    static bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+    {
+        value = 0;
+        for (unsigned shift = 0; (shift < 35U) && (p < end); shift += 7U)
+        {
+            const uint8_t byte = *p++;
+
+            value |= static_cast<uint32_t>(byte & 0x7FU) << shift;
+            if (!(byte & 0x80U))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static bool getPayload(const uint8_t *&p, const uint8_t *end, Slot &slot)
+    {
+        if ((p == end) || (*p > CAN_FRAME_MAX_LEN) || (end - p - 1 < *p))
+        {
+            return false;
+        }
+        slot.len = *p++;
+        std::memcpy(slot.data.data(), p, slot.len);
+        p += slot.len;
+
+        return true;
+    }
+
+    bool lose()
+    {
+        mIsJoined = false;
+        mLost++;
+        return false;
+    }
+
+    std::array<Slot, PACK_SLOT_MASK + 1U> mSlots{};
+    uint32_t mLast = 0;
+    uint8_t mSeq = 0;
+    bool mIsJoined = false;
+    uint64_t mLost = 0;
+};
+
+} /* namespace canaan */
+
+#endif /* PACK_STREAM_HPP */
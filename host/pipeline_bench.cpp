@@ -0,0 +1,225 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "pipeline.hpp"
+
+using namespace canaan;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+namespace
+{
+
+/* The same stages, configured at run time and called through pointers, */
+/* as a C pipeline with a runtime configuration would be.               */
+struct DynConfig
+{
+    uint8_t channelNum;
+    uint8_t maxLen;
+};
+
+using DynStage = bool (*)(PipelineContext &ctx, const DynConfig &cfg);
+
+struct DynPipeline
+{
+    std::vector<DynStage> stages;
+    DynConfig cfg;
+
+    PipelineContext run(const CanFrame_t &frame, uint8_t *out, uint32_t size) const
+    {
+        PipelineContext ctx{&frame, out, size, 0, 0};
+
+        for (DynStage stage : stages)
+        {
+            if (!stage(ctx, cfg))
+            {
+                break;
+            }
+        }
+
+        return ctx;
+    }
+};
+
+/* Keeps the measured output alive. */
+volatile uint64_t gSink = 0;
+
+struct Result
+{
+    double nsPerFrame;
+    double cyclesPerFrame;
+    uint64_t checksum;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Function                                                                   */
+/* -------------------------------------------------------------------------- */
+bool dynChannelGate(PipelineContext &ctx, const DynConfig &cfg)
+{
+    return ctx.frame->channel < cfg.channelNum;
+}
+
+bool dynLengthGate(PipelineContext &ctx, const DynConfig &cfg)
+{
+    return ctx.frame->len <= cfg.maxLen;
+}
+
+bool dynEncodeFrame(PipelineContext &ctx, const DynConfig &cfg)
+{
+    const CanFrame_t &frame = *ctx.frame;
+    const uint8_t len = (frame.len < cfg.maxLen) ? frame.len : cfg.maxLen;
+
+    return putRecord<PROTO_REC_FRAME>(ctx, static_cast<uint8_t>(11U + len), [&](uint8_t *p) {
+        protoPutU32(&p[0], frame.timestamp);
+        protoPutU32(&p[4], frame.id);
+        p[8] = frame.channel;
+        p[9] = frame.flags;
+        p[10] = len;
+        std::memcpy(&p[11], frame.data, len);
+    });
+}
+
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+std::vector<CanFrame_t> makeFrames(size_t count, uint8_t maxLen, uint8_t channelNum)
+{
+    std::mt19937 rng(1);
+    std::vector<CanFrame_t> frames(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        CanFrame_t &frame = frames[i];
+
+        std::memset(&frame, 0, sizeof(frame));
+        frame.id = rng() & CAN_STD_ID_MASK;
+        frame.timestamp = static_cast<uint32_t>(i * 100U);
+        frame.channel = static_cast<uint8_t>(rng() % channelNum);
+        frame.len = static_cast<uint8_t>(rng() % (maxLen + 1U));
+        for (uint8_t b = 0; b < frame.len; b++)
+        {
+            frame.data[b] = static_cast<uint8_t>(rng());
+        }
+    }
+
+    return frames;
+}
+
+template <typename Run>
+Result measure(const std::vector<CanFrame_t> &frames, int rounds, Run &&run)
+{
+    static uint8_t out[4096];
+    uint64_t checksum = 0;
+    uint32_t tail = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t startCycles = cycles();
+
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const CanFrame_t &frame : frames)
+        {
+            if (sizeof(out) - tail < PROTO_MAX_RECORD)
+            {
+                checksum += out[tail - 1U];
+                tail = 0;
+            }
+            tail += run(frame, &out[tail], static_cast<uint32_t>(sizeof(out) - tail)).tail;
+        }
+    }
+
+    const uint64_t endCycles = cycles();
+    const auto end = std::chrono::steady_clock::now();
+    const double count = static_cast<double>(frames.size()) * rounds;
+
+    return Result{
+        std::chrono::duration<double, std::nano>(end - start).count() / count,
+        static_cast<double>(endCycles - startCycles) / count,
+        checksum,
+    };
+}
+
+template <uint8_t MaxLen>
+bool compare(const char *name, int rounds)
+{
+    using Static = Pipeline<ChannelGate<2>, LengthGate<MaxLen>, EncodeFrame<MaxLen>>;
+    const DynPipeline dyn{{dynChannelGate, dynLengthGate, dynEncodeFrame}, {2, MaxLen}};
+    const std::vector<CanFrame_t> frames = makeFrames(1U << 16, MaxLen, 2);
+
+    /* Both must produce the same bytes before their speed means anything. */
+    for (const CanFrame_t &frame : frames)
+    {
+        uint8_t a[PROTO_MAX_RECORD];
+        uint8_t b[PROTO_MAX_RECORD];
+        const PipelineContext ca = Static::run(frame, a, sizeof(a));
+        const PipelineContext cb = dyn.run(frame, b, sizeof(b));
+
+        if ((ca.tail != cb.tail) || (std::memcmp(a, b, ca.tail) != 0) ||
+            (ca.tail != 0 && protoCrc8(0, &a[1], ca.tail - 2U) != a[ca.tail - 1U]))
+        {
+            std::fprintf(stderr, "%s: output mismatch\n", name);
+            return false;
+        }
+    }
+
+    const Result s = measure(frames, rounds, [](const CanFrame_t &f, uint8_t *o, uint32_t n) { return Static::run(f, o, n); });
+    const Result d = measure(frames, rounds, [&](const CanFrame_t &f, uint8_t *o, uint32_t n) { return dyn.run(f, o, n); });
+
+    gSink = gSink + s.checksum + d.checksum;
+    std::printf("%-8s template %7.2f ns %7.1f cycles | pointers %7.2f ns %7.1f cycles | x%.2f\n",
+                name, s.nsPerFrame, s.cyclesPerFrame, d.nsPerFrame, d.cyclesPerFrame,
+                d.nsPerFrame / s.nsPerFrame);
+
+    return true;
+}
+
+} /* namespace */
+
+/* protoCrc8() from protocol.c, to check the records against. */
+extern "C" uint8_t protoCrc8(uint8_t crc, const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80U) ? static_cast<uint8_t>((crc << 1) ^ 0x07U) : static_cast<uint8_t>(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Compares the compile-time pipeline with a function pointer pipeline */
+/* running the same stages. Usage: pipeline_bench [rounds]             */
+int main(int argc, char **argv)
+{
+    const int rounds = (argc > 1) ? std::atoi(argv[1]) : 200;
+    bool isOk = true;
+
+    isOk = compare<8>("classic", rounds) && isOk;
+    isOk = compare<64>("fd", rounds) && isOk;
+
+    return isOk ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "record_stream.hpp"
+
+/* Reports static RAM per module from the linker map and, given a capture  */
+/* holding a PROTO_REC_MEMORY record, the heap and the stack high-water   */
+/* marks with recommended stack sizes. Take the capture after running the */
+/* workload the sizes should cover.                                       */
+/*                                                                        */
+/*     ramreport <Canaan.elf.map> [capture.bin]                           */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* RP2040 SRAM, striped banks and the two scratch banks. */
+constexpr uint64_t kRamStart = 0x20000000ULL;
+constexpr uint64_t kRamEnd = 0x20042000ULL;
+
+/* Recommended stack: measured use plus a quarter, plus a fixed margin */
+/* for paths the workload did not reach, rounded up to 8 words.        */
+constexpr uint32_t kStackMarginWords = 16U;
+
+/* PROTO_REC_MEMORY layout, as MEM_PROFILE_* in mem_profile.h. */
+constexpr size_t kHeaderSize = 12U;
+constexpr size_t kEntrySize = 12U;
+constexpr size_t kNameLen = 8U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Stack
+{
+    std::string name;
+    uint32_t sizeWords; /* 0 if the task was not registered. */
+    uint32_t freeWords;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* "CMakeFiles/Canaan.dir/bridge.c.obj" -> "bridge.c",          */
+/* "/sdk/libfoo.a(bar.c.obj)" -> "libfoo.a(bar.c)".             */
+std::string moduleName(std::string path)
+{
+    const size_t slash = path.find_last_of('/', path.find('('));
+
+    if (slash != std::string::npos)
+    {
+        path = path.substr(slash + 1U);
+    }
+
+    for (const char *suffix : {".obj", ".o"})
+    {
+        const size_t at = path.rfind(suffix);
+        if ((at != std::string::npos) && ((at + std::string(suffix).size() == path.size()) || (path[at + std::string(suffix).size()] == ')')))
+        {
+            path.erase(at, std::string(suffix).size());
+            break;
+        }
+    }
+
+    return path;
+}
+
+/* Sums the input sections placed in RAM by the object they came from. */
+std::map<std::string, uint64_t> parseMap(std::istream &in)
+{
+    std::map<std::string, uint64_t> modules;
+    std::string line;
+    bool isMemoryMap = false;
+
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && (line.back() == '\r'))
+        {
+            line.pop_back();
+        }
+
+        if (line.rfind("Linker script and memory map", 0) == 0)
+        {
+            isMemoryMap = true;
+            continue;
+        }
+
+        /* Input sections are indented by one space. */
+        if (!isMemoryMap || (line.size() < 2) || (line[0] != ' ') || ((line[1] != '.') && (line.rfind(" COMMON", 0) != 0)))
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string name;
+        std::string addr;
+        std::string size;
+        std::string file;
+
+        fields >> name >> addr >> size;
+        if (addr.empty())
+        {
+            /* Long section names push the rest onto the next line. */
+            if (!std::getline(in, line))
+            {
+                break;
+            }
+            fields = std::istringstream(line);
+            fields >> addr >> size;
+        }
+        std::getline(fields >> std::ws, file);
+
+        if ((addr.rfind("0x", 0) != 0) || (size.rfind("0x", 0) != 0) || file.empty())
+        {
+            continue;
+        }
+
+        const uint64_t address = std::strtoull(addr.c_str(), nullptr, 16);
+        const uint64_t bytes = std::strtoull(size.c_str(), nullptr, 16);
+
+        if ((address >= kRamStart) && (address < kRamEnd) && (bytes > 0))
+        {
+            modules[moduleName(file)] += bytes;
+        }
+    }
+
+    return modules;
+}
+
+uint32_t recommendWords(uint32_t usedWords)
+{
+    return (usedWords + usedWords / 4U + kStackMarginWords + 7U) & ~7U;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: ramreport <Canaan.elf.map> [capture.bin]\n";
+        return 2;
+    }
+
+    std::ifstream map(argv[1]);
+    if (!map)
+    {
+        std::cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    /* Static RAM, largest first. */
+    const std::map<std::string, uint64_t> modules = parseMap(map);
+    std::vector<std::pair<std::string, uint64_t>> sorted(modules.begin(), modules.end());
+    uint64_t total = 0;
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    std::printf("Static RAM by module (bytes)\n");
+    for (const auto &module : sorted)
+    {
+        std::printf("  %-40s %8llu\n", module.first.c_str(), static_cast<unsigned long long>(module.second));
+        total += module.second;
+    }
+    std::printf("  %-40s %8llu of %llu\n", "total", static_cast<unsigned long long>(total),
+                static_cast<unsigned long long>(kRamEnd - kRamStart));
+
+    if (argc < 3)
+    {
+        return 0;
+    }
+
+    std::ifstream in(argv[2], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "cannot open " << argv[2] << "\n";
+        return 1;
+    }
+    std::vector<uint8_t> capture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    /* The last report wins: it covers the longest run. */
+    std::vector<uint8_t> report;
+    canaan::forEachRecord(capture.data(), capture.size(), [&](const canaan::Record &rec) {
+        if ((rec.type == PROTO_REC_MEMORY) && (rec.len >= kHeaderSize))
+        {
+            report.assign(rec.payload, rec.payload + rec.len);
+        }
+    });
+
+    if (report.empty())
+    {
+        std::cerr << "no memory report in " << argv[2] << "\n";
+        return 1;
+    }
+
+    const uint32_t heapSize = protoGetU32(&report[0]);
+    const uint32_t heapFree = protoGetU32(&report[4]);
+
+    std::printf("\nDevice static RAM (data + bss): %u bytes\n", protoGetU32(&report[8]));
+    std::printf("Heap: %u bytes, %u used, %u free\n", heapSize, heapSize - heapFree, heapFree);
+
+    std::vector<Stack> stacks;
+    for (size_t pos = kHeaderSize; pos + kEntrySize <= report.size(); pos += kEntrySize)
+    {
+        const uint8_t *p = &report[pos];
+        const std::string name(reinterpret_cast<const char *>(p), ::strnlen(reinterpret_cast<const char *>(p), kNameLen));
+
+        stacks.push_back(Stack{name, protoGetU16(&p[8]), protoGetU16(&p[10])});
+    }
+
+    int64_t reclaim = 0;
+
+    std::printf("\nStacks (words)          size    used    free  recommended\n");
+    for (const Stack &stack : stacks)
+    {
+        if (stack.sizeWords == 0)
+        {
+            std::printf("  %-20s %7s %7s %7u  -\n", stack.name.c_str(), "?", "?", stack.freeWords);
+            continue;
+        }
+
+        const uint32_t used = (stack.freeWords < stack.sizeWords) ? stack.sizeWords - stack.freeWords : 0;
+        const uint32_t recommended = recommendWords(used);
+
+        std::printf("  %-20s %7u %7u %7u  %7u%s\n", stack.name.c_str(), stack.sizeWords, used,
+                    stack.freeWords, recommended, (recommended > stack.sizeWords) ? "  (too small)" : "");
+        reclaim += static_cast<int64_t>(stack.sizeWords) - recommended;
+    }
+
+    std::printf("\nResizing the registered stacks frees %lld bytes.\n", static_cast<long long>(reclaim * 4));
+    std::printf("Unused heap: %u bytes. (heap_1 never frees, so this is final after start-up)\n", heapFree);
+
+    return 0;
+}
@@ -0,0 +1,312 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+extern "C"
+{
+#include "rate_limit.h"
+}
+
+/* Floods the transmit scheduler of one channel with frames from a host   */
+/* far faster than the bus takes them, and prints the rate each source   */
+/* gets on the bus, second by second, against its configured limit.      */
+/*                                                                       */
+/*     ratelimit_sim [seconds] [seed]                                    */
+/*                                                                       */
+/* Frames are admitted by rate_limit.c as channel.c does it: the head of */
+/* the transmit queue goes when the bus is free, is dropped, or is held  */
+/* until a release timer that runs on 1 ms ticks. Exits with 1 when a    */
+/* steady state rate is more than 1% off its limit.                      */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr uint64_t kNsPerS = 1000000000ULL;
+constexpr uint64_t kTickNs = 1000000ULL;
+
+/* 500 kbit/s nominal, 2 Mbit/s data phase. */
+constexpr uint32_t kBitrate = 500000U;
+constexpr uint32_t kDataBitrate = 2000000U;
+
+/* Host side: frames offered per second and the channel's queue depth. */
+constexpr uint64_t kFloodFps = 20000U;
+constexpr size_t kQueueLen = 16U;
+
+/* Allowed deviation of a steady state rate from its limit. */
+constexpr double kTolerance = 0.01;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Frames a flooding host sends, weight out of the sum of all weights. */
+struct Source
+{
+    const char *name;
+    uint32_t id;
+    uint32_t span; /* Identifiers from id, picked at random. */
+    uint8_t flags;
+    uint8_t len;
+    unsigned weight;
+    double limit; /* Frames per second, 0 when not limited. */
+};
+
+struct Scenario
+{
+    const char *name;
+    std::vector<Source> sources;
+    std::vector<RateRule_t> rules;
+    RateBusload_t busload;
+};
+
+struct Counts
+{
+    std::vector<uint64_t> sent; /* Per source. */
+    uint64_t busyNs;
+    uint64_t shaped;
+    uint64_t dropped;
+    uint64_t rejected; /* Turned away on a full queue. */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+uint64_t busTime(const CanFrame_t &frame)
+{
+    uint32_t nominal;
+    uint32_t data;
+
+    rateFrameBits(&frame, &nominal, &data);
+
+    return nominal * kNsPerS / kBitrate + data * kNsPerS / kDataBitrate;
+}
+
+/* Release timer: FreeRTOS expires a timer period ticks after the */
+/* current tick, which may be nearly over.                        */
+uint64_t releaseAt(uint64_t now, uint64_t release)
+{
+    uint64_t ticks = std::max<uint64_t>((release - now + kTickNs - 1U) / kTickNs, 1U);
+
+    return (now / kTickNs + ticks) * kTickNs;
+}
+
+void addCounts(Counts &to, const Counts &from)
+{
+    for (size_t i = 0; i < to.sent.size(); i++)
+    {
+        to.sent[i] += from.sent[i];
+    }
+    to.busyNs += from.busyNs;
+    to.shaped += from.shaped;
+    to.dropped += from.dropped;
+    to.rejected += from.rejected;
+}
+
+bool run(const Scenario &scenario, unsigned seconds, unsigned seed)
+{
+    static RateTable_t table;
+    RateBusload_t busloads[CAN_CHANNEL_NUM] = {};
+    std::mt19937 rng(seed);
+    std::vector<unsigned> picks;
+    std::deque<CanFrame_t> queue;
+
+    busloads[0] = scenario.busload;
+    rateTableBuild(&table, scenario.rules.data(), static_cast<uint8_t>(scenario.rules.size()), busloads);
+
+    for (size_t i = 0; i < scenario.sources.size(); i++)
+    {
+        picks.insert(picks.end(), scenario.sources[i].weight, static_cast<unsigned>(i));
+    }
+
+    std::printf("%s\n    s", scenario.name);
+    for (const Source &source : scenario.sources)
+    {
+        std::printf(" %9s", source.name);
+    }
+    std::printf("  busload   shaped  dropped\n");
+
+    Counts second{std::vector<uint64_t>(scenario.sources.size()), 0, 0, 0, 0};
+    Counts steady = second;
+    const uint64_t end = seconds * kNsPerS;
+    uint64_t nextArrival = 0;
+    uint64_t busFree = 0;
+    uint64_t heldUntil = 0;
+    uint64_t binEnd = kNsPerS;
+    uint64_t now = 0;
+    bool isHeadShaped = false;
+
+    while (now < end)
+    {
+        /* Host: every frame it sends is queued or turned away. */
+        while (nextArrival <= now)
+        {
+            const Source &source = scenario.sources[picks[rng() % picks.size()]];
+            CanFrame_t frame{};
+
+            frame.id = source.id + ((source.span > 1U) ? static_cast<uint32_t>(rng() % source.span) : 0U);
+            frame.flags = source.flags;
+            frame.len = source.len;
+            frame.reserved = static_cast<uint8_t>(&source - scenario.sources.data());
+
+            if (queue.size() < kQueueLen)
+            {
+                queue.push_back(frame);
+            }
+            else
+            {
+                second.rejected++;
+            }
+            nextArrival += kNsPerS / kFloodFps;
+        }
+
+        /* Scheduler: runs whenever the controller has room. */
+        while ((now >= busFree) && (now >= heldUntil) && !queue.empty())
+        {
+            const CanFrame_t &frame = queue.front();
+            uint64_t release;
+            RateVerdict_t verdict = rateTableAdmit(&table, 0, &frame, now, &release);
+
+            if (verdict == RATE_SHAPE)
+            {
+                second.shaped += isHeadShaped ? 0U : 1U;
+                isHeadShaped = true;
+                heldUntil = releaseAt(now, release);
+                break;
+            }
+
+            if (verdict == RATE_PASS)
+            {
+                const uint64_t duration = busTime(frame);
+
+                second.sent[frame.reserved]++;
+                second.busyNs += duration;
+                busFree = now + duration;
+            }
+            else
+            {
+                second.dropped++;
+            }
+            isHeadShaped = false;
+            queue.pop_front();
+        }
+
+        now = std::min({nextArrival, std::max({busFree, heldUntil, now + 1U}), binEnd});
+
+        if (now == binEnd)
+        {
+            std::printf("  %3llu", static_cast<unsigned long long>(binEnd / kNsPerS));
+            for (uint64_t sent : second.sent)
+            {
+                std::printf(" %9llu", static_cast<unsigned long long>(sent));
+            }
+            std::printf("  %6.2f%% %8llu %8llu\n", 100.0 * second.busyNs / kNsPerS,
+                        static_cast<unsigned long long>(second.shaped),
+                        static_cast<unsigned long long>(second.dropped));
+
+            /* The first second fills the buckets' bursts. */
+            if (binEnd > kNsPerS)
+            {
+                addCounts(steady, second);
+            }
+            second = Counts{std::vector<uint64_t>(scenario.sources.size()), 0, 0, 0, 0};
+            binEnd += kNsPerS;
+        }
+    }
+
+    /* Steady state against the configuration. */
+    const double span = static_cast<double>(seconds - 1U);
+    bool isPass = true;
+
+    std::printf("  after the first second, %llu frames turned away by the full queue:\n",
+                static_cast<unsigned long long>(steady.rejected));
+
+    for (size_t i = 0; i < scenario.sources.size(); i++)
+    {
+        const Source &source = scenario.sources[i];
+        const double fps = static_cast<double>(steady.sent[i]) / span;
+
+        if (source.limit > 0.0)
+        {
+            const double error = fps / source.limit - 1.0;
+
+            isPass &= std::fabs(error) <= kTolerance;
+            std::printf("    %-9s %8.1f fps, limit %6.0f, %+6.2f%%\n", source.name, fps, source.limit, 100.0 * error);
+        }
+        else
+        {
+            std::printf("    %-9s %8.1f fps, unlimited\n", source.name, fps);
+        }
+    }
+
+    if (scenario.busload.permille != 0)
+    {
+        const double load = static_cast<double>(steady.busyNs) / (span * kNsPerS);
+        const double cap = scenario.busload.permille / 1000.0;
+        const double error = load / cap - 1.0;
+
+        isPass &= std::fabs(error) <= kTolerance;
+        std::printf("    busload   %7.2f%%, cap %5.1f%%,    %+6.2f%%\n", 100.0 * load, 100.0 * cap, 100.0 * error);
+    }
+
+    std::printf("  %s\n\n", isPass ? "within limits" : "OFF LIMITS");
+
+    return isPass;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const unsigned seconds = (argc > 1) ? std::max(2, std::atoi(argv[1])) : 20U;
+    const unsigned seed = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 1U;
+
+    /* Identifier limits that drop and a busload cap that shapes. The caps */
+    /* add up to about the busload cap, with unlimited traffic on top.     */
+    const Scenario mixed{
+        "per identifier limits, dropping, under a 50% busload cap, shaping",
+        {
+            {"0x100", 0x100U, 1U, 0U, 8U, 4U, 200.0},
+            {"0x2xx", 0x200U, 0x100U, 0U, 8U, 8U, 800.0},
+            {"0x18DAxx", 0x18DA0000U, 0x10000U, CAN_FLAG_EXT, 8U, 4U, 300.0},
+            {"0x7DF", 0x7DFU, 1U, 0U, 8U, 1U, 0.0},
+            {"0x400 FD", 0x400U, 1U, CAN_FLAG_FD | CAN_FLAG_BRS, 64U, 1U, 0.0},
+        },
+        {
+            {0x100U, 0x100U, 200U, 4U, 0U, RATE_FLAG_DROP},
+            {0x200U, 0x2FFU, 800U, 16U, 0U, RATE_FLAG_DROP},
+            {0x18DA0000U, 0x18DAFFFFU, 300U, 8U, 0U, RATE_FLAG_EXT | RATE_FLAG_DROP},
+        },
+        {kBitrate, kDataBitrate, 500U, 10U, 0U, 0U},
+    };
+
+    /* One identifier shaped to its limit: nothing is dropped, the host */
+    /* is held back by the full queue instead.                          */
+    const Scenario shaped{
+        "one identifier limit, shaping",
+        {
+            {"0x123", 0x123U, 1U, 0U, 8U, 1U, 250.0},
+        },
+        {
+            {0x123U, 0x123U, 250U, 8U, 0U, 0U},
+        },
+        {kBitrate, kDataBitrate, 0U, 0U, 0U, 0U},
+    };
+
+    bool isPass = run(mixed, seconds, seed);
+    isPass &= run(shaped, seconds, seed);
+
+    return isPass ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#ifndef RECORD_STREAM_HPP
+#define RECORD_STREAM_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "protocol.h"
+
+namespace canaan
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* A record as defined in protocol.h, pointing into the scanned buffer. */
+struct Record
+{
+    uint8_t type;
+    uint8_t len;
+    const uint8_t *payload;
+    size_t offset; /* Offset of the sync byte. */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Function                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* CRC-8 (poly 0x07) lookup table, same polynomial as protoCrc8(). */
+constexpr std::array<uint8_t, 256> makeCrc8Table()
+{
+    std::array<uint8_t, 256> table{};
+
+    for (unsigned i = 0; i < 256; i++)
+    {
+        uint8_t crc = static_cast<uint8_t>(i);
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80U) ? static_cast<uint8_t>((crc << 1) ^ 0x07U) : static_cast<uint8_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> kCrc8Table = makeCrc8Table();
+
+inline uint8_t crc8(uint8_t crc, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = kCrc8Table[crc ^ data[i]];
+    }
+
+    return crc;
+}
+
+/* Calls fn(const Record &) for every intact record in [data, data + size). */
+/* Corrupt records are skipped by resynchronising on the next sync byte.    */
+/* Returns the offset of the first byte not consumed (a truncated tail).    */
+template <typename Fn>
+size_t forEachRecord(const uint8_t *data, size_t size, Fn &&fn, size_t *crcErrors = nullptr)
+{
+    size_t pos = 0;
+
+    while (pos + PROTO_HEADER_SIZE + PROTO_TRAILER_SIZE <= size)
+    {
+        if (data[pos] != PROTO_SYNC)
+        {
+            pos++;
+            continue;
+        }
+
+        const uint8_t len = data[pos + 2];
+        const size_t total = PROTO_HEADER_SIZE + len + PROTO_TRAILER_SIZE;
+
+        if (pos + total > size)
+        {
+            break;
+        }
+
+        if (crc8(0, &data[pos + 1], 2U + len) != data[pos + total - 1])
+        {
+            if (crcErrors != nullptr)
+            {
+                (*crcErrors)++;
+            }
+            pos++;
+            continue;
+        }
+
+        fn(Record{data[pos + 1], len, &data[pos + PROTO_HEADER_SIZE], pos});
+        pos += total;
+    }
+
+    return pos;
+}
+
+} /* namespace canaan */
+
+#endif /* RECORD_STREAM_HPP */
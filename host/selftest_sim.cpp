@@ -0,0 +1,379 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+extern "C"
+{
+#include "traffic_gen.h"
+#include "protocol.h"
+}
+
+/* Runs the self-test traffic generator of traffic_gen.c against a       */
+/* simulated transmit queue and bus looped back to its checker, and      */
+/* prints the report the device would send for each scenario.            */
+/*                                                                       */
+/*     selftest_sim [seconds] [seed]                                     */
+/*                                                                       */
+/* Frames are generated as self_test.c does it, on 1 ms ticks into a     */
+/* 16 deep queue, and come back when the bus is done with them. One      */
+/* scenario loses, swaps, duplicates and corrupts frames on the way, and */
+/* has the TX path refuse some, which must be offered again.             */
+/* Exits with 1 when the achieved busload is more than 3% off the        */
+/* offered one, or the report does not count the faults put in.          */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr uint64_t kNsPerUs = 1000ULL;
+constexpr uint64_t kNsPerMs = 1000000ULL;
+constexpr uint64_t kTickNs = kNsPerMs;
+
+/* 500 kbit/s nominal, 2 Mbit/s data phase. */
+constexpr uint32_t kBitrate = 500000U;
+constexpr uint32_t kDataBitrate = 2000000U;
+
+/* The channel's TX queue and the wait for the last frames. */
+constexpr size_t kQueueLen = 16U;
+constexpr uint64_t kDrainNs = 100U * kNsPerMs;
+
+/* Faults, by position of a frame on the bus in every kFaultPeriod. */
+constexpr uint32_t kFaultPeriod = 1000U;
+constexpr uint32_t kFaultLose = 100U;
+constexpr uint32_t kFaultSwap = 400U; /* With the next frame. */
+constexpr uint32_t kFaultDuplicate = 700U;
+constexpr uint32_t kFaultCorrupt = 900U;
+
+/* The TX path refuses a frame, by position in every kFaultPeriod sends. */
+constexpr uint32_t kFaultRefuse = 500U;
+
+/* Allowed deviation of the achieved busload from the offered one. */
+constexpr double kTolerance = 0.03;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Scenario
+{
+    const char *name;
+    TrafficConfig_t config;
+    bool isFaulty;
+};
+
+struct Faults
+{
+    uint32_t lost;
+    uint32_t swapped;
+    uint32_t duplicated;
+    uint32_t corrupted;
+    uint32_t refused;
+};
+
+/* The report as PROTO_REC_SELFTEST carries it. */
+struct Report
+{
+    uint8_t state;
+    uint32_t elapsedMs;
+    uint32_t generated;
+    uint32_t queued;
+    uint32_t txFull;
+    uint32_t txFailed;
+    uint32_t received;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t duplicates;
+    uint32_t corrupt;
+    uint16_t offered;
+    uint16_t achieved;
+    uint32_t latMin;
+    uint32_t latMean;
+    uint32_t latP50;
+    uint32_t latP99;
+    uint32_t latMax;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+Report decodeReport(const uint8_t *wire)
+{
+    Report report;
+
+    report.state = wire[0];
+    report.elapsedMs = protoGetU32(&wire[4]);
+    report.generated = protoGetU32(&wire[8]);
+    report.queued = protoGetU32(&wire[12]);
+    report.txFull = protoGetU32(&wire[16]);
+    report.received = protoGetU32(&wire[20]);
+    report.lost = protoGetU32(&wire[24]);
+    report.reordered = protoGetU32(&wire[28]);
+    report.duplicates = protoGetU32(&wire[32]);
+    report.corrupt = protoGetU32(&wire[36]);
+    report.offered = protoGetU16(&wire[40]);
+    report.achieved = protoGetU16(&wire[42]);
+    report.latMin = protoGetU32(&wire[44]);
+    report.latMean = protoGetU32(&wire[48]);
+    report.latP50 = protoGetU32(&wire[52]);
+    report.latP99 = protoGetU32(&wire[56]);
+    report.latMax = protoGetU32(&wire[60]);
+    report.txFailed = protoGetU32(&wire[64]);
+
+    return report;
+}
+
+bool run(const Scenario &scenario, unsigned seconds, unsigned seed)
+{
+    static TrafficGen_t gen;
+    static TrafficCheck_t check;
+    TrafficRun_t state{};
+    TrafficConfig_t config{};
+    uint8_t wire[TRAFFIC_CONFIG_WIRE_SIZE];
+    uint8_t report[TRAFFIC_REPORT_SIZE];
+    std::deque<CanFrame_t> queue;
+    std::vector<CanFrame_t> arrived;
+    Faults faults{};
+
+    /* Through the wire, as PROTO_CMD_SELFTEST_START takes it. */
+    TrafficConfig_t request = scenario.config;
+    request.durationMs = seconds * 1000U;
+    request.seed = seed;
+    trafficEncodeConfig(&request, wire);
+    if (!trafficDecodeConfig(wire, &config))
+    {
+        std::printf("%s\n  configuration rejected\n\n", scenario.name);
+        return false;
+    }
+
+    trafficInit(&gen, &config);
+    trafficCheckInit(&check);
+
+    CanFrame_t next{};
+    uint64_t nextDue = trafficNext(&gen, &next);
+    const uint64_t end = config.durationMs * kNsPerMs;
+    uint64_t drainEnd = 0;
+    uint64_t busFree = 0;
+    uint64_t onBus = 0;
+    uint64_t attempts = 0;
+    uint64_t tick = 0;
+    uint64_t now = 0;
+    bool isSwapHeld = false;
+    CanFrame_t held{};
+
+    state.state = TRAFFIC_STATE_RUNNING;
+
+    while (state.state != TRAFFIC_STATE_DONE)
+    {
+        /* Task: wakes on the tick and queues the frames due by then. */
+        if (now >= tick)
+        {
+            if (state.state == TRAFFIC_STATE_RUNNING)
+            {
+                state.elapsedMs = static_cast<uint32_t>(tick / kNsPerMs);
+                if (tick >= end)
+                {
+                    drainEnd = tick + kDrainNs;
+                    state.state = TRAFFIC_STATE_DRAINING;
+                }
+                else
+                {
+                    while (nextDue <= tick)
+                    {
+                        if (queue.size() >= kQueueLen)
+                        {
+                            state.txFull++;
+                            break;
+                        }
+
+                        next.timestamp = static_cast<uint32_t>(tick / kNsPerUs);
+                        if (scenario.isFaulty && (attempts++ % kFaultPeriod == kFaultRefuse))
+                        {
+                            state.txFailed++;
+                            faults.refused++;
+                            break;
+                        }
+                        queue.push_back(next);
+                        trafficCheckSent(&check, &next, next.timestamp);
+                        state.queued++;
+                        nextDue = trafficNext(&gen, &next);
+                    }
+                }
+            }
+            else if (tick >= drainEnd)
+            {
+                state.state = TRAFFIC_STATE_DONE;
+                break;
+            }
+            tick += kTickNs;
+        }
+
+        /* Bus: one frame at a time, back to the checker as it ends. */
+        if ((now >= busFree) && !queue.empty())
+        {
+            CanFrame_t frame = queue.front();
+            const uint32_t position = static_cast<uint32_t>(onBus++ % kFaultPeriod);
+
+            queue.pop_front();
+            busFree = now + trafficFrameNs(&config, &frame);
+            frame.channel = config.rxChannel;
+            frame.timestamp = static_cast<uint32_t>(busFree / kNsPerUs);
+            arrived.clear();
+
+            if (!scenario.isFaulty)
+            {
+                arrived.push_back(frame);
+            }
+            else if (position == kFaultLose)
+            {
+                faults.lost++;
+            }
+            else if (position == kFaultSwap)
+            {
+                held = frame;
+                isSwapHeld = true;
+            }
+            else if (position == kFaultDuplicate)
+            {
+                arrived.push_back(frame);
+                arrived.push_back(frame);
+                faults.duplicated++;
+            }
+            else if ((position == kFaultCorrupt) && (frame.len > TRAFFIC_SEQ_SIZE))
+            {
+                frame.data[frame.len - 1U] ^= 0x10U;
+                arrived.push_back(frame);
+                faults.corrupted++;
+            }
+            else
+            {
+                arrived.push_back(frame);
+                if (isSwapHeld)
+                {
+                    held.timestamp = frame.timestamp;
+                    arrived.push_back(held);
+                    isSwapHeld = false;
+                    faults.swapped++;
+                }
+            }
+
+            for (const CanFrame_t &back : arrived)
+            {
+                if (trafficMatches(&config, &back))
+                {
+                    trafficCheckReceived(&check, &config, &back);
+                }
+            }
+        }
+
+        now = queue.empty() ? tick : std::max(now + 1U, std::min(tick, busFree));
+    }
+
+    trafficReport(&gen, &check, &state, report);
+    const Report result = decodeReport(report);
+
+    std::printf("%s\n", scenario.name);
+    std::printf("  %u ms, %u generated, %u queued, %u turned away by the full queue, %u refused\n",
+                result.elapsedMs, result.generated, result.queued, result.txFull, result.txFailed);
+    std::printf("  %u received, %u lost, %u reordered, %u duplicates, %u corrupt\n", result.received, result.lost,
+                result.reordered, result.duplicates, result.corrupt);
+    std::printf("  latency us: min %u, mean %u, p50 %u, p99 %u, max %u\n", result.latMin, result.latMean,
+                result.latP50, result.latP99, result.latMax);
+
+    const double error = static_cast<double>(result.achieved) / result.offered - 1.0;
+    bool isPass = (result.state == TRAFFIC_STATE_DONE) && (std::fabs(error) <= kTolerance);
+
+    std::printf("  busload %5.1f%%, offered %5.1f%%, %+6.2f%%\n", result.achieved / 10.0, result.offered / 10.0,
+                100.0 * error);
+
+    /* A corrupt frame does not count as received, so it is lost too. */
+    if (scenario.isFaulty)
+    {
+        const bool isCounted = (result.lost == faults.lost + faults.corrupted) &&
+                               (result.reordered == faults.swapped) &&
+                               (result.duplicates == faults.duplicated) && (result.corrupt == faults.corrupted) &&
+                               (result.txFailed == faults.refused);
+
+        std::printf("  put in: %u lost, %u swapped, %u duplicated, %u corrupted, %u refused, %s\n", faults.lost,
+                    faults.swapped, faults.duplicated, faults.corrupted, faults.refused,
+                    isCounted ? "all counted" : "MISCOUNTED");
+        isPass &= isCounted;
+    }
+    else
+    {
+        isPass &= (result.lost == 0) && (result.reordered == 0) && (result.duplicates == 0) &&
+                  (result.corrupt == 0) && (result.txFailed == 0) && (result.received == result.queued);
+    }
+
+    std::printf("  %s\n\n", isPass ? "pass" : "FAIL");
+
+    return isPass;
+}
+
+TrafficConfig_t makeConfig(uint8_t flags, uint8_t idMode, uint8_t pattern, uint8_t shape, uint8_t lenMin,
+                           uint8_t lenMax, uint16_t permille, uint16_t burstLen, uint32_t idFirst, uint32_t idLast)
+{
+    TrafficConfig_t config{};
+
+    config.bitrate = kBitrate;
+    config.dataBitrate = kDataBitrate;
+    config.idFirst = idFirst;
+    config.idLast = idLast;
+    config.permille = permille;
+    config.burstLen = burstLen;
+    config.target = TRAFFIC_TARGET_LOOPBACK;
+    config.flags = flags;
+    config.idMode = idMode;
+    config.pattern = pattern;
+    config.shape = shape;
+    config.lenMin = lenMin;
+    config.lenMax = lenMax;
+
+    return config;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const unsigned seconds = (argc > 1) ? std::max(1, std::atoi(argv[1])) : 5U;
+    const unsigned seed = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 1U;
+
+    const std::vector<Scenario> scenarios{
+        {"even, classic 8 bytes, identifier sweep, 30%",
+         makeConfig(0U, TRAFFIC_ID_SWEEP, TRAFFIC_PAT_COUNT, TRAFFIC_SHAPE_EVEN, 8U, 8U, 300U, 0U, 0x100U, 0x1FFU),
+         false},
+        {"bursts of 12, classic 2 to 8 bytes, uniform extended identifiers, 60%",
+         makeConfig(CAN_FLAG_EXT, TRAFFIC_ID_UNIFORM, TRAFFIC_PAT_RANDOM, TRAFFIC_SHAPE_BURST, 2U, 8U, 600U, 12U,
+                    0x18DA0000U, 0x18DAFFFFU),
+         false},
+        {"Poisson, FD with BRS 8 to 64 bytes, skewed identifiers, 50%",
+         makeConfig(CAN_FLAG_FD | CAN_FLAG_BRS, TRAFFIC_ID_SKEWED, TRAFFIC_PAT_WALK, TRAFFIC_SHAPE_POISSON, 8U, 64U,
+                    500U, 0U, 0x000U, 0x7FFU),
+         false},
+        {"even, classic 8 bytes of 0x55 0xAA, fixed identifier, 90%",
+         makeConfig(0U, TRAFFIC_ID_FIXED, TRAFFIC_PAT_ALT, TRAFFIC_SHAPE_EVEN, 8U, 8U, 900U, 0U, 0x123U, 0x123U),
+         false},
+        {"even, classic 8 bytes, 80%, with lost, swapped, duplicated and corrupted frames",
+         makeConfig(0U, TRAFFIC_ID_SWEEP, TRAFFIC_PAT_COUNT, TRAFFIC_SHAPE_EVEN, 8U, 8U, 800U, 0U, 0x100U, 0x1FFU),
+         true},
+    };
+
+    bool isPass = true;
+
+    for (const Scenario &scenario : scenarios)
+    {
+        isPass &= run(scenario, seconds, seed);
+    }
+
+    return isPass ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "can_signal.h"
+#include "protocol.h"
+}
+
+#include "bench_traffic.hpp"
+
+/* Replays the frames of a capture, or of synthetic vehicle traffic, */
+/* through the raw and the signal mode encoders of the bridge, and    */
+/* prints the USB bytes per second and the host time per frame of    */
+/* each.                                                             */
+/*                                                                   */
+/*     signal_bench [capture.bin|-] [seconds]                        */
+/*                                                                   */
+/* The signal table has, for each of the first identifiers seen, the */
+/* 16-bit value at bit 0 and the status byte at bit 24 of the        */
+/* synthetic traffic, and the byte at bit 64 of FD frames, up to     */
+/* SIGNAL_MAX_SIGNALS. It runs with no deadband and with one on the  */
+/* 16-bit value. The host side copy of every signal is checked       */
+/* against the frames after each one: exits with 1 when a change was */
+/* not reported, or a value moved past its deadband unseen.          */
+/*                                                                   */
+/* On the device, STAT_PROCESS_CYCLES over STAT_PROCESS_TIMED gives  */
+/* the same cost per frame in core cycles.                           */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* PROTO_REC_FRAME payload before the data. */
+constexpr size_t kFrameHeader = 11U;
+
+/* Signal updates per PROTO_REC_SIGNAL record, as in bridge.c. */
+constexpr uint32_t kSignalsPerRecord = (PROTO_MAX_PAYLOAD - 4U) / SIGNAL_UPDATE_WIRE_SIZE;
+
+/* Full speed bulk: 19 packets of 64 bytes in every 1 ms frame. */
+constexpr double kUsbFullSpeedBytesPerS = 19.0 * 64.0 * 1000.0;
+
+/* Deadband of the 16-bit value in the second signal mode run. */
+constexpr uint32_t kValueDeadband = 8U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Result
+{
+    uint64_t bytes;
+    uint64_t records;
+    double nsPerFrame;
+    bool isExact;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+SignalDef_t makeDef(const CanFrame_t &frame, uint16_t startBit, uint8_t length, uint32_t deadband)
+{
+    SignalDef_t def{};
+
+    def.id = frame.id;
+    def.startBit = startBit;
+    def.length = length;
+    def.flags = static_cast<uint8_t>(((frame.flags & CAN_FLAG_EXT) ? SIGNAL_FLAG_EXT : 0U) |
+                                     ((frame.channel << SIGNAL_FLAG_CHANNEL_SHIFT) & SIGNAL_FLAG_CHANNEL_MASK));
+    def.deadband = deadband;
+
+    return def;
+}
+
+std::vector<SignalDef_t> makeTable(const std::vector<CanFrame_t> &frames, uint32_t valueDeadband)
+{
+    std::set<uint64_t> seen;
+    std::vector<SignalDef_t> defs;
+
+    for (const CanFrame_t &frame : frames)
+    {
+        const uint64_t key = (static_cast<uint64_t>(frame.channel) << 33) |
+                             (static_cast<uint64_t>(frame.flags & CAN_FLAG_EXT) << 32) | frame.id;
+        const size_t count = (frame.len > 8U) ? 3U : 2U;
+
+        if ((frame.len < 8U) || (seen.count(key) != 0) || (seen.size() >= SIGNAL_MAX_MESSAGES) ||
+            (defs.size() + count > SIGNAL_MAX_SIGNALS))
+        {
+            continue;
+        }
+        seen.insert(key);
+
+        defs.push_back(makeDef(frame, 0U, 16U, valueDeadband));
+        defs.push_back(makeDef(frame, 24U, 8U, 0U));
+        if (count > 2U)
+        {
+            defs.push_back(makeDef(frame, 64U, 8U, 0U));
+        }
+    }
+
+    return defs;
+}
+
+/* Little-endian value of a definition, as the host decodes it. */
+uint32_t extract(const SignalDef_t &def, const CanFrame_t &frame)
+{
+    uint32_t value = 0;
+
+    for (uint8_t bit = 0; bit < def.length; bit++)
+    {
+        const uint32_t at = def.startBit + bit;
+
+        value |= static_cast<uint32_t>((frame.data[at / 8U] >> (at % 8U)) & 1U) << bit;
+    }
+
+    return value;
+}
+
+bool matches(const SignalDef_t &def, const CanFrame_t &frame)
+{
+    return (def.id == frame.id) && (((def.flags & SIGNAL_FLAG_EXT) != 0) == ((frame.flags & CAN_FLAG_EXT) != 0)) &&
+           (((def.flags & SIGNAL_FLAG_CHANNEL_MASK) >> SIGNAL_FLAG_CHANNEL_SHIFT) == frame.channel) &&
+           (def.startBit / 8U + (def.length + 7U) / 8U <= frame.len);
+}
+
+Result runRaw(const std::vector<CanFrame_t> &frames)
+{
+    using Clock = std::chrono::steady_clock;
+    static uint8_t out[PROTO_MAX_RECORD];
+    uint8_t payload[kFrameHeader + CAN_FRAME_MAX_LEN];
+    Result result{0, 0, 0.0, true};
+
+    const auto start = Clock::now();
+    for (const CanFrame_t &frame : frames)
+    {
+        protoPutU32(&payload[0], frame.timestamp);
+        protoPutU32(&payload[4], frame.id);
+        payload[8] = frame.channel;
+        payload[9] = frame.flags;
+        payload[10] = frame.len;
+        std::memcpy(&payload[kFrameHeader], frame.data, frame.len);
+
+        result.bytes += protoEncode(PROTO_REC_FRAME, payload, static_cast<uint8_t>(kFrameHeader + frame.len), out,
+                                    sizeof(out));
+        result.records++;
+    }
+    const auto end = Clock::now();
+
+    result.nsPerFrame = std::chrono::duration<double, std::nano>(end - start).count() / frames.size();
+
+    return result;
+}
+
+/* Encodes as bridge.c does in BRIDGE_MODE_SIGNAL, then replays the */
+/* records into a host side copy of the signals to check them.      */
+Result runSignals(const std::vector<CanFrame_t> &frames, const std::vector<SignalDef_t> &defs)
+{
+    using Clock = std::chrono::steady_clock;
+    static SignalUpdate_t updates[SIGNAL_MAX_SIGNALS];
+    static uint8_t payload[PROTO_MAX_PAYLOAD];
+    static uint8_t out[PROTO_MAX_RECORD];
+    std::vector<std::vector<uint8_t>> records;
+    Result result{0, 0, 0.0, true};
+
+    signalInit();
+    signalTableClear();
+    for (const SignalDef_t &def : defs)
+    {
+        (void)signalTableAdd(&def);
+    }
+    (void)signalTableCommit();
+
+    const auto start = Clock::now();
+    for (const CanFrame_t &frame : frames)
+    {
+        const uint32_t count = signalProcess(&frame, updates, SIGNAL_MAX_SIGNALS);
+
+        for (uint32_t i = 0; i < count; i += kSignalsPerRecord)
+        {
+            const uint32_t n = std::min(count - i, kSignalsPerRecord);
+            uint32_t pos = 4;
+
+            protoPutU32(&payload[0], frame.timestamp);
+            for (uint32_t j = 0; j < n; j++)
+            {
+                protoPutU16(&payload[pos], updates[i + j].index);
+                protoPutU32(&payload[pos + 2], updates[i + j].value);
+                pos += SIGNAL_UPDATE_WIRE_SIZE;
+            }
+
+            const uint32_t size = protoEncode(PROTO_REC_SIGNAL, payload, static_cast<uint8_t>(pos), out, sizeof(out));
+            result.bytes += size;
+            result.records++;
+            records.emplace_back(out, out + size);
+        }
+
+        /* Marks the end of the frame's records for the check. */
+        records.emplace_back();
+    }
+    const auto end = Clock::now();
+
+    result.nsPerFrame = std::chrono::duration<double, std::nano>(end - start).count() / frames.size();
+
+    /* Host side: apply the updates, then compare with the frame. */
+    std::vector<uint32_t> values(defs.size());
+    std::vector<bool> isKnown(defs.size());
+    size_t next = 0;
+
+    for (const CanFrame_t &frame : frames)
+    {
+        for (; !records[next].empty(); next++)
+        {
+            canaan::forEachRecord(records[next].data(), records[next].size(), [&](const canaan::Record &rec) {
+                for (uint32_t pos = 4; pos + SIGNAL_UPDATE_WIRE_SIZE <= rec.len; pos += SIGNAL_UPDATE_WIRE_SIZE)
+                {
+                    const uint16_t index = protoGetU16(&rec.payload[pos]);
+
+                    values[index] = protoGetU32(&rec.payload[pos + 2]);
+                    isKnown[index] = true;
+                }
+            });
+        }
+        next++;
+
+        for (size_t i = 0; i < defs.size(); i++)
+        {
+            if (!matches(defs[i], frame))
+            {
+                continue;
+            }
+
+            const uint32_t actual = extract(defs[i], frame);
+            const uint32_t delta = (actual > values[i]) ? (actual - values[i]) : (values[i] - actual);
+
+            result.isExact &= isKnown[i] && (delta <= defs[i].deadband);
+        }
+    }
+
+    return result;
+}
+
+void print(const char *name, const Result &result, double frames, double seconds, const Result &raw)
+{
+    const double bytesPerS = result.bytes / seconds;
+
+    std::printf("  %-22s %10llu bytes  %7.2f per frame  %9.0f bytes/s  %5.1f%% of full speed  %4.0f ns per frame",
+                name, static_cast<unsigned long long>(result.bytes), result.bytes / frames, bytesPerS,
+                100.0 * bytesPerS / kUsbFullSpeedBytesPerS, result.nsPerFrame);
+    if (&result != &raw)
+    {
+        std::printf("  %.1fx less", static_cast<double>(raw.bytes) / std::max<uint64_t>(result.bytes, 1U));
+    }
+    std::printf("\n");
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const std::string source = (argc > 1) ? argv[1] : "-";
+    const unsigned seconds = (argc > 2) ? static_cast<unsigned>(std::max(1, std::atoi(argv[2]))) : 60U;
+    std::vector<CanFrame_t> frames;
+
+    if (source == "-")
+    {
+        frames = canaan::makeTraffic(seconds);
+    }
+    else if (!canaan::readCapture(source.c_str(), frames))
+    {
+        std::cerr << "cannot open " << source << "\n";
+        return 1;
+    }
+
+    if (frames.size() < 2U)
+    {
+        std::cerr << "no frames\n";
+        return 1;
+    }
+
+    /* Trace time, across timer wraps. */
+    int64_t spanUs = 0;
+    for (size_t i = 1; i < frames.size(); i++)
+    {
+        spanUs += static_cast<int32_t>(frames[i].timestamp - frames[i - 1].timestamp);
+    }
+
+    const std::vector<SignalDef_t> exact = makeTable(frames, 0U);
+    const std::vector<SignalDef_t> banded = makeTable(frames, kValueDeadband);
+    const double n = static_cast<double>(frames.size());
+    const double span = std::max<int64_t>(spanUs, 1) / 1e6;
+
+    const Result raw = runRaw(frames);
+    const Result changed = runSignals(frames, exact);
+    const Result deadband = runSignals(frames, banded);
+
+    std::printf("%zu frames over %.1f s, %zu signals\n", frames.size(), span, exact.size());
+    print("raw", raw, n, span, raw);
+    print("signals, on change", changed, n, span, raw);
+    print("signals, deadband 8", deadband, n, span, raw);
+    std::printf("  host copy of the signals: %s\n", (changed.isExact && deadband.isExact) ? "exact" : "WRONG");
+
+    return (changed.isExact && deadband.isExact) ? 0 : 1;
+}
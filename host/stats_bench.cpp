@@ -0,0 +1,178 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C"
+{
+#include "stats.h"
+}
+
+#include "target.hpp"
+
+/* Measures statsAdd() and statsSnapshot() of stats.c on the host, with  */
+/* a thread standing in for each core through the target model.          */
+/*                                                                       */
+/*     stats_bench [increments]                                          */
+/*                                                                       */
+/* Prints the time and TSC cycles per increment on one core, then with   */
+/* both cores incrementing while a third thread takes snapshots, and     */
+/* the time per snapshot. Exits with 1 when a snapshot went backwards,   */
+/* mixes counters read at different times, or the final counts are not   */
+/* the number of increments made.                                        */
+/*                                                                       */
+/* The masking is the model's here, not the M0+'s CPSID/CPSIE, so the    */
+/* figures rank changes to stats.h rather than predict device cycles.    */
+
+namespace
+{
+
+namespace target = canaan::target;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Result
+{
+    double nsPerAdd;
+    double cyclesPerAdd;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* Counts on a core: a frame counter and a per-channel one, as the */
+/* receive path does.                                              */
+Result addMany(unsigned core, uint64_t count)
+{
+    using Clock = std::chrono::steady_clock;
+
+    target::setCore(core);
+
+    const auto start = Clock::now();
+    const uint64_t startCycles = cycles();
+    for (uint64_t i = 0; i < count; i++)
+    {
+        statsInc(STAT_FRAMES_IN);
+        statsAdd(STAT_CH(core % CAN_CHANNEL_NUM, STAT_CH_RX_FRAMES), 2U);
+    }
+    const uint64_t endCycles = cycles();
+    const auto end = Clock::now();
+
+    return {std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * count),
+            static_cast<double>(endCycles - startCycles) / (2.0 * count)};
+}
+
+/* Each core adds 2 to its channel counter right after counting a    */
+/* frame, so a slot copied whole is at most one frame apart on each. */
+bool isConsistent(const StatsSnapshot_t &snapshot)
+{
+    uint64_t channel = 0;
+
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        channel += snapshot.counter[STAT_CH(ch, STAT_CH_RX_FRAMES)];
+    }
+
+    return (channel / 2U <= snapshot.counter[STAT_FRAMES_IN]) &&
+           (snapshot.counter[STAT_FRAMES_IN] - channel / 2U <= STATS_CORE_NUM);
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    using Clock = std::chrono::steady_clock;
+    const uint64_t count = (argc > 1) ? static_cast<uint64_t>(std::max(1, std::atoi(argv[1]))) : 20000000U;
+    static StatsSnapshot_t snapshot;
+    bool isOk = true;
+
+    /* One core. */
+    statsInit();
+    const Result single = addMany(0, count);
+
+    statsSnapshot(&snapshot);
+    isOk &= (snapshot.counter[STAT_FRAMES_IN] == count) &&
+            (snapshot.counter[STAT_CH(0, STAT_CH_RX_FRAMES)] == 2U * count);
+
+    /* Both cores, and a reader taking snapshots meanwhile. */
+    std::atomic<bool> isRunning{true};
+    uint64_t snapshots = 0;
+    double snapshotNs = 0.0;
+    Result dual[STATS_CORE_NUM];
+
+    statsInit();
+    std::thread reader([&] {
+        static StatsSnapshot_t last;
+
+        target::setCore(1);
+        while (isRunning.load(std::memory_order_relaxed))
+        {
+            const auto start = Clock::now();
+            statsSnapshot(&snapshot);
+            snapshotNs += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            snapshots++;
+
+            for (uint32_t id = 0; id < STAT_NUM; id++)
+            {
+                isOk &= snapshot.counter[id] >= last.counter[id];
+            }
+            isOk &= isConsistent(snapshot);
+            last = snapshot;
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (unsigned core = 0; core < STATS_CORE_NUM; core++)
+    {
+        writers.emplace_back([&dual, core, count] { dual[core] = addMany(core, count); });
+    }
+    for (std::thread &writer : writers)
+    {
+        writer.join();
+    }
+    isRunning = false;
+    reader.join();
+
+    statsSnapshot(&snapshot);
+    isOk &= snapshot.counter[STAT_FRAMES_IN] == STATS_CORE_NUM * count;
+    for (unsigned core = 0; core < STATS_CORE_NUM; core++)
+    {
+        isOk &= snapshot.counter[STAT_CH(core % CAN_CHANNEL_NUM, STAT_CH_RX_FRAMES)] == 2U * count;
+    }
+
+    std::printf("%llu increments per core, %u counters\n", static_cast<unsigned long long>(count),
+                static_cast<unsigned>(STAT_NUM));
+    std::printf("  one core         %6.2f ns %6.1f cycles per increment\n", single.nsPerAdd, single.cyclesPerAdd);
+    for (unsigned core = 0; core < STATS_CORE_NUM; core++)
+    {
+        std::printf("  both cores, %u    %6.2f ns %6.1f cycles per increment\n", core, dual[core].nsPerAdd,
+                    dual[core].cyclesPerAdd);
+    }
+    std::printf("  snapshot         %6.0f ns, %llu taken meanwhile\n", snapshotNs / std::max<uint64_t>(snapshots, 1U),
+                static_cast<unsigned long long>(snapshots));
+    std::printf("  counts           %s\n", isOk ? "exact, monotonic and consistent" : "WRONG");
+
+    return isOk ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#ifndef TARGET_FREERTOS_H
+#define TARGET_FREERTOS_H
+
+/* Host stand-in for the FreeRTOS kernel. Tasks are host threads run one */
+/* at a time by target.cpp in simulated time; see target.hpp.           */
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define configTICK_RATE_HZ (1000U)
+#define configMINIMAL_STACK_SIZE (128U)
+#define configNUMBER_OF_CORES (2U)
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL (pdFALSE)
+#define pdPASS (pdTRUE)
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+
+#define portYIELD_FROM_ISR(isWoken) ((void)(isWoken))
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+/* A queue, or a semaphore as a queue of empty items. */
+typedef struct TargetQueue
+{
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+typedef StaticQueue_t *QueueHandle_t;
+typedef StaticQueue_t *SemaphoreHandle_t;
+
+typedef struct TargetTask *TaskHandle_t;
+
+/* The task itself lives on the host side. */
+typedef struct
+{
+    TaskHandle_t handle;
+} StaticTask_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_FREERTOS_H */
@@ -0,0 +1,139 @@
+#ifndef TARGET_HARDWARE_DMA_H
+#define TARGET_HARDWARE_DMA_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define NUM_DMA_CHANNELS (12U)
+
+/* CTRL register fields, as on the RP2040. */
+#define DMA_CH0_CTRL_TRIG_EN_BITS (0x00000001UL)
+#define DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB (2U)
+#define DMA_CH0_CTRL_TRIG_DATA_SIZE_BITS (0x0000000CUL)
+#define DMA_CH0_CTRL_TRIG_INCR_READ_BITS (0x00000010UL)
+#define DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS (0x00000020UL)
+#define DMA_CH0_CTRL_TRIG_RING_SIZE_LSB (6U)
+#define DMA_CH0_CTRL_TRIG_RING_SIZE_BITS (0x000003C0UL)
+#define DMA_CH0_CTRL_TRIG_RING_SEL_BITS (0x00000400UL)
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB (11U)
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS (0x00007800UL)
+#define DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB (15U)
+#define DMA_CH0_CTRL_TRIG_TREQ_SEL_BITS (0x001F8000UL)
+#define DMA_CH0_CTRL_TRIG_BUSY_BITS (0x01000000UL)
+
+/* Transfer requests. */
+#define DREQ_SPI0_TX (16U)
+#define DREQ_SPI0_RX (17U)
+#define DREQ_SPI1_TX (18U)
+#define DREQ_SPI1_RX (19U)
+#define DREQ_UART0_TX (20U)
+#define DREQ_UART0_RX (21U)
+#define DREQ_UART1_TX (22U)
+#define DREQ_UART1_RX (23U)
+#define DREQ_FORCE (0x3FU)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+enum dma_channel_transfer_size
+{
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct
+{
+    uint32_t ctrl;
+} dma_channel_config;
+
+/* Addresses are host pointers. TRANS_COUNT reads the live count; a */
+/* write through dma_channel_set_trans_count() sets the reload one.  */
+typedef struct
+{
+    volatile uintptr_t read_addr;
+    volatile uintptr_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+} dma_channel_hw_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+dma_channel_hw_t *dma_channel_hw_addr(unsigned int channel);
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config *config, volatile void *writeAddr,
+                           const volatile void *readAddr, unsigned int transferCount, bool trigger);
+void dma_channel_set_config(unsigned int channel, const dma_channel_config *config, bool trigger);
+void dma_channel_set_read_addr(unsigned int channel, const volatile void *readAddr, bool trigger);
+void dma_channel_set_write_addr(unsigned int channel, volatile void *writeAddr, bool trigger);
+void dma_channel_set_trans_count(unsigned int channel, uint32_t transferCount, bool trigger);
+void dma_start_channel_mask(uint32_t mask);
+void dma_channel_start(unsigned int channel);
+bool dma_channel_is_busy(unsigned int channel);
+
+void dma_channel_set_irq0_enabled(unsigned int channel, bool isEnabled);
+void dma_channel_set_irq1_enabled(unsigned int channel, bool isEnabled);
+bool dma_channel_get_irq0_status(unsigned int channel);
+bool dma_channel_get_irq1_status(unsigned int channel);
+void dma_channel_acknowledge_irq0(unsigned int channel);
+void dma_channel_acknowledge_irq1(unsigned int channel);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+    c->ctrl = incr ? (c->ctrl | DMA_CH0_CTRL_TRIG_INCR_READ_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_INCR_READ_BITS);
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+    c->ctrl = incr ? (c->ctrl | DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS);
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, unsigned int dreq)
+{
+    c->ctrl = (c->ctrl & ~DMA_CH0_CTRL_TRIG_TREQ_SEL_BITS) | ((uint32_t)dreq << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB);
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config *c, unsigned int channel)
+{
+    c->ctrl = (c->ctrl & ~DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS) | ((uint32_t)channel << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB);
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+    c->ctrl = (c->ctrl & ~DMA_CH0_CTRL_TRIG_DATA_SIZE_BITS) | ((uint32_t)size << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB);
+}
+
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, unsigned int sizeBits)
+{
+    c->ctrl = (c->ctrl & ~(DMA_CH0_CTRL_TRIG_RING_SIZE_BITS | DMA_CH0_CTRL_TRIG_RING_SEL_BITS)) |
+              ((uint32_t)sizeBits << DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) |
+              (write ? DMA_CH0_CTRL_TRIG_RING_SEL_BITS : 0U);
+}
+
+static inline void channel_config_set_enable(dma_channel_config *c, bool enable)
+{
+    c->ctrl = enable ? (c->ctrl | DMA_CH0_CTRL_TRIG_EN_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_EN_BITS);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_HARDWARE_DMA_H */
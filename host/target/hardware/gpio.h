@@ -0,0 +1,52 @@
+#ifndef TARGET_HARDWARE_GPIO_H
+#define TARGET_HARDWARE_GPIO_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define GPIO_IN (false)
+#define GPIO_OUT (true)
+
+#define GPIO_FUNC_SPI (1)
+#define GPIO_FUNC_UART (2)
+#define GPIO_FUNC_SIO (5)
+
+#define GPIO_IRQ_LEVEL_LOW (0x1U)
+#define GPIO_IRQ_LEVEL_HIGH (0x2U)
+#define GPIO_IRQ_EDGE_FALL (0x4U)
+#define GPIO_IRQ_EDGE_RISE (0x8U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef void (*gpio_irq_callback_t)(unsigned int gpio, uint32_t events);
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void gpio_init(unsigned int gpio);
+void gpio_set_function(unsigned int gpio, int fn);
+void gpio_set_dir(unsigned int gpio, bool isOut);
+void gpio_pull_up(unsigned int gpio);
+void gpio_put(unsigned int gpio, bool value);
+bool gpio_get(unsigned int gpio);
+void gpio_set_irq_enabled(unsigned int gpio, uint32_t events, bool isEnabled);
+void gpio_set_irq_enabled_with_callback(unsigned int gpio, uint32_t events, bool isEnabled,
+                                        gpio_irq_callback_t callback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_HARDWARE_GPIO_H */
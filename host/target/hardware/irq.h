@@ -0,0 +1,51 @@
+#ifndef TARGET_HARDWARE_IRQ_H
+#define TARGET_HARDWARE_IRQ_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* RP2040 interrupt numbers. */
+#define TIMER_IRQ_3 (3U)
+#define USBCTRL_IRQ (5U)
+#define DMA_IRQ_0 (11U)
+#define DMA_IRQ_1 (12U)
+#define IO_IRQ_BANK0 (13U)
+#define SPI0_IRQ (18U)
+#define SPI1_IRQ (19U)
+#define UART0_IRQ (20U)
+#define UART1_IRQ (21U)
+#define NUM_IRQS (32U)
+
+#define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY (0x00U)
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY (0x80U)
+#define PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY (0xFFU)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef void (*irq_handler_t)(void);
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler);
+void irq_add_shared_handler(unsigned int num, irq_handler_t handler, uint8_t orderPriority);
+void irq_set_enabled(unsigned int num, bool isEnabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_HARDWARE_IRQ_H */
@@ -0,0 +1,95 @@
+#ifndef TARGET_HARDWARE_SPI_H
+#define TARGET_HARDWARE_SPI_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define spi0 (&gTargetSpi[0])
+#define spi1 (&gTargetSpi[1])
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef enum
+{
+    SPI_CPOL_0 = 0,
+    SPI_CPOL_1 = 1
+} spi_cpol_t;
+
+typedef enum
+{
+    SPI_CPHA_0 = 0,
+    SPI_CPHA_1 = 1
+} spi_cpha_t;
+
+typedef enum
+{
+    SPI_LSB_FIRST = 0,
+    SPI_MSB_FIRST = 1
+} spi_order_t;
+
+/* PL022 register block. Only DR is served, through DMA. */
+typedef struct
+{
+    volatile uint32_t cr0;
+    volatile uint32_t cr1;
+    volatile uint32_t dr;
+    volatile uint32_t sr;
+    volatile uint32_t cpsr;
+    volatile uint32_t imsc;
+    volatile uint32_t ris;
+    volatile uint32_t mis;
+    volatile uint32_t icr;
+    volatile uint32_t dmacr;
+} spi_hw_t;
+
+typedef struct spi_inst
+{
+    spi_hw_t hw;
+    unsigned int index;
+} spi_inst_t;
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+extern spi_inst_t gTargetSpi[2];
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+unsigned int spi_init(spi_inst_t *spi, unsigned int baudrate);
+void spi_set_format(spi_inst_t *spi, unsigned int dataBits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeatedTx, uint8_t *dst, size_t len);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+static inline spi_hw_t *spi_get_hw(spi_inst_t *spi)
+{
+    return &spi->hw;
+}
+
+static inline unsigned int spi_get_dreq(spi_inst_t *spi, bool isTx)
+{
+    return 16U + 2U * spi->index + (isTx ? 0U : 1U);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_HARDWARE_SPI_H */
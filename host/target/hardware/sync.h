@@ -0,0 +1,64 @@
+#ifndef TARGET_HARDWARE_SYNC_H
+#define TARGET_HARDWARE_SYNC_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Hardware spin locks of the SIO block. */
+#define NUM_SPIN_LOCKS (32U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef volatile uint32_t spin_lock_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Interrupts are masked per simulated core. An interrupt raised while */
+/* its core has them masked is held until restore_interrupts().        */
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+int spin_lock_claim_unused(bool required);
+spin_lock_t *spin_lock_instance(unsigned int lockNum);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* The simulated cores may be host threads, so the barrier is a real one. */
+static inline void __dmb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __compiler_memory_barrier(void)
+{
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void tight_loop_contents(void)
+{
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_HARDWARE_SYNC_H */
@@ -0,0 +1,114 @@
+#ifndef TARGET_HARDWARE_UART_H
+#define TARGET_HARDWARE_UART_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define uart0 (&gTargetUart[0])
+#define uart1 (&gTargetUart[1])
+
+/* PL011 register fields. */
+#define UART_UARTFR_BUSY_BITS (0x00000008UL)
+#define UART_UARTFR_RXFE_BITS (0x00000010UL)
+#define UART_UARTFR_TXFF_BITS (0x00000020UL)
+#define UART_UARTFR_TXFE_BITS (0x00000080UL)
+#define UART_UARTCR_LBE_BITS (0x00000080UL)
+#define UART_UARTIMSC_RXIM_BITS (0x00000010UL)
+#define UART_UARTIMSC_TXIM_BITS (0x00000020UL)
+#define UART_UARTIMSC_RTIM_BITS (0x00000040UL)
+#define UART_UARTIMSC_OEIM_BITS (0x00000400UL)
+#define UART_UARTIFLS_RXIFLSEL_LSB (3U)
+#define UART_UARTIFLS_RXIFLSEL_BITS (0x00000038UL)
+#define UART_UARTIFLS_TXIFLSEL_LSB (0U)
+#define UART_UARTIFLS_TXIFLSEL_BITS (0x00000007UL)
+#define UART_UARTRIS_RXRIS_BITS (0x00000010UL)
+#define UART_UARTRIS_RTRIS_BITS (0x00000040UL)
+#define UART_UARTRIS_OERIS_BITS (0x00000400UL)
+#define UART_UARTMIS_RXMIS_BITS (0x00000010UL)
+#define UART_UARTMIS_RTMIS_BITS (0x00000040UL)
+#define UART_UARTMIS_OEMIS_BITS (0x00000400UL)
+#define UART_UARTICR_RTIC_BITS (0x00000040UL)
+#define UART_UARTICR_OEIC_BITS (0x00000400UL)
+#define UART_UARTDMACR_RXDMAE_BITS (0x00000001UL)
+#define UART_UARTDMACR_TXDMAE_BITS (0x00000002UL)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Register block. ICR and IMSC writes take effect when the model next */
+/* looks at them, which is before any interrupt or DMA request.        */
+typedef struct
+{
+    volatile uint32_t dr;
+    volatile uint32_t rsr;
+    uint32_t _pad0[4];
+    volatile uint32_t fr;
+    uint32_t _pad1;
+    volatile uint32_t ilpr;
+    volatile uint32_t ibrd;
+    volatile uint32_t fbrd;
+    volatile uint32_t lcr_h;
+    volatile uint32_t cr;
+    volatile uint32_t ifls;
+    volatile uint32_t imsc;
+    volatile uint32_t ris;
+    volatile uint32_t mis;
+    volatile uint32_t icr;
+    volatile uint32_t dmacr;
+} uart_hw_t;
+
+typedef struct uart_inst
+{
+    uart_hw_t hw;
+    unsigned int index;
+} uart_inst_t;
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+extern uart_inst_t gTargetUart[2];
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+unsigned int uart_init(uart_inst_t *uart, unsigned int baudrate);
+void uart_set_fifo_enabled(uart_inst_t *uart, bool isEnabled);
+
+/* Reading DR pops the RX FIFO, which a plain field cannot do. */
+char uart_getc(uart_inst_t *uart);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+static inline uart_hw_t *uart_get_hw(uart_inst_t *uart)
+{
+    return &uart->hw;
+}
+
+static inline bool uart_is_readable(uart_inst_t *uart)
+{
+    return (uart->hw.fr & UART_UARTFR_RXFE_BITS) == 0;
+}
+
+static inline unsigned int uart_get_dreq(uart_inst_t *uart, bool isTx)
+{
+    return 20U + 2U * uart->index + (isTx ? 0U : 1U);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_HARDWARE_UART_H */
@@ -0,0 +1,50 @@
+#ifndef TARGET_PICO_STDLIB_H
+#define TARGET_PICO_STDLIB_H
+
+/* Host stand-in for the parts of the Pico SDK the firmware modules use. */
+/* Time is the simulated time of target.cpp, not the host clock.         */
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define PICO_OK (0)
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef unsigned int uint;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+uint get_core_num(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <pico/time.h>
+#include <hardware/gpio.h>
+#include <hardware/uart.h>
+
+#endif /* TARGET_PICO_STDLIB_H */
@@ -0,0 +1,45 @@
+#ifndef TARGET_PICO_TIME_H
+#define TARGET_PICO_TIME_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer
+{
+    int64_t delay_us;
+    repeating_timer_callback_t callback;
+    void *user_data;
+    uint64_t due; /* Simulated time of the next call, in ns. */
+    bool isFired;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Calls back from TIMER_IRQ_3, as the default alarm pool does, so masked */
+/* interrupts hold the call. A negative delay counts from the last start, */
+/* a positive one from the last return; both are the same here.           */
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_PICO_TIME_H */
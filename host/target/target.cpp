@@ -0,0 +1,1920 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "target.hpp"
+
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <hardware/irq.h>
+#include <hardware/gpio.h>
+#include <hardware/dma.h>
+#include <hardware/spi.h>
+#include <hardware/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <semphr.h>
+#include <timers.h>
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct TargetTask
+{
+    TaskFunction_t code;
+    void *arg;
+    std::string name;
+    unsigned core;
+    UBaseType_t priority;
+    std::condition_variable cv;
+    bool isRunning;
+    bool isReady;
+    uint64_t readyAt;
+    const void *waitObj; /* Wakes the task when it is blocked on it. */
+    uint64_t deadline;
+    uint32_t notify;
+};
+
+namespace
+{
+
+using canaan::target::Device;
+using canaan::target::kNever;
+using canaan::target::kNsPerMs;
+using canaan::target::kNsPerS;
+using canaan::target::kTickNs;
+using canaan::target::SpiDevice;
+using canaan::target::UartCounts;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr unsigned kCoreNum = 2U;
+constexpr unsigned kPinNum = 30U;
+constexpr size_t kUartFifoDepth = 32U;
+constexpr size_t kSpiFifoDepth = 8U;
+
+/* PL011 receive timeout, in bit periods. */
+constexpr uint64_t kUartTimeoutBits = 32U;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Kernel
+{
+    std::mutex lock;
+    std::condition_variable idle; /* The running task blocked. */
+    std::atomic<uint64_t> now{0};
+    uint64_t wakeLatency = 0;
+    TargetTask *running = nullptr;
+    bool isStepping = false;
+    std::vector<TargetTask *> tasks;
+    std::vector<StaticTimer_t *> timers;
+    std::vector<Device *> devices;
+};
+
+/* A data register a DMA channel is paced by. */
+class Port
+{
+public:
+    virtual ~Port() = default;
+    virtual const volatile void *reg() const = 0;
+    virtual bool isReady() = 0;
+    virtual uint32_t read() = 0;
+    virtual void write(uint32_t value) = 0;
+};
+
+struct DmaChannel
+{
+    bool isClaimed;
+    bool isBusy;
+    uint32_t reload;
+    bool isIrq0;
+    bool isIrq1;
+};
+
+struct Irq
+{
+    std::vector<std::pair<uint8_t, irq_handler_t>> handlers;
+    bool isEnabled;
+    bool isPending;
+};
+
+struct Pin
+{
+    bool level;
+    bool isDriven; /* Set from outside by setPin(). */
+    uint32_t irqEvents;
+    uint32_t pendingEvents;
+};
+
+class SpiModel : public Device
+{
+public:
+    explicit SpiModel(spi_inst_t *inst) : mInst(inst), mTx(this), mRx(this)
+    {
+    }
+
+    Port *txPort()
+    {
+        return &mTx;
+    }
+
+    Port *rxPort()
+    {
+        return &mRx;
+    }
+
+    uint64_t nextEvent() const override;
+    void advance(uint64_t now) override;
+    void transfer(const uint8_t *src, uint8_t *dst, size_t len, uint8_t fill);
+    void select(unsigned gpio, bool level);
+
+    unsigned baudrate = 1000000U;
+    SpiDevice *device = nullptr;
+    unsigned csPin = kPinNum;
+    uint64_t bytes = 0;
+
+private:
+    class TxPort : public Port
+    {
+    public:
+        explicit TxPort(SpiModel *spi) : mSpi(spi)
+        {
+        }
+        const volatile void *reg() const override
+        {
+            return &mSpi->mInst->hw.dr;
+        }
+        bool isReady() override
+        {
+            return mSpi->mTxFifo.size() < kSpiFifoDepth;
+        }
+        uint32_t read() override
+        {
+            return 0;
+        }
+        void write(uint32_t value) override
+        {
+            mSpi->mTxFifo.push_back(static_cast<uint8_t>(value));
+        }
+
+    private:
+        SpiModel *mSpi;
+    };
+
+    class RxPort : public Port
+    {
+    public:
+        explicit RxPort(SpiModel *spi) : mSpi(spi)
+        {
+        }
+        const volatile void *reg() const override
+        {
+            return &mSpi->mInst->hw.dr;
+        }
+        bool isReady() override
+        {
+            return !mSpi->mRxFifo.empty();
+        }
+        uint32_t read() override
+        {
+            const uint8_t value = mSpi->mRxFifo.front();
+
+            mSpi->mRxFifo.pop_front();
+            return value;
+        }
+        void write(uint32_t) override
+        {
+        }
+
+    private:
+        SpiModel *mSpi;
+    };
+
+    uint64_t byteNs() const
+    {
+        return 8U * kNsPerS / baudrate;
+    }
+
+    spi_inst_t *mInst;
+    TxPort mTx;
+    RxPort mRx;
+    std::deque<uint8_t> mTxFifo;
+    std::deque<uint8_t> mRxFifo;
+    bool mIsShifting = false;
+    uint8_t mShifting = 0;
+    uint64_t mShiftEnd = 0;
+};
+
+class UartModel : public Device
+{
+public:
+    explicit UartModel(uart_inst_t *inst) : mInst(inst), mTx(this), mRx(this)
+    {
+    }
+
+    Port *txPort()
+    {
+        return &mTx;
+    }
+
+    Port *rxPort()
+    {
+        return &mRx;
+    }
+
+    uint64_t nextEvent() const override;
+    void advance(uint64_t now) override;
+    void send(const uint8_t *data, size_t size);
+    uint8_t pop();
+
+    unsigned baudrate = 115200U;
+    bool isLoopback = false;
+    std::function<void(uint8_t)> onTx;
+    UartCounts counts{};
+
+private:
+    class TxPort : public Port
+    {
+    public:
+        explicit TxPort(UartModel *uart) : mUart(uart)
+        {
+        }
+        const volatile void *reg() const override
+        {
+            return &mUart->mInst->hw.dr;
+        }
+        bool isReady() override
+        {
+            return (mUart->mInst->hw.dmacr & UART_UARTDMACR_TXDMAE_BITS) && (mUart->mTxFifo.size() < kUartFifoDepth);
+        }
+        uint32_t read() override
+        {
+            return 0;
+        }
+        void write(uint32_t value) override
+        {
+            mUart->mTxFifo.push_back(static_cast<uint8_t>(value));
+        }
+
+    private:
+        UartModel *mUart;
+    };
+
+    class RxPort : public Port
+    {
+    public:
+        explicit RxPort(UartModel *uart) : mUart(uart)
+        {
+        }
+        const volatile void *reg() const override
+        {
+            return &mUart->mInst->hw.dr;
+        }
+        bool isReady() override
+        {
+            return (mUart->mInst->hw.dmacr & UART_UARTDMACR_RXDMAE_BITS) && !mUart->mRxFifo.empty();
+        }
+        uint32_t read() override
+        {
+            return mUart->pop();
+        }
+        void write(uint32_t) override
+        {
+        }
+
+    private:
+        UartModel *mUart;
+    };
+
+    uint64_t byteNs() const
+    {
+        return 10U * kNsPerS / baudrate; /* 8N1 */
+    }
+
+    void receive(uint8_t byte, uint64_t now);
+    void update();
+
+    uart_inst_t *mInst;
+    TxPort mTx;
+    RxPort mRx;
+    std::deque<uint8_t> mTxFifo;
+    std::deque<uint8_t> mRxFifo;
+    bool mIsShifting = false;
+    uint8_t mShifting = 0;
+    uint64_t mShiftEnd = 0;
+    std::deque<std::pair<uint64_t, uint8_t>> mWire; /* Arrival time and byte. */
+    uint64_t mLastRx = 0;
+};
+
+/* The default alarm pool: due repeating timers raise TIMER_IRQ_3. */
+class AlarmModel : public Device
+{
+public:
+    uint64_t nextEvent() const override;
+    void advance(uint64_t now) override;
+    void fire();
+
+    std::vector<repeating_timer_t *> timers;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+Kernel &kernel();
+uint64_t tickAfter(uint64_t now, TickType_t ticks);
+void wakeLocked(TargetTask *task, uint64_t at);
+void wakeWaitersLocked(const void *obj);
+void blockLocked(std::unique_lock<std::mutex> &guard, const void *obj, uint64_t deadline);
+void dispatchLocked(std::unique_lock<std::mutex> &guard, TargetTask *task);
+void taskEntry(TargetTask *task);
+void busyWait(uint64_t ns);
+void deliverPending();
+void bank0Handler();
+void dmaStart(unsigned channel);
+void dmaPump();
+bool dmaTransferOne(unsigned channel);
+Port *dmaPort(unsigned dreq);
+SpiModel &spiModel(unsigned index);
+UartModel &uartModel(unsigned index);
+AlarmModel &alarmModel();
+void alarmHandler();
+BaseType_t queueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t queueReceive(QueueHandle_t queue, void *item, TickType_t ticks, bool isPeek);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+thread_local TargetTask *tTask = nullptr;
+thread_local unsigned tCore = 0;
+thread_local bool tIsInIsr = false;
+
+bool gIsMasked[kCoreNum];
+uint32_t gCriticalNesting[kCoreNum];
+uint32_t gCriticalSaved[kCoreNum];
+Irq gIrqs[NUM_IRQS];
+
+Pin gPins[kPinNum];
+gpio_irq_callback_t gGpioCallback = nullptr;
+std::function<void(unsigned, bool)> gPinWrite;
+
+spin_lock_t gSpinLocks[NUM_SPIN_LOCKS];
+unsigned gSpinLockNext = 16U; /* The SDK keeps the first ones. */
+
+dma_channel_hw_t gDmaHw[NUM_DMA_CHANNELS];
+DmaChannel gDma[NUM_DMA_CHANNELS];
+uint32_t gDmaInts0 = 0;
+uint32_t gDmaInts1 = 0;
+bool gIsDmaPumping = false;
+bool gIsDmaAgain = false;
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* Never destroyed: task threads still wait on it when main() returns. */
+Kernel &kernel()
+{
+    static Kernel *k = new Kernel();
+
+    return *k;
+}
+
+/* FreeRTOS counts a timeout from the current tick. */
+uint64_t tickAfter(uint64_t now, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        return kNever;
+    }
+
+    return (now / kTickNs + ticks) * kTickNs;
+}
+
+void wakeLocked(TargetTask *task, uint64_t at)
+{
+    if (task->isRunning || task->isReady)
+    {
+        return;
+    }
+
+    task->isReady = true;
+    task->readyAt = at;
+}
+
+void wakeWaitersLocked(const void *obj)
+{
+    Kernel &k = kernel();
+
+    for (TargetTask *task : k.tasks)
+    {
+        if (task->waitObj == obj)
+        {
+            wakeLocked(task, k.now + k.wakeLatency);
+        }
+    }
+}
+
+void blockLocked(std::unique_lock<std::mutex> &guard, const void *obj, uint64_t deadline)
+{
+    Kernel &k = kernel();
+    TargetTask *task = tTask;
+
+    task->waitObj = obj;
+    task->deadline = deadline;
+    task->isRunning = false;
+    k.running = nullptr;
+    k.idle.notify_all();
+
+    task->cv.wait(guard, [task] { return task->isRunning; });
+    task->waitObj = nullptr;
+    task->deadline = kNever;
+}
+
+void dispatchLocked(std::unique_lock<std::mutex> &guard, TargetTask *task)
+{
+    Kernel &k = kernel();
+
+    task->isReady = false;
+    task->isRunning = true;
+    k.running = task;
+    task->cv.notify_one();
+
+    k.idle.wait(guard, [&k] { return k.running == nullptr; });
+}
+
+void taskEntry(TargetTask *task)
+{
+    Kernel &k = kernel();
+
+    {
+        std::unique_lock<std::mutex> guard(k.lock);
+
+        task->cv.wait(guard, [task] { return task->isRunning; });
+    }
+
+    tTask = task;
+    tCore = task->core;
+    task->code(task->arg);
+
+    /* A FreeRTOS task must not return. */
+    std::fprintf(stderr, "task %s returned\n", task->name.c_str());
+    std::abort();
+}
+
+/* The caller is busy for the time: a task blocks, anything else lets */
+/* the simulation run on.                                              */
+void busyWait(uint64_t ns)
+{
+    Kernel &k = kernel();
+
+    if (tTask != nullptr)
+    {
+        std::unique_lock<std::mutex> guard(k.lock);
+
+        blockLocked(guard, nullptr, k.now + ns);
+    }
+    else if (!k.isStepping)
+    {
+        canaan::target::run(k.now + ns);
+    }
+    else
+    {
+        k.now += ns;
+    }
+}
+
+void deliverPending()
+{
+    while (!gIsMasked[tCore] && !tIsInIsr)
+    {
+        unsigned num = 0;
+
+        while ((num < NUM_IRQS) && !(gIrqs[num].isPending && gIrqs[num].isEnabled))
+        {
+            num++;
+        }
+
+        if (num == NUM_IRQS)
+        {
+            return;
+        }
+
+        gIrqs[num].isPending = false;
+        tIsInIsr = true;
+        for (const auto &handler : gIrqs[num].handlers)
+        {
+            handler.second();
+        }
+        tIsInIsr = false;
+    }
+}
+
+void bank0Handler()
+{
+    for (unsigned gpio = 0; gpio < kPinNum; gpio++)
+    {
+        const uint32_t events = gPins[gpio].pendingEvents;
+
+        if ((events != 0) && (gGpioCallback != nullptr))
+        {
+            gPins[gpio].pendingEvents = 0;
+            gGpioCallback(gpio, events);
+        }
+    }
+}
+
+void dmaStart(unsigned channel)
+{
+    dma_channel_hw_t *hw = &gDmaHw[channel];
+
+    if (!(hw->ctrl_trig & DMA_CH0_CTRL_TRIG_EN_BITS))
+    {
+        return;
+    }
+
+    hw->transfer_count = gDma[channel].reload;
+    hw->ctrl_trig |= DMA_CH0_CTRL_TRIG_BUSY_BITS;
+    gDma[channel].isBusy = true;
+    gIsDmaAgain = true;
+}
+
+/* Moves data until no channel can go on, then raises the interrupts */
+/* of the channels that finished.                                    */
+void dmaPump()
+{
+    uint32_t done0 = 0;
+    uint32_t done1 = 0;
+
+    if (gIsDmaPumping)
+    {
+        gIsDmaAgain = true;
+        return;
+    }
+
+    gIsDmaPumping = true;
+    do
+    {
+        gIsDmaAgain = false;
+
+        for (unsigned ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+        {
+            dma_channel_hw_t *hw = &gDmaHw[ch];
+
+            while (gDma[ch].isBusy && (hw->transfer_count > 0) && dmaTransferOne(ch))
+            {
+            }
+
+            if (gDma[ch].isBusy && (hw->transfer_count == 0))
+            {
+                const unsigned chain = (hw->ctrl_trig & DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS) >> DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB;
+
+                gDma[ch].isBusy = false;
+                hw->ctrl_trig &= ~DMA_CH0_CTRL_TRIG_BUSY_BITS;
+                if (gDma[ch].isIrq0)
+                {
+                    gDmaInts0 |= 1UL << ch;
+                    done0 |= 1UL << ch;
+                }
+                if (gDma[ch].isIrq1)
+                {
+                    gDmaInts1 |= 1UL << ch;
+                    done1 |= 1UL << ch;
+                }
+                if (chain != ch)
+                {
+                    dmaStart(chain);
+                }
+            }
+        }
+    } while (gIsDmaAgain);
+    gIsDmaPumping = false;
+
+    if (done0 != 0)
+    {
+        canaan::target::raiseIrq(DMA_IRQ_0);
+    }
+    if (done1 != 0)
+    {
+        canaan::target::raiseIrq(DMA_IRQ_1);
+    }
+}
+
+bool dmaTransferOne(unsigned channel)
+{
+    dma_channel_hw_t *hw = &gDmaHw[channel];
+    const uint32_t ctrl = hw->ctrl_trig;
+    const unsigned treq = (ctrl & DMA_CH0_CTRL_TRIG_TREQ_SEL_BITS) >> DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB;
+    const uintptr_t size = 1U << ((ctrl & DMA_CH0_CTRL_TRIG_DATA_SIZE_BITS) >> DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB);
+    const unsigned ringBits = (ctrl & DMA_CH0_CTRL_TRIG_RING_SIZE_BITS) >> DMA_CH0_CTRL_TRIG_RING_SIZE_LSB;
+    const uintptr_t ringMask = (ringBits != 0) ? ((static_cast<uintptr_t>(1) << ringBits) - 1U) : ~static_cast<uintptr_t>(0);
+    const bool isRingWrite = (ctrl & DMA_CH0_CTRL_TRIG_RING_SEL_BITS) != 0;
+    Port *port = nullptr;
+    uint32_t value = 0;
+
+    if (treq != DREQ_FORCE)
+    {
+        port = dmaPort(treq);
+        if ((port == nullptr) || !port->isReady())
+        {
+            return false;
+        }
+    }
+
+    if ((port != nullptr) && (hw->read_addr == reinterpret_cast<uintptr_t>(port->reg())))
+    {
+        value = port->read();
+    }
+    else
+    {
+        std::memcpy(&value, reinterpret_cast<const void *>(hw->read_addr), size);
+    }
+
+    if ((port != nullptr) && (hw->write_addr == reinterpret_cast<uintptr_t>(port->reg())))
+    {
+        port->write(value);
+    }
+    else
+    {
+        std::memcpy(reinterpret_cast<void *>(hw->write_addr), &value, size);
+    }
+
+    if (ctrl & DMA_CH0_CTRL_TRIG_INCR_READ_BITS)
+    {
+        const uintptr_t mask = isRingWrite ? ~static_cast<uintptr_t>(0) : ringMask;
+
+        hw->read_addr = (hw->read_addr & ~mask) | ((hw->read_addr + size) & mask);
+    }
+    if (ctrl & DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS)
+    {
+        const uintptr_t mask = isRingWrite ? ringMask : ~static_cast<uintptr_t>(0);
+
+        hw->write_addr = (hw->write_addr & ~mask) | ((hw->write_addr + size) & mask);
+    }
+    hw->transfer_count--;
+
+    return true;
+}
+
+Port *dmaPort(unsigned dreq)
+{
+    switch (dreq)
+    {
+    case DREQ_SPI0_TX:
+    case DREQ_SPI1_TX:
+        return spiModel((dreq - DREQ_SPI0_TX) / 2U).txPort();
+    case DREQ_SPI0_RX:
+    case DREQ_SPI1_RX:
+        return spiModel((dreq - DREQ_SPI0_RX) / 2U).rxPort();
+    case DREQ_UART0_TX:
+    case DREQ_UART1_TX:
+        return uartModel((dreq - DREQ_UART0_TX) / 2U).txPort();
+    case DREQ_UART0_RX:
+    case DREQ_UART1_RX:
+        return uartModel((dreq - DREQ_UART0_RX) / 2U).rxPort();
+    default:
+        return nullptr;
+    }
+}
+
+/* Attached to the simulation on first use. */
+SpiModel &spiModel(unsigned index)
+{
+    static SpiModel *models[2] = {nullptr, nullptr};
+
+    if (models[index] == nullptr)
+    {
+        models[index] = new SpiModel(&gTargetSpi[index]);
+        canaan::target::attach(models[index]);
+    }
+
+    return *models[index];
+}
+
+UartModel &uartModel(unsigned index)
+{
+    static UartModel *models[2] = {nullptr, nullptr};
+
+    if (models[index] == nullptr)
+    {
+        models[index] = new UartModel(&gTargetUart[index]);
+        canaan::target::attach(models[index]);
+    }
+
+    return *models[index];
+}
+
+AlarmModel &alarmModel()
+{
+    static AlarmModel *model = nullptr;
+
+    if (model == nullptr)
+    {
+        model = new AlarmModel();
+        canaan::target::attach(model);
+        irq_set_exclusive_handler(TIMER_IRQ_3, alarmHandler);
+        irq_set_enabled(TIMER_IRQ_3, true);
+    }
+
+    return *model;
+}
+
+void alarmHandler()
+{
+    alarmModel().fire();
+}
+
+BaseType_t queueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    Kernel &k = kernel();
+    std::unique_lock<std::mutex> guard(k.lock);
+    const uint64_t deadline = tickAfter(k.now, ticks);
+
+    while (queue->count >= queue->length)
+    {
+        if ((ticks == 0) || (tTask == nullptr) || (k.now >= deadline))
+        {
+            return pdFAIL;
+        }
+        blockLocked(guard, queue, deadline);
+    }
+
+    /* Semaphores give with no item. */
+    if ((queue->itemSize > 0) && (item != nullptr))
+    {
+        const UBaseType_t slot = (queue->head + queue->count) % queue->length;
+
+        std::memcpy(&queue->storage[slot * queue->itemSize], item, queue->itemSize);
+    }
+    queue->count++;
+    wakeWaitersLocked(queue);
+
+    return pdPASS;
+}
+
+BaseType_t queueReceive(QueueHandle_t queue, void *item, TickType_t ticks, bool isPeek)
+{
+    Kernel &k = kernel();
+    std::unique_lock<std::mutex> guard(k.lock);
+    const uint64_t deadline = tickAfter(k.now, ticks);
+
+    while (queue->count == 0)
+    {
+        if ((ticks == 0) || (tTask == nullptr) || (k.now >= deadline))
+        {
+            return pdFAIL;
+        }
+        blockLocked(guard, queue, deadline);
+    }
+
+    if (queue->itemSize > 0)
+    {
+        std::memcpy(item, &queue->storage[queue->head * queue->itemSize], queue->itemSize);
+    }
+    if (!isPeek)
+    {
+        queue->head = (queue->head + 1U) % queue->length;
+        queue->count--;
+        wakeWaitersLocked(queue);
+    }
+
+    return pdPASS;
+}
+
+/* -------------------------------------------------------------------------- */
+/* SPI model                                                                  */
+/* -------------------------------------------------------------------------- */
+uint64_t SpiModel::nextEvent() const
+{
+    if (mIsShifting)
+    {
+        return mShiftEnd;
+    }
+
+    return mTxFifo.empty() ? kNever : kernel().now.load();
+}
+
+void SpiModel::advance(uint64_t now)
+{
+    if (mIsShifting && (now >= mShiftEnd))
+    {
+        mRxFifo.push_back((device != nullptr) ? device->exchange(mShifting) : 0xFFU);
+        mIsShifting = false;
+        bytes++;
+    }
+
+    if (!mIsShifting && !mTxFifo.empty())
+    {
+        mShifting = mTxFifo.front();
+        mTxFifo.pop_front();
+        mIsShifting = true;
+        mShiftEnd = now + byteNs();
+    }
+}
+
+/* A blocking transfer keeps the bus for its whole length. */
+void SpiModel::transfer(const uint8_t *src, uint8_t *dst, size_t len, uint8_t fill)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        const uint8_t miso = (device != nullptr) ? device->exchange((src != nullptr) ? src[i] : fill) : 0xFFU;
+
+        if (dst != nullptr)
+        {
+            dst[i] = miso;
+        }
+    }
+    bytes += len;
+
+    busyWait(len * byteNs());
+}
+
+void SpiModel::select(unsigned gpio, bool level)
+{
+    if ((gpio == csPin) && (device != nullptr))
+    {
+        device->select(!level);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* UART model                                                                 */
+/* -------------------------------------------------------------------------- */
+uint64_t UartModel::nextEvent() const
+{
+    const uint64_t now = kernel().now.load();
+    uint64_t next = kNever;
+
+    if (mIsShifting)
+    {
+        next = mShiftEnd;
+    }
+    else if (!mTxFifo.empty())
+    {
+        next = now;
+    }
+
+    if (!mWire.empty())
+    {
+        next = std::min(next, mWire.front().first);
+    }
+
+    if (!mRxFifo.empty() && !(mInst->hw.ris & UART_UARTRIS_RTRIS_BITS))
+    {
+        next = std::min(next, mLastRx + kUartTimeoutBits * kNsPerS / baudrate);
+    }
+
+    return std::max(next, now);
+}
+
+void UartModel::advance(uint64_t now)
+{
+    update();
+
+    if (mIsShifting && (now >= mShiftEnd))
+    {
+        mIsShifting = false;
+        counts.txBytes++;
+        if (isLoopback)
+        {
+            receive(mShifting, mShiftEnd);
+        }
+        else if (onTx)
+        {
+            onTx(mShifting);
+        }
+    }
+
+    if (!mIsShifting && !mTxFifo.empty())
+    {
+        mShifting = mTxFifo.front();
+        mTxFifo.pop_front();
+        mIsShifting = true;
+        mShiftEnd = now + byteNs();
+    }
+
+    while (!mWire.empty() && (mWire.front().first <= now))
+    {
+        receive(mWire.front().second, mWire.front().first);
+        mWire.pop_front();
+    }
+
+    if (!mRxFifo.empty() && !(mInst->hw.ris & UART_UARTRIS_RTRIS_BITS) &&
+        (now >= mLastRx + kUartTimeoutBits * kNsPerS / baudrate))
+    {
+        mInst->hw.ris |= UART_UARTRIS_RTRIS_BITS;
+        counts.rxTimeouts++;
+    }
+
+    update();
+    if (mInst->hw.mis != 0)
+    {
+        canaan::target::raiseIrq(UART0_IRQ + mInst->index);
+    }
+}
+
+/* Queues bytes on the line behind the ones still on their way. */
+void UartModel::send(const uint8_t *data, size_t size)
+{
+    uint64_t at = std::max(kernel().now.load(), mWire.empty() ? 0U : mWire.back().first);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        at += byteNs();
+        mWire.emplace_back(at, data[i]);
+    }
+}
+
+void UartModel::receive(uint8_t byte, uint64_t now)
+{
+    if (mRxFifo.size() >= kUartFifoDepth)
+    {
+        mInst->hw.ris |= UART_UARTRIS_OERIS_BITS;
+        counts.rxOverruns++;
+    }
+    else
+    {
+        mRxFifo.push_back(byte);
+        counts.rxBytes++;
+    }
+    mLastRx = now;
+}
+
+/* Emptying the FIFO clears the receive timeout. */
+uint8_t UartModel::pop()
+{
+    const uint8_t byte = mRxFifo.front();
+
+    mRxFifo.pop_front();
+    if (mRxFifo.empty())
+    {
+        mInst->hw.ris &= ~UART_UARTRIS_RTRIS_BITS;
+    }
+    update();
+
+    return byte;
+}
+
+/* Applies ICR writes and refreshes the flag and masked status registers. */
+/* The RX interrupt follows the FIFO level against the IFLS watermark.    */
+void UartModel::update()
+{
+    static const size_t watermarks[] = {4U, 8U, 16U, 24U, 28U, 28U, 28U, 28U};
+    uart_hw_t *hw = &mInst->hw;
+    const size_t level = watermarks[(hw->ifls & UART_UARTIFLS_RXIFLSEL_BITS) >> UART_UARTIFLS_RXIFLSEL_LSB];
+
+    hw->ris &= ~hw->icr;
+    hw->icr = 0;
+    if (mRxFifo.size() >= level)
+    {
+        hw->ris |= UART_UARTRIS_RXRIS_BITS;
+    }
+    else
+    {
+        hw->ris &= ~UART_UARTRIS_RXRIS_BITS;
+    }
+    hw->mis = hw->ris & hw->imsc;
+    hw->fr = (mRxFifo.empty() ? UART_UARTFR_RXFE_BITS : 0U) |
+             (mTxFifo.size() >= kUartFifoDepth ? UART_UARTFR_TXFF_BITS : 0U) |
+             (mTxFifo.empty() ? UART_UARTFR_TXFE_BITS : 0U) |
+             (mIsShifting || !mTxFifo.empty() ? UART_UARTFR_BUSY_BITS : 0U);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Alarm model                                                                */
+/* -------------------------------------------------------------------------- */
+uint64_t AlarmModel::nextEvent() const
+{
+    uint64_t next = kNever;
+
+    for (const repeating_timer_t *timer : timers)
+    {
+        next = timer->isFired ? next : std::min(next, timer->due);
+    }
+
+    return std::max(next, kernel().now.load());
+}
+
+/* A fired timer is not due again until its callback ran. */
+void AlarmModel::advance(uint64_t now)
+{
+    bool isRaised = false;
+
+    for (repeating_timer_t *timer : timers)
+    {
+        if (!timer->isFired && (timer->due <= now))
+        {
+            timer->isFired = true;
+            isRaised = true;
+        }
+    }
+
+    if (isRaised)
+    {
+        canaan::target::raiseIrq(TIMER_IRQ_3);
+    }
+}
+
+/* Runs the fired callbacks and counts the next delay from now, so a */
+/* call held by masked interrupts is late but not repeated.          */
+void AlarmModel::fire()
+{
+    const std::vector<repeating_timer_t *> fired = timers;
+
+    for (repeating_timer_t *timer : fired)
+    {
+        if (timer->isFired)
+        {
+            timer->isFired = false;
+            timer->due = kernel().now.load() + static_cast<uint64_t>(std::llabs(timer->delay_us)) * 1000U;
+            if (!timer->callback(timer))
+            {
+                (void)cancel_repeating_timer(timer);
+            }
+        }
+    }
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+uart_inst_t gTargetUart[2] = {{{}, 0U}, {{}, 1U}};
+spi_inst_t gTargetSpi[2] = {{{}, 0U}, {{}, 1U}};
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+namespace canaan::target
+{
+
+uint64_t now()
+{
+    return kernel().now.load();
+}
+
+bool run(uint64_t until, const std::function<bool()> &isDone)
+{
+    Kernel &k = kernel();
+    std::unique_lock<std::mutex> guard(k.lock);
+    bool isMet = false;
+
+    k.isStepping = true;
+    while (true)
+    {
+        const uint64_t at = k.now;
+        TargetTask *next = nullptr;
+        StaticTimer_t *timer = nullptr;
+        Device *device = nullptr;
+        uint64_t event = kNever;
+
+        /* Timeouts first, then the task that became ready first. */
+        for (TargetTask *task : k.tasks)
+        {
+            if (!task->isRunning && !task->isReady && (task->deadline <= at))
+            {
+                wakeLocked(task, task->deadline);
+            }
+        }
+
+        for (TargetTask *task : k.tasks)
+        {
+            if (task->isReady && (task->readyAt <= at) &&
+                ((next == nullptr) || (task->readyAt < next->readyAt) ||
+                 ((task->readyAt == next->readyAt) && (task->priority > next->priority))))
+            {
+                next = task;
+            }
+        }
+
+        if (next != nullptr)
+        {
+            dispatchLocked(guard, next);
+            continue;
+        }
+
+        for (StaticTimer_t *t : k.timers)
+        {
+            if (t->isActive && (t->expiry <= at))
+            {
+                timer = t;
+                break;
+            }
+        }
+
+        if (timer != nullptr)
+        {
+            timer->isActive = timer->isAutoReload != 0;
+            timer->expiry += timer->period * kTickNs;
+            guard.unlock();
+            timer->callback(timer);
+            guard.lock();
+            continue;
+        }
+
+        for (Device *d : k.devices)
+        {
+            if (d->nextEvent() <= at)
+            {
+                device = d;
+                break;
+            }
+        }
+
+        if (device != nullptr)
+        {
+            guard.unlock();
+            device->advance(at);
+            dmaPump();
+            guard.lock();
+            continue;
+        }
+
+        if (isDone)
+        {
+            guard.unlock();
+            isMet = isDone();
+            guard.lock();
+            if (isMet)
+            {
+                break;
+            }
+        }
+
+        /* Nothing left at this time: on to the next event. */
+        for (TargetTask *task : k.tasks)
+        {
+            event = std::min(event, task->isReady ? task->readyAt : task->isRunning ? kNever : task->deadline);
+        }
+        for (StaticTimer_t *t : k.timers)
+        {
+            event = t->isActive ? std::min(event, t->expiry) : event;
+        }
+        for (Device *d : k.devices)
+        {
+            event = std::min(event, d->nextEvent());
+        }
+
+        if (event > until)
+        {
+            k.now = std::max(at, until);
+            break;
+        }
+        k.now = std::max(at, event);
+    }
+    k.isStepping = false;
+
+    return isMet;
+}
+
+void setWakeLatency(uint64_t ns)
+{
+    kernel().wakeLatency = ns;
+}
+
+void setCore(unsigned core)
+{
+    tCore = core;
+}
+
+void attach(Device *device)
+{
+    Kernel &k = kernel();
+    std::lock_guard<std::mutex> guard(k.lock);
+
+    k.devices.push_back(device);
+}
+
+void raiseIrq(unsigned num)
+{
+    gIrqs[num].isPending = true;
+    deliverPending();
+}
+
+void setPin(unsigned gpio, bool level)
+{
+    Pin *pin = &gPins[gpio];
+    uint32_t events = 0;
+
+    pin->isDriven = true;
+    if (pin->level && !level)
+    {
+        events |= GPIO_IRQ_EDGE_FALL;
+    }
+    if (!pin->level && level)
+    {
+        events |= GPIO_IRQ_EDGE_RISE;
+    }
+    events |= level ? GPIO_IRQ_LEVEL_HIGH : GPIO_IRQ_LEVEL_LOW;
+    pin->level = level;
+
+    events &= pin->irqEvents;
+    if (events != 0)
+    {
+        pin->pendingEvents |= events;
+        raiseIrq(IO_IRQ_BANK0);
+    }
+}
+
+void onPinWrite(std::function<void(unsigned gpio, bool level)> callback)
+{
+    gPinWrite = std::move(callback);
+}
+
+void attachSpi(unsigned index, SpiDevice *device, unsigned csPin)
+{
+    spiModel(index).device = device;
+    spiModel(index).csPin = csPin;
+}
+
+uint64_t spiBytes(unsigned index)
+{
+    return spiModel(index).bytes;
+}
+
+void uartLoopback(unsigned index, bool isEnabled)
+{
+    uartModel(index).isLoopback = isEnabled;
+}
+
+void uartOnTx(unsigned index, std::function<void(uint8_t byte)> callback)
+{
+    uartModel(index).onTx = std::move(callback);
+}
+
+void uartSend(unsigned index, const uint8_t *data, size_t size)
+{
+    uartModel(index).send(data, size);
+}
+
+UartCounts uartCounts(unsigned index)
+{
+    return uartModel(index).counts;
+}
+
+} /* namespace canaan::target */
+
+/* -------------------------------------------------------------------------- */
+/* Pico SDK                                                                   */
+/* -------------------------------------------------------------------------- */
+extern "C"
+{
+
+uint64_t time_us_64(void)
+{
+    return kernel().now.load() / 1000U;
+}
+
+uint32_t time_us_32(void)
+{
+    return static_cast<uint32_t>(time_us_64());
+}
+
+void sleep_ms(uint32_t ms)
+{
+    busyWait(ms * kNsPerMs);
+}
+
+void sleep_us(uint64_t us)
+{
+    busyWait(us * 1000U);
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out)
+{
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->due = kernel().now.load() + static_cast<uint64_t>(std::llabs(delay_us)) * 1000U;
+    out->isFired = false;
+    alarmModel().timers.push_back(out);
+
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+    std::vector<repeating_timer_t *> &timers = alarmModel().timers;
+    const auto it = std::find(timers.begin(), timers.end(), timer);
+
+    if (it == timers.end())
+    {
+        return false;
+    }
+    timers.erase(it);
+
+    return true;
+}
+
+uint get_core_num(void)
+{
+    return tCore;
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+    const uint32_t status = gIsMasked[tCore] ? 1U : 0U;
+
+    gIsMasked[tCore] = true;
+
+    return status;
+}
+
+void restore_interrupts(uint32_t status)
+{
+    gIsMasked[tCore] = status != 0;
+    deliverPending();
+}
+
+int spin_lock_claim_unused(bool required)
+{
+    if (gSpinLockNext >= NUM_SPIN_LOCKS)
+    {
+        if (required)
+        {
+            std::fprintf(stderr, "no spin lock left\n");
+            std::abort();
+        }
+        return -1;
+    }
+
+    return static_cast<int>(gSpinLockNext++);
+}
+
+spin_lock_t *spin_lock_instance(unsigned int lockNum)
+{
+    return &gSpinLocks[lockNum];
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+    const uint32_t saved = save_and_disable_interrupts();
+
+    while (__atomic_exchange_n(lock, 1U, __ATOMIC_ACQUIRE) != 0U)
+    {
+    }
+
+    return saved;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved)
+{
+    __atomic_store_n(lock, 0U, __ATOMIC_RELEASE);
+    restore_interrupts(saved);
+}
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler)
+{
+    gIrqs[num].handlers.assign(1, std::make_pair(static_cast<uint8_t>(0), handler));
+}
+
+void irq_add_shared_handler(unsigned int num, irq_handler_t handler, uint8_t orderPriority)
+{
+    std::vector<std::pair<uint8_t, irq_handler_t>> &handlers = gIrqs[num].handlers;
+
+    /* Higher order priority runs first. */
+    handlers.emplace_back(orderPriority, handler);
+    std::stable_sort(handlers.begin(), handlers.end(),
+                     [](const auto &a, const auto &b) { return a.first > b.first; });
+}
+
+void irq_set_enabled(unsigned int num, bool isEnabled)
+{
+    gIrqs[num].isEnabled = isEnabled;
+    deliverPending();
+}
+
+void gpio_init(unsigned int gpio)
+{
+    gPins[gpio].irqEvents = 0;
+}
+
+void gpio_set_function(unsigned int, int)
+{
+}
+
+void gpio_set_dir(unsigned int, bool)
+{
+}
+
+void gpio_pull_up(unsigned int gpio)
+{
+    if (!gPins[gpio].isDriven)
+    {
+        gPins[gpio].level = true;
+    }
+}
+
+void gpio_put(unsigned int gpio, bool value)
+{
+    gPins[gpio].level = value;
+    spiModel(0).select(gpio, value);
+    spiModel(1).select(gpio, value);
+    if (gPinWrite)
+    {
+        gPinWrite(gpio, value);
+    }
+}
+
+bool gpio_get(unsigned int gpio)
+{
+    return gPins[gpio].level;
+}
+
+void gpio_set_irq_enabled(unsigned int gpio, uint32_t events, bool isEnabled)
+{
+    if (isEnabled)
+    {
+        gPins[gpio].irqEvents |= events;
+    }
+    else
+    {
+        gPins[gpio].irqEvents &= ~events;
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(unsigned int gpio, uint32_t events, bool isEnabled,
+                                        gpio_irq_callback_t callback)
+{
+    gpio_set_irq_enabled(gpio, events, isEnabled);
+    gGpioCallback = callback;
+    irq_set_exclusive_handler(IO_IRQ_BANK0, bank0Handler);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (unsigned ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+    {
+        if (!gDma[ch].isClaimed)
+        {
+            gDma[ch].isClaimed = true;
+            return static_cast<int>(ch);
+        }
+    }
+
+    if (required)
+    {
+        std::fprintf(stderr, "no DMA channel left\n");
+        std::abort();
+    }
+
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned int channel)
+{
+    dma_channel_config config = {DMA_CH0_CTRL_TRIG_EN_BITS};
+
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, DREQ_FORCE);
+    channel_config_set_chain_to(&config, channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+
+    return config;
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(unsigned int channel)
+{
+    return &gDmaHw[channel];
+}
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config *config, volatile void *writeAddr,
+                           const volatile void *readAddr, unsigned int transferCount, bool trigger)
+{
+    gDmaHw[channel].write_addr = reinterpret_cast<uintptr_t>(writeAddr);
+    gDmaHw[channel].read_addr = reinterpret_cast<uintptr_t>(readAddr);
+    gDma[channel].reload = transferCount;
+    dma_channel_set_config(channel, config, trigger);
+}
+
+void dma_channel_set_config(unsigned int channel, const dma_channel_config *config, bool trigger)
+{
+    gDmaHw[channel].ctrl_trig = (config->ctrl & ~DMA_CH0_CTRL_TRIG_BUSY_BITS) |
+                                (gDmaHw[channel].ctrl_trig & DMA_CH0_CTRL_TRIG_BUSY_BITS);
+    if (trigger)
+    {
+        dmaStart(channel);
+        dmaPump();
+    }
+}
+
+void dma_channel_set_read_addr(unsigned int channel, const volatile void *readAddr, bool trigger)
+{
+    gDmaHw[channel].read_addr = reinterpret_cast<uintptr_t>(readAddr);
+    if (trigger)
+    {
+        dmaStart(channel);
+        dmaPump();
+    }
+}
+
+void dma_channel_set_write_addr(unsigned int channel, volatile void *writeAddr, bool trigger)
+{
+    gDmaHw[channel].write_addr = reinterpret_cast<uintptr_t>(writeAddr);
+    if (trigger)
+    {
+        dmaStart(channel);
+        dmaPump();
+    }
+}
+
+void dma_channel_set_trans_count(unsigned int channel, uint32_t transferCount, bool trigger)
+{
+    gDma[channel].reload = transferCount;
+    if (trigger)
+    {
+        dmaStart(channel);
+        dmaPump();
+    }
+}
+
+void dma_start_channel_mask(uint32_t mask)
+{
+    for (unsigned ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+    {
+        if (mask & (1UL << ch))
+        {
+            dmaStart(ch);
+        }
+    }
+    dmaPump();
+}
+
+void dma_channel_start(unsigned int channel)
+{
+    dma_start_channel_mask(1UL << channel);
+}
+
+bool dma_channel_is_busy(unsigned int channel)
+{
+    return gDma[channel].isBusy;
+}
+
+void dma_channel_set_irq0_enabled(unsigned int channel, bool isEnabled)
+{
+    gDma[channel].isIrq0 = isEnabled;
+}
+
+void dma_channel_set_irq1_enabled(unsigned int channel, bool isEnabled)
+{
+    gDma[channel].isIrq1 = isEnabled;
+}
+
+bool dma_channel_get_irq0_status(unsigned int channel)
+{
+    return (gDmaInts0 & (1UL << channel)) != 0;
+}
+
+bool dma_channel_get_irq1_status(unsigned int channel)
+{
+    return (gDmaInts1 & (1UL << channel)) != 0;
+}
+
+void dma_channel_acknowledge_irq0(unsigned int channel)
+{
+    gDmaInts0 &= ~(1UL << channel);
+}
+
+void dma_channel_acknowledge_irq1(unsigned int channel)
+{
+    gDmaInts1 &= ~(1UL << channel);
+}
+
+unsigned int spi_init(spi_inst_t *spi, unsigned int baudrate)
+{
+    spiModel(spi->index).baudrate = baudrate;
+
+    return baudrate;
+}
+
+void spi_set_format(spi_inst_t *, unsigned int, spi_cpol_t, spi_cpha_t, spi_order_t)
+{
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    spiModel(spi->index).transfer(src, nullptr, len, 0);
+
+    return static_cast<int>(len);
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeatedTx, uint8_t *dst, size_t len)
+{
+    spiModel(spi->index).transfer(nullptr, dst, len, repeatedTx);
+
+    return static_cast<int>(len);
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len)
+{
+    spiModel(spi->index).transfer(src, dst, len, 0);
+
+    return static_cast<int>(len);
+}
+
+unsigned int uart_init(uart_inst_t *uart, unsigned int baudrate)
+{
+    uartModel(uart->index).baudrate = baudrate;
+
+    return baudrate;
+}
+
+void uart_set_fifo_enabled(uart_inst_t *, bool)
+{
+}
+
+char uart_getc(uart_inst_t *uart)
+{
+    return static_cast<char>(uartModel(uart->index).pop());
+}
+
+/* -------------------------------------------------------------------------- */
+/* FreeRTOS                                                                   */
+/* -------------------------------------------------------------------------- */
+TaskHandle_t xTaskCreateStatic(TaskFunction_t code, const char *name, uint32_t, void *arg, UBaseType_t priority,
+                               StackType_t *, StaticTask_t *def)
+{
+    Kernel &k = kernel();
+    TargetTask *task = new TargetTask();
+
+    task->code = code;
+    task->arg = arg;
+    task->name = name;
+    task->core = tCore;
+    task->priority = priority;
+    task->isRunning = false;
+    task->isReady = true;
+    task->readyAt = k.now;
+    task->waitObj = nullptr;
+    task->deadline = kNever;
+    task->notify = 0;
+    def->handle = task;
+
+    {
+        std::lock_guard<std::mutex> guard(k.lock);
+
+        k.tasks.push_back(task);
+    }
+    std::thread(taskEntry, task).detach();
+
+    return task;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return tTask;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return static_cast<TickType_t>(kernel().now.load() / kTickNs);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    Kernel &k = kernel();
+    std::unique_lock<std::mutex> guard(k.lock);
+    const uint64_t deadline = tickAfter(k.now, ticks);
+
+    if (tTask != nullptr)
+    {
+        blockLocked(guard, nullptr, deadline);
+    }
+    else if (!k.isStepping)
+    {
+        guard.unlock();
+        canaan::target::run(deadline);
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    Kernel &k = kernel();
+    std::lock_guard<std::mutex> guard(k.lock);
+
+    task->notify++;
+    if (task->waitObj == &task->notify)
+    {
+        wakeLocked(task, k.now + k.wakeLatency);
+    }
+
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *isWoken)
+{
+    (void)xTaskNotifyGive(task);
+    if (isWoken != nullptr)
+    {
+        *isWoken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t isClear, TickType_t ticks)
+{
+    Kernel &k = kernel();
+    std::unique_lock<std::mutex> guard(k.lock);
+    TargetTask *task = tTask;
+    uint32_t value;
+
+    if (task == nullptr)
+    {
+        std::fprintf(stderr, "ulTaskNotifyTake() outside a task\n");
+        std::abort();
+    }
+
+    if ((task->notify == 0) && (ticks != 0))
+    {
+        blockLocked(guard, &task->notify, tickAfter(k.now, ticks));
+    }
+
+    value = task->notify;
+    if (value != 0)
+    {
+        task->notify = isClear ? 0U : (value - 1U);
+    }
+
+    return value;
+}
+
+void targetEnterCritical(void)
+{
+    if (gCriticalNesting[tCore]++ == 0)
+    {
+        gCriticalSaved[tCore] = save_and_disable_interrupts();
+    }
+}
+
+void targetExitCritical(void)
+{
+    if (--gCriticalNesting[tCore] == 0)
+    {
+        restore_interrupts(gCriticalSaved[tCore]);
+    }
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage, StaticQueue_t *queue)
+{
+    queue->storage = storage;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->head = 0;
+    queue->count = 0;
+
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queueSend(queue, item, ticks);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *isWoken)
+{
+    (void)isWoken;
+
+    return queueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queueReceive(queue, item, ticks, false);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *item, BaseType_t *isWoken)
+{
+    (void)isWoken;
+
+    return queueReceive(queue, item, 0, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queueReceive(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeekFromISR(QueueHandle_t queue, void *item)
+{
+    return queueReceive(queue, item, 0, true);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(kernel().lock);
+
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(kernel().lock);
+
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *semaphore)
+{
+    return xQueueCreateStatic(1, 0, nullptr, semaphore);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *semaphore)
+{
+    xQueueCreateStatic(1, 0, nullptr, semaphore);
+    semaphore->count = 1;
+
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    return queueReceive(semaphore, nullptr, ticks, false);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return queueSend(semaphore, nullptr, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *isWoken)
+{
+    (void)isWoken;
+
+    return queueSend(semaphore, nullptr, 0);
+}
+
+TimerHandle_t xTimerCreateStatic(const char *, TickType_t period, UBaseType_t isAutoReload, void *id,
+                                 TimerCallbackFunction_t callback, StaticTimer_t *timer)
+{
+    Kernel &k = kernel();
+    std::lock_guard<std::mutex> guard(k.lock);
+
+    timer->period = period;
+    timer->isAutoReload = isAutoReload;
+    timer->id = id;
+    timer->callback = callback;
+    timer->expiry = 0;
+    timer->isActive = false;
+    k.timers.push_back(timer);
+
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t)
+{
+    Kernel &k = kernel();
+    std::lock_guard<std::mutex> guard(k.lock);
+
+    timer->expiry = tickAfter(k.now, timer->period);
+    timer->isActive = true;
+
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t)
+{
+    std::lock_guard<std::mutex> guard(kernel().lock);
+
+    timer->isActive = false;
+
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks)
+{
+    timer->period = period;
+
+    return xTimerStart(timer, ticks);
+}
+
+BaseType_t xTimerChangePeriodFromISR(TimerHandle_t timer, TickType_t period, BaseType_t *isWoken)
+{
+    (void)isWoken;
+
+    return xTimerChangePeriod(timer, period, 0);
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+    return timer->id;
+}
+
+} /* extern "C" */
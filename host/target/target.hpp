@@ -0,0 +1,109 @@
+#ifndef TARGET_HPP
+#define TARGET_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/* Host model of the RP2040 and FreeRTOS parts the firmware modules use, */
+/* so a sim can compile a module as it is and drive it.                  */
+/*                                                                       */
+/* Time is simulated and only moves in run(). Tasks are host threads,    */
+/* but only one runs at a time and it takes no simulated time; a task    */
+/* runs until it blocks, and time moves on once every task is blocked.   */
+/* A blocking SPI transfer or sleep blocks the task for its duration.    */
+/* Interrupts run on the thread that raises them, unless the core has   */
+/* them masked, in which case they wait for restore_interrupts().        */
+/*                                                                       */
+/* The DMA engine moves one element per request of the peripheral it is */
+/* paced by. The PL011 model raises requests per character, as the       */
+/* RP2040 does, and asserts the receive timeout after 32 bit periods     */
+/* with characters left in its FIFO. The SPI model clocks a byte every   */
+/* 8 bit periods while its TX FIFO holds data. Repeating timers call     */
+/* back from TIMER_IRQ_3, the interrupt of the default alarm pool.       */
+
+namespace canaan::target
+{
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+constexpr uint64_t kNever = UINT64_MAX;
+constexpr uint64_t kNsPerUs = 1000ULL;
+constexpr uint64_t kNsPerMs = 1000000ULL;
+constexpr uint64_t kNsPerS = 1000000000ULL;
+constexpr uint64_t kTickNs = kNsPerMs;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Acts on its own in simulated time, e.g. a bus or a chip. advance() */
+/* is called once time reaches nextEvent(), with no task running.     */
+class Device
+{
+public:
+    virtual ~Device() = default;
+    virtual uint64_t nextEvent() const = 0;
+    virtual void advance(uint64_t now) = 0;
+};
+
+/* A chip on an SPI bus: one byte back for every byte in. */
+class SpiDevice
+{
+public:
+    virtual ~SpiDevice() = default;
+    virtual void select(bool isSelected) = 0;
+    virtual uint8_t exchange(uint8_t mosi) = 0;
+};
+
+/* What a UART saw of the line. */
+struct UartCounts
+{
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    uint64_t rxOverruns; /* Characters lost on a full RX FIFO. */
+    uint64_t rxTimeouts; /* Receive timeout interrupts asserted. */
+};
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Simulated time in ns. */
+uint64_t now();
+
+/* Runs tasks, timers, interrupts and devices until the time, or until */
+/* isDone() holds between two events. Returns whether it did.          */
+bool run(uint64_t until, const std::function<bool()> &isDone = nullptr);
+
+/* Delay from a notification to the task running, for scheduling costs. */
+void setWakeLatency(uint64_t ns);
+
+/* Core the calling thread runs on, for get_core_num() and masking. */
+void setCore(unsigned core);
+
+void attach(Device *device);
+void raiseIrq(unsigned num);
+
+/* Input level of a pin, as driven from outside. Edges raise IO_IRQ_BANK0. */
+void setPin(unsigned gpio, bool level);
+void onPinWrite(std::function<void(unsigned gpio, bool level)> callback);
+
+/* Puts a chip on an SPI instance, selected while csPin is low. */
+void attachSpi(unsigned index, SpiDevice *device, unsigned csPin);
+uint64_t spiBytes(unsigned index);
+
+/* Sends TX straight back into RX, as UARTCR.LBE does. Otherwise TX */
+/* goes to the callback and RX comes from uartSend().               */
+void uartLoopback(unsigned index, bool isEnabled);
+void uartOnTx(unsigned index, std::function<void(uint8_t byte)> callback);
+void uartSend(unsigned index, const uint8_t *data, size_t size);
+UartCounts uartCounts(unsigned index);
+
+} /* namespace canaan::target */
+
+#endif /* TARGET_HPP */
@@ -0,0 +1,48 @@
+#ifndef TARGET_TASK_H
+#define TARGET_TASK_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <FreeRTOS.h>
+#include <hardware/sync.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define taskENTER_CRITICAL() targetEnterCritical()
+#define taskEXIT_CRITICAL() targetExitCritical()
+#define taskENTER_CRITICAL_FROM_ISR() ((UBaseType_t)save_and_disable_interrupts())
+#define taskEXIT_CRITICAL_FROM_ISR(state) restore_interrupts((uint32_t)(state))
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef void (*TaskFunction_t)(void *arg);
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+TaskHandle_t xTaskCreateStatic(TaskFunction_t code, const char *name, uint32_t stackDepth, void *arg,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *isWoken);
+uint32_t ulTaskNotifyTake(BaseType_t isClear, TickType_t ticks);
+
+void targetEnterCritical(void);
+void targetExitCritical(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_TASK_H */
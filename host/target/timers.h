@@ -0,0 +1,46 @@
+#ifndef TARGET_TIMERS_H
+#define TARGET_TIMERS_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <FreeRTOS.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef struct TargetTimer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+/* Expires on a tick boundary, as the timer task sees it. */
+typedef struct TargetTimer
+{
+    TickType_t period;
+    UBaseType_t isAutoReload;
+    void *id;
+    TimerCallbackFunction_t callback;
+    uint64_t expiry; /* Simulated ns. */
+    bool isActive;
+} StaticTimer_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t isAutoReload, void *id,
+                                 TimerCallbackFunction_t callback, StaticTimer_t *timer);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks);
+BaseType_t xTimerChangePeriodFromISR(TimerHandle_t timer, TickType_t period, BaseType_t *isWoken);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TARGET_TIMERS_H */
@@ -0,0 +1,217 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "record_stream.hpp"
+#include "trace.h"
+
+/* Converts the PROTO_REC_TRACE records of a captured record stream into */
+/* the JSON trace event format, which ui.perfetto.dev opens directly.     */
+/*                                                                        */
+/*     trace2perfetto <capture.bin> [trace.json]                          */
+
+namespace
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+struct Event
+{
+    uint64_t timestamp; /* Unwrapped microseconds. */
+    uint32_t core;
+    uint32_t event;
+    uint32_t arg;
+    uint32_t data;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+const char *eventName(uint32_t event)
+{
+    switch (event)
+    {
+    case TRACE_EV_QUEUE_SEND:
+        return "queue_send";
+    case TRACE_EV_QUEUE_RECEIVE:
+        return "queue_receive";
+    case TRACE_EV_QUEUE_FULL:
+        return "queue_full";
+    case TRACE_EV_NOTIFY:
+        return "notify";
+    case TRACE_EV_NOTIFY_TAKE:
+        return "notify_take";
+    case TRACE_EV_FRAME_RX:
+        return "frame_rx";
+    case TRACE_EV_FILTER:
+        return "filter";
+    case TRACE_EV_ENQUEUE:
+        return "enqueue";
+    case TRACE_EV_USB_FLUSH:
+        return "usb_flush";
+    default:
+        return "unknown";
+    }
+}
+
+std::string taskName(const std::map<uint32_t, std::string> &names, uint32_t number)
+{
+    auto it = names.find(number);
+
+    return (it != names.end()) ? it->second : ("task" + std::to_string(number));
+}
+
+void writeEvent(std::FILE *out, bool &isFirst, const char *name, const char *phase,
+                const Event &ev, const std::string &args)
+{
+    std::fprintf(out, "%s\n  {\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%llu,\"pid\":1,\"tid\":%u%s%s}",
+                 isFirst ? "" : ",", name, phase,
+                 static_cast<unsigned long long>(ev.timestamp), ev.core,
+                 args.empty() ? "" : ",", args.c_str());
+    isFirst = false;
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: trace2perfetto <capture.bin> [trace.json]\n";
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    std::vector<uint8_t> capture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    /* Collect events, unwrapping the 32-bit timer per core. */
+    std::vector<Event> events;
+    std::map<uint32_t, std::string> names;
+    uint64_t epoch[TRACE_CORE_NUM] = {};
+    uint32_t last[TRACE_CORE_NUM] = {};
+
+    canaan::forEachRecord(capture.data(), capture.size(), [&](const canaan::Record &rec) {
+        if ((rec.type != PROTO_REC_TRACE) || (rec.len < 2) || (rec.payload[0] >= TRACE_CORE_NUM))
+        {
+            return;
+        }
+
+        const uint32_t core = rec.payload[0];
+        const uint32_t count = std::min<uint32_t>(rec.payload[1], (rec.len - 2U) / TRACE_EVENT_WIRE_SIZE);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint8_t *p = &rec.payload[2U + i * TRACE_EVENT_WIRE_SIZE];
+            const uint32_t ts = protoGetU32(&p[0]);
+            const uint32_t word = protoGetU32(&p[4]);
+            Event ev;
+
+            if (ts < last[core])
+            {
+                epoch[core] += 1ULL << 32;
+            }
+            last[core] = ts;
+
+            ev.timestamp = epoch[core] + ts;
+            ev.core = core;
+            ev.event = word & 0xFFU;
+            ev.arg = word >> 8;
+            ev.data = protoGetU32(&p[8]);
+
+            if (ev.event == TRACE_EV_TASK_CREATE)
+            {
+                std::string name;
+                for (int c = 0; (c < 4) && ((ev.data >> (8 * c)) & 0xFFU); c++)
+                {
+                    name.push_back(static_cast<char>((ev.data >> (8 * c)) & 0xFFU));
+                }
+                names[ev.arg] = name;
+                continue;
+            }
+
+            events.push_back(ev);
+        }
+    });
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event &a, const Event &b) { return a.timestamp < b.timestamp; });
+
+    std::FILE *out = (argc > 2) ? std::fopen(argv[2], "w") : stdout;
+    if (out == nullptr)
+    {
+        std::cerr << "cannot open " << argv[2] << "\n";
+        return 1;
+    }
+
+    bool isFirst = true;
+    bool isRunning[TRACE_CORE_NUM] = {};
+    std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (uint32_t core = 0; core < TRACE_CORE_NUM; core++)
+    {
+        Event meta{0, core, 0, 0, 0};
+        writeEvent(out, isFirst, "thread_name", "M", meta,
+                   "\"args\":{\"name\":\"core" + std::to_string(core) + "\"}");
+    }
+
+    for (const Event &ev : events)
+    {
+        switch (ev.event)
+        {
+        case TRACE_EV_TASK_IN:
+            writeEvent(out, isFirst, taskName(names, ev.arg).c_str(), "B", ev, "");
+            isRunning[ev.core] = true;
+            break;
+
+        case TRACE_EV_TASK_OUT:
+            /* A dump can start in the middle of a slice. */
+            if (isRunning[ev.core])
+            {
+                writeEvent(out, isFirst, taskName(names, ev.arg).c_str(), "E", ev, "");
+                isRunning[ev.core] = false;
+            }
+            break;
+
+        case TRACE_EV_ISR_ENTER:
+            writeEvent(out, isFirst, ("irq" + std::to_string(ev.arg)).c_str(), "B", ev, "");
+            break;
+
+        case TRACE_EV_ISR_EXIT:
+            writeEvent(out, isFirst, ("irq" + std::to_string(ev.arg)).c_str(), "E", ev, "");
+            break;
+
+        default:
+            writeEvent(out, isFirst, eventName(ev.event), "i", ev,
+                       "\"s\":\"t\",\"args\":{\"arg\":" + std::to_string(ev.arg) +
+                           ",\"data\":" + std::to_string(ev.data) + "}");
+            break;
+        }
+    }
+
+    std::fprintf(out, "\n]}\n");
+
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    std::cerr << events.size() << " events\n";
+
+    return 0;
+}
@@ -0,0 +1,258 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+extern "C"
+{
+#include "uart_link.h"
+#include "bridge.h"
+#include "stats.h"
+#include <hardware/sync.h>
+}
+
+#include "target.hpp"
+
+/* Runs uart_link.c on the host target model with the UART looped back   */
+/* at the highest baud rate the PL011 takes, and checks what comes back. */
+/*                                                                       */
+/*     uartlink_sim [bytes] [seed]                                       */
+/*                                                                       */
+/* The bridge side hands the link the bytes to send as fast as it takes  */
+/* them; the link's receive side must give back the same bytes in the    */
+/* same order. Prints the throughput against the line rate and the       */
+/* overruns. Then bursts of random length arrive on an idle line, and    */
+/* each must reach the bridge once the sampling timer sees the line      */
+/* idle, well before the output poll would have picked it up. Last, the  */
+/* loopback runs again while another task masks the interrupts of the    */
+/* link's core for 100 us every tick, over twice what the UART FIFO      */
+/* holds at this rate; the receive DMA must go on without a loss.        */
+/*                                                                       */
+/* Exits with 1 on a corrupted, lost or reordered byte, an overrun, a    */
+/* throughput under 95% of the line rate, or a burst handed over late.   */
+
+namespace
+{
+
+namespace target = canaan::target;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* 8N1: ten bit periods per byte. */
+constexpr double kLineBytesPerS = UART_LINK_BAUDRATE / 10.0;
+
+/* Task switch after an interrupt on a 125 MHz core. */
+constexpr uint64_t kWakeLatencyNs = 5U * target::kNsPerUs;
+
+/* Idle line bursts, and the time between them. */
+constexpr unsigned kBurstNum = 50U;
+constexpr size_t kBurstMax = 600U;
+constexpr uint64_t kBurstGapNs = 3U * target::kNsPerMs;
+
+/* Interrupts masked on the link's core, once a tick, while this much */
+/* is looped back.                                                    */
+constexpr uint64_t kMaskNs = 100U * target::kNsPerUs;
+constexpr size_t kMaskedBytes = 200000U;
+
+/* Pass criteria. */
+constexpr double kMinLineShare = 0.95;
+constexpr uint64_t kMaxHandOverNs = 100U * target::kNsPerUs;
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* What the bridge side of the link sent and got. */
+struct Host
+{
+    std::vector<uint8_t> out;
+    size_t sent;
+    std::vector<uint8_t> in;
+    uint64_t lastInput;
+};
+
+/* A task that masks interrupts, as a long critical section would. */
+struct Masker
+{
+    bool isEnabled;
+    unsigned count;
+};
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+Host gHost;
+
+Masker gMasker;
+
+StaticTask_t gTaskDef;
+StackType_t gTaskStack[configMINIMAL_STACK_SIZE];
+StaticTask_t gMaskTaskDef;
+StackType_t gMaskTaskStack[configMINIMAL_STACK_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* Runs on the link's core, so its interrupts are the ones held. */
+void maskTask(void *nouse)
+{
+    (void)nouse;
+    while (true)
+    {
+        vTaskDelay(1);
+        if (gMasker.isEnabled)
+        {
+            const uint32_t status = save_and_disable_interrupts();
+
+            sleep_us(kMaskNs / target::kNsPerUs);
+            restore_interrupts(status);
+            gMasker.count++;
+        }
+    }
+}
+
+/* Loops back the bytes to send at full rate. */
+bool loopback(size_t total, std::mt19937 &rng)
+{
+    gHost.out.resize(total);
+    for (uint8_t &byte : gHost.out)
+    {
+        byte = static_cast<uint8_t>(rng());
+    }
+    gHost.sent = 0;
+    gHost.in.clear();
+
+    target::uartLoopback(0, true);
+    const bool isDone = target::run(target::now() + 10U * target::kNsPerS,
+                                    [] { return gHost.in.size() >= gHost.out.size(); });
+    target::uartLoopback(0, false);
+
+    return isDone && (gHost.in == gHost.out);
+}
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Bridge                                                                     */
+/* -------------------------------------------------------------------------- */
+extern "C" void bridgeHostInput(uint8_t link, const uint8_t *data, uint32_t size)
+{
+    (void)link;
+    gHost.in.insert(gHost.in.end(), data, data + size);
+    gHost.lastInput = target::now();
+}
+
+extern "C" uint32_t bridgeHostOutput(uint8_t link, uint8_t *buff, uint32_t size)
+{
+    const size_t count = std::min<size_t>(size, gHost.out.size() - gHost.sent);
+
+    (void)link;
+    std::copy_n(gHost.out.begin() + gHost.sent, count, buff);
+    gHost.sent += count;
+
+    return static_cast<uint32_t>(count);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+    const size_t total = (argc > 1) ? static_cast<size_t>(std::max(1, std::atoi(argv[1]))) : 1000000U;
+    const unsigned seed = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 1U;
+    std::mt19937 rng(seed);
+    StatsSnapshot_t stats;
+    bool isOk = true;
+
+    target::setWakeLatency(kWakeLatencyNs);
+    statsInit();
+    uartLinkInit();
+    (void)xTaskCreateStatic(uartLinkTask, "uart", configMINIMAL_STACK_SIZE, NULL, 2, gTaskStack, &gTaskDef);
+    (void)xTaskCreateStatic(maskTask, "mask", configMINIMAL_STACK_SIZE, NULL, 3, gMaskTaskStack, &gMaskTaskDef);
+
+    /* Loopback at full rate. */
+    const uint64_t start = target::now();
+    const bool isIntact = loopback(total, rng);
+    const double seconds = (gHost.lastInput - start) / static_cast<double>(target::kNsPerS);
+    const double bytesPerS = gHost.in.size() / std::max(seconds, 1e-9);
+    const target::UartCounts loop = target::uartCounts(0);
+
+    statsSnapshot(&stats);
+    std::printf("loopback at %u baud, %zu bytes\n", static_cast<unsigned>(UART_LINK_BAUDRATE), total);
+    std::printf("  received        %zu bytes, %s\n", gHost.in.size(), isIntact ? "intact and in order" : "WRONG");
+    std::printf("  throughput      %.0f bytes/s, %.1f%% of the line rate\n", bytesPerS,
+                100.0 * bytesPerS / kLineBytesPerS);
+    std::printf("  overruns        %llu in the FIFO, %llu counted\n", static_cast<unsigned long long>(loop.rxOverruns),
+                static_cast<unsigned long long>(stats.counter[STAT_UART_RX_OVERRUNS]));
+
+    isOk &= isIntact && (loop.rxOverruns == 0) && (stats.counter[STAT_UART_RX_OVERRUNS] == 0) &&
+            (bytesPerS >= kMinLineShare * kLineBytesPerS);
+
+    /* Bursts on an idle line. */
+    std::uniform_int_distribution<size_t> length(1U, kBurstMax);
+    uint64_t worst = 0;
+    uint64_t sum = 0;
+    unsigned late = 0;
+
+    gHost.in.clear();
+    for (unsigned i = 0; i < kBurstNum; i++)
+    {
+        std::vector<uint8_t> burst(length(rng));
+        const size_t expected = burst.size();
+
+        for (uint8_t &byte : burst)
+        {
+            byte = static_cast<uint8_t>(rng());
+        }
+
+        /* The last stop bit ends at sendAt plus the burst's line time. */
+        const uint64_t sendAt = target::now();
+        const uint64_t endAt = sendAt + static_cast<uint64_t>(expected * target::kNsPerS / kLineBytesPerS);
+
+        gHost.in.clear();
+        target::uartSend(0, burst.data(), burst.size());
+        (void)target::run(sendAt + kBurstGapNs, [expected] { return gHost.in.size() >= expected; });
+
+        const uint64_t handOver = (gHost.in == burst) ? (gHost.lastInput - endAt) : target::kNever;
+
+        worst = std::max(worst, handOver);
+        sum += (handOver != target::kNever) ? handOver : 0U;
+        late += (handOver > kMaxHandOverNs) ? 1U : 0U;
+        (void)target::run(sendAt + kBurstGapNs);
+    }
+
+    std::printf("idle line, %u bursts of 1 to %zu bytes\n", kBurstNum, kBurstMax);
+    std::printf("  hand over       %.1f us mean, %.1f us worst after the last stop bit, %u late\n",
+                sum / 1e3 / kBurstNum, (worst != target::kNever) ? worst / 1e3 : -1.0, late);
+
+    isOk &= late == 0;
+
+    /* Loopback again with interrupts masked now and then. */
+    gMasker.isEnabled = true;
+    const bool isMaskedIntact = loopback(kMaskedBytes, rng);
+    gMasker.isEnabled = false;
+
+    const target::UartCounts masked = target::uartCounts(0);
+
+    statsSnapshot(&stats);
+    std::printf("loopback with interrupts masked for %llu us every tick, %zu bytes\n",
+                static_cast<unsigned long long>(kMaskNs / target::kNsPerUs), kMaskedBytes);
+    std::printf("  masked          %u times, %.0f bytes each on the line, the FIFO holds %u\n", gMasker.count,
+                kMaskNs * kLineBytesPerS / target::kNsPerS, 32U);
+    std::printf("  received        %zu bytes, %s\n", gHost.in.size(), isMaskedIntact ? "intact and in order" : "WRONG");
+    std::printf("  overruns        %llu in the FIFO, %llu counted\n",
+                static_cast<unsigned long long>(masked.rxOverruns - loop.rxOverruns),
+                static_cast<unsigned long long>(stats.counter[STAT_UART_RX_OVERRUNS]));
+
+    isOk &= isMaskedIntact && (gMasker.count > 0) && (masked.rxOverruns == 0) &&
+            (stats.counter[STAT_UART_RX_OVERRUNS] == 0);
+
+    return isOk ? 0 : 1;
+}
@@ -9,21 +9,44 @@
 #include <semphr.h>
 #include <queue.h>
 #include <timers.h>
+#include "bridge.h"
+#include "uart_link.h"
+#include "mcp251xfd.h"
+#include "stats.h"
+#include "trace.h"
+#include "mem_profile.h"
+#include "clock_sync.h"
+#include "self_test.h"
+#include "nv_config.h"
 
 /* -------------------------------------------------------------------------- */
 /* Macro                                                                      */
 /* -------------------------------------------------------------------------- */
 #define LED_PORT (25U)
 
+/* Application task stacks in words: the deepest call path of each    */
+/* task, as -fcallgraph-info=su gives it, plus 256 bytes for the       */
+/* FreeRTOS and SDK calls at its end and 64 for the saved context, a   */
+/* quarter on top and rounded up. PROTO_CMD_GET_MEMORY reports the     */
+/* high-water marks to check them against on the device.               */
 #define HEARTBEAT_PRIORITY (1U)
-#define HEARTBEAT_STACK_SIZE (configMINIMAL_STACK_SIZE)
+#define HEARTBEAT_STACK_SIZE (configMINIMAL_STACK_SIZE) /* 32 bytes deep. */
 #define HEARTBEAT_INTERVAL_MS (250U)
 
 #define USBD_PRIORITY (3U)
 #define USBD_STACK_SIZE (3 * configMINIMAL_STACK_SIZE / 2) * (CFG_TUSB_DEBUG ? 2 : 1)
 
 #define CDC_PRIORITY (2U)
-#define CDC_STACK_SIZE (configMINIMAL_STACK_SIZE)
+#define CDC_STACK_SIZE (288U) /* 592 bytes: a command, through the parser. */
+
+#define UART_PRIORITY (2U)
+#define UART_STACK_SIZE (288U) /* 592 bytes: as the CDC task. */
+
+#define MCP_PRIORITY (3U)
+#define MCP_STACK_SIZE (256U) /* 496 bytes: a frame through the gateway. */
+
+#define SELF_TEST_PRIORITY (2U)
+#define SELF_TEST_STACK_SIZE (192U) /* 292 bytes: the next frame's timing. */
 
 /* -------------------------------------------------------------------------- */
 /* Type definition                                                            */
@@ -42,14 +65,23 @@ static void cdcTask(void *nouse);
 static TaskHandle_t gHbTaskHndl = NULL;
 static TaskHandle_t gUsbdTaskHndl = NULL;
 static TaskHandle_t gCdcTaskHndl = NULL;
+static TaskHandle_t gUartTaskHndl = NULL;
+static TaskHandle_t gMcpTaskHndl = NULL;
+static TaskHandle_t gSelfTestTaskHndl = NULL;
 
 static StaticTask_t gHbTaskDef;
 static StaticTask_t gUsbdTaskDef;
 static StaticTask_t gCdcTaskDef;
+static StaticTask_t gUartTaskDef;
+static StaticTask_t gMcpTaskDef;
+static StaticTask_t gSelfTestTaskDef;
 
 static StackType_t gHbStack[HEARTBEAT_STACK_SIZE];
 static StackType_t gUsbdStack[USBD_STACK_SIZE];
 static StackType_t gCdcStack[CDC_STACK_SIZE];
+static StackType_t gUartStack[UART_STACK_SIZE];
+static StackType_t gMcpStack[MCP_STACK_SIZE];
+static StackType_t gSelfTestStack[SELF_TEST_STACK_SIZE];
 
 /* -------------------------------------------------------------------------- */
 /* Public function                                                            */
@@ -63,15 +95,60 @@ int main(void)
     gpio_init(LED_PORT);
     gpio_set_dir(LED_PORT, GPIO_OUT);
 
+    /* Paint the exception stacks for the memory report. */
+    memProfileInit();
+
+    /* Initialize statistics counters. */
+    statsInit();
+
+    /* Initialize trace recorder. (started by the host) */
+    traceInit();
+
+    /* Initialize CAN to host bridge. */
+    bridgeInit();
+
+    /* Initialize traffic generator. (started by the host) */
+    selfTestInit();
+
+    /* Initialize flash writes of the configuration. (other core parked) */
+    (void)nvConfigInit();
+
+    /* Apply the stored configuration, so frames flow before USB enumerates. */
+    (void)bridgeLoadConfig();
+
+    /* Initialize UART host link. */
+    uartLinkInit();
+
+    /* Initialize SPI CAN controller. (left idle if it does not answer) */
+    bool isMcpReady = mcpInit();
+
     /* Creates a tasks. */
     gHbTaskHndl = xTaskCreateStatic(heartbeatTask, "hb", HEARTBEAT_STACK_SIZE,
                                     NULL, HEARTBEAT_PRIORITY, gHbStack, &gHbTaskDef);
+    memProfileAddTask(gHbTaskHndl, HEARTBEAT_STACK_SIZE);
 
     gUsbdTaskHndl = xTaskCreateStatic(usbdTask, "usbd", USBD_STACK_SIZE,
                                       NULL, USBD_PRIORITY, gUsbdStack, &gUsbdTaskDef);
+    memProfileAddTask(gUsbdTaskHndl, USBD_STACK_SIZE);
 
     gCdcTaskHndl = xTaskCreateStatic(cdcTask, "cdc", CDC_STACK_SIZE,
                                      NULL, CDC_PRIORITY, gCdcStack, &gCdcTaskDef);
+    memProfileAddTask(gCdcTaskHndl, CDC_STACK_SIZE);
+
+    gUartTaskHndl = xTaskCreateStatic(uartLinkTask, "uart", UART_STACK_SIZE,
+                                      NULL, UART_PRIORITY, gUartStack, &gUartTaskDef);
+    memProfileAddTask(gUartTaskHndl, UART_STACK_SIZE);
+
+    if (isMcpReady)
+    {
+        gMcpTaskHndl = xTaskCreateStatic(mcpTask, "mcp", MCP_STACK_SIZE,
+                                         NULL, MCP_PRIORITY, gMcpStack, &gMcpTaskDef);
+        memProfileAddTask(gMcpTaskHndl, MCP_STACK_SIZE);
+    }
+
+    gSelfTestTaskHndl = xTaskCreateStatic(selfTestTask, "selftest", SELF_TEST_STACK_SIZE,
+                                          NULL, SELF_TEST_PRIORITY, gSelfTestStack, &gSelfTestTaskDef);
+    memProfileAddTask(gSelfTestTaskHndl, SELF_TEST_STACK_SIZE);
 
     /* Start task scheduking. */
     vTaskStartScheduler();
@@ -82,6 +159,15 @@ int main(void)
     }
 }
 
+#if (configCHECK_FOR_STACK_OVERFLOW > 0)
+void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
+{
+    /* The stack and whatever lies below it are corrupt: stop here. */
+    (void)xTask;
+    panic("stack overflow in %s", pcTaskName);
+}
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* Private functions                                                          */
 /* -------------------------------------------------------------------------- */
@@ -110,13 +196,19 @@ static void usbdTask(void *nouse)
     tud_init(BOARD_TUD_RHPORT);
     board_init_after_tusb();
 
+    /* Timestamp every start of frame for host clock synchronisation. */
+    clockSyncInit();
+
     while (true)
     {
         /* Put this thread to waiting state until there is new events. */
         tud_task();
 
         /* Following code only run if tud_task() process at least 1 event. */
-        tud_cdc_write_flush();
+        for (uint8_t itf = 0; itf < CFG_TUD_CDC; itf++)
+        {
+            tud_cdc_n_write_flush(itf);
+        }
 
         /* CFG_TUSB_OS=OPT_OS_FREERTOSに設定できれば、tud_taskがFreeRTOSの   */
         /* タスク制御を行うが、pico-sdk(2.0.0)のissueにより設定できない。    */
@@ -130,24 +222,43 @@ static void cdcTask(void *nouse)
 {
     while (true)
     {
-        /* Connected check for DTR bit.                                      */
-        /* Most but not all terminal client set this when making connection. */
-        if (tud_cdc_connected())
+        for (uint8_t itf = 0; itf < CFG_TUD_CDC; itf++)
         {
+            /* Connected check for DTR bit.                                      */
+            /* Most but not all terminal client set this when making connection. */
+            if (!tud_cdc_n_connected(itf))
+            {
+                continue;
+            }
+
             /* There are data available. */
-            while (tud_cdc_available())
+            while (tud_cdc_n_available(itf))
             {
                 uint8_t buff[64];
 
                 /* Read a characters. */
-                uint32_t count = tud_cdc_read(buff, sizeof(buff));
-                (void)count;
+                uint32_t count = tud_cdc_n_read(itf, buff, sizeof(buff));
+
+                /* Pass to the command parser. */
+                bridgeHostInput(BRIDGE_LINK_CDC(itf), buff, count);
+            }
+
+            /* Forward records while the CDC FIFO has room. */
+            while (tud_cdc_n_write_available(itf) > 0)
+            {
+                uint8_t buff[64];
+                uint32_t space = tud_cdc_n_write_available(itf);
+                uint32_t count = bridgeHostOutput(BRIDGE_LINK_CDC(itf), buff, (space < sizeof(buff)) ? space : sizeof(buff));
+
+                if (count == 0)
+                {
+                    break;
+                }
 
-                /* Echo back. */
-                tud_cdc_write(buff, count);
+                tud_cdc_n_write(itf, buff, count);
             }
 
-            tud_cdc_write_flush();
+            traceRecord(TRACE_EV_USB_FLUSH, itf, tud_cdc_n_write_flush(itf));
         }
 
         vTaskDelay(1);
@@ -0,0 +1,705 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/spi.h>
+#include <hardware/gpio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include "mcp251xfd.h"
+#include "channel.h"
+#include "stats.h"
+#include "trace.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* SPI instructions. (upper nibble of the 16-bit command word) */
+#define CMD_RESET (0x0U)
+#define CMD_WRITE (0x2U)
+#define CMD_READ (0x3U)
+
+/* Registers. */
+#define REG_C1CON (0x000U)
+#define REG_C1NBTCFG (0x004U)
+#define REG_C1DBTCFG (0x008U)
+#define REG_C1TDC (0x00CU)
+#define REG_C1TBC (0x010U)
+#define REG_C1TSCON (0x014U)
+#define REG_C1INT (0x01CU)
+#define REG_FIFOCON(m) (0x050U + 12U * (m))
+#define REG_FIFOSTA(m) (0x054U + 12U * (m))
+#define REG_FIFOUA(m) (0x058U + 12U * (m))
+#define REG_FLTCON(n) (0x1D0U + (n))
+#define REG_FLTOBJ(n) (0x1F0U + 8U * (n))
+#define REG_MASK(n) (0x1F4U + 8U * (n))
+#define REG_OSC (0xE00U)
+
+/* Start of the message RAM. FIFO user addresses are relative to it. */
+#define RAM_BASE (0x400U)
+
+/* C1CON fields. */
+#define CON_STEF (1UL << 19)
+#define CON_TXQEN (1UL << 20)
+#define CON_OPMOD_SHIFT (21U)
+#define CON_OPMOD_MASK (0x7U)
+#define CON_REQOP_SHIFT (24U)
+#define MODE_NORMAL_FD (0U)
+#define MODE_INT_LOOPBACK (2U)
+#define MODE_CONFIG (4U)
+#define MODE_NORMAL_20 (6U)
+
+/* C1INT enables. */
+#define INT_TXIE (1UL << 16)
+#define INT_RXIE (1UL << 17)
+#define INT_RXOVIE (1UL << 27)
+
+/* C1TDC: automatic transmitter delay compensation. */
+#define TDC_TDCMOD_AUTO (2UL << 16)
+#define TDC_TDCO_SHIFT (8U)
+
+/* C1TSCON: the time base counter ticks at 1 MHz off the 40 MHz SYSCLK, */
+/* and received frames are stamped at their end of frame.               */
+#define TSCON_TBCEN (1UL << 16)
+#define TSCON_TSEOF (1UL << 17)
+#define TBC_PRESCALE (40U)
+
+/* C1FIFOCONm fields. */
+#define FIFOCON_TFNRFNIE (1UL << 0)
+#define FIFOCON_RXOVIE (1UL << 3)
+#define FIFOCON_RXTSEN (1UL << 5)
+#define FIFOCON_TXEN (1UL << 7)
+#define FIFOCON_UINC (1UL << 8)
+#define FIFOCON_TXREQ (1UL << 9)
+#define FIFOCON_TXAT_UNLIMITED (3UL << 21)
+#define FIFOCON_FSIZE_SHIFT (24U)
+#define FIFOCON_PLSIZE_SHIFT (29U)
+
+/* C1FIFOSTAm fields. */
+#define FIFOSTA_TFNRFNIF (1UL << 0) /* TX: not full,  RX: not empty. */
+#define FIFOSTA_TFERFFIF (1UL << 2) /* TX: empty,     RX: full.      */
+#define FIFOSTA_RXOVIF (1UL << 3)
+#define FIFOSTA_FIFOCI_SHIFT (8U)
+#define FIFOSTA_FIFOCI_MASK (0x1FU)
+
+/* C1FLTCONm byte: enable and target FIFO. */
+#define FLTCON_FLTEN (0x80U)
+
+/* OSC fields. */
+#define OSC_OSCRDY (1UL << 10)
+
+/* Message object flags word. */
+#define OBJ_IDE (1UL << 4)
+#define OBJ_RTR (1UL << 5)
+#define OBJ_BRS (1UL << 6)
+#define OBJ_FDF (1UL << 7)
+#define OBJ_EID_SHIFT (11U)
+
+/* FIFO assignment. FIFO 0 is the disabled TX queue. */
+#define TX_FIFO (1U)
+#define RX_FIFO (2U)
+
+/* Payload area of every message object. */
+#if MCP_FD_ENABLED
+#define OBJ_PAYLOAD (64U)
+#define OBJ_PLSIZE (7U)
+#else
+#define OBJ_PAYLOAD (8U)
+#define OBJ_PLSIZE (0U)
+#endif
+#define OBJ_SIZE (8U + OBJ_PAYLOAD)
+
+/* Received objects carry their time stamp between header and payload. */
+#define RX_OBJ_TS (8U)
+#define RX_OBJ_DATA (12U)
+#define RX_OBJ_SIZE (RX_OBJ_DATA + OBJ_PAYLOAD)
+
+/* Longest burst: the whole receive FIFO. */
+#define BURST_BUFF_SIZE (MCP_RX_FIFO_DEPTH * RX_OBJ_SIZE)
+
+#define MODE_WAIT_MS (10U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static void intPinHandler(uint gpio, uint32_t events);
+static void dmaIrqHandler(void);
+static void txKick(void *ctx, BaseType_t *isWoken);
+
+static void rxService(void);
+static void txService(void);
+static void setTxIrq(bool isEnabled);
+
+static bool setMode(uint8_t mode);
+static void applyLoopback(void);
+static void spiTransfer(uint8_t cmd, uint16_t addr, const uint8_t *tx, uint8_t *rx, uint32_t len);
+static void spiDmaTransfer(const uint8_t *tx, uint8_t *rx, uint32_t len);
+static uint32_t regRead(uint16_t addr);
+static void regWrite(uint16_t addr, uint32_t value);
+static void regWriteByte(uint16_t addr, uint8_t value);
+
+static uint8_t dlcToLen(uint8_t dlc);
+static uint8_t lenToDlc(uint8_t len);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static TaskHandle_t gTaskHndl = NULL;
+
+static int gTxDma = -1;
+static int gRxDma = -1;
+static SemaphoreHandle_t gDmaDone = NULL;
+static StaticSemaphore_t gDmaDoneDef;
+static bool gIsDmaReady = false; /* Set once the scheduler runs. */
+static uint8_t gDummyTx = 0;
+static uint8_t gDummyRx;
+
+/* FIFO positions in the message RAM and the driver's own indices. */
+static uint16_t gTxRamAddr = 0;
+static uint16_t gRxRamAddr = 0;
+static uint32_t gTxHead = 0;
+static uint32_t gRxTail = 0;
+static bool gIsTxIrq = false;
+
+/* Operating mode asked for by mcpSetLoopback() and the one in force. */
+static volatile bool gIsLoopbackRequested = false;
+static bool gIsLoopback = false;
+
+static uint8_t gBurst[BURST_BUFF_SIZE] __attribute__((aligned(4)));
+
+static const uint8_t gDlcToLen[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+bool mcpInit(void)
+{
+    uint32_t value;
+    uint32_t start;
+
+    /* Initialize SPI. (mode 0,0) */
+    spi_init(MCP_SPI_ID, MCP_SPI_BAUDRATE);
+    spi_set_format(MCP_SPI_ID, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(MCP_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(MCP_MOSI_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(MCP_MISO_PIN, GPIO_FUNC_SPI);
+    gpio_init(MCP_CS_PIN);
+    gpio_set_dir(MCP_CS_PIN, GPIO_OUT);
+    gpio_put(MCP_CS_PIN, true);
+    gpio_init(MCP_INT_PIN);
+    gpio_set_dir(MCP_INT_PIN, GPIO_IN);
+    gpio_pull_up(MCP_INT_PIN);
+
+    /* Reset and wait for the oscillator. */
+    spiTransfer(CMD_RESET, 0, NULL, NULL, 0);
+    sleep_ms(1);
+    start = time_us_32();
+    while ((regRead(REG_OSC) & OSC_OSCRDY) == 0)
+    {
+        if ((time_us_32() - start) > (MODE_WAIT_MS * 1000U))
+        {
+            return false;
+        }
+    }
+
+    /* Reset leaves the controller in configuration mode. */
+    value = regRead(REG_C1CON);
+    if (((value >> CON_OPMOD_SHIFT) & CON_OPMOD_MASK) != MODE_CONFIG)
+    {
+        return false;
+    }
+
+    /* Drop the TX queue and the TX event FIFO; their RAM goes to the FIFOs. */
+    regWrite(REG_C1CON, value & ~(CON_STEF | CON_TXQEN));
+
+    /* Bit timing. */
+    regWrite(REG_C1NBTCFG, ((uint32_t)(MCP_NBT_BRP - 1U) << 24) |
+                               ((uint32_t)(MCP_NBT_TSEG1 - 1U) << 16) |
+                               ((uint32_t)(MCP_NBT_TSEG2 - 1U) << 8) |
+                               (uint32_t)(MCP_NBT_SJW - 1U));
+    regWrite(REG_C1DBTCFG, ((uint32_t)(MCP_DBT_BRP - 1U) << 24) |
+                               ((uint32_t)(MCP_DBT_TSEG1 - 1U) << 16) |
+                               ((uint32_t)(MCP_DBT_TSEG2 - 1U) << 8) |
+                               (uint32_t)(MCP_DBT_SJW - 1U));
+    regWrite(REG_C1TDC, TDC_TDCMOD_AUTO |
+                            ((uint32_t)(MCP_DBT_BRP * MCP_DBT_TSEG1) << TDC_TDCO_SHIFT));
+    regWrite(REG_C1TSCON, TSCON_TBCEN | TSCON_TSEOF | (TBC_PRESCALE - 1U));
+
+    /* FIFO 1 transmits, FIFO 2 receives. */
+    regWrite(REG_FIFOCON(TX_FIFO), FIFOCON_TXEN | FIFOCON_TXAT_UNLIMITED |
+                                       ((uint32_t)(MCP_TX_FIFO_DEPTH - 1U) << FIFOCON_FSIZE_SHIFT) |
+                                       ((uint32_t)OBJ_PLSIZE << FIFOCON_PLSIZE_SHIFT));
+    regWrite(REG_FIFOCON(RX_FIFO), FIFOCON_TFNRFNIE | FIFOCON_RXOVIE | FIFOCON_RXTSEN |
+                                       ((uint32_t)(MCP_RX_FIFO_DEPTH - 1U) << FIFOCON_FSIZE_SHIFT) |
+                                       ((uint32_t)OBJ_PLSIZE << FIFOCON_PLSIZE_SHIFT));
+
+    /* Filter 0 accepts every frame into the receive FIFO. Acceptance */
+    /* filtering is left to the channel layer so both buses match.    */
+    regWriteByte(REG_FLTCON(0), 0);
+    regWrite(REG_FLTOBJ(0), 0);
+    regWrite(REG_MASK(0), 0);
+    regWriteByte(REG_FLTCON(0), FLTCON_FLTEN | RX_FIFO);
+
+    regWrite(REG_C1INT, INT_TXIE | INT_RXIE | INT_RXOVIE);
+
+    if (!setMode(MCP_FD_ENABLED ? MODE_NORMAL_FD : MODE_NORMAL_20))
+    {
+        return false;
+    }
+
+    /* The user addresses point at the first object after a reset. */
+    gTxRamAddr = RAM_BASE + (uint16_t)regRead(REG_FIFOUA(TX_FIFO));
+    gRxRamAddr = RAM_BASE + (uint16_t)regRead(REG_FIFOUA(RX_FIFO));
+    gTxHead = 0;
+    gRxTail = 0;
+
+    /* One DMA pair for burst transfers. DMA_IRQ_1 belongs to the UART link. */
+    gTxDma = dma_claim_unused_channel(true);
+    gRxDma = dma_claim_unused_channel(true);
+    gDmaDone = xSemaphoreCreateBinaryStatic(&gDmaDoneDef);
+    dma_channel_set_irq0_enabled(gRxDma, true);
+    irq_add_shared_handler(DMA_IRQ_0, dmaIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    channelRegisterDriver(MCP_CHANNEL, txKick, NULL);
+
+    return true;
+}
+
+/* Switches the controller between normal operation and internal       */
+/* loopback, where frames sent are received back without reaching the */
+/* bus. The task makes the switch when it next wakes.                  */
+void mcpSetLoopback(bool isEnabled)
+{
+    gIsLoopbackRequested = isEnabled;
+    txKick(NULL, NULL);
+}
+
+void mcpTask(void *nouse)
+{
+    gTaskHndl = xTaskGetCurrentTaskHandle();
+    gIsDmaReady = true;
+
+    gpio_set_irq_enabled_with_callback(MCP_INT_PIN, GPIO_IRQ_EDGE_FALL, true, intPinHandler);
+
+    while (true)
+    {
+        /* Woken by the interrupt pin, a frame queued for transmission */
+        /* or a mode switch.                                           */
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (gIsLoopbackRequested != gIsLoopback)
+        {
+            applyLoopback();
+        }
+
+        /* The pin is level driven; only an edge wakes us, so serve */
+        /* until the controller has nothing more to report.         */
+        do
+        {
+            rxService();
+            txService();
+        } while (!gpio_get(MCP_INT_PIN));
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static void intPinHandler(uint gpio, uint32_t events)
+{
+    BaseType_t isWoken = pdFALSE;
+
+    traceRecord(TRACE_EV_ISR_ENTER, IO_IRQ_BANK0, gpio);
+
+    if (gTaskHndl != NULL)
+    {
+        vTaskNotifyGiveFromISR(gTaskHndl, &isWoken);
+    }
+
+    traceRecord(TRACE_EV_ISR_EXIT, IO_IRQ_BANK0, gpio);
+    portYIELD_FROM_ISR(isWoken);
+}
+
+static void dmaIrqHandler(void)
+{
+    BaseType_t isWoken = pdFALSE;
+
+    if (!dma_channel_get_irq0_status(gRxDma))
+    {
+        return;
+    }
+
+    traceRecord(TRACE_EV_ISR_ENTER, DMA_IRQ_0, 0);
+
+    dma_channel_acknowledge_irq0(gRxDma);
+    xSemaphoreGiveFromISR(gDmaDone, &isWoken);
+
+    traceRecord(TRACE_EV_ISR_EXIT, DMA_IRQ_0, 0);
+    portYIELD_FROM_ISR(isWoken);
+}
+
+static void txKick(void *ctx, BaseType_t *isWoken)
+{
+    if (gTaskHndl == NULL)
+    {
+        return;
+    }
+
+    if (isWoken != NULL)
+    {
+        vTaskNotifyGiveFromISR(gTaskHndl, isWoken);
+    }
+    else
+    {
+        xTaskNotifyGive(gTaskHndl);
+    }
+}
+
+static void rxService(void)
+{
+    uint32_t sta = regRead(REG_FIFOSTA(RX_FIFO));
+    uint32_t head = (sta >> FIFOSTA_FIFOCI_SHIFT) & FIFOSTA_FIFOCI_MASK;
+    uint32_t count;
+    uint32_t before;
+    uint32_t tbc;
+    uint32_t now;
+
+    if (sta & FIFOSTA_RXOVIF)
+    {
+        /* Flags in the low byte are read-only except the overflow. */
+        statsInc(STAT_MCP_RX_OVERFLOWS);
+        regWriteByte(REG_FIFOSTA(RX_FIFO), 0);
+    }
+
+    if ((sta & FIFOSTA_TFNRFNIF) == 0)
+    {
+        return;
+    }
+
+    /* FIFOCI is where the controller writes next; equal indices on a */
+    /* non-empty FIFO mean it is full.                                */
+    count = (head + MCP_RX_FIFO_DEPTH - gRxTail) % MCP_RX_FIFO_DEPTH;
+    if (count == 0)
+    {
+        count = MCP_RX_FIFO_DEPTH;
+    }
+
+    /* Pair the time base counter with the local clock, halfway through */
+    /* its read, and date each frame back from there by its own stamp.  */
+    /* Every frame counted is older than the pair.                      */
+    before = time_us_32();
+    tbc = regRead(REG_C1TBC);
+    now = before + (time_us_32() - before) / 2U;
+
+    while (count > 0)
+    {
+        /* One burst per contiguous run of objects. */
+        uint32_t burst = MCP_RX_FIFO_DEPTH - gRxTail;
+
+        if (burst > count)
+        {
+            burst = count;
+        }
+
+        spiTransfer(CMD_READ, gRxRamAddr + gRxTail * RX_OBJ_SIZE, NULL, gBurst, burst * RX_OBJ_SIZE);
+
+        for (uint32_t i = 0; i < burst; i++)
+        {
+            const uint8_t *obj = &gBurst[i * RX_OBJ_SIZE];
+            uint32_t idWord = obj[0] | ((uint32_t)obj[1] << 8) | ((uint32_t)obj[2] << 16) | ((uint32_t)obj[3] << 24);
+            uint32_t flagWord = obj[4];
+            uint32_t stamp = obj[RX_OBJ_TS] | ((uint32_t)obj[RX_OBJ_TS + 1U] << 8) |
+                             ((uint32_t)obj[RX_OBJ_TS + 2U] << 16) | ((uint32_t)obj[RX_OBJ_TS + 3U] << 24);
+            CanFrame_t frame;
+
+            if (flagWord & OBJ_IDE)
+            {
+                frame.id = ((idWord & CAN_STD_ID_MASK) << 18) | ((idWord >> OBJ_EID_SHIFT) & 0x3FFFFUL);
+                frame.flags = CAN_FLAG_EXT;
+            }
+            else
+            {
+                frame.id = idWord & CAN_STD_ID_MASK;
+                frame.flags = 0;
+            }
+            frame.flags |= (flagWord & OBJ_RTR) ? CAN_FLAG_RTR : 0;
+            frame.flags |= (flagWord & OBJ_FDF) ? CAN_FLAG_FD : 0;
+            frame.flags |= (flagWord & OBJ_BRS) ? CAN_FLAG_BRS : 0;
+            frame.len = dlcToLen(flagWord & 0x0FU);
+            if (frame.len > OBJ_PAYLOAD)
+            {
+                frame.len = OBJ_PAYLOAD;
+            }
+            frame.timestamp = now - (tbc - stamp);
+            frame.reserved = 0;
+            memcpy(frame.data, &obj[RX_OBJ_DATA], frame.len);
+
+            /* Release the object before handing the frame on. */
+            regWriteByte(REG_FIFOCON(RX_FIFO) + 1U, FIFOCON_UINC >> 8);
+
+            channelRx(MCP_CHANNEL, &frame);
+        }
+
+        gRxTail = (gRxTail + burst) % MCP_RX_FIFO_DEPTH;
+        count -= burst;
+    }
+}
+
+static void txService(void)
+{
+    uint32_t sta;
+    uint32_t tail;
+    uint32_t space;
+
+    if (!channelTxPending(MCP_CHANNEL))
+    {
+        setTxIrq(false);
+        return;
+    }
+
+    sta = regRead(REG_FIFOSTA(TX_FIFO));
+    if (sta & FIFOSTA_TFNRFNIF)
+    {
+        /* FIFOCI is the next object to go out. */
+        tail = (sta >> FIFOSTA_FIFOCI_SHIFT) & FIFOSTA_FIFOCI_MASK;
+        space = MCP_TX_FIFO_DEPTH - ((gTxHead + MCP_TX_FIFO_DEPTH - tail) % MCP_TX_FIFO_DEPTH);
+    }
+    else
+    {
+        space = 0;
+    }
+
+    while (space > 0)
+    {
+        uint32_t limit = MCP_TX_FIFO_DEPTH - gTxHead;
+        uint32_t burst = 0;
+        CanFrame_t frame;
+
+        if (limit > space)
+        {
+            limit = space;
+        }
+
+        while ((burst < limit) && channelTxPop(MCP_CHANNEL, &frame))
+        {
+            uint8_t *obj = &gBurst[burst * OBJ_SIZE];
+            uint32_t idWord;
+            uint8_t len = (frame.len > OBJ_PAYLOAD) ? OBJ_PAYLOAD : frame.len;
+            uint8_t dlc = lenToDlc(len);
+
+#if !MCP_FD_ENABLED
+            /* A classic controller rejects FD format objects. */
+            frame.flags &= (uint8_t)~(CAN_FLAG_FD | CAN_FLAG_BRS);
+#endif
+
+            /* A DLC above 8 without FDF would go out as a classic frame */
+            /* of 8 bytes, so a longer classic frame is dropped. FD ones */
+            /* round up to the next DLC, padded with zeros.              */
+            if (!(frame.flags & CAN_FLAG_FD) && (frame.len > CAN_CLASSIC_MAX_LEN))
+            {
+                statsInc(STAT_MCP_TX_INVALID);
+                continue;
+            }
+
+            if (frame.flags & CAN_FLAG_EXT)
+            {
+                idWord = ((frame.id >> 18) & CAN_STD_ID_MASK) | ((frame.id & 0x3FFFFUL) << OBJ_EID_SHIFT);
+            }
+            else
+            {
+                idWord = frame.id & CAN_STD_ID_MASK;
+            }
+
+            obj[0] = (uint8_t)idWord;
+            obj[1] = (uint8_t)(idWord >> 8);
+            obj[2] = (uint8_t)(idWord >> 16);
+            obj[3] = (uint8_t)(idWord >> 24);
+            obj[4] = dlc |
+                     ((frame.flags & CAN_FLAG_EXT) ? OBJ_IDE : 0) |
+                     ((frame.flags & CAN_FLAG_RTR) ? OBJ_RTR : 0) |
+                     ((frame.flags & CAN_FLAG_BRS) ? OBJ_BRS : 0) |
+                     ((frame.flags & CAN_FLAG_FD) ? OBJ_FDF : 0);
+            obj[5] = 0;
+            obj[6] = 0;
+            obj[7] = 0;
+            memcpy(&obj[8], frame.data, len);
+            memset(&obj[8 + len], 0, gDlcToLen[dlc] - len);
+
+            burst++;
+        }
+
+        if (burst == 0)
+        {
+            break;
+        }
+
+        /* Load the run in one transfer, then hand each object over. */
+        spiTransfer(CMD_WRITE, gTxRamAddr + gTxHead * OBJ_SIZE, gBurst, NULL, burst * OBJ_SIZE);
+        for (uint32_t i = 0; i < burst; i++)
+        {
+            regWriteByte(REG_FIFOCON(TX_FIFO) + 1U, (FIFOCON_UINC | FIFOCON_TXREQ) >> 8);
+        }
+
+        gTxHead = (gTxHead + burst) % MCP_TX_FIFO_DEPTH;
+        space -= burst;
+    }
+
+    /* Wait for room on the not-full interrupt only while frames are left. */
+    setTxIrq(channelTxPending(MCP_CHANNEL));
+}
+
+static void setTxIrq(bool isEnabled)
+{
+    if (isEnabled == gIsTxIrq)
+    {
+        return;
+    }
+
+    regWriteByte(REG_FIFOCON(TX_FIFO), (uint8_t)(FIFOCON_TXEN | (isEnabled ? FIFOCON_TFNRFNIE : 0)));
+    gIsTxIrq = isEnabled;
+}
+
+static bool setMode(uint8_t mode)
+{
+    uint32_t start = time_us_32();
+
+    /* REQOP is in the top byte of C1CON with ABAT and TXBWS left at 0. */
+    regWriteByte(REG_C1CON + 3U, mode);
+
+    while (((regRead(REG_C1CON) >> CON_OPMOD_SHIFT) & CON_OPMOD_MASK) != mode)
+    {
+        if ((time_us_32() - start) > (MODE_WAIT_MS * 1000U))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The mode can only change through configuration mode, which empties */
+/* the FIFOs: frames not sent yet are lost, and both FIFOs start over  */
+/* at their first object.                                              */
+static void applyLoopback(void)
+{
+    bool isLoopback = gIsLoopbackRequested;
+
+    gIsLoopback = isLoopback;
+
+    if (!setMode(MODE_CONFIG) ||
+        !setMode(isLoopback ? MODE_INT_LOOPBACK : (MCP_FD_ENABLED ? MODE_NORMAL_FD : MODE_NORMAL_20)))
+    {
+        return;
+    }
+
+    gTxRamAddr = RAM_BASE + (uint16_t)regRead(REG_FIFOUA(TX_FIFO));
+    gRxRamAddr = RAM_BASE + (uint16_t)regRead(REG_FIFOUA(RX_FIFO));
+    gTxHead = 0;
+    gRxTail = 0;
+}
+
+static void spiTransfer(uint8_t cmd, uint16_t addr, const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    uint8_t header[2];
+
+    header[0] = (uint8_t)((cmd << 4) | ((addr >> 8) & 0x0FU));
+    header[1] = (uint8_t)addr;
+
+    gpio_put(MCP_CS_PIN, false);
+    spi_write_blocking(MCP_SPI_ID, header, sizeof(header));
+
+    if (len == 0)
+    {
+        /* Command only. */
+    }
+    else if (gIsDmaReady && (len >= MCP_DMA_THRESHOLD))
+    {
+        spiDmaTransfer(tx, rx, len);
+    }
+    else if (rx != NULL)
+    {
+        spi_read_blocking(MCP_SPI_ID, 0, rx, len);
+    }
+    else
+    {
+        spi_write_blocking(MCP_SPI_ID, tx, len);
+    }
+
+    gpio_put(MCP_CS_PIN, true);
+    statsAdd(STAT_MCP_SPI_BYTES, sizeof(header) + len);
+}
+
+static void spiDmaTransfer(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    spi_hw_t *hw = spi_get_hw(MCP_SPI_ID);
+    dma_channel_config cfg;
+
+    /* Transmit: the buffer, or a constant zero while reading. */
+    cfg = dma_channel_get_default_config(gTxDma);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&cfg, tx != NULL);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, spi_get_dreq(MCP_SPI_ID, true));
+    dma_channel_configure(gTxDma, &cfg, &hw->dr, (tx != NULL) ? tx : &gDummyTx, len, false);
+
+    /* Receive: the buffer, or a sink while writing. It finishes last. */
+    cfg = dma_channel_get_default_config(gRxDma);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, rx != NULL);
+    channel_config_set_dreq(&cfg, spi_get_dreq(MCP_SPI_ID, false));
+    dma_channel_configure(gRxDma, &cfg, (rx != NULL) ? rx : &gDummyRx, &hw->dr, len, false);
+
+    dma_start_channel_mask((1UL << gTxDma) | (1UL << gRxDma));
+    (void)xSemaphoreTake(gDmaDone, portMAX_DELAY);
+}
+
+static uint32_t regRead(uint16_t addr)
+{
+    uint8_t data[4];
+
+    spiTransfer(CMD_READ, addr, NULL, data, sizeof(data));
+
+    return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void regWrite(uint16_t addr, uint32_t value)
+{
+    uint8_t data[4];
+
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)(value >> 16);
+    data[3] = (uint8_t)(value >> 24);
+
+    spiTransfer(CMD_WRITE, addr, data, NULL, sizeof(data));
+}
+
+static void regWriteByte(uint16_t addr, uint8_t value)
+{
+    spiTransfer(CMD_WRITE, addr, &value, NULL, 1);
+}
+
+static uint8_t dlcToLen(uint8_t dlc)
+{
+    return gDlcToLen[dlc & 0x0FU];
+}
+
+static uint8_t lenToDlc(uint8_t len)
+{
+    uint8_t dlc = 0;
+
+    /* Round up to the next valid CAN FD length. */
+    while ((dlc < 15U) && (gDlcToLen[dlc] < len))
+    {
+        dlc++;
+    }
+
+    return dlc;
+}
@@ -0,0 +1,55 @@
+#ifndef MCP251XFD_H
+#define MCP251XFD_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_config.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Channel served by the controller. */
+#define MCP_CHANNEL (CAN_CHANNEL_NUM - 1U)
+
+/* SPI instance and pins. */
+#define MCP_SPI_ID (spi0)
+#define MCP_SPI_BAUDRATE (16000000U) /* Below 0.85 * SYSCLK / 2 at 40 MHz. */
+#define MCP_SCK_PIN (18U)
+#define MCP_MOSI_PIN (19U)
+#define MCP_MISO_PIN (16U)
+#define MCP_CS_PIN (17U)
+#define MCP_INT_PIN (20U)
+
+/* CAN FD (64 byte payloads) or classic CAN 2.0, as the build. */
+#define MCP_FD_ENABLED (CAN_FD_ENABLED)
+
+/* Bit timing for a 40 MHz oscillator: 500 kbit/s nominal, 2 Mbit/s data. */
+/* Fields are written as (value - 1) into C1NBTCFG and C1DBTCFG.          */
+#define MCP_NBT_BRP (1U)
+#define MCP_NBT_TSEG1 (63U)
+#define MCP_NBT_TSEG2 (16U)
+#define MCP_NBT_SJW (16U)
+#define MCP_DBT_BRP (1U)
+#define MCP_DBT_TSEG1 (15U)
+#define MCP_DBT_TSEG2 (4U)
+#define MCP_DBT_SJW (4U)
+
+/* Message RAM layout: one TX FIFO and one RX FIFO. (2 KiB in total) */
+#define MCP_TX_FIFO_DEPTH (8U)
+#define MCP_RX_FIFO_DEPTH (16U)
+
+/* Transfers at least this long go through DMA. */
+#define MCP_DMA_THRESHOLD (16U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+bool mcpInit(void);
+void mcpTask(void *nouse);
+void mcpSetLoopback(bool isEnabled);
+
+#endif /* MCP251XFD_H */
@@ -0,0 +1,140 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "mem_profile.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Bytes left unpainted below the live stack pointer of core 0. */
+#define PAINT_GUARD (64U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef struct
+{
+    TaskHandle_t task;
+    uint32_t stackWords;
+} MemTask_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static uint32_t unusedBytes(const uint8_t *bottom, const uint8_t *top);
+static uint8_t putEntry(uint8_t *entry, const char *name, uint32_t sizeWords, uint32_t freeWords);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Linker script symbols. (memmap_default.ld) */
+extern uint8_t __data_start__[];
+extern uint8_t __bss_end__[];
+extern uint8_t __StackBottom[];
+extern uint8_t __StackTop[];
+extern uint8_t __StackOneBottom[];
+extern uint8_t __StackOneTop[];
+
+static MemTask_t gTasks[MEM_PROFILE_MAX_TASKS];
+static uint8_t gTaskCount = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void memProfileInit(void)
+{
+    uint8_t *sp = (uint8_t *)__builtin_frame_address(0);
+
+    /* Task stacks are painted by FreeRTOS. The exception stacks, which */
+    /* carry every ISR once the scheduler runs, are painted here: core  */
+    /* 1 has not started yet and core 0 up to just below this frame.    */
+    memset(__StackOneBottom, MEM_PROFILE_FILL_BYTE, (size_t)(__StackOneTop - __StackOneBottom));
+    if (sp - PAINT_GUARD > __StackBottom)
+    {
+        memset(__StackBottom, MEM_PROFILE_FILL_BYTE, (size_t)(sp - PAINT_GUARD - __StackBottom));
+    }
+
+    gTaskCount = 0;
+}
+
+void memProfileAddTask(TaskHandle_t task, uint32_t stackWords)
+{
+    if ((task == NULL) || (gTaskCount >= MEM_PROFILE_MAX_TASKS))
+    {
+        return;
+    }
+
+    gTasks[gTaskCount].task = task;
+    gTasks[gTaskCount].stackWords = stackWords;
+    gTaskCount++;
+}
+
+uint8_t memProfileReport(uint8_t *payload, uint8_t size)
+{
+    static TaskStatus_t tasks[MEM_PROFILE_MAX_TASKS + 4U];
+    UBaseType_t count;
+    uint8_t pos = MEM_PROFILE_HEADER_SIZE;
+
+    /* Payload: heap size, heap free, static RAM, then one entry per stack. */
+    protoPutU32(&payload[0], configTOTAL_HEAP_SIZE);
+    protoPutU32(&payload[4], (uint32_t)xPortGetFreeHeapSize());
+    protoPutU32(&payload[8], (uint32_t)(__bss_end__ - __data_start__));
+
+    pos += putEntry(&payload[pos], "msp0", (uint32_t)(__StackTop - __StackBottom) / 4U,
+                    unusedBytes(__StackBottom, __StackTop) / 4U);
+    pos += putEntry(&payload[pos], "msp1", (uint32_t)(__StackOneTop - __StackOneBottom) / 4U,
+                    unusedBytes(__StackOneBottom, __StackOneTop) / 4U);
+
+    count = uxTaskGetSystemState(tasks, sizeof(tasks) / sizeof(tasks[0]), NULL);
+    for (UBaseType_t i = 0; (i < count) && (pos + MEM_PROFILE_ENTRY_SIZE <= size); i++)
+    {
+        uint32_t stackWords = 0;
+
+        for (uint8_t j = 0; j < gTaskCount; j++)
+        {
+            if (gTasks[j].task == tasks[i].xHandle)
+            {
+                stackWords = gTasks[j].stackWords;
+                break;
+            }
+        }
+
+        pos += putEntry(&payload[pos], tasks[i].pcTaskName, stackWords, tasks[i].usStackHighWaterMark);
+    }
+
+    return pos;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static uint32_t unusedBytes(const uint8_t *bottom, const uint8_t *top)
+{
+    const uint8_t *p = bottom;
+
+    /* Stacks grow down: untouched paint remains at the bottom. */
+    while ((p < top) && (*p == MEM_PROFILE_FILL_BYTE))
+    {
+        p++;
+    }
+
+    return (uint32_t)(p - bottom);
+}
+
+static uint8_t putEntry(uint8_t *entry, const char *name, uint32_t sizeWords, uint32_t freeWords)
+{
+    /* Entry: name (NUL padded), stack size and never used words. */
+    memset(entry, 0, MEM_PROFILE_NAME_LEN);
+    strncpy((char *)entry, name, MEM_PROFILE_NAME_LEN);
+    protoPutU16(&entry[8], (uint16_t)sizeWords);
+    protoPutU16(&entry[10], (uint16_t)freeWords);
+
+    return MEM_PROFILE_ENTRY_SIZE;
+}
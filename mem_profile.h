@@ -0,0 +1,34 @@
+#ifndef MEM_PROFILE_H
+#define MEM_PROFILE_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Tasks whose stack size is registered. Others report a size of 0. */
+#define MEM_PROFILE_MAX_TASKS (12U)
+
+/* Fixed part and per stack entry of a PROTO_REC_MEMORY payload. */
+#define MEM_PROFILE_HEADER_SIZE (12U)
+#define MEM_PROFILE_ENTRY_SIZE (12U)
+#define MEM_PROFILE_NAME_LEN (8U)
+
+/* Fill pattern of the exception stacks, as FreeRTOS uses for tasks. */
+#define MEM_PROFILE_FILL_BYTE (0xA5U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void memProfileInit(void);
+void memProfileAddTask(TaskHandle_t task, uint32_t stackWords);
+uint8_t memProfileReport(uint8_t *payload, uint8_t size);
+
+#endif /* MEM_PROFILE_H */
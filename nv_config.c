@@ -0,0 +1,225 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stddef.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include <pico/flash.h>
+#include <hardware/flash.h>
+#include "nv_config.h"
+#include "bridge.h"
+#include "dedup.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* First slot. The program image must stay below this offset. */
+#define FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - NV_CONFIG_SLOT_NUM * FLASH_SECTOR_SIZE)
+
+/* Programmed size of a slot, whole pages. */
+#define IMAGE_SIZE ((sizeof(NvConfigImage_t) + FLASH_PAGE_SIZE - 1U) & ~(FLASH_PAGE_SIZE - 1U))
+
+/* Longest wait for the other core to leave flash alone. */
+#define FLASH_SAFE_TIMEOUT_MS (100U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Contents of a slot. The CRC-32 covers everything after itself. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t crc;
+    uint16_t version;
+    uint16_t size;
+    uint32_t sequence; /* The valid slot with the newest sequence wins. */
+    NvConfig_t config;
+} NvConfigImage_t;
+
+_Static_assert(sizeof(NvConfigImage_t) <= FLASH_SECTOR_SIZE, "configuration does not fit a sector");
+
+/* Flash operation run with the other core locked out. */
+typedef struct
+{
+    uint32_t offset;
+    const uint8_t *data; /* NULL to erase only. */
+} FlashJob_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static const NvConfigImage_t *slotImage(uint8_t slot);
+static bool isValid(const NvConfigImage_t *image);
+static uint32_t imageCrc(const NvConfigImage_t *image);
+static bool flashWrite(uint8_t slot, const uint8_t *data);
+static void flashJob(void *param);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Slot holding the applied configuration, or NV_CONFIG_SLOT_NUM if none. */
+static uint8_t gActiveSlot = NV_CONFIG_SLOT_NUM;
+static uint32_t gSequence = 0;
+
+/* Page-padded image being written. */
+static union
+{
+    NvConfigImage_t image;
+    uint8_t raw[IMAGE_SIZE];
+} gWrite __attribute__((aligned(4)));
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Prepares the core for flash_safe_execute(). With the SDK's FreeRTOS SMP */
+/* helper, a task it pins to the other core parks it during a write and    */
+/* this only confirms the helper is there; without it, this core becomes   */
+/* one the other can lock out. Call before the scheduler starts.           */
+bool nvConfigInit(void)
+{
+    return flash_safe_execute_core_init();
+}
+
+void nvConfigDefaults(NvConfig_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->mode = BRIDGE_MODE_RAW;
+    config->link = BRIDGE_LINK_CDC(0);
+    config->dedupEnabled = 0;
+    config->dedupKeepaliveMs = DEDUP_DEFAULT_KEEPALIVE_MS;
+}
+
+bool nvConfigLoad(NvConfig_t *config)
+{
+    const NvConfigImage_t *newest = NULL;
+
+    /* Read straight from XIP; nothing has to be copied until a slot wins. */
+    for (uint8_t slot = 0; slot < NV_CONFIG_SLOT_NUM; slot++)
+    {
+        const NvConfigImage_t *image = slotImage(slot);
+
+        if (!isValid(image))
+        {
+            continue;
+        }
+
+        if ((newest == NULL) || ((int32_t)(image->sequence - newest->sequence) > 0))
+        {
+            newest = image;
+            gActiveSlot = slot;
+        }
+    }
+
+    if (newest == NULL)
+    {
+        nvConfigDefaults(config);
+        return false;
+    }
+
+    gSequence = newest->sequence;
+    memcpy(config, &newest->config, sizeof(*config));
+
+    return true;
+}
+
+bool nvConfigSave(const NvConfig_t *config)
+{
+    /* Never touch the active slot: a reset while writing leaves it intact */
+    /* and the half-written slot fails its CRC on the next boot.          */
+    uint8_t slot = (gActiveSlot < NV_CONFIG_SLOT_NUM) ? (uint8_t)((gActiveSlot + 1U) % NV_CONFIG_SLOT_NUM) : 0;
+
+    memset(gWrite.raw, 0xFF, sizeof(gWrite.raw));
+    gWrite.image.magic = NV_CONFIG_MAGIC;
+    gWrite.image.version = NV_CONFIG_VERSION;
+    gWrite.image.size = sizeof(NvConfig_t);
+    gWrite.image.sequence = gSequence + 1U;
+    memcpy(&gWrite.image.config, config, sizeof(*config));
+    gWrite.image.crc = imageCrc(&gWrite.image);
+
+    if (!flashWrite(slot, gWrite.raw) || (memcmp(slotImage(slot), gWrite.raw, sizeof(NvConfigImage_t)) != 0))
+    {
+        return false;
+    }
+
+    gActiveSlot = slot;
+    gSequence = gWrite.image.sequence;
+
+    return true;
+}
+
+bool nvConfigErase(void)
+{
+    bool isOk = true;
+
+    for (uint8_t slot = 0; slot < NV_CONFIG_SLOT_NUM; slot++)
+    {
+        isOk = flashWrite(slot, NULL) && isOk;
+    }
+
+    gActiveSlot = NV_CONFIG_SLOT_NUM;
+
+    return isOk;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static const NvConfigImage_t *slotImage(uint8_t slot)
+{
+    return (const NvConfigImage_t *)(uintptr_t)(XIP_BASE + FLASH_OFFSET + slot * FLASH_SECTOR_SIZE);
+}
+
+static bool isValid(const NvConfigImage_t *image)
+{
+    return (image->magic == NV_CONFIG_MAGIC) &&
+           (image->version == NV_CONFIG_VERSION) &&
+           (image->size == sizeof(NvConfig_t)) &&
+           (image->crc == imageCrc(image));
+}
+
+static uint32_t imageCrc(const NvConfigImage_t *image)
+{
+    /* CRC-32 (IEEE), a nibble at a time to keep the table small. */
+    static const uint32_t table[16] = {
+        0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+        0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+        0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+        0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+    };
+    const uint8_t *data = (const uint8_t *)&image->version;
+    uint32_t size = sizeof(*image) - offsetof(NvConfigImage_t, version);
+    uint32_t crc = 0xFFFFFFFFUL;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0FU];
+        crc = (crc >> 4) ^ table[crc & 0x0FU];
+    }
+
+    return ~crc;
+}
+
+static bool flashWrite(uint8_t slot, const uint8_t *data)
+{
+    FlashJob_t job = {FLASH_OFFSET + slot * FLASH_SECTOR_SIZE, data};
+
+    /* Execution from flash stops while erasing, so the other core is */
+    /* parked for the duration. An erase takes tens of milliseconds.  */
+    return flash_safe_execute(flashJob, &job, FLASH_SAFE_TIMEOUT_MS) == PICO_OK;
+}
+
+static void __not_in_flash_func(flashJob)(void *param)
+{
+    const FlashJob_t *job = (const FlashJob_t *)param;
+
+    flash_range_erase(job->offset, FLASH_SECTOR_SIZE);
+    if (job->data != NULL)
+    {
+        flash_range_program(job->offset, job->data, IMAGE_SIZE);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef NV_CONFIG_H
+#define NV_CONFIG_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_config.h"
+#include "channel.h"
+#include "can_signal.h"
+#include "gateway.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Slot header identification. Bump the version whenever NvConfig_t changes; */
+/* an image of another version is ignored and the defaults are used.        */
+#define NV_CONFIG_MAGIC (0x4E414E43UL) /* "CNAN" */
+#define NV_CONFIG_VERSION (3U)
+
+/* Flash sectors written alternately, at the very end of flash. */
+#define NV_CONFIG_SLOT_NUM (2U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Acceptance filter as given to channelSetFilter(). */
+typedef struct
+{
+    uint32_t id;
+    uint32_t mask;
+    uint8_t flags;
+    uint8_t reserved[3];
+} NvConfigFilter_t;
+
+/* Settings restored at boot. Signals, routes and rate limits are */
+/* kept in their wire format.                                      */
+typedef struct
+{
+    uint8_t mode;              /* BRIDGE_MODE_*                     */
+    uint8_t link;              /* Host link frames are forwarded to. */
+    uint8_t dedupEnabled;
+    uint8_t routeCount;
+    uint16_t dedupKeepaliveMs;
+    uint16_t signalCount;
+    uint8_t rateCount;
+    uint8_t reserved[3];
+    NvConfigFilter_t filters[CAN_CHANNEL_NUM][CHANNEL_FILTER_NUM];
+    uint8_t signals[SIGNAL_MAX_SIGNALS][SIGNAL_DEF_WIRE_SIZE];
+    uint8_t routes[GATEWAY_MAX_ROUTES][GATEWAY_ROUTE_WIRE_SIZE];
+    uint8_t rates[RATE_MAX_RULES][RATE_RULE_WIRE_SIZE];
+    uint8_t busloads[CAN_CHANNEL_NUM][RATE_BUSLOAD_WIRE_SIZE]; /* permille 0: no cap. */
+} NvConfig_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+bool nvConfigInit(void);
+void nvConfigDefaults(NvConfig_t *config);
+bool nvConfigLoad(NvConfig_t *config);
+bool nvConfigSave(const NvConfig_t *config);
+bool nvConfigErase(void);
+
+#endif /* NV_CONFIG_H */
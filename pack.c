@@ -0,0 +1,241 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include "pack.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Key of an empty slot: no channel has it. */
+#define EMPTY_KEY (0xFFU)
+
+_Static_assert(PACK_SLOT_NUM <= PACK_SLOT_MASK + 1U, "slot numbers do not fit the op byte");
+_Static_assert(PACK_INDEX_BITS <= 8U, "index entries do not fit a slot");
+_Static_assert(CAN_CHANNEL_NUM <= 16U, "channels do not fit the key");
+_Static_assert(PACK_HEADER_SIZE + PACK_MAX_FRAME <= PROTO_MAX_PAYLOAD, "a frame does not fit a record");
+_Static_assert(sizeof(PackEncoder_t) <= PACK_RAM_BUDGET, "encoder exceeds its RAM budget");
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static void openRecord(PackEncoder_t *enc);
+static uint8_t victim(PackEncoder_t *enc);
+static uint8_t *putVarint(uint8_t *p, uint32_t value);
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void packInit(PackEncoder_t *enc)
+{
+    /* No record open and none since a reset: the next one resets. */
+    memset(enc, 0, sizeof(*enc));
+}
+
+/* Appends a frame to the open record, opening one if needed. Returns  */
+/* false, leaving the encoder as it was, if the record is too full:    */
+/* close it and try again.                                              */
+bool packFrame(PackEncoder_t *enc, const CanFrame_t *frame)
+{
+    const uint8_t key = (uint8_t)((frame->channel << 4) | (frame->flags & CAN_FLAG_EXT));
+    const uint32_t hash = (uint32_t)((frame->id ^ ((uint32_t)key << 24)) * 2654435761U);
+    const uint8_t homes[2] = {(uint8_t)(hash >> (32U - PACK_INDEX_BITS)),
+                              (uint8_t)((hash >> (32U - 2U * PACK_INDEX_BITS)) & (PACK_INDEX_NUM - 1U))};
+    PackSlot_t *slot = NULL;
+    uint8_t number = 0;
+    uint8_t home;
+    int32_t delta;
+    uint8_t op;
+    uint8_t *start;
+    uint8_t *p;
+
+    /* The channel layer and the length gate of the raw pipeline keep */
+    /* these away; a longer frame can not be told apart here.         */
+    if (frame->len > PACK_MAX_LEN)
+    {
+        return true;
+    }
+
+    /* Opening may reset the dictionary and the timestamps. */
+    if (enc->len == 0)
+    {
+        openRecord(enc);
+    }
+
+    for (uint8_t i = 0; (i < 2U) && (slot == NULL); i++)
+    {
+        number = enc->index[homes[i]];
+        if ((number != 0) && (enc->slots[number - 1U].key == key) && (enc->slots[number - 1U].id == frame->id))
+        {
+            slot = &enc->slots[number - 1U];
+        }
+    }
+
+    /* Encode past the committed payload first; nothing of the state */
+    /* changes until the frame is known to fit.                      */
+    start = &enc->payload[enc->len];
+    delta = (int32_t)(frame->timestamp - enc->last);
+    p = putVarint(start + 1, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+
+    if (slot == NULL)
+    {
+        op = PACK_OP_NEW;
+        *p++ = (uint8_t)((frame->channel << 4) | (frame->flags & 0x0FU));
+        p = putVarint(p, frame->id);
+        *p++ = frame->len;
+        memcpy(p, frame->data, frame->len);
+        p += frame->len;
+    }
+    else if ((slot->flags != frame->flags) || (slot->len != frame->len))
+    {
+        op = PACK_OP_SHAPE;
+        *p++ = frame->flags;
+        *p++ = frame->len;
+        memcpy(p, frame->data, frame->len);
+        p += frame->len;
+    }
+    else
+    {
+        uint8_t *bitmap = p;
+        uint32_t size = (frame->len + 7U) / 8U;
+
+        memset(bitmap, 0, size);
+        p += size;
+        for (uint32_t i = 0; i < frame->len; i++)
+        {
+            uint8_t diff = (uint8_t)(frame->data[i] ^ slot->data[i]);
+
+            if (diff != 0)
+            {
+                bitmap[i / 8U] |= (uint8_t)(1U << (i % 8U));
+                *p++ = diff;
+            }
+        }
+
+        /* Nothing changed: drop the bitmap. */
+        op = (p == bitmap + size) ? PACK_OP_REPEAT : PACK_OP_XOR;
+        p = (op == PACK_OP_REPEAT) ? bitmap : p;
+    }
+
+    if ((uint32_t)(p - enc->payload) > PROTO_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    /* Commit. A new identifier takes a slot from the clock hand, and a */
+    /* free one of its two index entries, or else the first: the        */
+    /* identifier found there loses its entry and reads as new next.    */
+    if (slot == NULL)
+    {
+        number = (uint8_t)(victim(enc) + 1U);
+        slot = &enc->slots[number - 1U];
+        home = (enc->index[homes[0]] == 0) ? homes[0] : ((enc->index[homes[1]] == 0) ? homes[1] : homes[0]);
+        enc->index[home] = number;
+        slot->home = home;
+    }
+
+    *start = (uint8_t)(op | (number - 1U));
+    enc->len = (uint8_t)(p - enc->payload);
+    enc->last = frame->timestamp;
+    slot->id = frame->id;
+    slot->key = key;
+    slot->flags = frame->flags;
+    slot->len = frame->len;
+    slot->isUsed = 1;
+    memcpy(slot->data, frame->data, frame->len);
+
+    return true;
+}
+
+/* Ends the open record and returns its payload length, or 0 if there */
+/* are no frames to send. The payload stays in enc->payload until the */
+/* next packFrame().                                                   */
+uint8_t packClose(PackEncoder_t *enc)
+{
+    uint8_t len = enc->len;
+
+    if (!packIsOpen(enc))
+    {
+        return 0;
+    }
+
+    enc->len = 0;
+    enc->seq++;
+    enc->sent = (enc->sent + len >= PACK_RESET_BYTES) ? 0U : (uint16_t)(enc->sent + len);
+
+    return len;
+}
+
+/* Makes the next record opened a reset, for a decoder that missed one: */
+/* at once when none is open, else once the open one is closed.         */
+void packResync(PackEncoder_t *enc)
+{
+    enc->sent = (enc->len != 0) ? (uint16_t)(PACK_RESET_BYTES - 1U) : 0U;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static void openRecord(PackEncoder_t *enc)
+{
+    bool isReset = (enc->sent == 0);
+
+    enc->payload[0] = enc->seq;
+    enc->payload[1] = isReset ? PACK_FLAG_RESET : 0;
+    enc->len = PACK_HEADER_SIZE;
+
+    if (isReset)
+    {
+        memset(enc->index, 0, sizeof(enc->index));
+        for (uint8_t i = 0; i < PACK_SLOT_NUM; i++)
+        {
+            enc->slots[i].key = EMPTY_KEY;
+            enc->slots[i].isUsed = 0;
+        }
+        enc->hand = 0;
+        enc->last = 0;
+    }
+}
+
+/* Second chance replacement: the hand passes over slots hit since its */
+/* last turn, once, so at most two turns.                               */
+static uint8_t victim(PackEncoder_t *enc)
+{
+    while (true)
+    {
+        PackSlot_t *slot = &enc->slots[enc->hand];
+        uint8_t number = enc->hand;
+
+        enc->hand = (uint8_t)((enc->hand + 1U) % PACK_SLOT_NUM);
+
+        if (slot->key == EMPTY_KEY)
+        {
+            return number;
+        }
+
+        /* The slot's identifier goes: so does its index entry, unless */
+        /* another identifier took that since.                         */
+        if (!slot->isUsed)
+        {
+            if (enc->index[slot->home] == number + 1U)
+            {
+                enc->index[slot->home] = 0;
+            }
+            return number;
+        }
+        slot->isUsed = 0;
+    }
+}
+
+static uint8_t *putVarint(uint8_t *p, uint32_t value)
+{
+    while (value >= 0x80U)
+    {
+        *p++ = (uint8_t)(value | 0x80U);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+
+    return p;
+}
@@ -0,0 +1,113 @@
+#ifndef PACK_H
+#define PACK_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_config.h"
+#include "can_frame.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* PROTO_REC_PACKED payload: seq u8, flags u8, then frames back to back.   */
+/* Every frame starts with an op in bits 6-7 and a dictionary slot in      */
+/* bits 0-5, then the zigzag varint of its timestamp minus the previous    */
+/* frame's:                                                                */
+/*                                                                          */
+/*     PACK_OP_XOR     as the slot's last frame, then a bitmap of the      */
+/*                     payload bytes that changed, (len + 7) / 8 bytes,    */
+/*                     and each changed byte XOR its last value            */
+/*     PACK_OP_REPEAT  the slot's last frame again                          */
+/*     PACK_OP_NEW     channel << 4 | flags u8, id varint, len u8, payload; */
+/*                     the slot takes the new identifier                    */
+/*     PACK_OP_SHAPE   flags u8, len u8, payload, for the slot's identifier */
+/*                                                                          */
+/* Slots hold the last frame of an identifier on a channel. A record with */
+/* PACK_FLAG_RESET empties them and restarts the timestamps from 0, so a  */
+/* decoder joining the stream, or one that missed a record (a gap in seq), */
+/* waits for the next reset, or asks for one with PROTO_CMD_PACK_RESYNC.   */
+#define PACK_OP_XOR (0x00U)
+#define PACK_OP_REPEAT (0x40U)
+#define PACK_OP_NEW (0x80U)
+#define PACK_OP_SHAPE (0xC0U)
+#define PACK_OP_MASK (0xC0U)
+#define PACK_SLOT_MASK (0x3FU)
+
+#define PACK_FLAG_RESET (0x01U)
+
+#define PACK_HEADER_SIZE (2U)
+
+/* Dictionary slots, at most PACK_SLOT_MASK + 1, and the hash index over */
+/* them, where an identifier has two entries to choose from.             */
+#define PACK_SLOT_NUM (64U)
+#define PACK_INDEX_BITS (8U)
+#define PACK_INDEX_NUM (1U << PACK_INDEX_BITS)
+
+/* Payload bytes between resets. Counted in bytes, not records, as a */
+/* quiet bus closes records after a frame or two. Bounds what a lost  */
+/* record costs a decoder that does not ask for a resync.             */
+#define PACK_RESET_BYTES (4096U)
+
+/* Longest payload of this build. */
+#define PACK_MAX_LEN (CAN_FD_ENABLED ? CAN_FRAME_MAX_LEN : 8U)
+
+/* Longest encoded frame: op, 5 byte delta, bitmap or the NEW fields, */
+/* and the payload.                                                   */
+#define PACK_MAX_FRAME (1U + 5U + (PACK_MAX_LEN / 8U > 7U ? PACK_MAX_LEN / 8U : 7U) + PACK_MAX_LEN)
+
+/* RAM of an encoder, whatever the traffic. */
+#define PACK_RAM_BUDGET (6144U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Last frame of a dictionary slot. */
+typedef struct
+{
+    uint32_t id;
+    uint8_t key;   /* channel << 4 | CAN_FLAG_EXT, 0xFF when empty. */
+    uint8_t flags; /* CAN_FLAG_*                                     */
+    uint8_t len;
+    uint8_t isUsed; /* Hit since the clock hand last passed. */
+    uint8_t home;   /* Index entry.                          */
+    uint8_t data[PACK_MAX_LEN];
+} PackSlot_t;
+
+/* Stream encoder of one host link. The record being filled has room */
+/* for one encoded frame past the payload limit, where a frame that   */
+/* turns out not to fit is left without being committed.              */
+typedef struct
+{
+    PackSlot_t slots[PACK_SLOT_NUM];
+    uint8_t index[PACK_INDEX_NUM]; /* Slot + 1, 0 when empty. */
+    uint8_t payload[PROTO_MAX_PAYLOAD + PACK_MAX_FRAME];
+    uint8_t len;      /* Payload bytes, 0 when no record is open. */
+    uint8_t seq;      /* Of the record being filled.             */
+    uint8_t hand;     /* Clock hand for slot replacement.        */
+    uint16_t sent;    /* Payload bytes since the last reset.     */
+    uint32_t last;    /* Timestamp of the previous frame.        */
+} PackEncoder_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void packInit(PackEncoder_t *enc);
+bool packFrame(PackEncoder_t *enc, const CanFrame_t *frame);
+uint8_t packClose(PackEncoder_t *enc);
+void packResync(PackEncoder_t *enc);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+static inline bool packIsOpen(const PackEncoder_t *enc)
+{
+    return enc->len > PACK_HEADER_SIZE;
+}
+
+#endif /* PACK_H */
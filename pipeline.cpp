@@ -0,0 +1,79 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+extern "C"
+{
+#include "can_config.h"
+#include "dedup.h"
+#include "stats.h"
+#include "trace.h"
+}
+#include "pipeline.h"
+#include "pipeline.hpp"
+
+using namespace canaan;
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Longest payload of this build. */
+#define MAX_LEN (CAN_FD_ENABLED ? CAN_FRAME_MAX_LEN : 8U)
+
+/* -------------------------------------------------------------------------- */
+/* Stages                                                                     */
+/* -------------------------------------------------------------------------- */
+namespace
+{
+
+/* Drops identical repeats. The summary of a finished run of repeats */
+/* precedes the frame that ended it.                                  */
+struct DedupStage
+{
+    static bool apply(PipelineContext &ctx)
+    {
+        DedupSummary_t summary;
+        bool hasSummary;
+        bool isForwarded = dedupFilter(ctx.frame, &summary, &hasSummary);
+
+        traceRecord(TRACE_EV_FILTER, isForwarded, ctx.frame->id);
+
+        if (hasSummary)
+        {
+            (void)putRecord<PROTO_REC_SUPPRESSED>(ctx, 14U, [&](uint8_t *p) {
+                protoPutU32(&p[0], summary.id);
+                p[4] = summary.channel;
+                p[5] = summary.flags;
+                protoPutU32(&p[6], summary.count);
+                protoPutU32(&p[10], summary.lastTimestamp);
+            });
+        }
+
+        return isForwarded;
+    }
+};
+
+/* Frames reach the pipeline decoded, accepted and timestamped by the */
+/* channel layer; what is left is specialised for this build here.    */
+using RawPipeline = Pipeline<ChannelGate<CAN_CHANNEL_NUM>,
+                             LengthGate<MAX_LEN>,
+                             DedupStage,
+                             EncodeFrame<MAX_LEN>>;
+
+} /* namespace */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+extern "C" uint32_t pipelineRaw(const CanFrame_t *frame, uint8_t *out, uint32_t size)
+{
+    PipelineContext ctx = RawPipeline::run(*frame, out, size);
+
+    if (ctx.records > 0)
+    {
+        statsAdd(STAT_RECORDS_OUT, ctx.records);
+        traceRecord(TRACE_EV_ENQUEUE, PROTO_REC_FRAME, ctx.tail);
+    }
+
+    return ctx.tail;
+}
@@ -0,0 +1,27 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include "can_frame.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/* Runs a received frame through the raw mode pipeline (see pipeline.cpp) */
+/* and returns the number of record bytes written to out.                */
+uint32_t pipelineRaw(const CanFrame_t *frame, uint8_t *out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,169 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+extern "C"
+{
+#include "can_frame.h"
+#include "protocol.h"
+}
+
+namespace canaan
+{
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* State handed from stage to stage for one frame. */
+struct PipelineContext
+{
+    const CanFrame_t *frame;
+    uint8_t *out;     /* Record buffer.                    */
+    uint32_t size;    /* Capacity of out.                  */
+    uint32_t tail;    /* Bytes written so far.             */
+    uint32_t records; /* Records written so far.           */
+};
+
+/* Stage chain. Every stage is a type with                              */
+/*     static bool apply(PipelineContext &ctx);                         */
+/* run in order until one returns false. The chain is resolved at       */
+/* compile time, so each stage inlines into the next with its template  */
+/* parameters as constants: no indirect calls and no configuration      */
+/* checks per frame.                                                    */
+template <typename... Stages>
+struct Pipeline
+{
+    static PipelineContext run(const CanFrame_t &frame, uint8_t *out, uint32_t size)
+    {
+        PipelineContext ctx{&frame, out, size, 0, 0};
+
+        (void)(Stages::apply(ctx) && ...);
+
+        return ctx;
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+/* Function                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* CRC-8 (poly 0x07) lookup table, same polynomial as protoCrc8(). */
+constexpr std::array<uint8_t, 256> makeProtoCrc8Table()
+{
+    std::array<uint8_t, 256> table{};
+
+    for (unsigned i = 0; i < 256; i++)
+    {
+        uint8_t crc = static_cast<uint8_t>(i);
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80U) ? static_cast<uint8_t>((crc << 1) ^ 0x07U) : static_cast<uint8_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+
+    return table;
+}
+
+inline constexpr std::array<uint8_t, 256> kProtoCrc8Table = makeProtoCrc8Table();
+
+static_assert(kProtoCrc8Table[1] == 0x07U, "CRC-8 table does not match protoCrc8()");
+
+inline uint8_t protoCrc8Fast(uint8_t crc, const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc = kProtoCrc8Table[crc ^ data[i]];
+    }
+
+    return crc;
+}
+
+/* Appends a record whose payload the caller writes through fill(uint8_t *). */
+/* Fails without writing anything if the record does not fit.                */
+template <uint8_t Type, typename Fill>
+inline bool putRecord(PipelineContext &ctx, uint8_t len, Fill &&fill)
+{
+    const uint32_t total = PROTO_HEADER_SIZE + len + PROTO_TRAILER_SIZE;
+    uint8_t *rec = &ctx.out[ctx.tail];
+
+    if (ctx.size - ctx.tail < total)
+    {
+        return false;
+    }
+
+    rec[0] = PROTO_SYNC;
+    rec[1] = Type;
+    rec[2] = len;
+    fill(&rec[PROTO_HEADER_SIZE]);
+    rec[total - 1U] = protoCrc8Fast(0, &rec[1], 2U + len);
+
+    ctx.tail += total;
+    ctx.records++;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Stages                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/* Drops frames of channels this build does not have. */
+template <uint8_t ChannelNum>
+struct ChannelGate
+{
+    static bool apply(PipelineContext &ctx)
+    {
+        if constexpr (ChannelNum == 1U)
+        {
+            return ctx.frame->channel == 0;
+        }
+        else
+        {
+            return ctx.frame->channel < ChannelNum;
+        }
+    }
+};
+
+/* Drops frames longer than the build carries. (8 without CAN FD) */
+template <uint8_t MaxLen>
+struct LengthGate
+{
+    static bool apply(PipelineContext &ctx)
+    {
+        return ctx.frame->len <= MaxLen;
+    }
+};
+
+/* Encodes a PROTO_REC_FRAME. With MaxLen 8 the payload copy is a bounded */
+/* copy the compiler can unroll.                                          */
+template <uint8_t MaxLen>
+struct EncodeFrame
+{
+    static bool apply(PipelineContext &ctx)
+    {
+        const CanFrame_t &frame = *ctx.frame;
+        const uint8_t len = (frame.len < MaxLen) ? frame.len : MaxLen;
+
+        return putRecord<PROTO_REC_FRAME>(ctx, static_cast<uint8_t>(11U + len), [&](uint8_t *p) {
+            protoPutU32(&p[0], frame.timestamp);
+            protoPutU32(&p[4], frame.id);
+            p[8] = frame.channel;
+            p[9] = frame.flags;
+            p[10] = len;
+            std::memcpy(&p[11], frame.data, len);
+        });
+    }
+};
+
+} /* namespace canaan */
+
+#endif /* PIPELINE_HPP */
@@ -0,0 +1,113 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define STATE_SYNC (0U)
+#define STATE_TYPE (1U)
+#define STATE_LEN (2U)
+#define STATE_PAYLOAD (3U)
+#define STATE_CRC (4U)
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void protoParserInit(ProtoParser_t *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->state = STATE_SYNC;
+}
+
+void protoParserFeed(ProtoParser_t *parser, const uint8_t *data, uint32_t size,
+                     ProtoHandler_t handler, void *ctx)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        uint8_t b = data[i];
+
+        switch (parser->state)
+        {
+        case STATE_SYNC:
+            if (b == PROTO_SYNC)
+            {
+                parser->state = STATE_TYPE;
+            }
+            break;
+
+        case STATE_TYPE:
+            parser->type = b;
+            parser->crc = protoCrc8(0, &b, 1);
+            parser->state = STATE_LEN;
+            break;
+
+        case STATE_LEN:
+            parser->len = b;
+            parser->pos = 0;
+            parser->crc = protoCrc8(parser->crc, &b, 1);
+            parser->state = (b == 0) ? STATE_CRC : STATE_PAYLOAD;
+            break;
+
+        case STATE_PAYLOAD:
+            parser->payload[parser->pos++] = b;
+            if (parser->pos == parser->len)
+            {
+                parser->crc = protoCrc8(parser->crc, parser->payload, parser->len);
+                parser->state = STATE_CRC;
+            }
+            break;
+
+        default: /* STATE_CRC */
+            if (b == parser->crc)
+            {
+                handler(parser->type, parser->payload, parser->len, ctx);
+            }
+            else
+            {
+                /* Drop the record and hunt for the next sync byte. */
+                parser->crcErrors++;
+            }
+            parser->state = STATE_SYNC;
+            break;
+        }
+    }
+}
+
+uint32_t protoEncode(uint8_t type, const uint8_t *payload, uint8_t len,
+                     uint8_t *out, uint32_t outSize)
+{
+    uint32_t total = PROTO_HEADER_SIZE + len + PROTO_TRAILER_SIZE;
+
+    if (outSize < total)
+    {
+        return 0;
+    }
+
+    out[0] = PROTO_SYNC;
+    out[1] = type;
+    out[2] = len;
+    if (len > 0)
+    {
+        memcpy(&out[PROTO_HEADER_SIZE], payload, len);
+    }
+    out[total - 1] = protoCrc8(0, &out[1], 2U + len);
+
+    return total;
+}
+
+uint8_t protoCrc8(uint8_t crc, const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80U) ? (uint8_t)((crc << 1) ^ 0x07U) : (uint8_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
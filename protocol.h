@@ -0,0 +1,140 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Record layout on the wire (all multi-byte fields are little-endian):     */
+/*                                                                          */
+/*     +------+------+-----+-------------+-------+                          */
+/*     | SYNC | TYPE | LEN | PAYLOAD ... | CRC-8 |                          */
+/*     +------+------+-----+-------------+-------+                          */
+/*                                                                          */
+/* The CRC-8 (poly 0x07) covers TYPE, LEN and PAYLOAD.                      */
+#define PROTO_SYNC (0xA5U)
+#define PROTO_HEADER_SIZE (3U)
+#define PROTO_TRAILER_SIZE (1U)
+#define PROTO_MAX_PAYLOAD (255U)
+#define PROTO_MAX_RECORD (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD + PROTO_TRAILER_SIZE)
+
+/* Host to device commands. */
+#define PROTO_CMD_SET_MODE (0x01U)
+#define PROTO_CMD_GET_STATS (0x02U)
+#define PROTO_CMD_SET_DEDUP (0x03U)
+#define PROTO_CMD_TRACE_START (0x04U)
+#define PROTO_CMD_TRACE_STOP (0x05U)
+#define PROTO_CMD_TRACE_DUMP (0x06U)
+#define PROTO_CMD_CONFIG_SAVE (0x07U)
+#define PROTO_CMD_CONFIG_ERASE (0x08U)
+#define PROTO_CMD_GET_MEMORY (0x09U)
+#define PROTO_CMD_CLOCK_PING (0x0AU)
+#define PROTO_CMD_PACK_RESYNC (0x0BU)
+#define PROTO_CMD_SIGNAL_CLEAR (0x10U)
+#define PROTO_CMD_SIGNAL_ADD (0x11U)
+#define PROTO_CMD_SIGNAL_COMMIT (0x12U)
+#define PROTO_CMD_TX_FRAME (0x20U)
+#define PROTO_CMD_SET_FILTER (0x21U)
+#define PROTO_CMD_ROUTE_CLEAR (0x30U)
+#define PROTO_CMD_ROUTE_ADD (0x31U)
+#define PROTO_CMD_ROUTE_COMMIT (0x32U)
+#define PROTO_CMD_RATE_CLEAR (0x40U)
+#define PROTO_CMD_RATE_ADD (0x41U)
+#define PROTO_CMD_RATE_BUSLOAD (0x42U)
+#define PROTO_CMD_RATE_COMMIT (0x43U)
+#define PROTO_CMD_SELFTEST_START (0x50U)
+#define PROTO_CMD_SELFTEST_STOP (0x51U)
+#define PROTO_CMD_SELFTEST_REPORT (0x52U)
+
+/* Device to host records. */
+#define PROTO_REC_ACK (0x80U)
+#define PROTO_REC_FRAME (0x81U)
+#define PROTO_REC_SIGNAL (0x82U)
+#define PROTO_REC_STATS (0x83U)
+#define PROTO_REC_SUPPRESSED (0x84U)
+#define PROTO_REC_TRACE (0x85U)
+#define PROTO_REC_MEMORY (0x86U)
+#define PROTO_REC_CLOCK (0x87U)
+#define PROTO_REC_PACKED (0x88U)
+#define PROTO_REC_SELFTEST (0x89U)
+
+/* Result codes carried by PROTO_REC_ACK. */
+#define PROTO_ACK_OK (0x00U)
+#define PROTO_ACK_INVALID (0x01U)
+#define PROTO_ACK_NO_SPACE (0x02U)
+#define PROTO_ACK_UNKNOWN (0x03U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Called for every complete record with a valid CRC. */
+typedef void (*ProtoHandler_t)(uint8_t type, const uint8_t *payload, uint8_t len, void *ctx);
+
+/* Incremental record parser. */
+typedef struct
+{
+    uint8_t state;
+    uint8_t type;
+    uint8_t len;
+    uint8_t pos;
+    uint8_t crc;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    uint32_t crcErrors;
+} ProtoParser_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void protoParserInit(ProtoParser_t *parser);
+void protoParserFeed(ProtoParser_t *parser, const uint8_t *data, uint32_t size,
+                     ProtoHandler_t handler, void *ctx);
+uint32_t protoEncode(uint8_t type, const uint8_t *payload, uint8_t len,
+                     uint8_t *out, uint32_t outSize);
+uint8_t protoCrc8(uint8_t crc, const uint8_t *data, uint32_t size);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+static inline void protoPutU16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void protoPutU32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void protoPutU64(uint8_t *p, uint64_t v)
+{
+    protoPutU32(&p[0], (uint32_t)v);
+    protoPutU32(&p[4], (uint32_t)(v >> 32));
+}
+
+static inline uint16_t protoGetU16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t protoGetU32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t protoGetU64(const uint8_t *p)
+{
+    return (uint64_t)protoGetU32(&p[0]) | ((uint64_t)protoGetU32(&p[4]) << 32);
+}
+
+#endif /* PROTOCOL_H */
@@ -0,0 +1,252 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stddef.h>
+#include <string.h>
+#include "rate_limit.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define NS_PER_S (1000000000ULL)
+#define NS_PER_MS (1000000ULL)
+
+/* Bits after the CRC: delimiter, ACK slot and delimiter, EOF, intermission. */
+#define TRAILER_BITS (13U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static RateBucket_t *lookup(RateTable_t *table, uint8_t ch, const CanFrame_t *frame);
+static uint64_t releaseTime(const RateBucket_t *bucket, uint64_t now, uint64_t cost);
+static void charge(RateBucket_t *bucket, uint64_t now, uint64_t cost);
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+bool rateDecodeRule(const uint8_t *wire, RateRule_t *rule)
+{
+    rule->channel = wire[0];
+    rule->flags = wire[1];
+    rule->first = protoGetU32(&wire[2]);
+    rule->last = protoGetU32(&wire[6]);
+    rule->rate = protoGetU32(&wire[10]);
+    rule->burst = protoGetU16(&wire[14]);
+
+    return (rule->channel < CAN_CHANNEL_NUM) &&
+           (rule->first <= rule->last) &&
+           (rule->rate != 0) &&
+           (rule->burst != 0);
+}
+
+bool rateDecodeBusload(const uint8_t *wire, RateBusload_t *busload)
+{
+    busload->channel = wire[0];
+    busload->flags = wire[1];
+    busload->bitrate = protoGetU32(&wire[2]);
+    busload->dataBitrate = protoGetU32(&wire[6]);
+    busload->permille = protoGetU16(&wire[10]);
+    busload->burstMs = protoGetU16(&wire[12]);
+
+    if (busload->dataBitrate == 0)
+    {
+        busload->dataBitrate = busload->bitrate;
+    }
+
+    return (busload->channel < CAN_CHANNEL_NUM) &&
+           (busload->permille <= 1000U) &&
+           ((busload->permille == 0) || (busload->bitrate != 0));
+}
+
+void rateTableBuild(RateTable_t *table, const RateRule_t *rules, uint8_t count, const RateBusload_t *busloads)
+{
+    memset(table, 0, sizeof(*table));
+    memset(table->stdBucket, RATE_NO_BUCKET, sizeof(table->stdBucket));
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const RateRule_t *rule = &rules[i];
+        RateBucket_t *bucket = &table->buckets[i];
+
+        bucket->cost = NS_PER_S / rule->rate;
+        bucket->tolerance = bucket->cost * rule->burst;
+        bucket->flags = rule->flags;
+
+        if (rule->flags & RATE_FLAG_EXT)
+        {
+            table->extFirst[i] = rule->first;
+            table->extLast[i] = rule->last;
+            table->extRules[rule->channel] |= (uint16_t)(1U << i);
+            continue;
+        }
+
+        /* Overlapping ranges: the first rule keeps an identifier. */
+        for (uint32_t id = rule->first; (id <= rule->last) && (id < RATE_STD_ID_NUM); id++)
+        {
+            if (table->stdBucket[rule->channel][id] == RATE_NO_BUCKET)
+            {
+                table->stdBucket[rule->channel][id] = i;
+            }
+        }
+    }
+
+    for (uint8_t ch = 0; ch < CAN_CHANNEL_NUM; ch++)
+    {
+        const RateBusload_t *busload = &busloads[ch];
+        RateBusBucket_t *bus = &table->busload[ch];
+
+        if (busload->permille == 0)
+        {
+            continue;
+        }
+
+        /* A bit takes 1e9 / bitrate ns; at the cap it costs 1000 / permille */
+        /* times that. The fraction is kept as 1/256 ns.                    */
+        bus->nominalCost = (NS_PER_S * 1000ULL * 256ULL) / ((uint64_t)busload->bitrate * busload->permille);
+        bus->dataCost = (NS_PER_S * 1000ULL * 256ULL) / ((uint64_t)busload->dataBitrate * busload->permille);
+        bus->bucket.tolerance = busload->burstMs * NS_PER_MS;
+        bus->bucket.flags = busload->flags & RATE_FLAG_DROP;
+    }
+}
+
+RateVerdict_t rateTableAdmit(RateTable_t *table, uint8_t ch, const CanFrame_t *frame, uint64_t now, uint64_t *release)
+{
+    RateBucket_t *bucket = lookup(table, ch, frame);
+    RateBusBucket_t *bus = &table->busload[ch];
+    uint64_t busCost = 0;
+    uint64_t at = now;
+    bool isDrop = false;
+
+    if (bucket != NULL)
+    {
+        uint64_t t = releaseTime(bucket, now, bucket->cost);
+
+        if (t > now)
+        {
+            at = t;
+            isDrop = (bucket->flags & RATE_FLAG_DROP) != 0;
+        }
+    }
+
+    if (bus->nominalCost != 0)
+    {
+        uint32_t nominal;
+        uint32_t data;
+        uint64_t t;
+
+        rateFrameBits(frame, &nominal, &data);
+        busCost = (nominal * bus->nominalCost + data * bus->dataCost) >> 8;
+
+        t = releaseTime(&bus->bucket, now, busCost);
+        if (t > now)
+        {
+            at = (t > at) ? t : at;
+            isDrop |= (bus->bucket.flags & RATE_FLAG_DROP) != 0;
+        }
+    }
+
+    /* Nothing is charged unless the frame goes: a shaped frame is */
+    /* admitted again, in full, at its release.                    */
+    if (at > now)
+    {
+        *release = at;
+        return isDrop ? RATE_DROP : RATE_SHAPE;
+    }
+
+    if (bucket != NULL)
+    {
+        charge(bucket, now, bucket->cost);
+    }
+    if (bus->nominalCost != 0)
+    {
+        charge(&bus->bucket, now, busCost);
+    }
+
+    return RATE_PASS;
+}
+
+/* Bits of a frame on the bus with worst case stuffing. A frame with bit */
+/* rate switch sends data bits at the data rate, the rest nominal ones.  */
+void rateFrameBits(const CanFrame_t *frame, uint32_t *nominal, uint32_t *data)
+{
+    bool isExt = (frame->flags & CAN_FLAG_EXT) != 0;
+    uint32_t payload = (frame->flags & CAN_FLAG_RTR) ? 0 : frame->len * 8U;
+    uint32_t arbitration;
+    uint32_t control;
+
+    if (!(frame->flags & CAN_FLAG_FD))
+    {
+        /* SOF to CRC is stuffed, a stuff bit every 4 at worst. */
+        uint32_t stuffed = (isExt ? 54U : 34U) + payload;
+
+        *nominal = stuffed + (stuffed - 1U) / 4U + TRAILER_BITS;
+        *data = 0;
+        return;
+    }
+
+    /* SOF to BRS, then ESI, DLC and payload with dynamic stuffing, then */
+    /* stuff count and CRC with a fixed stuff bit every 4.              */
+    arbitration = isExt ? 36U : 17U;
+    arbitration += (arbitration - 1U) / 4U;
+    control = 5U + payload;
+    control += control / 4U + (4U + ((frame->len > 16U) ? 21U : 17U)) * 5U / 4U;
+
+    if (frame->flags & CAN_FLAG_BRS)
+    {
+        *nominal = arbitration + TRAILER_BITS;
+        *data = control;
+    }
+    else
+    {
+        *nominal = arbitration + control + TRAILER_BITS;
+        *data = 0;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static RateBucket_t *lookup(RateTable_t *table, uint8_t ch, const CanFrame_t *frame)
+{
+    uint32_t ext;
+
+    if (!(frame->flags & CAN_FLAG_EXT))
+    {
+        uint8_t index = table->stdBucket[ch][frame->id & CAN_STD_ID_MASK];
+
+        return (index != RATE_NO_BUCKET) ? &table->buckets[index] : NULL;
+    }
+
+    /* At most RATE_MAX_RULES ranges, first match wins. */
+    for (ext = table->extRules[ch]; ext != 0; ext &= ext - 1U)
+    {
+        uint32_t index = (uint32_t)__builtin_ctz(ext);
+
+        if ((frame->id >= table->extFirst[index]) && (frame->id <= table->extLast[index]))
+        {
+            return &table->buckets[index];
+        }
+    }
+
+    return NULL;
+}
+
+/* Earliest time the bucket takes a frame of cost, now if it does already. */
+static uint64_t releaseTime(const RateBucket_t *bucket, uint64_t now, uint64_t cost)
+{
+    uint64_t tat = (bucket->tat > now) ? bucket->tat : now;
+
+    /* A full bucket takes one frame even if it costs more than the burst. */
+    if ((tat == now) || (tat + cost <= now + bucket->tolerance))
+    {
+        return now;
+    }
+
+    return tat + cost - bucket->tolerance;
+}
+
+static void charge(RateBucket_t *bucket, uint64_t now, uint64_t cost)
+{
+    bucket->tat = ((bucket->tat > now) ? bucket->tat : now) + cost;
+}
@@ -0,0 +1,119 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_config.h"
+#include "can_frame.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Capacity of the rule table. (one bit per rule in the extended rule masks) */
+#define RATE_MAX_RULES (16U)
+
+/* Standard identifiers indexed directly. */
+#define RATE_STD_ID_NUM (CAN_STD_ID_MASK + 1U)
+
+/* Standard identifier without a rule. */
+#define RATE_NO_BUCKET (0xFFU)
+
+/* Rule and busload cap flags. */
+#define RATE_FLAG_EXT (0x01U)  /* Match 29-bit identifiers.                    */
+#define RATE_FLAG_DROP (0x02U) /* Drop excess frames instead of delaying them. */
+
+/* PROTO_CMD_RATE_ADD payload, one or more rules of:                        */
+/*                                                                          */
+/*     channel u8, flags u8, first u32, last u32, rate u32, burst u16       */
+/*                                                                          */
+/* Frames of channel with an identifier in [first, last] share one bucket */
+/* of burst frames, refilled at rate frames per second.                    */
+#define RATE_RULE_WIRE_SIZE (16U)
+
+/* PROTO_CMD_RATE_BUSLOAD payload:                                          */
+/*                                                                          */
+/*     channel u8, flags u8, bitrate u32, dataBitrate u32, permille u16,    */
+/*     burstMs u16                                                          */
+/*                                                                          */
+/* Caps the bus time taken by all frames sent on channel to permille of   */
+/* the bus, averaged over burstMs. A permille of 0 removes the cap.        */
+#define RATE_BUSLOAD_WIRE_SIZE (14U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Rate limit of an identifier range. */
+typedef struct
+{
+    uint32_t first;
+    uint32_t last;
+    uint32_t rate;  /* Frames per second. */
+    uint16_t burst; /* Frames.            */
+    uint8_t channel;
+    uint8_t flags; /* RATE_FLAG_* */
+} RateRule_t;
+
+/* Busload cap of a channel. */
+typedef struct
+{
+    uint32_t bitrate;     /* Nominal bit rate, bit/s.           */
+    uint32_t dataBitrate; /* Data phase bit rate of BRS frames. */
+    uint16_t permille;
+    uint16_t burstMs;
+    uint8_t channel;
+    uint8_t flags; /* RATE_FLAG_DROP */
+} RateBusload_t;
+
+/* Token bucket in its virtual scheduling form: instead of a token count, */
+/* tat is the time at which the bucket is full again. A frame fits while  */
+/* it leaves tat no further than tolerance ahead of now. Times are in ns. */
+typedef struct
+{
+    uint64_t tat;
+    uint64_t tolerance;
+    uint64_t cost; /* Per frame, for an identifier rule. */
+    uint8_t flags;
+} RateBucket_t;
+
+/* Busload bucket of a channel, costs per bit in 1/256 ns. */
+typedef struct
+{
+    RateBucket_t bucket;
+    uint64_t nominalCost;
+    uint64_t dataCost;
+} RateBusBucket_t;
+
+/* Compiled rules. A standard identifier selects its bucket directly;    */
+/* extended identifiers are compared with the channel's extended ranges. */
+typedef struct
+{
+    RateBucket_t buckets[RATE_MAX_RULES];
+    RateBusBucket_t busload[CAN_CHANNEL_NUM];
+    uint32_t extFirst[RATE_MAX_RULES];
+    uint32_t extLast[RATE_MAX_RULES];
+    uint16_t extRules[CAN_CHANNEL_NUM];
+    uint8_t stdBucket[CAN_CHANNEL_NUM][RATE_STD_ID_NUM];
+} RateTable_t;
+
+typedef enum
+{
+    RATE_PASS = 0, /* Send now.                        */
+    RATE_SHAPE,    /* Keep the frame until the release. */
+    RATE_DROP      /* Discard the frame.               */
+} RateVerdict_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+bool rateDecodeRule(const uint8_t *wire, RateRule_t *rule);
+bool rateDecodeBusload(const uint8_t *wire, RateBusload_t *busload);
+void rateTableBuild(RateTable_t *table, const RateRule_t *rules, uint8_t count, const RateBusload_t *busloads);
+RateVerdict_t rateTableAdmit(RateTable_t *table, uint8_t ch, const CanFrame_t *frame, uint64_t now, uint64_t *release);
+void rateFrameBits(const CanFrame_t *frame, uint32_t *nominal, uint32_t *data);
+
+#endif /* RATE_LIMIT_H */
@@ -0,0 +1,261 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "self_test.h"
+#include "channel.h"
+#include "mcp251xfd.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define NS_PER_US (1000ULL)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static void begin(void);
+static void generate(uint64_t now);
+static void finish(void);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static TaskHandle_t gTaskHndl = NULL;
+
+/* Run state. The receive path updates gCheck under gLock; the rest */
+/* belongs to the task, with gRun.state read anywhere.              */
+static TrafficGen_t gGen;
+static TrafficCheck_t gCheck;
+static TrafficRun_t gRun;
+static spin_lock_t *gLock = NULL;
+static volatile bool gIsChecking = false;
+
+/* Set by the commands, taken by the task. */
+static TrafficConfig_t gRequest;
+static volatile bool gIsStartRequested = false;
+static volatile bool gIsStopRequested = false;
+static volatile bool gIsResultReady = false;
+
+/* The frame waiting for its time or for room in the TX queue. */
+static CanFrame_t gNext;
+static uint64_t gNextDue = 0;
+static uint64_t gStart = 0;    /* time_us_64() at the start of the run. */
+static uint64_t gDrainEnd = 0; /* End of the wait for the last frames.  */
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void selfTestInit(void)
+{
+    memset(&gGen, 0, sizeof(gGen));
+    trafficCheckInit(&gCheck);
+    memset(&gRun, 0, sizeof(gRun));
+    gRun.state = TRAFFIC_STATE_IDLE;
+    gLock = spin_lock_instance((uint)spin_lock_claim_unused(true));
+}
+
+/* Paces the generator on the tick: every wake sends the frames that */
+/* fell due since the last one, so bursts within a tick are as tight */
+/* as the TX path takes them.                                        */
+void selfTestTask(void *nouse)
+{
+    gTaskHndl = xTaskGetCurrentTaskHandle();
+
+    while (true)
+    {
+        uint64_t now;
+
+        if ((gRun.state != TRAFFIC_STATE_RUNNING) && (gRun.state != TRAFFIC_STATE_DRAINING))
+        {
+            (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        else
+        {
+            (void)ulTaskNotifyTake(pdTRUE, 1);
+        }
+
+        if (gIsStartRequested)
+        {
+            gIsStartRequested = false;
+            begin();
+        }
+
+        now = (time_us_64() - gStart) * NS_PER_US;
+
+        if (gRun.state == TRAFFIC_STATE_RUNNING)
+        {
+            bool isOver = (gGen.config.durationMs != 0) && (now >= gGen.config.durationMs * 1000000ULL);
+
+            if (gIsStopRequested || isOver)
+            {
+                gRun.elapsedMs = (uint32_t)(now / 1000000ULL);
+                gDrainEnd = time_us_64() + SELF_TEST_DRAIN_MS * 1000U;
+                gRun.state = TRAFFIC_STATE_DRAINING;
+            }
+            else
+            {
+                generate(now);
+                gRun.elapsedMs = (uint32_t)(now / 1000000ULL);
+            }
+        }
+        gIsStopRequested = false;
+
+        if ((gRun.state == TRAFFIC_STATE_DRAINING) && (time_us_64() >= gDrainEnd))
+        {
+            finish();
+        }
+    }
+}
+
+/* Starts a run, replacing one in progress. */
+bool selfTestStart(const TrafficConfig_t *config)
+{
+    /* Only the CAN FD controller loops frames back by itself. */
+    if ((config->target == TRAFFIC_TARGET_LOOPBACK) && (config->txChannel != MCP_CHANNEL))
+    {
+        return false;
+    }
+
+    if (gTaskHndl == NULL)
+    {
+        return false;
+    }
+
+    gRequest = *config;
+    gIsStartRequested = true;
+    xTaskNotifyGive(gTaskHndl);
+
+    return true;
+}
+
+/* Stops generating; the result follows once the last frames are in. */
+void selfTestStop(void)
+{
+    if (gTaskHndl != NULL)
+    {
+        gIsStopRequested = true;
+        xTaskNotifyGive(gTaskHndl);
+    }
+}
+
+void selfTestReport(uint8_t *wire)
+{
+    uint32_t save = spin_lock_blocking(gLock);
+
+    trafficReport(&gGen, &gCheck, &gRun, wire);
+    spin_unlock(gLock, save);
+}
+
+/* Hands over the report of a run that just ended, once. */
+bool selfTestTakeResult(uint8_t *wire)
+{
+    if (!gIsResultReady)
+    {
+        return false;
+    }
+
+    gIsResultReady = false;
+    selfTestReport(wire);
+
+    return true;
+}
+
+/* Called from the receive path, task or ISR. Returns true for frames  */
+/* of the run, which are checked here instead of going to the host.    */
+bool selfTestRx(const CanFrame_t *frame)
+{
+    uint32_t save;
+
+    if (!gIsChecking || !trafficMatches(&gGen.config, frame))
+    {
+        return false;
+    }
+
+    save = spin_lock_blocking(gLock);
+    trafficCheckReceived(&gCheck, &gGen.config, frame);
+    spin_unlock(gLock, save);
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static void begin(void)
+{
+    uint32_t save;
+
+    /* Stop checking while the run is replaced. */
+    gIsChecking = false;
+
+    if ((gGen.config.target == TRAFFIC_TARGET_LOOPBACK) && (gRun.state != TRAFFIC_STATE_DONE) &&
+        (gRun.state != TRAFFIC_STATE_IDLE))
+    {
+        mcpSetLoopback(false);
+    }
+
+    save = spin_lock_blocking(gLock);
+    trafficInit(&gGen, &gRequest);
+    trafficCheckInit(&gCheck);
+    memset(&gRun, 0, sizeof(gRun));
+    spin_unlock(gLock, save);
+
+    if (gGen.config.target == TRAFFIC_TARGET_LOOPBACK)
+    {
+        mcpSetLoopback(true);
+    }
+
+    gNextDue = trafficNext(&gGen, &gNext);
+    gStart = time_us_64();
+    gIsResultReady = false;
+    gRun.state = TRAFFIC_STATE_RUNNING;
+    gIsChecking = true;
+}
+
+static void generate(uint64_t now)
+{
+    uint32_t save;
+
+    while (gNextDue <= now)
+    {
+        /* Full: the frame is offered again on the next tick. */
+        if (channelTxFree(gGen.config.txChannel) == 0)
+        {
+            gRun.txFull++;
+            return;
+        }
+
+        /* Recorded only once the TX path took it. */
+        gNext.timestamp = time_us_32();
+        if (!channelTransmit(&gNext))
+        {
+            gRun.txFailed++;
+            return;
+        }
+
+        save = spin_lock_blocking(gLock);
+        trafficCheckSent(&gCheck, &gNext, gNext.timestamp);
+        spin_unlock(gLock, save);
+        gRun.queued++;
+
+        gNextDue = trafficNext(&gGen, &gNext);
+    }
+}
+
+static void finish(void)
+{
+    gIsChecking = false;
+
+    if (gGen.config.target == TRAFFIC_TARGET_LOOPBACK)
+    {
+        mcpSetLoopback(false);
+    }
+
+    gRun.state = TRAFFIC_STATE_DONE;
+    gIsResultReady = true;
+}
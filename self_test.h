@@ -0,0 +1,34 @@
+#ifndef SELF_TEST_H
+#define SELF_TEST_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "can_frame.h"
+#include "traffic_gen.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Frames still on the way are waited for this long after the last one. */
+#define SELF_TEST_DRAIN_MS (100U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void selfTestInit(void);
+void selfTestTask(void *nouse);
+
+bool selfTestStart(const TrafficConfig_t *config);
+void selfTestStop(void);
+void selfTestReport(uint8_t *wire);
+bool selfTestTakeResult(uint8_t *wire);
+
+bool selfTestRx(const CanFrame_t *frame);
+
+#endif /* SELF_TEST_H */
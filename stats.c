@@ -0,0 +1,51 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include "stats.h"
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+StatsSlot_t gStatsSlots[STATS_CORE_NUM];
+
+/* Slot copy of statsSnapshot(), kept off the callers' task stacks. */
+static uint64_t gStatsCopy[STAT_NUM];
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void statsInit(void)
+{
+    memset(gStatsSlots, 0, sizeof(gStatsSlots));
+}
+
+void statsSnapshot(StatsSnapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    for (uint32_t core = 0; core < STATS_CORE_NUM; core++)
+    {
+        const StatsSlot_t *slot = &gStatsSlots[core];
+        uint32_t seq;
+
+        /* Copy the whole slot until no update overlapped the copy, so */
+        /* that its counters agree with each other.                    */
+        do
+        {
+            do
+            {
+                seq = slot->seq;
+            } while (seq & 1U);
+
+            __dmb();
+            memcpy(gStatsCopy, (const void *)slot->counter, sizeof(gStatsCopy));
+            __dmb();
+        } while (seq != slot->seq);
+
+        for (uint32_t id = 0; id < STAT_NUM; id++)
+        {
+            snapshot->counter[id] += gStatsCopy[id];
+        }
+    }
+}
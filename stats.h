@@ -0,0 +1,127 @@
+#ifndef STATS_H
+#define STATS_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include "can_config.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Number of cores that may bump counters. */
+#define STATS_CORE_NUM (2U)
+
+/* Slot alignment, so that the two cores never share a line. */
+#define STATS_SLOT_ALIGN (32U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Counter identifiers. PROTO_REC_STATS page 0 carries them in this */
+/* order, and page 1 + n the counters of channel n. (see STAT_CH)    */
+typedef enum
+{
+    STAT_FRAMES_IN = 0,     /* Frames taken from the receive queues.    */
+    STAT_RECORDS_OUT,       /* Records sent to the host.                */
+    STAT_BYTES_OUT,         /* Bytes sent to the host.                  */
+    STAT_PROCESS_CYCLES,    /* Core cycles converting frames to records. */
+    STAT_DEDUP_SUPPRESSED,  /* Frames dropped as identical repeats.     */
+    STAT_DEDUP_UNCACHED,    /* Frames forwarded for lack of a slot.     */
+    STAT_UART_RX_BYTES,     /* Bytes received on the UART link.         */
+    STAT_UART_TX_BYTES,     /* Bytes sent on the UART link.             */
+    STAT_UART_RX_OVERRUNS,  /* UART receive FIFO overruns, ring laps.  */
+    STAT_MCP_SPI_BYTES,     /* SPI bytes exchanged with the MCP251xFD.  */
+    STAT_MCP_RX_OVERFLOWS,  /* MCP251xFD receive FIFO overflows.        */
+    STAT_CONFIG_APPLY_US,   /* Time to apply the stored configuration.  */
+    STAT_FIRST_RECORD_US,   /* Reset to the first forwarded frame.      */
+    STAT_GATEWAY_FORWARDED, /* Frames routed from bus to bus.           */
+    STAT_GATEWAY_DROPPED,   /* Routed frames lost on a full TX queue.   */
+    STAT_GATEWAY_US,        /* Receive to TX queue time of routed ones. */
+    STAT_PACK_CYCLES,       /* Core cycles spent in packFrame().        */
+    STAT_PROCESS_TIMED,     /* Frames STAT_PROCESS_CYCLES covers.       */
+    STAT_PACK_TIMED,        /* packFrame() calls timed.                 */
+    STAT_MCP_TX_INVALID,    /* Classic frames over 8 bytes not sent.    */
+    STAT_GLOBAL_NUM
+} StatId_t;
+
+/* Per channel counter identifiers. */
+typedef enum
+{
+    STAT_CH_RX_FRAMES = 0, /* Frames accepted into the receive queue. */
+    STAT_CH_RX_DROPPED,    /* Frames lost on a full receive queue.    */
+    STAT_CH_RX_FILTERED,   /* Frames rejected by acceptance filters.  */
+    STAT_CH_TX_FRAMES,     /* Frames queued for transmission.         */
+    STAT_CH_TX_DROPPED,    /* Frames lost on a full transmit queue.   */
+    STAT_CH_TX_SHAPED,     /* Frames held back by a rate limit.       */
+    STAT_CH_TX_LIMITED,    /* Frames dropped by a rate limit.         */
+    STAT_CH_NUM
+} StatChannelId_t;
+
+/* Counter of a channel. */
+#define STAT_CH(ch, id) ((StatId_t)(STAT_GLOBAL_NUM + (ch) * STAT_CH_NUM + (id)))
+
+/* Total number of counters. */
+#define STAT_NUM (STAT_GLOBAL_NUM + CAN_CHANNEL_NUM * STAT_CH_NUM)
+
+/* Counters written by one core only. */
+typedef struct
+{
+    volatile uint32_t seq; /* Odd while an update is in progress. */
+    uint64_t counter[STAT_NUM];
+} __attribute__((aligned(STATS_SLOT_ALIGN))) StatsSlot_t;
+
+/* Aggregated counters of all cores. */
+typedef struct
+{
+    uint64_t counter[STAT_NUM];
+} StatsSnapshot_t;
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+extern StatsSlot_t gStatsSlots[STATS_CORE_NUM];
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void statsInit(void);
+
+/* Sums consistent copies of the slots. Not reentrant: callers take */
+/* turns, as bridge commands do under the bridge lock.              */
+void statsSnapshot(StatsSnapshot_t *snapshot);
+
+/* -------------------------------------------------------------------------- */
+/* Inline function                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* Adds to a counter of the calling core. Callable from tasks and ISRs. */
+/* Interrupts are masked on this core only, so there is no cross-core   */
+/* lock; the sequence count lets readers on the other core retry. They  */
+/* are masked before the core is read, so a task cannot move to the     */
+/* other core in between and write into a slot it does not own.         */
+static inline void statsAdd(StatId_t id, uint32_t value)
+{
+    uint32_t state = save_and_disable_interrupts();
+    StatsSlot_t *slot = &gStatsSlots[get_core_num()];
+
+    slot->seq++;
+    __dmb();
+    slot->counter[id] += value;
+    __dmb();
+    slot->seq++;
+
+    restore_interrupts(state);
+}
+
+static inline void statsInc(StatId_t id)
+{
+    statsAdd(id, 1U);
+}
+
+#endif /* STATS_H */
@@ -0,0 +1,145 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <string.h>
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "trace.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static TraceEvent_t gRings[TRACE_CORE_NUM][TRACE_RING_SIZE];
+static uint32_t gHeads[TRACE_CORE_NUM];
+static volatile bool gIsRunning = false;
+
+static bool gIsDumping = false;
+static uint32_t gDumpCore = 0;
+static uint32_t gDumpPos = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void traceInit(void)
+{
+    gIsRunning = false;
+    gIsDumping = false;
+    memset(gHeads, 0, sizeof(gHeads));
+}
+
+void traceStart(void)
+{
+    static TaskStatus_t tasks[TRACE_MAX_TASKS];
+    UBaseType_t count;
+
+    gIsDumping = false;
+    memset(gHeads, 0, sizeof(gHeads));
+    gIsRunning = true;
+
+    /* Tasks were created before recording started. Name them so */
+    /* the host can label the task switch events.                 */
+    count = uxTaskGetSystemState(tasks, TRACE_MAX_TASKS, NULL);
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        const char *name = tasks[i].pcTaskName;
+        uint32_t chars = 0;
+
+        for (uint32_t j = 0; (j < 4U) && (name[j] != '\0'); j++)
+        {
+            chars |= (uint32_t)(uint8_t)name[j] << (8U * j);
+        }
+
+        traceRecord(TRACE_EV_TASK_CREATE, tasks[i].xTaskNumber, chars);
+    }
+}
+
+void traceStop(void)
+{
+    gIsRunning = false;
+}
+
+#if TRACE_ENABLED
+/* Runs from RAM: it is called on every context switch and must not */
+/* stall on an XIP cache miss.                                      */
+void __not_in_flash_func(traceRecord)(uint32_t event, uint32_t arg, uint32_t data)
+{
+    uint32_t core;
+    uint32_t state;
+    TraceEvent_t *ev;
+
+    if (!gIsRunning)
+    {
+        return;
+    }
+
+    /* Masked first, so the task cannot move to the other core after   */
+    /* its number was read. Each core owns its ring, so masking local  */
+    /* interrupts then suffices.                                       */
+    state = save_and_disable_interrupts();
+    core = get_core_num();
+
+    ev = &gRings[core][gHeads[core]++ & (TRACE_RING_SIZE - 1U)];
+    ev->timestamp = time_us_32();
+    ev->word = (event & 0xFFU) | (arg << 8);
+    ev->data = data;
+
+    restore_interrupts(state);
+}
+#endif
+
+bool traceDumpBegin(void)
+{
+    /* Freeze the rings while they are read out. */
+    gIsRunning = false;
+
+    gIsDumping = true;
+    gDumpCore = 0;
+    gDumpPos = (gHeads[0] > TRACE_RING_SIZE) ? (gHeads[0] - TRACE_RING_SIZE) : 0;
+
+    return true;
+}
+
+uint8_t traceDumpNext(uint8_t *payload, uint8_t size)
+{
+    uint8_t count = 0;
+    uint8_t pos = 2;
+
+    if (!gIsDumping)
+    {
+        return 0;
+    }
+
+    /* Move to the next core once this one is exhausted. */
+    while (gDumpPos == gHeads[gDumpCore])
+    {
+        if (++gDumpCore >= TRACE_CORE_NUM)
+        {
+            gIsDumping = false;
+            return 0;
+        }
+        gDumpPos = (gHeads[gDumpCore] > TRACE_RING_SIZE) ? (gHeads[gDumpCore] - TRACE_RING_SIZE) : 0;
+    }
+
+    /* Payload: core, count, then count events, oldest first. */
+    while ((count < TRACE_EVENTS_PER_RECORD) &&
+           ((uint32_t)pos + TRACE_EVENT_WIRE_SIZE <= size) &&
+           (gDumpPos != gHeads[gDumpCore]))
+    {
+        const TraceEvent_t *ev = &gRings[gDumpCore][gDumpPos & (TRACE_RING_SIZE - 1U)];
+
+        protoPutU32(&payload[pos], ev->timestamp);
+        protoPutU32(&payload[pos + 4], ev->word);
+        protoPutU32(&payload[pos + 8], ev->data);
+        pos += TRACE_EVENT_WIRE_SIZE;
+        gDumpPos++;
+        count++;
+    }
+
+    payload[0] = (uint8_t)gDumpCore;
+    payload[1] = count;
+
+    return pos;
+}
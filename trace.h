@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <trace_hooks.h>
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Events kept per core. (power of two) */
+#define TRACE_RING_BITS (8U)
+#define TRACE_RING_SIZE (1U << TRACE_RING_BITS)
+
+/* Number of cores with their own ring. */
+#define TRACE_CORE_NUM (2U)
+
+/* Tasks named in the trace when recording starts. */
+#define TRACE_MAX_TASKS (16U)
+
+/* Size of an event in a PROTO_REC_TRACE payload. */
+#define TRACE_EVENT_WIRE_SIZE (12U)
+
+/* Events per PROTO_REC_TRACE record. */
+#define TRACE_EVENTS_PER_RECORD (20U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+
+/* One recorded event. */
+typedef struct
+{
+    uint32_t timestamp; /* Hardware timer, microseconds.    */
+    uint32_t word;      /* Event in bits 0-7, arg in 8-31. */
+    uint32_t data;
+} TraceEvent_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void traceInit(void);
+void traceStart(void);
+void traceStop(void);
+bool traceDumpBegin(void);
+uint8_t traceDumpNext(uint8_t *payload, uint8_t size);
+
+#if !TRACE_ENABLED
+static inline void traceRecord(uint32_t event, uint32_t arg, uint32_t data)
+{
+    (void)event;
+    (void)arg;
+    (void)data;
+}
+#endif
+
+#endif /* TRACE_H */
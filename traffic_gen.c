@@ -0,0 +1,453 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <math.h>
+#include <string.h>
+#include "traffic_gen.h"
+#include "rate_limit.h"
+#include "protocol.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define NS_PER_S (1000000000ULL)
+#define NS_PER_MS (1000000ULL)
+
+_Static_assert((TRAFFIC_WINDOW & (TRAFFIC_WINDOW - 1U)) == 0, "the window must divide the sequence numbers");
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static uint32_t nextRandom(uint32_t *state);
+static uint32_t pickId(TrafficGen_t *gen, uint16_t seq);
+static uint8_t pickLen(TrafficGen_t *gen);
+static uint8_t patternByte(const TrafficConfig_t *config, uint16_t seq, uint8_t index);
+static uint32_t latencyBin(uint32_t us);
+static uint32_t binFloor(uint32_t bin);
+static uint32_t percentile(const TrafficCheck_t *check, uint32_t permille);
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+bool trafficDecodeConfig(const uint8_t *wire, TrafficConfig_t *config)
+{
+    uint8_t maxLen = (wire[3] & CAN_FLAG_FD) ? CAN_FRAME_MAX_LEN : 8U;
+
+    config->txChannel = wire[0];
+    config->rxChannel = wire[1];
+    config->target = wire[2];
+    config->flags = wire[3] & (CAN_FLAG_EXT | CAN_FLAG_FD | CAN_FLAG_BRS);
+    config->idMode = wire[4];
+    config->pattern = wire[5];
+    config->shape = wire[6];
+    config->lenMin = wire[7];
+    config->lenMax = wire[8];
+    config->permille = protoGetU16(&wire[9]);
+    config->burstLen = protoGetU16(&wire[11]);
+    config->durationMs = protoGetU32(&wire[13]);
+    config->bitrate = protoGetU32(&wire[17]);
+    config->dataBitrate = protoGetU32(&wire[21]);
+    config->idFirst = protoGetU32(&wire[25]);
+    config->idLast = protoGetU32(&wire[29]);
+    config->seed = protoGetU32(&wire[33]);
+
+    if (config->dataBitrate == 0)
+    {
+        config->dataBitrate = config->bitrate;
+    }
+    if (config->burstLen == 0)
+    {
+        config->burstLen = 1;
+    }
+
+    /* A controller looping frames back hands them to its own channel. */
+    if (config->target == TRAFFIC_TARGET_LOOPBACK)
+    {
+        config->rxChannel = config->txChannel;
+    }
+
+    return (config->txChannel < CAN_CHANNEL_NUM) &&
+           (config->rxChannel < CAN_CHANNEL_NUM) &&
+           (config->target <= TRAFFIC_TARGET_LOOPBACK) &&
+           (CAN_FD_ENABLED || !(config->flags & CAN_FLAG_FD)) &&
+           ((config->flags & CAN_FLAG_FD) || !(config->flags & CAN_FLAG_BRS)) &&
+           (config->idMode <= TRAFFIC_ID_SKEWED) &&
+           (config->pattern <= TRAFFIC_PAT_ALT) &&
+           (config->shape <= TRAFFIC_SHAPE_POISSON) &&
+           (config->lenMin >= TRAFFIC_SEQ_SIZE) &&
+           (config->lenMin <= config->lenMax) &&
+           (config->lenMax <= maxLen) &&
+           (config->permille != 0) &&
+           (config->permille <= 1000U) &&
+           (config->bitrate != 0) &&
+           (config->idFirst <= config->idLast) &&
+           (config->idLast <= ((config->flags & CAN_FLAG_EXT) ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK));
+}
+
+void trafficEncodeConfig(const TrafficConfig_t *config, uint8_t *wire)
+{
+    wire[0] = config->txChannel;
+    wire[1] = config->rxChannel;
+    wire[2] = config->target;
+    wire[3] = config->flags;
+    wire[4] = config->idMode;
+    wire[5] = config->pattern;
+    wire[6] = config->shape;
+    wire[7] = config->lenMin;
+    wire[8] = config->lenMax;
+    protoPutU16(&wire[9], config->permille);
+    protoPutU16(&wire[11], config->burstLen);
+    protoPutU32(&wire[13], config->durationMs);
+    protoPutU32(&wire[17], config->bitrate);
+    protoPutU32(&wire[21], config->dataBitrate);
+    protoPutU32(&wire[25], config->idFirst);
+    protoPutU32(&wire[29], config->idLast);
+    protoPutU32(&wire[33], config->seed);
+}
+
+void trafficInit(TrafficGen_t *gen, const TrafficConfig_t *config)
+{
+    memset(gen, 0, sizeof(*gen));
+    gen->config = *config;
+    gen->rng = (config->seed != 0) ? config->seed : 1U;
+}
+
+/* Fills in the next frame and returns when it is due. */
+uint64_t trafficNext(TrafficGen_t *gen, CanFrame_t *frame)
+{
+    const TrafficConfig_t *config = &gen->config;
+    uint64_t due = gen->due;
+    uint64_t busNs;
+    uint64_t spacing;
+
+    frame->id = pickId(gen, gen->seq);
+    frame->flags = config->flags;
+    frame->len = pickLen(gen);
+    frame->channel = config->txChannel;
+    frame->reserved = 0;
+    frame->data[0] = (uint8_t)gen->seq;
+    frame->data[1] = (uint8_t)(gen->seq >> 8);
+    for (uint8_t i = TRAFFIC_SEQ_SIZE; i < frame->len; i++)
+    {
+        frame->data[i] = patternByte(config, gen->seq, i);
+    }
+
+    gen->seq++;
+    gen->generated++;
+
+    /* The frame takes busNs of the bus, so at the load it takes up */
+    /* spacing of the time line.                                    */
+    busNs = trafficFrameNs(config, frame);
+    spacing = busNs * 1000U / config->permille;
+
+    switch (config->shape)
+    {
+    case TRAFFIC_SHAPE_BURST:
+        gen->burstNs += busNs;
+        if (++gen->inBurst < config->burstLen)
+        {
+            gen->due += busNs;
+        }
+        else
+        {
+            gen->due = gen->burstStart + gen->burstNs * 1000U / config->permille;
+            gen->burstStart = gen->due;
+            gen->burstNs = 0;
+            gen->inBurst = 0;
+        }
+        break;
+
+    case TRAFFIC_SHAPE_POISSON:
+    {
+        /* Exponential gaps of mean spacing: u in (0, 1]. */
+        float u = (float)((nextRandom(&gen->rng) >> 8) + 1U) / 16777216.0f;
+
+        gen->due += (uint64_t)((float)spacing * -logf(u));
+        break;
+    }
+
+    default:
+        gen->due += spacing;
+        break;
+    }
+
+    return due;
+}
+
+/* Worst case bus time of a frame, stuff bits included. */
+uint64_t trafficFrameNs(const TrafficConfig_t *config, const CanFrame_t *frame)
+{
+    uint32_t nominal;
+    uint32_t data;
+
+    rateFrameBits(frame, &nominal, &data);
+
+    return nominal * NS_PER_S / config->bitrate + data * NS_PER_S / config->dataBitrate;
+}
+
+/* Whether a received frame is one of the run's. */
+bool trafficMatches(const TrafficConfig_t *config, const CanFrame_t *frame)
+{
+    return (frame->channel == config->rxChannel) &&
+           ((frame->flags & (CAN_FLAG_EXT | CAN_FLAG_RTR)) == (config->flags & CAN_FLAG_EXT)) &&
+           (frame->id >= config->idFirst) &&
+           (frame->id <= config->idLast) &&
+           (frame->len >= TRAFFIC_SEQ_SIZE);
+}
+
+void trafficCheckInit(TrafficCheck_t *check)
+{
+    memset(check, 0, sizeof(*check));
+    check->latMin = UINT32_MAX;
+}
+
+/* Called once a frame is in the TX path, with the time it went in, us. */
+void trafficCheckSent(TrafficCheck_t *check, const CanFrame_t *frame, uint32_t now)
+{
+    uint16_t seq = (uint16_t)(frame->data[0] | (frame->data[1] << 8));
+
+    check->sentAt[seq % TRAFFIC_WINDOW] = now;
+    check->sentNext = (uint16_t)(seq + 1U);
+}
+
+/* Called for every matching frame that comes back, in order of arrival. */
+/* A frame behind the expected one was either counted lost when a later  */
+/* one came, and is reordered, or was seen already and is a duplicate.   */
+void trafficCheckReceived(TrafficCheck_t *check, const TrafficConfig_t *config, const CanFrame_t *frame)
+{
+    uint16_t seq = (uint16_t)(frame->data[0] | (frame->data[1] << 8));
+    int16_t ahead = (int16_t)(seq - check->next);
+    uint32_t slot = seq % TRAFFIC_WINDOW;
+    uint32_t latency;
+
+    for (uint8_t i = TRAFFIC_SEQ_SIZE; i < frame->len; i++)
+    {
+        if (frame->data[i] != patternByte(config, seq, i))
+        {
+            check->corrupt++;
+            return;
+        }
+    }
+
+    if (ahead < 0)
+    {
+        /* Too far behind to tell counts as a duplicate. */
+        if ((-ahead > (int32_t)TRAFFIC_WINDOW) || (check->seen[slot / 32U] & (1UL << (slot % 32U))) ||
+            (check->lost == 0))
+        {
+            check->duplicates++;
+            return;
+        }
+        check->reordered++;
+        check->lost--;
+    }
+    else
+    {
+        /* Sequence numbers skipped here are lost until they turn up. */
+        uint16_t skipped = check->next;
+
+        for (uint32_t n = 0; (skipped != seq) && (n < TRAFFIC_WINDOW); n++, skipped++)
+        {
+            uint32_t at = skipped % TRAFFIC_WINDOW;
+
+            check->seen[at / 32U] &= ~(1UL << (at % 32U));
+        }
+        check->lost += (uint16_t)ahead;
+        check->next = (uint16_t)(seq + 1U);
+    }
+
+    check->seen[slot / 32U] |= 1UL << (slot % 32U);
+    check->received++;
+    check->busNs += trafficFrameNs(config, frame);
+
+    /* Back before its send was recorded: its send time is not known. */
+    if ((int16_t)(seq - check->sentNext) >= 0)
+    {
+        return;
+    }
+
+    latency = frame->timestamp - check->sentAt[slot];
+    check->latCount++;
+    check->latSum += latency;
+    check->latMin = (latency < check->latMin) ? latency : check->latMin;
+    check->latMax = (latency > check->latMax) ? latency : check->latMax;
+    check->latHist[latencyBin(latency)]++;
+}
+
+void trafficReport(const TrafficGen_t *gen, const TrafficCheck_t *check, const TrafficRun_t *run, uint8_t *wire)
+{
+    uint64_t elapsedNs = (uint64_t)run->elapsedMs * NS_PER_MS;
+    uint32_t lost = check->lost;
+
+    /* Done: whatever did not come back is lost, the tail included. */
+    if ((run->state == TRAFFIC_STATE_DONE) && (run->queued >= check->received))
+    {
+        lost = run->queued - check->received;
+    }
+
+    wire[0] = run->state;
+    wire[1] = gen->config.txChannel;
+    wire[2] = gen->config.rxChannel;
+    wire[3] = gen->config.target;
+    protoPutU32(&wire[4], run->elapsedMs);
+    protoPutU32(&wire[8], gen->generated);
+    protoPutU32(&wire[12], run->queued);
+    protoPutU32(&wire[16], run->txFull);
+    protoPutU32(&wire[20], check->received);
+    protoPutU32(&wire[24], lost);
+    protoPutU32(&wire[28], check->reordered);
+    protoPutU32(&wire[32], check->duplicates);
+    protoPutU32(&wire[36], check->corrupt);
+    protoPutU16(&wire[40], gen->config.permille);
+    protoPutU16(&wire[42], (uint16_t)((elapsedNs != 0) ? (check->busNs * 1000U / elapsedNs) : 0U));
+    protoPutU32(&wire[44], (check->latCount != 0) ? check->latMin : 0U);
+    protoPutU32(&wire[48], (check->latCount != 0) ? (uint32_t)(check->latSum / check->latCount) : 0U);
+    protoPutU32(&wire[52], percentile(check, 500U));
+    protoPutU32(&wire[56], percentile(check, 990U));
+    protoPutU32(&wire[60], check->latMax);
+    protoPutU32(&wire[64], run->txFailed);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static uint32_t nextRandom(uint32_t *state)
+{
+    /* xorshift32 */
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+static uint32_t pickId(TrafficGen_t *gen, uint16_t seq)
+{
+    const TrafficConfig_t *config = &gen->config;
+    uint32_t span = config->idLast - config->idFirst + 1U;
+
+    switch (config->idMode)
+    {
+    case TRAFFIC_ID_SWEEP:
+        return config->idFirst + seq % span;
+
+    case TRAFFIC_ID_UNIFORM:
+        return config->idFirst + nextRandom(&gen->rng) % span;
+
+    case TRAFFIC_ID_SKEWED:
+    {
+        /* The product of two uniform picks: low identifiers, which win */
+        /* arbitration, come up far more often than high ones.          */
+        uint64_t a = nextRandom(&gen->rng) % span;
+        uint64_t b = nextRandom(&gen->rng) % span;
+
+        return config->idFirst + (uint32_t)(a * b / span);
+    }
+
+    default:
+        return config->idFirst;
+    }
+}
+
+static uint8_t pickLen(TrafficGen_t *gen)
+{
+    const TrafficConfig_t *config = &gen->config;
+    uint8_t len = config->lenMin;
+
+    if (config->lenMax > config->lenMin)
+    {
+        len = (uint8_t)(len + nextRandom(&gen->rng) % (config->lenMax - config->lenMin + 1U));
+    }
+
+    /* FD lengths past 8 come in steps: round up to one the DLC has. */
+    if (len > 8U)
+    {
+        len = (len <= 24U) ? (uint8_t)((len + 3U) & ~3U) : ((len <= 32U) ? 32U : ((len <= 48U) ? 48U : 64U));
+    }
+
+    return len;
+}
+
+/* The checker rebuilds a frame's payload from its sequence number. */
+static uint8_t patternByte(const TrafficConfig_t *config, uint16_t seq, uint8_t index)
+{
+    switch (config->pattern)
+    {
+    case TRAFFIC_PAT_COUNT:
+        return (uint8_t)(seq + index);
+
+    case TRAFFIC_PAT_RANDOM:
+    {
+        uint32_t x = (config->seed ^ ((uint32_t)seq * 2654435761U) ^ ((uint32_t)index << 24)) | 1U;
+
+        (void)nextRandom(&x);
+        return (uint8_t)nextRandom(&x);
+    }
+
+    case TRAFFIC_PAT_WALK:
+        return (uint8_t)(1U << ((seq + index) % 8U));
+
+    case TRAFFIC_PAT_ALT:
+        return ((seq + index) & 1U) ? 0xAAU : 0x55U;
+
+    default:
+        return 0;
+    }
+}
+
+/* TRAFFIC_LAT_STEPS bins per power of two, exact below the first one. */
+static uint32_t latencyBin(uint32_t us)
+{
+    uint32_t log2;
+    uint32_t bin;
+
+    if (us < TRAFFIC_LAT_STEPS)
+    {
+        return us;
+    }
+
+    log2 = 31U - (uint32_t)__builtin_clz(us);
+    bin = TRAFFIC_LAT_STEPS * (log2 - 1U) + ((us >> (log2 - 2U)) & (TRAFFIC_LAT_STEPS - 1U));
+
+    return (bin < TRAFFIC_LAT_BINS) ? bin : (TRAFFIC_LAT_BINS - 1U);
+}
+
+static uint32_t binFloor(uint32_t bin)
+{
+    uint32_t log2 = bin / TRAFFIC_LAT_STEPS + 1U;
+
+    if (bin < TRAFFIC_LAT_STEPS)
+    {
+        return bin;
+    }
+
+    return (TRAFFIC_LAT_STEPS + bin % TRAFFIC_LAT_STEPS) << (log2 - 2U);
+}
+
+/* Upper edge of the bin holding the permille-th latency. */
+static uint32_t percentile(const TrafficCheck_t *check, uint32_t permille)
+{
+    uint64_t rank = ((uint64_t)check->latCount * permille + 999U) / 1000U;
+    uint64_t count = 0;
+
+    if (check->latCount == 0)
+    {
+        return 0;
+    }
+
+    for (uint32_t bin = 0; bin < TRAFFIC_LAT_BINS - 1U; bin++)
+    {
+        count += check->latHist[bin];
+        if (count >= rank)
+        {
+            uint32_t edge = binFloor(bin + 1U) - 1U;
+
+            return (edge < check->latMax) ? edge : check->latMax;
+        }
+    }
+
+    return check->latMax;
+}
@@ -0,0 +1,163 @@
+#ifndef TRAFFIC_GEN_H
+#define TRAFFIC_GEN_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_config.h"
+#include "can_frame.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Where generated frames go. */
+#define TRAFFIC_TARGET_BUS (0U)      /* TX path of txChannel, back on rxChannel. */
+#define TRAFFIC_TARGET_LOOPBACK (1U) /* TX path, looped back by the controller.  */
+
+/* Identifier distributions over [idFirst, idLast]. */
+#define TRAFFIC_ID_FIXED (0U)   /* idFirst only.                    */
+#define TRAFFIC_ID_SWEEP (1U)   /* Each in turn.                    */
+#define TRAFFIC_ID_UNIFORM (2U) /* At random.                       */
+#define TRAFFIC_ID_SKEWED (3U)  /* At random, low identifiers most. */
+
+/* Payload patterns after the sequence number. */
+#define TRAFFIC_PAT_ZERO (0U)
+#define TRAFFIC_PAT_COUNT (1U)  /* Byte i of frame n is n + i.  */
+#define TRAFFIC_PAT_RANDOM (2U) /* From the sequence number.    */
+#define TRAFFIC_PAT_WALK (3U)   /* A walking one.               */
+#define TRAFFIC_PAT_ALT (4U)    /* 0x55 and 0xAA, worst stuffing. */
+
+/* Burst shapes. The average load is permille of the bus in all of them. */
+#define TRAFFIC_SHAPE_EVEN (0U)    /* Evenly spaced frames.                */
+#define TRAFFIC_SHAPE_BURST (1U)   /* burstLen frames back to back, a gap. */
+#define TRAFFIC_SHAPE_POISSON (2U) /* Random arrivals.                     */
+
+/* Payload bytes taken by the little-endian sequence number. */
+#define TRAFFIC_SEQ_SIZE (2U)
+
+/* Frames in flight the checker tells apart, and keeps send times of. */
+#define TRAFFIC_WINDOW (256U)
+
+/* Latency histogram: TRAFFIC_LAT_STEPS bins per power of two of us. */
+#define TRAFFIC_LAT_STEPS (4U)
+#define TRAFFIC_LAT_BINS (24U * TRAFFIC_LAT_STEPS)
+
+/* PROTO_CMD_SELFTEST_START payload:                                        */
+/*                                                                          */
+/*     txChannel u8, rxChannel u8, target u8, flags u8, idMode u8,          */
+/*     pattern u8, shape u8, lenMin u8, lenMax u8, permille u16,            */
+/*     burstLen u16, durationMs u32, bitrate u32, dataBitrate u32,          */
+/*     idFirst u32, idLast u32, seed u32                                    */
+/*                                                                          */
+/* Frames of flags (CAN_FLAG_EXT, FD, BRS) and lenMin to lenMax bytes, at */
+/* least TRAFFIC_SEQ_SIZE, load the bus at bitrate to permille for        */
+/* durationMs, 0 for until stopped.                                       */
+#define TRAFFIC_CONFIG_WIRE_SIZE (37U)
+
+/* PROTO_REC_SELFTEST payload:                                              */
+/*                                                                          */
+/*     state u8, txChannel u8, rxChannel u8, target u8, elapsedMs u32,      */
+/*     generated u32, queued u32, txFull u32, received u32, lost u32,       */
+/*     reordered u32, duplicates u32, corrupt u32, offered u16 (permille),  */
+/*     achieved u16 (permille), latency min u32, mean u32, p50 u32,         */
+/*     p99 u32, max u32 (us), txFailed u32                                  */
+/*                                                                          */
+/* txFull counts the times the TX queue turned a frame away, and txFailed */
+/* the times channelTransmit() refused one the queue had room for; the    */
+/* frame is offered again after either. lost is provisional while         */
+/* running: frames still on the way count once the run is done. Latency   */
+/* covers the frames whose send was recorded before they came back.       */
+#define TRAFFIC_REPORT_SIZE (68U)
+
+/* Report states. */
+#define TRAFFIC_STATE_IDLE (0U)
+#define TRAFFIC_STATE_RUNNING (1U)
+#define TRAFFIC_STATE_DRAINING (2U) /* Sent all, waiting for the last frames. */
+#define TRAFFIC_STATE_DONE (3U)
+
+/* -------------------------------------------------------------------------- */
+/* Type definition                                                            */
+/* -------------------------------------------------------------------------- */
+typedef struct
+{
+    uint32_t bitrate;     /* Nominal bit rate, bit/s.           */
+    uint32_t dataBitrate; /* Data phase bit rate of BRS frames. */
+    uint32_t idFirst;
+    uint32_t idLast;
+    uint32_t durationMs;
+    uint32_t seed;
+    uint16_t permille;
+    uint16_t burstLen;
+    uint8_t txChannel;
+    uint8_t rxChannel;
+    uint8_t target; /* TRAFFIC_TARGET_* */
+    uint8_t flags;  /* CAN_FLAG_*       */
+    uint8_t idMode; /* TRAFFIC_ID_*     */
+    uint8_t pattern;
+    uint8_t shape;
+    uint8_t lenMin;
+    uint8_t lenMax;
+} TrafficConfig_t;
+
+/* Frame source. Times are in ns from the start of the run. */
+typedef struct
+{
+    TrafficConfig_t config;
+    uint64_t due;        /* Of the next frame.            */
+    uint64_t burstStart; /* Of the burst being sent.      */
+    uint64_t burstNs;    /* Bus time of the burst so far. */
+    uint32_t rng;
+    uint32_t generated;
+    uint16_t seq;
+    uint16_t inBurst;
+} TrafficGen_t;
+
+/* Checks the frames that come back against what was sent. */
+typedef struct
+{
+    uint32_t sentAt[TRAFFIC_WINDOW]; /* Send time, us, by sequence number. */
+    uint32_t seen[TRAFFIC_WINDOW / 32U];
+    uint32_t latHist[TRAFFIC_LAT_BINS];
+    uint64_t latSum;
+    uint64_t busNs; /* Bus time of the frames received. */
+    uint32_t latMin;
+    uint32_t latMax;
+    uint32_t latCount; /* Frames the latency covers. */
+    uint32_t received;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t duplicates;
+    uint32_t corrupt;
+    uint16_t next;     /* Sequence number expected next.      */
+    uint16_t sentNext; /* Sequence number to be recorded next. */
+} TrafficCheck_t;
+
+/* Counts of the sending side, for the report. */
+typedef struct
+{
+    uint32_t elapsedMs;
+    uint32_t queued;
+    uint32_t txFull;
+    uint32_t txFailed;
+    uint8_t state; /* TRAFFIC_STATE_* */
+} TrafficRun_t;
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+bool trafficDecodeConfig(const uint8_t *wire, TrafficConfig_t *config);
+void trafficEncodeConfig(const TrafficConfig_t *config, uint8_t *wire);
+void trafficInit(TrafficGen_t *gen, const TrafficConfig_t *config);
+uint64_t trafficNext(TrafficGen_t *gen, CanFrame_t *frame);
+uint64_t trafficFrameNs(const TrafficConfig_t *config, const CanFrame_t *frame);
+bool trafficMatches(const TrafficConfig_t *config, const CanFrame_t *frame);
+
+void trafficCheckInit(TrafficCheck_t *check);
+void trafficCheckSent(TrafficCheck_t *check, const CanFrame_t *frame, uint32_t now);
+void trafficCheckReceived(TrafficCheck_t *check, const TrafficConfig_t *config, const CanFrame_t *frame);
+void trafficReport(const TrafficGen_t *gen, const TrafficCheck_t *check, const TrafficRun_t *run, uint8_t *wire);
+
+#endif /* TRAFFIC_GEN_H */
@@ -1,6 +1,8 @@
 #ifndef TUSB_CONFIG_H
 #define TUSB_CONFIG_H
 
+#include "can_config.h"
+
 /* -------------------------------------------------------------------------- */
 /* Board specific configuration                                               */
 /* -------------------------------------------------------------------------- */
@@ -34,7 +36,7 @@
 #define CFG_TUD_ENDPOINT0_SIZE (64)
 
 /* Set to 1 to enable USB class. */
-#define CFG_TUD_CDC (1)
+#define CFG_TUD_CDC (CAN_CDC_PER_CHANNEL ? CAN_CHANNEL_NUM : 1)
 #define CFG_TUD_MSC (0)
 #define CFG_TUD_HID (0)
 #define CFG_TUD_MIDI (0)
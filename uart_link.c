@@ -0,0 +1,330 @@
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <pico/stdlib.h>
+#include <hardware/uart.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "uart_link.h"
+#include "bridge.h"
+#include "stats.h"
+#include "trace.h"
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+#define TX_BUFF_NUM (2U)
+#define RX_DMA_NUM (2U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+static void uartIrqHandler(void);
+static void dmaIrqHandler(void);
+static bool rxTimerCallback(repeating_timer_t *timer);
+static uint32_t rxProduced(void);
+static uint32_t rxLaps(void);
+static void rxDrain(void);
+static void txPump(void);
+
+/* -------------------------------------------------------------------------- */
+/* Global                                                                     */
+/* -------------------------------------------------------------------------- */
+static TaskHandle_t gTaskHndl = NULL;
+
+/* Two channels chained to each other each fill the whole ring, so the */
+/* DMA never waits for the CPU. The ring wrap needs the alignment.     */
+static int gRxDma[RX_DMA_NUM] = {-1, -1};
+static uint8_t gRxRing[UART_LINK_RX_RING_SIZE] __attribute__((aligned(UART_LINK_RX_RING_SIZE)));
+static volatile uint32_t gRxLaps = 0;
+
+/* Written by the sampling timer, read by the task. */
+static repeating_timer_t gRxTimer;
+static volatile uint32_t gRxHead = 0;
+static uint32_t gRxNotified = 0;
+static uint32_t gRxConsumed = 0;
+
+/* One DMA channel per buffer, so a filled buffer is chained behind the */
+/* one on the wire and the line does not wait for the interrupt.        */
+static int gTxDma[TX_BUFF_NUM] = {-1, -1};
+static dma_channel_config gTxCfg[TX_BUFF_NUM];
+static uint8_t gTxBuff[TX_BUFF_NUM][UART_LINK_TX_BUFF_SIZE];
+static volatile uint32_t gTxLen[TX_BUFF_NUM] = {0};
+static uint8_t gTxFill = 0;
+
+/* -------------------------------------------------------------------------- */
+/* Public function                                                            */
+/* -------------------------------------------------------------------------- */
+void uartLinkInit(void)
+{
+    uart_hw_t *hw = uart_get_hw(UART_LINK_ID);
+
+    /* Initialize UART. */
+    uart_init(UART_LINK_ID, UART_LINK_BAUDRATE);
+    uart_set_fifo_enabled(UART_LINK_ID, true);
+    gpio_set_function(UART_LINK_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(UART_LINK_RX_PIN, GPIO_FUNC_UART);
+    hw->dmacr = UART_UARTDMACR_RXDMAE_BITS | UART_UARTDMACR_TXDMAE_BITS;
+
+    /* Only a FIFO overrun interrupts: the DMA takes every character. */
+    hw->imsc = UART_UARTIMSC_OEIM_BITS;
+    irq_set_exclusive_handler(UART_LINK_IRQ, uartIrqHandler);
+    irq_set_enabled(UART_LINK_IRQ, true);
+
+    /* Receive: UART data register into the ring, a ring-sized transfer */
+    /* per channel. Each channel starts the other when it completes,    */
+    /* and its write address has wrapped back to the ring start.        */
+    for (uint8_t i = 0; i < RX_DMA_NUM; i++)
+    {
+        gRxDma[i] = dma_claim_unused_channel(true);
+    }
+    for (uint8_t i = 0; i < RX_DMA_NUM; i++)
+    {
+        dma_channel_config cfg = dma_channel_get_default_config(gRxDma[i]);
+
+        channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+        channel_config_set_read_increment(&cfg, false);
+        channel_config_set_write_increment(&cfg, true);
+        channel_config_set_ring(&cfg, true, UART_LINK_RX_RING_BITS);
+        channel_config_set_dreq(&cfg, uart_get_dreq(UART_LINK_ID, false));
+        channel_config_set_chain_to(&cfg, gRxDma[(i + 1U) % RX_DMA_NUM]);
+        dma_channel_configure(gRxDma[i], &cfg, gRxRing, &hw->dr, UART_LINK_RX_RING_SIZE, false);
+
+        /* Each completed lap interrupts, to be counted. */
+        dma_channel_set_irq1_enabled(gRxDma[i], true);
+    }
+
+    /* Transmit: each buffer into the UART data register. */
+    for (uint8_t i = 0; i < TX_BUFF_NUM; i++)
+    {
+        gTxDma[i] = dma_claim_unused_channel(true);
+        gTxCfg[i] = dma_channel_get_default_config(gTxDma[i]);
+        channel_config_set_transfer_data_size(&gTxCfg[i], DMA_SIZE_8);
+        channel_config_set_read_increment(&gTxCfg[i], true);
+        channel_config_set_write_increment(&gTxCfg[i], false);
+        channel_config_set_dreq(&gTxCfg[i], uart_get_dreq(UART_LINK_ID, true));
+        dma_channel_configure(gTxDma[i], &gTxCfg[i], &hw->dr, gTxBuff[i], 0, false);
+
+        /* DMA_IRQ_0 is left for drivers of the CAN side. */
+        dma_channel_set_irq1_enabled(gTxDma[i], true);
+    }
+    irq_add_shared_handler(DMA_IRQ_1, dmaIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    /* Start receiving, and sample the write address to find batches. */
+    (void)add_repeating_timer_us(-(int64_t)UART_LINK_RX_SAMPLE_US, rxTimerCallback, NULL, &gRxTimer);
+    dma_channel_start(gRxDma[0]);
+}
+
+void uartLinkTask(void *nouse)
+{
+    gTaskHndl = xTaskGetCurrentTaskHandle();
+
+    while (true)
+    {
+        /* Woken by a received chunk, an idle line or a finished */
+        /* transmit buffer. The timeout polls the bridge.        */
+        (void)ulTaskNotifyTake(pdTRUE, UART_LINK_POLL_TICKS);
+
+        rxDrain();
+        txPump();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Private functions                                                          */
+/* -------------------------------------------------------------------------- */
+static void uartIrqHandler(void)
+{
+    uart_hw_t *hw = uart_get_hw(UART_LINK_ID);
+
+    traceRecord(TRACE_EV_ISR_ENTER, UART_LINK_IRQ, 0);
+
+    if (hw->mis & UART_UARTMIS_OEMIS_BITS)
+    {
+        statsInc(STAT_UART_RX_OVERRUNS);
+    }
+    hw->icr = UART_UARTICR_OEIC_BITS;
+
+    traceRecord(TRACE_EV_ISR_EXIT, UART_LINK_IRQ, 0);
+}
+
+static void dmaIrqHandler(void)
+{
+    BaseType_t isWoken = pdFALSE;
+    bool isEvent = false;
+
+    traceRecord(TRACE_EV_ISR_ENTER, DMA_IRQ_1, 0);
+
+    /* A lap is counted before its flag clears, so rxLaps() never sees */
+    /* it missing from both.                                           */
+    for (uint8_t i = 0; i < RX_DMA_NUM; i++)
+    {
+        if (dma_channel_get_irq1_status(gRxDma[i]))
+        {
+            gRxLaps++;
+            dma_channel_acknowledge_irq1(gRxDma[i]);
+        }
+    }
+
+    for (uint8_t i = 0; i < TX_BUFF_NUM; i++)
+    {
+        if (dma_channel_get_irq1_status(gTxDma[i]))
+        {
+            UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+
+            dma_channel_acknowledge_irq1(gTxDma[i]);
+
+            /* The next buffer, if chained, is already on the wire. Unchain */
+            /* this one so its next completion does not restart the other.  */
+            channel_config_set_chain_to(&gTxCfg[i], gTxDma[i]);
+            dma_channel_set_config(gTxDma[i], &gTxCfg[i], false);
+            gTxLen[i] = 0;
+
+            taskEXIT_CRITICAL_FROM_ISR(state);
+            isEvent = true;
+        }
+    }
+
+    if (isEvent && (gTaskHndl != NULL))
+    {
+        vTaskNotifyGiveFromISR(gTaskHndl, &isWoken);
+    }
+
+    traceRecord(TRACE_EV_ISR_EXIT, DMA_IRQ_1, 0);
+    portYIELD_FROM_ISR(isWoken);
+}
+
+static bool rxTimerCallback(repeating_timer_t *timer)
+{
+    uint32_t head = rxProduced();
+    bool isIdle = head == gRxHead;
+    BaseType_t isWoken = pdFALSE;
+
+    (void)timer;
+    gRxHead = head;
+
+    /* Hand over a full chunk, or a partial batch once a whole sample */
+    /* period went by without a character.                            */
+    if ((head != gRxNotified) && (isIdle || ((head - gRxNotified) >= UART_LINK_RX_CHUNK)) && (gTaskHndl != NULL))
+    {
+        gRxNotified = head;
+        vTaskNotifyGiveFromISR(gTaskHndl, &isWoken);
+    }
+
+    portYIELD_FROM_ISR(isWoken);
+
+    return true;
+}
+
+/* Bytes written into the ring since the start. The idle channel's */
+/* write address rests at the ring start, so the two offsets add   */
+/* up to the busy one's. A lap ending between the reads retries.   */
+static uint32_t rxProduced(void)
+{
+    uint32_t laps;
+    uint32_t offset;
+
+    do
+    {
+        laps = rxLaps();
+        offset = 0;
+        for (uint8_t i = 0; i < RX_DMA_NUM; i++)
+        {
+            offset += (uint32_t)(dma_channel_hw_addr(gRxDma[i])->write_addr - (uintptr_t)gRxRing);
+        }
+    } while (laps != rxLaps());
+
+    return laps * UART_LINK_RX_RING_SIZE + (offset & (UART_LINK_RX_RING_SIZE - 1U));
+}
+
+/* Completed laps, with those whose interrupt has not run yet. */
+static uint32_t rxLaps(void)
+{
+    uint32_t laps = gRxLaps;
+
+    for (uint8_t i = 0; i < RX_DMA_NUM; i++)
+    {
+        laps += dma_channel_get_irq1_status(gRxDma[i]) ? 1U : 0U;
+    }
+
+    return laps;
+}
+
+static void rxDrain(void)
+{
+    uint32_t produced = gRxHead;
+    uint32_t pending = produced - gRxConsumed;
+
+    if (pending > UART_LINK_RX_RING_SIZE)
+    {
+        /* The ring lapped the reader. Skip to the oldest intact byte. */
+        statsInc(STAT_UART_RX_OVERRUNS);
+        gRxConsumed = produced - UART_LINK_RX_RING_SIZE;
+        pending = UART_LINK_RX_RING_SIZE;
+    }
+
+    while (pending > 0)
+    {
+        uint32_t pos = gRxConsumed & (UART_LINK_RX_RING_SIZE - 1U);
+        uint32_t chunk = UART_LINK_RX_RING_SIZE - pos;
+
+        if (chunk > pending)
+        {
+            chunk = pending;
+        }
+
+        bridgeHostInput(BRIDGE_LINK_UART, &gRxRing[pos], chunk);
+
+        gRxConsumed += chunk;
+        statsAdd(STAT_UART_RX_BYTES, chunk);
+        pending -= chunk;
+    }
+}
+
+static void txPump(void)
+{
+    /* Buffers are filled, and so sent, in turn. */
+    while (gTxLen[gTxFill] == 0)
+    {
+        uint8_t index = gTxFill;
+        uint8_t other = index ^ 1U;
+        dma_channel_hw_t *ch = dma_channel_hw_addr(gTxDma[index]);
+        uint32_t count = bridgeHostOutput(BRIDGE_LINK_UART, gTxBuff[index], UART_LINK_TX_BUFF_SIZE);
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        taskENTER_CRITICAL();
+        gTxLen[index] = count;
+        dma_channel_set_read_addr(gTxDma[index], gTxBuff[index], false);
+        dma_channel_set_trans_count(gTxDma[index], count, false);
+
+        if (dma_channel_is_busy(gTxDma[other]))
+        {
+            /* Chain behind the buffer on the wire. */
+            channel_config_set_chain_to(&gTxCfg[other], gTxDma[index]);
+            dma_channel_set_config(gTxDma[other], &gTxCfg[other], false);
+
+            /* If it finished before the chain was set, nothing read this */
+            /* buffer yet and it has to be started here.                  */
+            if (!dma_channel_is_busy(gTxDma[other]) && !dma_channel_is_busy(gTxDma[index]) &&
+                (ch->read_addr == (uintptr_t)gTxBuff[index]))
+            {
+                dma_channel_start(gTxDma[index]);
+            }
+        }
+        else
+        {
+            dma_channel_start(gTxDma[index]);
+        }
+        taskEXIT_CRITICAL();
+
+        gTxFill = other;
+        statsAdd(STAT_UART_TX_BYTES, count);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+/* -------------------------------------------------------------------------- */
+/* Include                                                                    */
+/* -------------------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* -------------------------------------------------------------------------- */
+/* Macro                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* UART instance and pins of the host link. */
+#define UART_LINK_ID (uart0)
+#define UART_LINK_IRQ (UART0_IRQ)
+#define UART_LINK_TX_PIN (0U)
+#define UART_LINK_RX_PIN (1U)
+
+/* Up to clk_peri / 16, 7812500 baud at 125 MHz. */
+#ifndef UART_LINK_BAUDRATE
+#define UART_LINK_BAUDRATE (3000000U)
+#endif
+
+/* Receive ring size. Must be a power of two. */
+#define UART_LINK_RX_RING_BITS (10U)
+#define UART_LINK_RX_RING_SIZE (1U << UART_LINK_RX_RING_BITS)
+
+/* The task is woken each time this much was received while the line */
+/* stays busy, and once it goes idle.                                */
+#define UART_LINK_RX_CHUNK (UART_LINK_RX_RING_SIZE / 4U)
+
+/* Period of the timer sampling the receive DMA. The line counts as  */
+/* idle after one period without a character, so a batch is handed   */
+/* over within two. The ring holds 3.4 ms at 3 Mbaud, far longer.    */
+#define UART_LINK_RX_SAMPLE_US (40U)
+
+/* Size of each of the two transmit buffers. */
+#define UART_LINK_TX_BUFF_SIZE (256U)
+
+/* The bridge is polled for output this often, as the CDC task does. */
+#define UART_LINK_POLL_TICKS (1U)
+
+/* -------------------------------------------------------------------------- */
+/* Prototype                                                                  */
+/* -------------------------------------------------------------------------- */
+void uartLinkInit(void);
+void uartLinkTask(void *nouse);
+
+#endif /* UART_LINK_H */
@@ -60,6 +60,14 @@ enum
 {
     ITF_NUM_CDC_0 = 0,
     ITF_NUM_CDC_0_DATA,
+#if CFG_TUD_CDC > 1
+    ITF_NUM_CDC_1,
+    ITF_NUM_CDC_1_DATA,
+#endif
+#if CFG_TUD_CDC > 2
+    ITF_NUM_CDC_2,
+    ITF_NUM_CDC_2_DATA,
+#endif
     ITF_NUM_TOTAL
 };
 
@@ -69,6 +77,14 @@ enum
 #define EPNUM_CDC_0_OUT (0x02)
 #define EPNUM_CDC_0_IN (0x82)
 
+#define EPNUM_CDC_1_NOTIF (0x83)
+#define EPNUM_CDC_1_OUT (0x04)
+#define EPNUM_CDC_1_IN (0x84)
+
+#define EPNUM_CDC_2_NOTIF (0x85)
+#define EPNUM_CDC_2_OUT (0x06)
+#define EPNUM_CDC_2_IN (0x86)
+
 uint8_t const desc_fs_configuration[] =
     {
         /* Config number, interface count, string index, total length, attribute, power in mA */
@@ -76,6 +92,16 @@ uint8_t const desc_fs_configuration[] =
 
         /* 1st CDC: Interface number, string index, EP notification address and size, EP data address (out, in) and size. */
         TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, 4, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, 64),
+
+#if CFG_TUD_CDC > 1
+        /* 2nd CDC: One interface per CAN channel. */
+        TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, 5, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, 64),
+#endif
+
+#if CFG_TUD_CDC > 2
+        /* 3rd CDC: One interface per CAN channel. */
+        TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_2, 6, EPNUM_CDC_2_NOTIF, 8, EPNUM_CDC_2_OUT, EPNUM_CDC_2_IN, 64),
+#endif
 };
 
 /* Invoked when received GET CONFIGURATION DESCRIPTOR */
@@ -109,6 +135,8 @@ char const *string_desc_arr[] =
         "TinyUSB Device",           /* 2: Product                                   */
         NULL,                       /* 3: Serials will use unique ID if possible    */
         "TinyUSB CDC",              /* 4: CDC Interface                             */
+        "TinyUSB CDC 1",            /* 5: CDC Interface of channel 1                */
+        "TinyUSB CDC 2",            /* 6: CDC Interface of channel 2                */
 };
 
 static uint16_t _desc_str[32 + 1];